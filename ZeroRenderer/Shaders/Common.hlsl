@@ -42,6 +42,31 @@ Texture2D gTextureMaps[10] : register(t3);
 // The texture array will occupy registers t0, t1, ..., t3 in space0. 
 StructuredBuffer<MaterialData> gMaterialData : register(t0, space1);
 
+// Per-object data of every item, by object index, tightly packed.
+struct ObjectData
+{
+	float4x4 World;
+	float4x4 TexTransform;
+	uint     MaterialIndex;
+};
+
+StructuredBuffer<ObjectData> gObjectData : register(t2, space1);
+
+// The object index of every instance of the frame.
+StructuredBuffer<uint> gInstanceObjects : register(t1, space1);
+
+// Root constant set per draw, or per command of an indirect draw.
+cbuffer cbDrawConstants : register(b0)
+{
+	uint gInstanceBase;
+};
+
+// A draw's instances start at gInstanceBase in gInstanceObjects.
+ObjectData GetObjectData(uint instanceID)
+{
+	return gObjectData[gInstanceObjects[gInstanceBase + instanceID]];
+}
+
 
 SamplerState gsamPointWrap        : register(s0);
 SamplerState gsamPointClamp       : register(s1);
@@ -51,17 +76,6 @@ SamplerState gsamAnisotropicWrap  : register(s4);
 SamplerState gsamAnisotropicClamp : register(s5);
 SamplerComparisonState gsamShadow : register(s6);
 
-// Constant data that varies per frame.
-cbuffer cbPerObject : register(b0)
-{
-    float4x4 gWorld;
-	float4x4 gTexTransform;
-	uint gMaterialIndex;
-	uint gObjPad0;
-	uint gObjPad1;
-	uint gObjPad2;
-};
-
 // Constant data that varies per material.
 cbuffer cbPass : register(b1)
 {
@@ -0,0 +1,29 @@
+//=============================================================================
+// Applies the delta packets built by SceneDeltaBuilder to the scene buffer.
+// One group copies one packet: the header tells where its payload sits in
+// the upload and where it goes in the scene buffer.
+//=============================================================================
+
+cbuffer cbScatter : register(b0)
+{
+	uint gFirstPacket;
+};
+
+// Packet headers (DestOffset, SrcOffset, ByteCount) followed by the payload.
+ByteAddressBuffer gDeltas : register(t0);
+
+RWByteAddressBuffer gScene : register(u0);
+
+#define ScatterThreads 64
+
+[numthreads(ScatterThreads, 1, 1)]
+void CS(uint3 groupID : SV_GroupID, uint3 threadID : SV_GroupThreadID)
+{
+	uint3 packet = gDeltas.Load3((gFirstPacket + groupID.x) * 12);
+
+	// Neighbouring threads copy neighbouring words.
+	for (uint offset = threadID.x * 4; offset < packet.z; offset += ScatterThreads * 4)
+	{
+		gScene.Store(packet.x + offset, gDeltas.Load(packet.y + offset));
+	}
+}
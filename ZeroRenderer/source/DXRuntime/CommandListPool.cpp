@@ -0,0 +1,48 @@
+#include "CommandListPool.h"
+
+#include <cassert>
+
+CommandListPool::CommandListPool(ID3D12Device* device) : mDevice(device)
+{
+}
+
+void CommandListPool::Reset(UINT count)
+{
+	while (mLists.size() < count)
+	{
+		Entry entry;
+		ThrowIfFailed(mDevice->CreateCommandAllocator(
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			IID_PPV_ARGS(entry.Allocator.GetAddressOf())));
+
+		ThrowIfFailed(mDevice->CreateCommandList(
+			0,
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			entry.Allocator.Get(),
+			nullptr,
+			IID_PPV_ARGS(entry.List.GetAddressOf())));
+
+		// Lists are created open; Open expects them closed.
+		ThrowIfFailed(entry.List->Close());
+
+		mLists.push_back(std::move(entry));
+	}
+
+	mCount = count;
+}
+
+CommandListHandle CommandListPool::Open(UINT index)
+{
+	assert(index < mCount);
+	return { mLists[index].Allocator.Get(), mLists[index].List.Get() };
+}
+
+void CommandListPool::Execute(ID3D12CommandQueue* queue)
+{
+	mSubmit.clear();
+	for (UINT i = 0; i < mCount; ++i)
+		mSubmit.push_back(mLists[i].List.Get());
+
+	if (!mSubmit.empty())
+		queue->ExecuteCommandLists((UINT)mSubmit.size(), mSubmit.data());
+}
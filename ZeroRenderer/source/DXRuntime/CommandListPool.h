@@ -0,0 +1,54 @@
+#pragma once
+
+//
+// The direct command lists of a frame resource.
+//
+// Each list has an allocator of its own, so lists can be recorded on
+// different threads at once. The pool only grows: Reset asks for as many
+// lists as the frame will record, creating the ones missing, and the
+// allocators are reused once the frame resource's fence has completed.
+// Execute submits the lists in index order with one ExecuteCommandLists,
+// so the order of the indices is the order the GPU runs them in.
+//
+
+#include "../Common/d3dUtil.h"
+
+#include "CommandListHandle.h"
+
+#include <vector>
+
+class CommandListPool
+{
+public:
+	explicit CommandListPool(ID3D12Device* device);
+
+	CommandListPool(const CommandListPool& rhs) = delete;
+	CommandListPool& operator=(const CommandListPool& rhs) = delete;
+
+	// Starts a frame of count lists. The GPU must be done with the last one.
+	void Reset(UINT count);
+
+	UINT Count() const { return mCount; }
+
+	// Resets list index for recording; the handle closes it. Different
+	// lists may be opened and recorded on different threads.
+	CommandListHandle Open(UINT index);
+
+	ID3D12GraphicsCommandList* List(UINT index) const { return mLists[index].List.Get(); }
+
+	// Submits the frame's lists, all closed, in index order.
+	void Execute(ID3D12CommandQueue* queue);
+
+private:
+	struct Entry
+	{
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> Allocator;
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> List;
+	};
+
+	ID3D12Device* mDevice = nullptr;
+
+	std::vector<Entry> mLists;
+	std::vector<ID3D12CommandList*> mSubmit;
+	UINT mCount = 0;
+};
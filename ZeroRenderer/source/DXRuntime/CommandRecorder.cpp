@@ -0,0 +1,225 @@
+#include "CommandRecorder.h"
+
+#include <cstring>
+
+const char* CommandRecorder::CallName(Call call)
+{
+	switch (call)
+	{
+	case Call::RootSignature:     return "root signature";
+	case Call::PipelineState:     return "PSO";
+	case Call::DescriptorHeaps:   return "descriptor heaps";
+	case Call::PrimitiveTopology: return "topology";
+	case Call::VertexBuffers:     return "vertex buffers";
+	case Call::IndexBuffer:       return "index buffer";
+	case Call::RootArgument:      return "root arguments";
+	default:                      return "";
+	}
+}
+
+uint32_t CommandRecorder::Stats::TotalIssued() const
+{
+	uint32_t total = 0;
+	for (uint32_t n : Issued)
+		total += n;
+	return total;
+}
+
+uint32_t CommandRecorder::Stats::TotalFiltered() const
+{
+	uint32_t total = 0;
+	for (uint32_t n : Filtered)
+		total += n;
+	return total;
+}
+
+CommandRecorder::Stats& CommandRecorder::Stats::operator+=(const Stats& rhs)
+{
+	for (int call = 0; call < (int)Call::Count; ++call)
+	{
+		Issued[call] += rhs.Issued[call];
+		Filtered[call] += rhs.Filtered[call];
+	}
+	return *this;
+}
+
+void CommandRecorder::Begin(ID3D12GraphicsCommandList* cmdList)
+{
+	mCmdList = cmdList;
+	mStats = Stats();
+	Invalidate();
+}
+
+void CommandRecorder::Invalidate()
+{
+	mRootSignature = nullptr;
+	mPipelineState = nullptr;
+	std::memset(mHeaps, 0, sizeof(mHeaps));
+	mHeapCount = 0;
+
+	// UNDEFINED is never bound on purpose, so the next topology differs.
+	mTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	std::memset(mVertexBuffers, 0, sizeof(mVertexBuffers));
+	std::memset(&mIndexBuffer, 0, sizeof(mIndexBuffer));
+
+	for (RootArgument& argument : mRootArguments)
+		argument = RootArgument();
+}
+
+bool CommandRecorder::Record(Call call, bool changed)
+{
+	if (changed)
+		++mStats.Issued[(int)call];
+	else
+		++mStats.Filtered[(int)call];
+	return changed;
+}
+
+void CommandRecorder::SetGraphicsRootSignature(ID3D12RootSignature* rootSignature)
+{
+	if (!Record(Call::RootSignature, rootSignature != mRootSignature))
+		return;
+
+	mCmdList->SetGraphicsRootSignature(rootSignature);
+	mRootSignature = rootSignature;
+
+	// A new root signature starts with no arguments bound.
+	for (RootArgument& argument : mRootArguments)
+		argument = RootArgument();
+}
+
+void CommandRecorder::SetPipelineState(ID3D12PipelineState* pso)
+{
+	if (!Record(Call::PipelineState, pso != mPipelineState))
+		return;
+
+	mCmdList->SetPipelineState(pso);
+	mPipelineState = pso;
+}
+
+void CommandRecorder::SetDescriptorHeaps(UINT count, ID3D12DescriptorHeap* const* heaps)
+{
+	bool changed = count != mHeapCount || count > MaxDescriptorHeaps ||
+		std::memcmp(heaps, mHeaps, count * sizeof(*heaps)) != 0;
+	if (!Record(Call::DescriptorHeaps, changed))
+		return;
+
+	mCmdList->SetDescriptorHeaps(count, heaps);
+
+	// Tables into the old heaps are no longer valid.
+	for (RootArgument& argument : mRootArguments)
+	{
+		if (argument.Kind == RootKind::Table)
+			argument = RootArgument();
+	}
+
+	if (count <= MaxDescriptorHeaps)
+	{
+		std::memcpy(mHeaps, heaps, count * sizeof(*heaps));
+		mHeapCount = count;
+	}
+	else
+	{
+		mHeapCount = 0;
+	}
+}
+
+void CommandRecorder::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+	if (!Record(Call::PrimitiveTopology, topology != mTopology))
+		return;
+
+	mCmdList->IASetPrimitiveTopology(topology);
+	mTopology = topology;
+}
+
+void CommandRecorder::IASetVertexBuffers(UINT startSlot, UINT count, const D3D12_VERTEX_BUFFER_VIEW* views)
+{
+	bool tracked = startSlot + count <= MaxVertexBuffers;
+	bool changed = !tracked || std::memcmp(views, mVertexBuffers + startSlot, count * sizeof(*views)) != 0;
+	if (!Record(Call::VertexBuffers, changed))
+		return;
+
+	mCmdList->IASetVertexBuffers(startSlot, count, views);
+
+	if (tracked)
+		std::memcpy(mVertexBuffers + startSlot, views, count * sizeof(*views));
+	else
+		std::memset(mVertexBuffers, 0, sizeof(mVertexBuffers));
+}
+
+void CommandRecorder::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view)
+{
+	if (!Record(Call::IndexBuffer, std::memcmp(view, &mIndexBuffer, sizeof(*view)) != 0))
+		return;
+
+	mCmdList->IASetIndexBuffer(view);
+	mIndexBuffer = *view;
+}
+
+void CommandRecorder::SetRootArgument(UINT index, RootKind kind, uint64_t value)
+{
+	if (index < MaxRootParameters)
+		mRootArguments[index] = { kind, value };
+}
+
+void CommandRecorder::SetGraphicsRootConstantBufferView(UINT index, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	bool changed = index >= MaxRootParameters ||
+		mRootArguments[index].Kind != RootKind::ConstantBuffer || mRootArguments[index].Value != address;
+	if (!Record(Call::RootArgument, changed))
+		return;
+
+	mCmdList->SetGraphicsRootConstantBufferView(index, address);
+	SetRootArgument(index, RootKind::ConstantBuffer, address);
+}
+
+void CommandRecorder::SetGraphicsRootShaderResourceView(UINT index, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	bool changed = index >= MaxRootParameters ||
+		mRootArguments[index].Kind != RootKind::ShaderResource || mRootArguments[index].Value != address;
+	if (!Record(Call::RootArgument, changed))
+		return;
+
+	mCmdList->SetGraphicsRootShaderResourceView(index, address);
+	SetRootArgument(index, RootKind::ShaderResource, address);
+}
+
+void CommandRecorder::SetGraphicsRootDescriptorTable(UINT index, D3D12_GPU_DESCRIPTOR_HANDLE table)
+{
+	bool changed = index >= MaxRootParameters ||
+		mRootArguments[index].Kind != RootKind::Table || mRootArguments[index].Value != table.ptr;
+	if (!Record(Call::RootArgument, changed))
+		return;
+
+	mCmdList->SetGraphicsRootDescriptorTable(index, table);
+	SetRootArgument(index, RootKind::Table, table.ptr);
+}
+
+void CommandRecorder::SetGraphicsRoot32BitConstant(UINT index, UINT value, UINT destOffset)
+{
+	// Only the last constant set in a parameter is remembered.
+	uint64_t packed = (uint64_t)destOffset << 32 | value;
+	bool changed = index >= MaxRootParameters ||
+		mRootArguments[index].Kind != RootKind::Constant || mRootArguments[index].Value != packed;
+	if (!Record(Call::RootArgument, changed))
+		return;
+
+	mCmdList->SetGraphicsRoot32BitConstant(index, value, destOffset);
+	SetRootArgument(index, RootKind::Constant, packed);
+}
+
+void CommandRecorder::ExecuteIndirect(ID3D12CommandSignature* signature, UINT maxCommandCount,
+	ID3D12Resource* argumentBuffer, UINT64 argumentBufferOffset)
+{
+	mCmdList->ExecuteIndirect(signature, maxCommandCount, argumentBuffer, argumentBufferOffset, nullptr, 0);
+
+	std::memset(mVertexBuffers, 0, sizeof(mVertexBuffers));
+	std::memset(&mIndexBuffer, 0, sizeof(mIndexBuffer));
+
+	for (RootArgument& argument : mRootArguments)
+	{
+		if (argument.Kind == RootKind::Constant)
+			argument = RootArgument();
+	}
+}
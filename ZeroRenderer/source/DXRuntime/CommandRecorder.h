@@ -0,0 +1,111 @@
+#pragma once
+
+//
+// State-caching wrapper of a graphics command list.
+//
+// The recorder remembers the root signature, PSO, descriptor heaps, input
+// assembler state and root arguments it last bound, and drops the calls that
+// would bind them again. Only the calls made through its own methods are
+// tracked; anything else goes to the list through operator->. Code that
+// changes tracked state on the raw list (Ssao, ImGui) must be followed by
+// Invalidate.
+//
+
+#include "../Common/d3dUtil.h"
+
+#include <cstdint>
+
+class CommandRecorder
+{
+public:
+	enum class Call
+	{
+		RootSignature,
+		PipelineState,
+		DescriptorHeaps,
+		PrimitiveTopology,
+		VertexBuffers,
+		IndexBuffer,
+		RootArgument,   // root constants, CBVs, SRVs and descriptor tables
+		Count
+	};
+
+	static const char* CallName(Call call);
+
+	// Calls made through the recorder since Begin, and how many of them were
+	// dropped because they would not have changed anything.
+	struct Stats
+	{
+		uint32_t Issued[(int)Call::Count] = {};
+		uint32_t Filtered[(int)Call::Count] = {};
+
+		uint32_t TotalIssued() const;
+		uint32_t TotalFiltered() const;
+
+		// Sums the stats of several recorders.
+		Stats& operator+=(const Stats& rhs);
+	};
+
+	// Starts recording into a list, forgetting whatever was bound to it
+	// before. Clears the stats.
+	void Begin(ID3D12GraphicsCommandList* cmdList);
+
+	// Forgets the bound state, so the next call of every kind is issued.
+	void Invalidate();
+
+	ID3D12GraphicsCommandList* Get() const { return mCmdList; }
+	ID3D12GraphicsCommandList* operator->() const { return mCmdList; }
+
+	void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature);
+	void SetPipelineState(ID3D12PipelineState* pso);
+	void SetDescriptorHeaps(UINT count, ID3D12DescriptorHeap* const* heaps);
+
+	void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology);
+	void IASetVertexBuffers(UINT startSlot, UINT count, const D3D12_VERTEX_BUFFER_VIEW* views);
+	void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view);
+
+	void SetGraphicsRootConstantBufferView(UINT index, D3D12_GPU_VIRTUAL_ADDRESS address);
+	void SetGraphicsRootShaderResourceView(UINT index, D3D12_GPU_VIRTUAL_ADDRESS address);
+	void SetGraphicsRootDescriptorTable(UINT index, D3D12_GPU_DESCRIPTOR_HANDLE table);
+	void SetGraphicsRoot32BitConstant(UINT index, UINT value, UINT destOffset);
+
+	// The commands may set the vertex and index buffers and root constants,
+	// which are left undefined afterwards, so they are forgotten.
+	void ExecuteIndirect(ID3D12CommandSignature* signature, UINT maxCommandCount,
+		ID3D12Resource* argumentBuffer, UINT64 argumentBufferOffset);
+
+	const Stats& GetStats() const { return mStats; }
+
+private:
+	static constexpr UINT MaxVertexBuffers = 4;
+	static constexpr UINT MaxRootParameters = 16;
+	static constexpr UINT MaxDescriptorHeaps = 2;
+
+	enum class RootKind : uint8_t { None, ConstantBuffer, ShaderResource, Table, Constant };
+
+	struct RootArgument
+	{
+		RootKind Kind = RootKind::None;
+		uint64_t Value = 0;
+	};
+
+	// Counts the call; returns true if it has to reach the list.
+	bool Record(Call call, bool changed);
+
+	void SetRootArgument(UINT index, RootKind kind, uint64_t value);
+
+	ID3D12GraphicsCommandList* mCmdList = nullptr;
+
+	ID3D12RootSignature* mRootSignature = nullptr;
+	ID3D12PipelineState* mPipelineState = nullptr;
+	ID3D12DescriptorHeap* mHeaps[MaxDescriptorHeaps] = {};
+	UINT mHeapCount = 0;
+
+	D3D12_PRIMITIVE_TOPOLOGY mTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	D3D12_VERTEX_BUFFER_VIEW mVertexBuffers[MaxVertexBuffers] = {};
+	D3D12_INDEX_BUFFER_VIEW mIndexBuffer = {};
+
+	RootArgument mRootArguments[MaxRootParameters];
+
+	Stats mStats;
+};
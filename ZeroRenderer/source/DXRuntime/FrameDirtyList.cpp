@@ -0,0 +1,48 @@
+#include "FrameDirtyList.h"
+
+#include <cassert>
+
+FrameDirtyList::FrameDirtyList(int frameCount) :
+	mLists(frameCount)
+{
+	assert(frameCount > 0 && frameCount <= 32);
+	mAllFrames = frameCount == 32 ? ~0u : (1u << frameCount) - 1;
+}
+
+void FrameDirtyList::Mark(uint32_t index)
+{
+	if (index >= mQueued.size())
+		mQueued.resize(index + 1, 0);
+
+	uint32_t missing = mAllFrames & ~mQueued[index];
+	if (missing == 0)
+		return;
+
+	for (int frame = 0; frame < FrameCount(); ++frame)
+	{
+		if (missing & (1u << frame))
+			mLists[frame].push_back(index);
+	}
+	mQueued[index] = mAllFrames;
+}
+
+void FrameDirtyList::MarkAll(uint32_t count)
+{
+	for (uint32_t index = 0; index < count; ++index)
+		Mark(index);
+}
+
+void FrameDirtyList::Discard(int frame)
+{
+	const uint32_t bit = 1u << frame;
+	for (uint32_t index : mLists[frame])
+		mQueued[index] &= ~bit;
+	mLists[frame].clear();
+}
+
+void FrameDirtyList::Clear()
+{
+	for (auto& list : mLists)
+		list.clear();
+	mQueued.clear();
+}
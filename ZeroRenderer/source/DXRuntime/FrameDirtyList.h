@@ -0,0 +1,58 @@
+#pragma once
+
+//
+// Change tracking for data that every frame resource keeps a copy of.
+//
+// Each frame resource has its own list of the dense indices whose copy is
+// stale. Mark queues an index once on every list that does not hold it yet,
+// and a frame resource drains only its own list when it is updated, so the
+// cost of an update follows the number of changes rather than the number of
+// elements.
+//
+
+#include <cstdint>
+#include <vector>
+
+class FrameDirtyList
+{
+public:
+	explicit FrameDirtyList(int frameCount);
+
+	// Queues index on the list of every frame resource.
+	void Mark(uint32_t index);
+
+	// Queues the indices [0, count).
+	void MarkAll(uint32_t count);
+
+	// Invokes f(uint32_t index) for every index queued for the frame resource,
+	// in the order they were queued, and empties its list.
+	template<typename F>
+	void Drain(int frame, F&& f)
+	{
+		const uint32_t bit = 1u << frame;
+		for (uint32_t index : mLists[frame])
+		{
+			mQueued[index] &= ~bit;
+			f(index);
+		}
+		mLists[frame].clear();
+	}
+
+	// Empties the list of the frame resource without visiting it, e.g. once
+	// it was given everything.
+	void Discard(int frame);
+
+	void Clear();
+
+	size_t Pending(int frame) const { return mLists[frame].size(); }
+
+	int FrameCount() const { return (int)mLists.size(); }
+
+private:
+	std::vector<std::vector<uint32_t>> mLists;
+
+	// bit f is set while the index is on list f
+	std::vector<uint32_t> mQueued;
+
+	uint32_t mAllFrames;
+};
@@ -0,0 +1,113 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace
+{
+	// The timer may wake this much late; the rest of a sleep is spun.
+	constexpr double SpinSeconds = 0.001;
+}
+
+FramePacer::FramePacer(ID3D12Fence* fence, int framesInFlight) :
+	mFence(fence),
+	mStart(std::chrono::steady_clock::now()),
+	mScheduler(framesInFlight)
+{
+	mFenceEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+	if (mFenceEvent == nullptr)
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
+	// Available since Windows 10 1803; plain timers round up to the
+	// scheduler tick, so without one the sleeps are spun.
+	mTimer = CreateWaitableTimerEx(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+}
+
+FramePacer::~FramePacer()
+{
+	if (mTimer != nullptr)
+		CloseHandle(mTimer);
+	CloseHandle(mFenceEvent);
+}
+
+void FramePacer::BeginFrame(UINT64 mustComplete)
+{
+	double start = Now();
+	mScheduler.Complete(mFence->GetCompletedValue(), start, false);
+
+	UINT64 waitFence = std::max<UINT64>(mScheduler.WaitFence(), mustComplete);
+	if (mFence->GetCompletedValue() < waitFence)
+	{
+		WaitForFence(waitFence);
+		mScheduler.Complete(waitFence, Now(), true);
+	}
+
+	double awake = Now();
+	UINT64 wakeFence = mScheduler.WakeFence();
+	if (SleepUntil(mScheduler.SampleTime(awake), wakeFence))
+		mScheduler.Complete(wakeFence, Now(), true);
+
+	double sample = Now();
+	mScheduler.BeginFrame(sample);
+
+	mWaitMilliseconds = float((awake - start) * 1000.0);
+	mSleepMilliseconds = float((sample - awake) * 1000.0);
+}
+
+void FramePacer::EndFrame(UINT64 fence)
+{
+	mScheduler.Submit(fence, Now());
+}
+
+void FramePacer::WaitForFence(UINT64 value)
+{
+	// The event may still be signaled for a wake fence that completed after
+	// its sleep ended, so the fence is checked again on every wake-up.
+	while (mFence->GetCompletedValue() < value)
+	{
+		ThrowIfFailed(mFence->SetEventOnCompletion(value, mFenceEvent));
+		WaitForSingleObject(mFenceEvent, INFINITE);
+	}
+}
+
+double FramePacer::Now() const
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+}
+
+bool FramePacer::SleepUntil(double time, UINT64 wakeFence)
+{
+	auto woken = [&] { return wakeFence != 0 && mFence->GetCompletedValue() >= wakeFence; };
+
+	double remaining = time - Now();
+	if (mTimer != nullptr && remaining > SpinSeconds)
+	{
+		// Relative due times are negative, in 100 ns units.
+		LARGE_INTEGER due;
+		due.QuadPart = -(LONGLONG)((remaining - SpinSeconds) * 1e7);
+		if (SetWaitableTimer(mTimer, &due, 0, nullptr, nullptr, FALSE))
+		{
+			HANDLE handles[] = { mTimer, mFenceEvent };
+			DWORD count = 1;
+			if (wakeFence != 0)
+			{
+				ThrowIfFailed(mFence->SetEventOnCompletion(wakeFence, mFenceEvent));
+				count = 2;
+			}
+
+			if (WaitForMultipleObjects(count, handles, FALSE, INFINITE) != WAIT_OBJECT_0)
+				CancelWaitableTimer(mTimer);
+		}
+	}
+
+	while (Now() < time)
+	{
+		if (woken())
+			return true;
+		YieldProcessor();
+	}
+	return false;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+//
+// Frame pacing on a fence.
+//
+// Runs a FrameScheduler against the real fence and clock: BeginFrame waits
+// on the fence for as long as the scheduler asks, then sleeps until the
+// frame should sample its input or the scheduler's wake fence completes;
+// EndFrame reports the submission. Waits go through one event made at
+// construction, and sleeps end on time to a few microseconds: a
+// high-resolution waitable timer covers all but the last millisecond, which
+// is spun.
+//
+
+#include "../Common/d3dUtil.h"
+
+#include "FrameScheduler.h"
+
+#include <chrono>
+
+class FramePacer
+{
+public:
+	FramePacer(ID3D12Fence* fence, int framesInFlight);
+	~FramePacer();
+
+	FramePacer(const FramePacer& rhs) = delete;
+	FramePacer& operator=(const FramePacer& rhs) = delete;
+
+	// Call before the frame reads any input. mustComplete is a fence the
+	// frame needs completed regardless, such as its frame resource's.
+	void BeginFrame(UINT64 mustComplete);
+
+	// Call once the frame's last command list is submitted and fence signaled.
+	void EndFrame(UINT64 fence);
+
+	// Blocks until the GPU reaches value.
+	void WaitForFence(UINT64 value);
+
+	FrameScheduler& Scheduler() { return mScheduler; }
+	const FrameScheduler& Scheduler() const { return mScheduler; }
+
+	// Time the last BeginFrame spent blocked on the fence and asleep.
+	float GetWaitMilliseconds() const { return mWaitMilliseconds; }
+	float GetSleepMilliseconds() const { return mSleepMilliseconds; }
+
+private:
+	// Seconds since construction.
+	double Now() const;
+
+	// Returns true if wakeFence, unless 0, completed before time.
+	bool SleepUntil(double time, UINT64 wakeFence);
+
+	ID3D12Fence* mFence = nullptr;
+	HANDLE mFenceEvent = nullptr;
+	HANDLE mTimer = nullptr;     // null where high-resolution timers are missing
+
+	std::chrono::steady_clock::time_point mStart;
+
+	FrameScheduler mScheduler;
+
+	float mWaitMilliseconds = 0.0f;
+	float mSleepMilliseconds = 0.0f;
+};
@@ -1,29 +1,13 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, 
-                             UINT materialCount, Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> cmdList,
-                             UINT maxInstanceCount) : CmdList(cmdList)
+FrameResource::FrameResource(ID3D12Device* device, UINT64 uploadSize)
 {
-    // create the own commandAllocator
-    ThrowIfFailed(device->CreateCommandAllocator(
-        D3D12_COMMAND_LIST_TYPE_DIRECT,
-        IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
+    CommandLists = std::make_unique<CommandListPool>(device);
 
-    PassCB         = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-
-    ObjectCB       = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
-
-    SsaoCB         = std::make_unique<UploadBuffer<SsaoConstants>>(device, 1, true);
-
-    MaterialBuffer = std::make_unique<UploadBuffer<MaterialData>>(device, maxInstanceCount, false);
+    Uploads = std::make_unique<UploadAllocator>(device, uploadSize);
 }
 
 FrameResource::~FrameResource()
 {
 
 }
-
-CommandListHandle FrameResource::Command()
-{
-    return { CmdListAlloc.Get(), CmdList.Get() };
-}
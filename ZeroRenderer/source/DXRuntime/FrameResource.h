@@ -4,9 +4,8 @@
 
 #include "../Math/MathHelper.h"
 
-#include "../Resource/UploadBuffer.h"
-
-#include "CommandListHandle.h"
+#include "CommandListPool.h"
+#include "UploadAllocator.h"
 
 // render pass constants
 struct PassConstants
@@ -33,18 +32,6 @@ struct PassConstants
     Light Lights[MaxLights];
 };
 
-// object constants
-struct ObjectConstants
-{
-    DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();        // world matrix
-    DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4(); // tex   matrix
-    UINT     MaterialIndex;
-    /* for alignment */
-    UINT     ObjPad0;
-    UINT     ObjPad1;
-    UINT     ObjPad2;
-};
-
 // structed buffer content
 struct MaterialData
 {
@@ -63,16 +50,17 @@ struct MaterialData
 	UINT MaterialPad2;
 };
 
-struct InstanceData
+// per-object data, read by the shaders through the object index of an instance
+struct ObjectData
 {
-    DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
-    UINT MaterialIndex;
-    UINT InstancePad0;
-    UINT InstancePad1;
-    UINT InstancePad2;
+    DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();        // world matrix, transposed
+    DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4(); // tex   matrix, transposed
+    UINT MaterialIndex = 0;
 };
 
+// structured buffers need no padding
+static_assert(sizeof(ObjectData) == 132, "ObjectData must match the shaders' tightly packed layout");
+
 // vertex
 struct Vertex
 {
@@ -104,9 +92,8 @@ struct SsaoConstants
 class FrameResource
 {
 public:
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, 
-        UINT materialCount, Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> cmdList,
-        UINT maxInstanceCount = 25);
+    // uploadSize is the initial size of the frame's upload memory, see UploadAllocator.
+    FrameResource(ID3D12Device* device, UINT64 uploadSize);
 
     // ֹ
     FrameResource(const FrameResource& rhs) = delete;
@@ -114,20 +101,12 @@ public:
 
     ~FrameResource();
 
-    CommandListHandle Command();
-
-    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
-    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> CmdList;
-
-    std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-
-    std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
-
-    std::unique_ptr<UploadBuffer<MaterialData>> MaterialBuffer = nullptr;
-
-    std::unique_ptr<UploadBuffer<InstanceData>> InstanceBuffer = nullptr;
+    // The lists the frame is recorded into, see CommandListPool.
+    std::unique_ptr<CommandListPool> CommandLists = nullptr;
 
-    std::unique_ptr<UploadBuffer<SsaoConstants>> SsaoCB = nullptr;
+    // Constants, instances, indirect arguments and scene deltas of the frame,
+    // reset once the fence below has completed.
+    std::unique_ptr<UploadAllocator> Uploads = nullptr;
 
     UINT64 Fence = 0;  // for sync
 };
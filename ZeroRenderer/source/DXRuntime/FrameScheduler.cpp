@@ -0,0 +1,108 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+
+FrameScheduler::FrameScheduler(int framesInFlight)
+{
+	SetFramesInFlight(framesInFlight);
+}
+
+void FrameScheduler::SetFramesInFlight(int count)
+{
+	mFramesInFlight = std::clamp(count, 1, MaxFramesInFlight);
+}
+
+int FrameScheduler::AllowedPending() const
+{
+	// Pacing predicts the completion of the one queued frame.
+	int inFlight = mPacing ? std::min(mFramesInFlight, 2) : mFramesInFlight;
+	return inFlight - 1;
+}
+
+uint64_t FrameScheduler::WaitFence() const
+{
+	int excess = mPendingCount - AllowedPending();
+	if (excess <= 0)
+		return 0;
+
+	return Pending(excess - 1).Fence;
+}
+
+void FrameScheduler::Complete(uint64_t fence, double time, bool exact)
+{
+	while (mPendingCount > 0 && mPending[mOldest].Fence <= fence)
+	{
+		const Frame& frame = mPending[mOldest];
+
+		// The GPU was busy with the frame from the later of its submission
+		// and the completion of the one before. A completion noticed late
+		// still bounds that when the GPU was idle at the submission; paced
+		// frames rarely wait on their fence, so the bound is what brings a
+		// high estimate back down.
+		double busy = time - std::max(frame.Submit, mLastCompleteTime);
+		if (exact && frame.Fence == fence)
+			Smooth(mGpuTime, busy);
+		else if (mLastCompleteTime <= frame.Submit && busy < mGpuTime)
+			mGpuTime = busy;
+
+		Smooth(mLatency, time - frame.Sample);
+
+		mLastCompleteTime = time;
+		mOldest = (mOldest + 1) % MaxFramesInFlight;
+		--mPendingCount;
+	}
+}
+
+double FrameScheduler::SampleTime(double now) const
+{
+	if (!mPacing || mPendingCount != 1)
+		return now;
+
+	// The queued frame runs once submitted and once the GPU is done with the
+	// frame before, then the next one follows it.
+	const Frame& queued = Pending(0);
+	double idle = std::max(queued.Submit, mLastCompleteTime) + mGpuTime;
+
+	double meetsTarget = idle + mGpuTime - mTargetLatency;
+	double keepsBusy = idle - mCpuTime - StartMargin;
+
+	return std::max(now, std::min(meetsTarget, keepsBusy));
+}
+
+uint64_t FrameScheduler::WakeFence() const
+{
+	// The queued frame SampleTime predicts the completion of.
+	if (!mPacing || mPendingCount != 1)
+		return 0;
+
+	return Pending(0).Fence;
+}
+
+void FrameScheduler::BeginFrame(double time)
+{
+	mSampleTime = time;
+}
+
+void FrameScheduler::Submit(uint64_t fence, double time)
+{
+	Smooth(mCpuTime, time - mSampleTime);
+
+	// Callers wait for WaitFence first; should one not, the oldest frame is
+	// forgotten rather than overwritten.
+	if (mPendingCount == MaxFramesInFlight)
+	{
+		mOldest = (mOldest + 1) % MaxFramesInFlight;
+		--mPendingCount;
+	}
+
+	Frame& frame = mPending[(mOldest + mPendingCount) % MaxFramesInFlight];
+	frame.Fence = fence;
+	frame.Sample = mSampleTime;
+	frame.Submit = time;
+	++mPendingCount;
+}
+
+void FrameScheduler::Smooth(double& average, double sample)
+{
+	average = average == 0.0 ? sample : average + (sample - average) * 0.1;
+}
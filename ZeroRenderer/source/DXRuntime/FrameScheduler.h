@@ -0,0 +1,106 @@
+#pragma once
+
+//
+// Decides when a frame may start and when it samples its input.
+//
+// The scheduler follows the frames between their input sampling, their
+// submission and the first time the CPU sees their fence completed, and
+// keeps smoothed CPU, GPU and latency figures from that. Latency runs from
+// the input sampling to the GPU completing the frame.
+//
+// By default the CPU runs up to FramesInFlight frames ahead of the GPU and
+// samples input as soon as it may start. With pacing enabled it keeps at
+// most one frame queued and delays the sampling of the next one until the
+// latest moment that still meets the target latency, or, with a target too
+// low to meet, until just before the GPU would run out of work. The GPU stays
+// as busy as before; the time the frame used to spend in the queue is spent
+// before the input is read instead. A wait for the sampling ends early when
+// the queued frame completes, since the GPU has nothing left then.
+//
+// Times are in seconds on any clock that only moves forward. It touches no
+// device, so the scheduling can be checked against a simulated GPU.
+//
+
+#include <cstdint>
+
+class FrameScheduler
+{
+public:
+	static constexpr int MaxFramesInFlight = 8;
+
+	explicit FrameScheduler(int framesInFlight);
+
+	// Clamped to [1, MaxFramesInFlight]. Takes effect with the next frame.
+	void SetFramesInFlight(int count);
+	int GetFramesInFlight() const { return mFramesInFlight; }
+
+	void SetPacing(bool enable) { mPacing = enable; }
+	bool GetPacing() const { return mPacing; }
+
+	void SetTargetLatency(double seconds) { mTargetLatency = seconds; }
+	double GetTargetLatency() const { return mTargetLatency; }
+
+	// The fence that must complete before the next frame starts, or 0 if
+	// it may start right away.
+	uint64_t WaitFence() const;
+
+	// The GPU completed every frame up to fence by time. exact says the CPU
+	// was waiting on that fence, so time is when it completed rather than a
+	// later moment it was noticed.
+	void Complete(uint64_t fence, double time, bool exact);
+
+	// When the next frame should sample its input, now or later.
+	double SampleTime(double now) const;
+
+	// The fence that ends the wait for SampleTime early, or 0 if there is
+	// none. Report its completion to Complete as exact.
+	uint64_t WakeFence() const;
+
+	// The next frame sampled its input at time.
+	void BeginFrame(double time);
+
+	// The frame begun last was submitted at time and signals fence.
+	void Submit(uint64_t fence, double time);
+
+	// Smoothed over the last frames; 0 until measured.
+	double GetCpuTime() const { return mCpuTime; }     // sampling to submission
+	double GetGpuTime() const { return mGpuTime; }     // on the GPU, when it was busy
+	double GetLatency() const { return mLatency; }     // sampling to GPU completion
+
+	int GetPendingCount() const { return mPendingCount; }
+
+	// How long before the GPU runs out of work the paced frame samples its
+	// input, to absorb jitter in the CPU time and the wake-up.
+	static constexpr double StartMargin = 0.0005;
+
+private:
+	struct Frame
+	{
+		uint64_t Fence = 0;
+		double Sample = 0.0;
+		double Submit = 0.0;
+	};
+
+	// Frames the next one may leave pending on the GPU.
+	int AllowedPending() const;
+
+	const Frame& Pending(int i) const { return mPending[(mOldest + i) % MaxFramesInFlight]; }
+
+	static void Smooth(double& average, double sample);
+
+	int mFramesInFlight = 1;
+	bool mPacing = false;
+	double mTargetLatency = 0.0;
+
+	// Submitted frames the GPU has not completed yet, oldest first.
+	Frame mPending[MaxFramesInFlight];
+	int mOldest = 0;
+	int mPendingCount = 0;
+
+	double mSampleTime = 0.0;            // of the frame being recorded
+	double mLastCompleteTime = 0.0;      // of the newest completed frame
+
+	double mCpuTime = 0.0;
+	double mGpuTime = 0.0;
+	double mLatency = 0.0;
+};
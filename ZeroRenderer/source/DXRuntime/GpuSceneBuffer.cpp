@@ -0,0 +1,163 @@
+#include "GpuSceneBuffer.h"
+
+using Microsoft::WRL::ComPtr;
+
+// SceneScatter.hlsl handles one packet per group.
+static constexpr UINT MaxScatterGroups = D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION;
+
+static UINT64 AlignUp(UINT64 value, UINT64 alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+GpuSceneBuffer::GpuSceneBuffer(ID3D12Device* device, ID3DBlob* scatterShader, UINT objectStride, UINT materialStride)
+{
+	mRegions[(int)Region::Objects].Stride = objectStride;
+	mRegions[(int)Region::Materials].Stride = materialStride;
+
+	BuildScatterPipeline(device, scatterShader);
+}
+
+bool GpuSceneBuffer::Reserve(ID3D12Device* device, UINT objectCount, UINT materialCount)
+{
+	const UINT counts[(int)Region::Count] = { objectCount, materialCount };
+
+	UINT capacities[(int)Region::Count];
+	bool resize = mBuffer == nullptr;
+	for (int region = 0; region < (int)Region::Count; ++region)
+	{
+		RegionLayout& layout = mRegions[region];
+		capacities[region] = mBuffer ? (UINT)layout.Policy.Update(layout.Capacity, counts[region])
+		                             : (UINT)layout.Policy.Fit(counts[region]);
+		resize = resize || capacities[region] != layout.Capacity;
+	}
+	if (!resize)
+		return false;
+
+	// Regions start on 256 bytes, which any view of them accepts.
+	UINT64 size = 0;
+	for (int region = 0; region < (int)Region::Count; ++region)
+	{
+		RegionLayout& layout = mRegions[region];
+		layout.Capacity = capacities[region];
+		layout.Offset = size;
+		size = AlignUp(size + (UINT64)layout.Capacity * layout.Stride, 256);
+	}
+
+	if (mBuffer)
+		mRetired.emplace_back(mBuffer, gNumFrameResources);
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		get_rvalue_ptr(CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT)),
+		D3D12_HEAP_FLAG_NONE,
+		get_rvalue_ptr(CD3DX12_RESOURCE_DESC::Buffer(size, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS)),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(mBuffer.ReleaseAndGetAddressOf())));
+
+	mSize = size;
+	mState = D3D12_RESOURCE_STATE_COMMON;
+
+	// Whatever was queued was laid out for the old buffer.
+	mDeltas.Clear();
+	return true;
+}
+
+void GpuSceneBuffer::Write(Region region, UINT index, const void* record)
+{
+	const RegionLayout& layout = mRegions[(int)region];
+	assert(index < layout.Capacity);
+	mDeltas.Write((uint32_t)(layout.Offset + (UINT64)index * layout.Stride), record, layout.Stride);
+}
+
+void GpuSceneBuffer::Flush(ID3D12GraphicsCommandList* cmdList, UploadAllocator& uploads)
+{
+	// Called once per frame, so after gNumFrameResources calls the frames
+	// that could still read a retired buffer are done.
+	for (auto& retired : mRetired)
+		--retired.second;
+	mRetired.erase(std::remove_if(mRetired.begin(), mRetired.end(),
+		[](const auto& retired) { return retired.second <= 0; }), mRetired.end());
+
+	mDeltas.Build();
+
+	const D3D12_RESOURCE_STATES readState =
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+
+	const UINT packetCount = mDeltas.PacketCount();
+	if (packetCount > 0)
+	{
+		const auto& upload = mDeltas.Upload();
+		auto packets = uploads.Copy(upload.data(), (UINT)upload.size());
+
+		if (mState != D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+		{
+			cmdList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(mBuffer.Get(),
+				mState, D3D12_RESOURCE_STATE_UNORDERED_ACCESS)));
+			mState = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		}
+
+		cmdList->SetComputeRootSignature(mScatterRootSignature.Get());
+		cmdList->SetPipelineState(mScatterPSO.Get());
+		cmdList->SetComputeRootShaderResourceView(1, packets.GPU);
+		cmdList->SetComputeRootUnorderedAccessView(2, mBuffer->GetGPUVirtualAddress());
+
+		// The packets cover disjoint ranges, so the dispatches need no UAV
+		// barrier between them.
+		for (UINT first = 0; first < packetCount; first += MaxScatterGroups)
+		{
+			cmdList->SetComputeRoot32BitConstant(0, first, 0);
+			cmdList->Dispatch(std::min(packetCount - first, MaxScatterGroups), 1, 1);
+		}
+	}
+
+	if (mState != readState)
+	{
+		cmdList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(mBuffer.Get(),
+			mState, readState)));
+		mState = readState;
+	}
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS GpuSceneBuffer::Address(Region region) const
+{
+	return mBuffer->GetGPUVirtualAddress() + mRegions[(int)region].Offset;
+}
+
+void GpuSceneBuffer::BuildScatterPipeline(ID3D12Device* device, ID3DBlob* scatterShader)
+{
+	CD3DX12_ROOT_PARAMETER slotRootParameter[3];
+	slotRootParameter[0].InitAsConstants(1, 0);             // first packet of the dispatch
+	slotRootParameter[1].InitAsShaderResourceView(0);       // packets and payload
+	slotRootParameter[2].InitAsUnorderedAccessView(0);      // scene buffer
+
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(3, slotRootParameter, 0, nullptr,
+		D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+	ComPtr<ID3DBlob> serializedRootSig = nullptr;
+	ComPtr<ID3DBlob> errorBlob = nullptr;
+	HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1,
+		serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+
+	if (errorBlob != nullptr)
+	{
+		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+	}
+	ThrowIfFailed(hr);
+
+	ThrowIfFailed(device->CreateRootSignature(
+		0,
+		serializedRootSig->GetBufferPointer(),
+		serializedRootSig->GetBufferSize(),
+		IID_PPV_ARGS(mScatterRootSignature.GetAddressOf())));
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+	psoDesc.pRootSignature = mScatterRootSignature.Get();
+	psoDesc.CS =
+	{
+		reinterpret_cast<BYTE*>(scatterShader->GetBufferPointer()),
+		scatterShader->GetBufferSize()
+	};
+	psoDesc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+	ThrowIfFailed(device->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(mScatterPSO.GetAddressOf())));
+}
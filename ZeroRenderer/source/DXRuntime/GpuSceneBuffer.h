@@ -0,0 +1,86 @@
+#pragma once
+
+//
+// Persistent scene data on the GPU.
+//
+// Object and material records live once in a default-heap buffer that every
+// frame reads, rather than in a copy per frame resource. Changed records are
+// queued with Write; Flush uploads them as coalesced delta packets (see
+// SceneDeltaBuilder) and scatters them into place with the SceneScatter
+// compute shader before anything is drawn. The frames in flight run on one
+// queue, so the scatter of a frame waits for the draws of the previous ones.
+//
+
+#include "../Common/d3dUtil.h"
+
+#include "../Resource/BufferCapacity.h"
+
+#include "SceneDeltaBuilder.h"
+#include "UploadAllocator.h"
+
+class GpuSceneBuffer
+{
+public:
+	enum class Region
+	{
+		Objects,
+		Materials,
+		Count
+	};
+
+	// scatterShader is SceneScatter.hlsl's CS.
+	GpuSceneBuffer(ID3D12Device* device, ID3DBlob* scatterShader, UINT objectStride, UINT materialStride);
+
+	GpuSceneBuffer(const GpuSceneBuffer& rhs) = delete;
+	GpuSceneBuffer& operator=(const GpuSceneBuffer& rhs) = delete;
+
+	// Makes room for the records of both regions, or gives back room a region
+	// has not needed for a while (see BufferCapacity). Returns true if the
+	// buffer was recreated, which leaves every record to be written again.
+	// Call once per frame, before its writes.
+	bool Reserve(ID3D12Device* device, UINT objectCount, UINT materialCount);
+
+	// Queues the record at index of the region; record points to its stride.
+	void Write(Region region, UINT index, const void* record);
+
+	// Uploads the writes queued since the last call through the frame's
+	// upload memory and records their scatter, leaving the buffer readable by
+	// the shaders. Sets the pipeline state and the compute root signature.
+	void Flush(ID3D12GraphicsCommandList* cmdList, UploadAllocator& uploads);
+
+	// First record of the region, for a root shader resource view.
+	D3D12_GPU_VIRTUAL_ADDRESS Address(Region region) const;
+
+	UINT64 GetSize() const { return mSize; }
+
+	// What the last Flush uploaded.
+	UINT GetUploadBytes() const { return mDeltas.UploadBytes(); }
+	UINT GetPacketCount() const { return mDeltas.PacketCount(); }
+	UINT GetRecordCount() const { return mDeltas.WriteCount(); }
+
+private:
+	void BuildScatterPipeline(ID3D12Device* device, ID3DBlob* scatterShader);
+
+	struct RegionLayout
+	{
+		UINT Stride = 0;
+		UINT Capacity = 0;
+		UINT64 Offset = 0;
+		BufferCapacity Policy{ 64 };
+	};
+
+	RegionLayout mRegions[(int)Region::Count];
+	UINT64 mSize = 0;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mBuffer;
+	D3D12_RESOURCE_STATES mState = D3D12_RESOURCE_STATE_COMMON;
+
+	// Replaced buffers and the frames left until the frames in flight no
+	// longer read them.
+	std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12Resource>, int>> mRetired;
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> mScatterRootSignature;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> mScatterPSO;
+
+	SceneDeltaBuilder mDeltas;
+};
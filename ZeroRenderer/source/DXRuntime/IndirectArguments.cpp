@@ -0,0 +1,77 @@
+#include "IndirectArguments.h"
+
+#include <cassert>
+
+IndirectArgumentLayout& IndirectArgumentLayout::Constants(UINT rootParameterIndex, UINT destOffsetIn32BitValues, UINT count)
+{
+	D3D12_INDIRECT_ARGUMENT_DESC desc = {};
+	desc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	desc.Constant.RootParameterIndex = rootParameterIndex;
+	desc.Constant.DestOffsetIn32BitValues = destOffsetIn32BitValues;
+	desc.Constant.Num32BitValuesToSet = count;
+	return Append(desc, count * sizeof(UINT));
+}
+
+IndirectArgumentLayout& IndirectArgumentLayout::VertexBufferView(UINT slot)
+{
+	D3D12_INDIRECT_ARGUMENT_DESC desc = {};
+	desc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
+	desc.VertexBuffer.Slot = slot;
+	return Append(desc, sizeof(D3D12_VERTEX_BUFFER_VIEW));
+}
+
+IndirectArgumentLayout& IndirectArgumentLayout::IndexBufferView()
+{
+	D3D12_INDIRECT_ARGUMENT_DESC desc = {};
+	desc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+	return Append(desc, sizeof(D3D12_INDEX_BUFFER_VIEW));
+}
+
+IndirectArgumentLayout& IndirectArgumentLayout::DrawIndexed()
+{
+	D3D12_INDIRECT_ARGUMENT_DESC desc = {};
+	desc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+	return Append(desc, sizeof(D3D12_DRAW_INDEXED_ARGUMENTS));
+}
+
+bool IndirectArgumentLayout::IsComplete() const
+{
+	if (mArguments.empty())
+		return false;
+
+	D3D12_INDIRECT_ARGUMENT_TYPE last = mArguments.back().Type;
+	return last == D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED || last == D3D12_INDIRECT_ARGUMENT_TYPE_DRAW;
+}
+
+D3D12_COMMAND_SIGNATURE_DESC IndirectArgumentLayout::Desc() const
+{
+	assert(IsComplete());
+
+	D3D12_COMMAND_SIGNATURE_DESC desc = {};
+	desc.ByteStride = mByteStride;
+	desc.NumArgumentDescs = (UINT)mArguments.size();
+	desc.pArgumentDescs = mArguments.data();
+	desc.NodeMask = 0;
+	return desc;
+}
+
+IndirectArgumentLayout& IndirectArgumentLayout::Append(const D3D12_INDIRECT_ARGUMENT_DESC& desc, UINT size)
+{
+	assert(!IsComplete());
+
+	mArguments.push_back(desc);
+	mOffsets.push_back(mByteStride);
+	mSizes.push_back(size);
+	mByteStride += size;
+	return *this;
+}
+
+IndirectArgumentLayout DrawLayout(UINT rootParameterIndex)
+{
+	IndirectArgumentLayout layout;
+	layout.Constants(rootParameterIndex, 0, 1)
+		.VertexBufferView(0)
+		.IndexBufferView()
+		.DrawIndexed();
+	return layout;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+//
+// Argument buffers for ExecuteIndirect.
+//
+// IndirectArgumentLayout lists the arguments of one command the way a command
+// signature does and works out where each of them lives in the packed
+// command, which is all a CPU-side builder needs. It touches no device, so
+// layouts can be checked without a GPU.
+//
+// The passes draw with IndirectDrawArguments: the first instance of the draw
+// as a root constant, since SV_InstanceID does not include the start instance,
+// the vertex and index buffer views, and the DrawIndexedInstanced arguments.
+//
+
+#include "../Common/d3dUtil.h"
+
+#include <vector>
+
+class IndirectArgumentLayout
+{
+public:
+	// Each call appends one argument. The draw must come last.
+	IndirectArgumentLayout& Constants(UINT rootParameterIndex, UINT destOffsetIn32BitValues, UINT count);
+	IndirectArgumentLayout& VertexBufferView(UINT slot);
+	IndirectArgumentLayout& IndexBufferView();
+	IndirectArgumentLayout& DrawIndexed();
+
+	UINT ArgumentCount() const { return (UINT)mArguments.size(); }
+
+	// Byte offset and size of an argument within a command.
+	UINT Offset(UINT argument) const { return mOffsets[argument]; }
+	UINT Size(UINT argument) const { return mSizes[argument]; }
+
+	// Bytes from one command to the next; arguments are packed on 4 bytes.
+	UINT ByteStride() const { return mByteStride; }
+
+	// True once the layout ends in a draw.
+	bool IsComplete() const;
+
+	// Valid as long as the layout is alive and unchanged.
+	D3D12_COMMAND_SIGNATURE_DESC Desc() const;
+
+private:
+	IndirectArgumentLayout& Append(const D3D12_INDIRECT_ARGUMENT_DESC& desc, UINT size);
+
+	std::vector<D3D12_INDIRECT_ARGUMENT_DESC> mArguments;
+	std::vector<UINT> mOffsets;
+	std::vector<UINT> mSizes;
+	UINT mByteStride = 0;
+};
+
+// One command of the passes' indirect draws, packed as DrawLayout() lays it out.
+#pragma pack(push, 4)
+struct IndirectDrawArguments
+{
+	UINT InstanceBase = 0;
+	D3D12_VERTEX_BUFFER_VIEW VertexBufferView = {};
+	D3D12_INDEX_BUFFER_VIEW IndexBufferView = {};
+	D3D12_DRAW_INDEXED_ARGUMENTS Draw = {};
+};
+#pragma pack(pop)
+
+static_assert(sizeof(IndirectDrawArguments) == 56, "IndirectDrawArguments must be packed");
+
+// Layout of IndirectDrawArguments; the instance base goes to the 32-bit
+// constant root parameter rootParameterIndex.
+IndirectArgumentLayout DrawLayout(UINT rootParameterIndex);
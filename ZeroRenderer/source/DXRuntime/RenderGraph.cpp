@@ -0,0 +1,471 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+namespace
+{
+	// States that only read; any number of them may be combined.
+	constexpr UINT ReadOnlyStates =
+		(UINT)D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER |
+		(UINT)D3D12_RESOURCE_STATE_INDEX_BUFFER |
+		(UINT)D3D12_RESOURCE_STATE_DEPTH_READ |
+		(UINT)D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE |
+		(UINT)D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE |
+		(UINT)D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT |
+		(UINT)D3D12_RESOURCE_STATE_COPY_SOURCE |
+		(UINT)D3D12_RESOURCE_STATE_RESOLVE_SOURCE;
+
+	bool IsReadOnly(D3D12_RESOURCE_STATES state)
+	{
+		return state != D3D12_RESOURCE_STATE_COMMON && ((UINT)state & ~ReadOnlyStates) == 0;
+	}
+
+	// A resource in state current may be used as required without a barrier.
+	bool Satisfies(D3D12_RESOURCE_STATES current, D3D12_RESOURCE_STATES required)
+	{
+		if (current == required)
+			return true;
+		return IsReadOnly(current) && IsReadOnly(required) && ((UINT)current & (UINT)required) == (UINT)required;
+	}
+
+	UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+	}
+
+	bool Overlap(uint32_t first0, uint32_t last0, uint32_t first1, uint32_t last1)
+	{
+		return first0 <= last1 && first1 <= last0;
+	}
+}
+
+void RenderGraph::Clear()
+{
+	mResources.clear();
+	mPasses.clear();
+	mKept.clear();
+	mBarriers.clear();
+	mFinalBatch = Batch();
+	mHeapSize = 0;
+}
+
+RenderGraph::ResourceId RenderGraph::Import(const char* name, D3D12_RESOURCE_STATES state)
+{
+	Resource resource;
+	resource.Name = name;
+	resource.Imported = true;
+	resource.State = state;
+
+	mResources.push_back(std::move(resource));
+	return (ResourceId)mResources.size() - 1;
+}
+
+RenderGraph::ResourceId RenderGraph::CreateTexture(const char* name, const D3D12_RESOURCE_DESC& desc,
+	const D3D12_CLEAR_VALUE* clearValue, const D3D12_RESOURCE_ALLOCATION_INFO& info)
+{
+	Resource resource;
+	resource.Name = name;
+	resource.Desc = desc;
+	if (clearValue != nullptr)
+	{
+		resource.ClearValue = *clearValue;
+		resource.HasClearValue = true;
+	}
+	resource.Size = info.SizeInBytes;
+	resource.Alignment = info.Alignment;
+
+	mResources.push_back(std::move(resource));
+	return (ResourceId)mResources.size() - 1;
+}
+
+RenderGraph::PassId RenderGraph::AddPass(const char* name, bool sideEffects)
+{
+	Pass pass;
+	pass.Name = name;
+	pass.SideEffects = sideEffects;
+
+	mPasses.push_back(std::move(pass));
+	return (PassId)mPasses.size() - 1;
+}
+
+RenderGraph::Access& RenderGraph::FindAccess(PassId pass, ResourceId resource)
+{
+	assert(pass < mPasses.size() && resource < mResources.size());
+
+	std::vector<Access>& accesses = mPasses[pass].Accesses;
+	for (Access& access : accesses)
+	{
+		if (access.Resource == resource)
+			return access;
+	}
+
+	accesses.push_back({});
+	accesses.back().Resource = resource;
+	return accesses.back();
+}
+
+void RenderGraph::Read(PassId pass, ResourceId resource, D3D12_RESOURCE_STATES state)
+{
+	assert(IsReadOnly(state));
+
+	Access& access = FindAccess(pass, resource);
+	access.ReadState = D3D12_RESOURCE_STATES((UINT)access.ReadState | (UINT)state);
+	access.Reads = true;
+}
+
+void RenderGraph::Write(PassId pass, ResourceId resource, D3D12_RESOURCE_STATES state)
+{
+	Access& access = FindAccess(pass, resource);
+	assert(!access.Writes || access.WriteState == state);
+
+	access.WriteState = state;
+	access.Writes = true;
+}
+
+void RenderGraph::Compile()
+{
+	Cull();
+	ComputeLifetimes();
+	PlaceTransients();
+	PlanBarriers();
+}
+
+void RenderGraph::Cull()
+{
+	// Backwards: a resource is needed while a kept pass further on reads
+	// what is in it now. A pass that overwrites it without reading it ends
+	// the need, as nothing before it can be seen past it.
+	std::vector<bool> needed(mResources.size(), false);
+
+	for (PassId p = (PassId)mPasses.size(); p-- > 0; )
+	{
+		Pass& pass = mPasses[p];
+
+		bool keep = pass.SideEffects;
+		for (const Access& access : pass.Accesses)
+		{
+			if (access.Writes && (mResources[access.Resource].Imported || needed[access.Resource]))
+				keep = true;
+		}
+
+		pass.Culled = !keep;
+		if (!keep)
+			continue;
+
+		for (const Access& access : pass.Accesses)
+			needed[access.Resource] = access.Reads;
+	}
+
+	mKept.clear();
+	for (PassId p = 0; p < (PassId)mPasses.size(); ++p)
+	{
+		if (!mPasses[p].Culled)
+			mKept.push_back(p);
+	}
+}
+
+void RenderGraph::ComputeLifetimes()
+{
+	for (Resource& resource : mResources)
+	{
+		resource.FirstUse = None;
+		resource.LastUse = None;
+		resource.HeapOffset = 0;
+	}
+
+	for (uint32_t k = 0; k < (uint32_t)mKept.size(); ++k)
+	{
+		for (const Access& access : mPasses[mKept[k]].Accesses)
+		{
+			Resource& resource = mResources[access.Resource];
+			if (resource.FirstUse == None)
+			{
+				resource.FirstUse = k;
+
+				// Created in the state it is first needed in.
+				if (!resource.Imported)
+					resource.State = access.State();
+			}
+			resource.LastUse = k;
+		}
+	}
+}
+
+void RenderGraph::PlaceTransients()
+{
+	std::vector<ResourceId> order;
+	for (ResourceId r = 0; r < (ResourceId)mResources.size(); ++r)
+	{
+		if (!mResources[r].Imported && mResources[r].FirstUse != None)
+			order.push_back(r);
+	}
+
+	// Largest first, as the small ones fit the gaps the large ones leave.
+	std::stable_sort(order.begin(), order.end(), [this](ResourceId a, ResourceId b)
+	{
+		return mResources[a].Size > mResources[b].Size;
+	});
+
+	mHeapSize = 0;
+
+	std::vector<ResourceId> placed;
+	for (ResourceId r : order)
+	{
+		Resource& resource = mResources[r];
+
+		// Past every placed resource alive at the same time that the range
+		// would overlap; the offset only grows, so this ends at the lowest
+		// free one.
+		UINT64 offset = 0;
+		for (bool moved = true; moved; )
+		{
+			moved = false;
+			offset = AlignUp(offset, resource.Alignment);
+			for (ResourceId other : placed)
+			{
+				const Resource& o = mResources[other];
+				if (Overlap(resource.FirstUse, resource.LastUse, o.FirstUse, o.LastUse) &&
+					offset < o.HeapOffset + o.Size && o.HeapOffset < offset + resource.Size)
+				{
+					offset = o.HeapOffset + o.Size;
+					moved = true;
+					break;
+				}
+			}
+		}
+
+		resource.HeapOffset = offset;
+		mHeapSize = std::max(mHeapSize, offset + resource.Size);
+		placed.push_back(r);
+	}
+}
+
+RenderGraph::ResourceId RenderGraph::FindAliasingBefore(ResourceId r, bool& aliased) const
+{
+	const Resource& resource = mResources[r];
+
+	ResourceId before = None;
+	uint32_t count = 0;
+	for (ResourceId other = 0; other < (ResourceId)mResources.size(); ++other)
+	{
+		const Resource& o = mResources[other];
+		if (other == r || o.Imported || o.FirstUse == None)
+			continue;
+
+		if (resource.HeapOffset < o.HeapOffset + o.Size && o.HeapOffset < resource.HeapOffset + resource.Size)
+		{
+			before = other;
+			++count;
+		}
+	}
+
+	// Whichever of them had the memory last, earlier in this frame or in the
+	// one before, a single one can be named only if it is the only one.
+	aliased = count != 0;
+	return count == 1 ? before : None;
+}
+
+void RenderGraph::PlanBarriers()
+{
+	mBarriers.clear();
+	for (Pass& pass : mPasses)
+		pass.Barriers = Batch();
+
+	std::vector<D3D12_RESOURCE_STATES> state(mResources.size());
+	for (ResourceId r = 0; r < (ResourceId)mResources.size(); ++r)
+		state[r] = mResources[r].State;
+
+	auto transition = [&](ResourceId r, D3D12_RESOURCE_STATES after)
+	{
+		Barrier barrier;
+		barrier.Kind = Barrier::Type::Transition;
+		barrier.Resource = r;
+		barrier.StateBefore = state[r];
+		barrier.StateAfter = after;
+		mBarriers.push_back(barrier);
+
+		state[r] = after;
+	};
+
+	// Transients last used by kept pass k go back to the state they are
+	// created in, before another one can take their memory.
+	auto restore = [&](uint32_t k)
+	{
+		for (ResourceId r = 0; r < (ResourceId)mResources.size(); ++r)
+		{
+			const Resource& resource = mResources[r];
+			if (!resource.Imported && resource.LastUse == k && state[r] != resource.State)
+				transition(r, resource.State);
+		}
+	};
+
+	for (uint32_t k = 0; k < (uint32_t)mKept.size(); ++k)
+	{
+		Pass& pass = mPasses[mKept[k]];
+		pass.Barriers.First = (uint32_t)mBarriers.size();
+
+		if (k > 0)
+			restore(k - 1);
+
+		for (ResourceId r = 0; r < (ResourceId)mResources.size(); ++r)
+		{
+			if (mResources[r].Imported || mResources[r].FirstUse != k)
+				continue;
+
+			bool aliased = false;
+			ResourceId before = FindAliasingBefore(r, aliased);
+			if (!aliased)
+				continue;
+
+			Barrier barrier;
+			barrier.Kind = Barrier::Type::Aliasing;
+			barrier.Resource = r;
+			barrier.Before = before;
+			mBarriers.push_back(barrier);
+		}
+
+		for (const Access& access : pass.Accesses)
+		{
+			if (!Satisfies(state[access.Resource], access.State()))
+				transition(access.Resource, access.State());
+		}
+
+		pass.Barriers.Count = (uint32_t)mBarriers.size() - pass.Barriers.First;
+	}
+
+	mFinalBatch.First = (uint32_t)mBarriers.size();
+
+	if (!mKept.empty())
+		restore((uint32_t)mKept.size() - 1);
+
+	for (ResourceId r = 0; r < (ResourceId)mResources.size(); ++r)
+	{
+		if (mResources[r].Imported && state[r] != mResources[r].State)
+			transition(r, mResources[r].State);
+	}
+
+	mFinalBatch.Count = (uint32_t)mBarriers.size() - mFinalBatch.First;
+}
+
+uint32_t RenderGraph::GetCulledCount() const
+{
+	return (uint32_t)(mPasses.size() - mKept.size());
+}
+
+UINT64 RenderGraph::GetTransientSize() const
+{
+	UINT64 size = 0;
+	for (const Resource& resource : mResources)
+	{
+		if (!resource.Imported && resource.FirstUse != None)
+			size += resource.Size;
+	}
+	return size;
+}
+
+std::string RenderGraph::StateName(D3D12_RESOURCE_STATES state)
+{
+	if (state == D3D12_RESOURCE_STATE_COMMON)
+		return "COMMON";
+	if (state == D3D12_RESOURCE_STATE_GENERIC_READ)
+		return "GENERIC_READ";
+
+	static const std::pair<D3D12_RESOURCE_STATES, const char*> names[] =
+	{
+		{ D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, "VERTEX_AND_CONSTANT_BUFFER" },
+		{ D3D12_RESOURCE_STATE_INDEX_BUFFER, "INDEX_BUFFER" },
+		{ D3D12_RESOURCE_STATE_RENDER_TARGET, "RENDER_TARGET" },
+		{ D3D12_RESOURCE_STATE_UNORDERED_ACCESS, "UNORDERED_ACCESS" },
+		{ D3D12_RESOURCE_STATE_DEPTH_WRITE, "DEPTH_WRITE" },
+		{ D3D12_RESOURCE_STATE_DEPTH_READ, "DEPTH_READ" },
+		{ D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, "NON_PIXEL_SHADER_RESOURCE" },
+		{ D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, "PIXEL_SHADER_RESOURCE" },
+		{ D3D12_RESOURCE_STATE_STREAM_OUT, "STREAM_OUT" },
+		{ D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, "INDIRECT_ARGUMENT" },
+		{ D3D12_RESOURCE_STATE_COPY_DEST, "COPY_DEST" },
+		{ D3D12_RESOURCE_STATE_COPY_SOURCE, "COPY_SOURCE" },
+		{ D3D12_RESOURCE_STATE_RESOLVE_DEST, "RESOLVE_DEST" },
+		{ D3D12_RESOURCE_STATE_RESOLVE_SOURCE, "RESOLVE_SOURCE" },
+	};
+
+	std::string name;
+	UINT rest = (UINT)state;
+	for (const auto& [flag, flagName] : names)
+	{
+		if ((rest & (UINT)flag) == 0)
+			continue;
+
+		if (!name.empty())
+			name += '|';
+		name += flagName;
+		rest &= ~(UINT)flag;
+	}
+
+	if (rest != 0)
+	{
+		char hex[16];
+		snprintf(hex, sizeof(hex), "0x%x", rest);
+		if (!name.empty())
+			name += '|';
+		name += hex;
+	}
+	return name;
+}
+
+std::string RenderGraph::Describe() const
+{
+	std::string text;
+
+	auto describeBatch = [&](Batch batch)
+	{
+		for (uint32_t i = batch.First; i < batch.First + batch.Count; ++i)
+		{
+			const Barrier& barrier = mBarriers[i];
+			if (barrier.Kind == Barrier::Type::Aliasing)
+			{
+				text += "  alias " + mResources[barrier.Resource].Name + " after " +
+					(barrier.Before == None ? std::string("any") : mResources[barrier.Before].Name) + "\n";
+			}
+			else
+			{
+				text += "  " + mResources[barrier.Resource].Name + ": " +
+					StateName(barrier.StateBefore) + " -> " + StateName(barrier.StateAfter) + "\n";
+			}
+		}
+	};
+
+	for (const Pass& pass : mPasses)
+	{
+		text += pass.Name + (pass.Culled ? " (culled)\n" : "\n");
+		describeBatch(pass.Barriers);
+	}
+
+	text += "final\n";
+	describeBatch(mFinalBatch);
+
+	char line[256];
+	snprintf(line, sizeof(line), "heap %llu, %llu without aliasing\n",
+		(unsigned long long)mHeapSize, (unsigned long long)GetTransientSize());
+	text += line;
+
+	for (const Resource& resource : mResources)
+	{
+		if (resource.Imported)
+			continue;
+
+		if (resource.FirstUse == None)
+		{
+			text += "  " + resource.Name + ": unused\n";
+			continue;
+		}
+
+		snprintf(line, sizeof(line), ": %llu + %llu, passes %u-%u, created %s\n",
+			(unsigned long long)resource.HeapOffset, (unsigned long long)resource.Size,
+			resource.FirstUse, resource.LastUse, StateName(resource.State).c_str());
+		text += "  " + resource.Name + line;
+	}
+
+	return text;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+//
+// A frame described as passes and the resources they read and write.
+//
+// Passes are added in the order they run and declare every resource they
+// access, in the state they need it in. Compile then works out:
+//
+//   culling   a pass is kept if it has side effects, writes an imported
+//             resource, or writes what a kept pass reads later; the rest are
+//             dropped, and so are the resources only they touch
+//   barriers  the transitions and aliasing barriers each kept pass needs,
+//             as one batch recorded before it, plus a final batch that
+//             returns the imported resources to the state they came in
+//   aliasing  transient resources whose lifetimes do not overlap share the
+//             memory of one heap; they are placed largest first, each at the
+//             lowest offset free for its whole lifetime
+//
+// Imported resources belong to someone else (the swap chain, the depth
+// buffer) and enter and leave the frame in the state they were imported in.
+// Transient resources belong to the graph. They are created in the state of
+// their first access and returned to it after their last, so the plan is
+// the same every frame. A transient that shares memory with another one
+// holds garbage when it takes the memory over: the pass that first accesses
+// it must write it in full, a clear or discard at least.
+//
+// The compiler touches no device; RenderGraphResources creates the heap and
+// the placed resources of a compiled graph and records its barriers.
+//
+
+#include "../Common/d3dUtil.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class RenderGraph
+{
+public:
+	using ResourceId = uint32_t;
+	using PassId = uint32_t;
+
+	static constexpr uint32_t None = UINT32_MAX;
+
+	struct Barrier
+	{
+		enum class Type : uint8_t { Transition, Aliasing };
+
+		Type Kind = Type::Transition;
+		ResourceId Resource = None;   // the one transitioned, or taking the memory over
+		ResourceId Before = None;     // aliasing: the one that had the memory, None if several
+		D3D12_RESOURCE_STATES StateBefore = D3D12_RESOURCE_STATE_COMMON;
+		D3D12_RESOURCE_STATES StateAfter = D3D12_RESOURCE_STATE_COMMON;
+	};
+
+	// Barriers [First, First + Count) of GetBarriers, recorded with one call.
+	struct Batch
+	{
+		uint32_t First = 0;
+		uint32_t Count = 0;
+	};
+
+	struct Resource
+	{
+		std::string Name;
+		bool Imported = false;
+
+		// Imported: the state it enters and leaves the frame in. Transient:
+		// the state of its first access, which it is created in.
+		D3D12_RESOURCE_STATES State = D3D12_RESOURCE_STATE_COMMON;
+
+		// Transient only.
+		D3D12_RESOURCE_DESC Desc = {};
+		D3D12_CLEAR_VALUE ClearValue = {};
+		bool HasClearValue = false;
+		UINT64 Size = 0;
+		UINT64 Alignment = 0;
+
+		// Kept passes that access it, as indices into the kept passes; None
+		// if none does.
+		uint32_t FirstUse = None;
+		uint32_t LastUse = None;
+
+		UINT64 HeapOffset = 0;   // transient and used
+	};
+
+	// Forgets every pass and resource.
+	void Clear();
+
+	// A resource owned elsewhere, in state before and after the frame.
+	ResourceId Import(const char* name, D3D12_RESOURCE_STATES state);
+
+	// A texture owned by the graph. info is what the device reports for desc
+	// (GetResourceAllocationInfo); clearValue may be null.
+	ResourceId CreateTexture(const char* name, const D3D12_RESOURCE_DESC& desc,
+		const D3D12_CLEAR_VALUE* clearValue, const D3D12_RESOURCE_ALLOCATION_INFO& info);
+
+	// A pass with side effects beyond its writes (presenting, readbacks) is
+	// never culled.
+	PassId AddPass(const char* name, bool sideEffects = false);
+
+	// Accesses of a pass. Reads of one resource in one pass combine their
+	// states; a write needs a single state and takes precedence over reads
+	// of the same resource in the pass.
+	void Read(PassId pass, ResourceId resource, D3D12_RESOURCE_STATES state);
+	void Write(PassId pass, ResourceId resource, D3D12_RESOURCE_STATES state);
+
+	// Culls, plans the barriers and places the transient resources.
+	void Compile();
+
+	bool IsCulled(PassId pass) const { return mPasses[pass].Culled; }
+
+	// Of the compiled plan.
+	const std::vector<Barrier>& GetBarriers() const { return mBarriers; }
+	Batch GetBatch(PassId pass) const { return mPasses[pass].Barriers; }
+	Batch GetFinalBatch() const { return mFinalBatch; }
+
+	const Resource& GetResource(ResourceId resource) const { return mResources[resource]; }
+	uint32_t GetResourceCount() const { return (uint32_t)mResources.size(); }
+
+	const std::string& GetPassName(PassId pass) const { return mPasses[pass].Name; }
+	uint32_t GetPassCount() const { return (uint32_t)mPasses.size(); }
+	uint32_t GetCulledCount() const;
+
+	// Bytes of the heap the transients are placed in, and what they would
+	// take without aliasing.
+	UINT64 GetHeapSize() const { return mHeapSize; }
+	UINT64 GetTransientSize() const;
+
+	// The compiled plan as text: the barriers before each pass, the final
+	// ones and the placement of the transients. Stable, so plans can be
+	// compared against expected ones.
+	std::string Describe() const;
+
+	static std::string StateName(D3D12_RESOURCE_STATES state);
+
+private:
+	struct Access
+	{
+		ResourceId Resource = None;
+		D3D12_RESOURCE_STATES ReadState = D3D12_RESOURCE_STATE_COMMON;
+		D3D12_RESOURCE_STATES WriteState = D3D12_RESOURCE_STATE_COMMON;
+		bool Reads = false;
+		bool Writes = false;
+
+		// The state the pass needs the resource in.
+		D3D12_RESOURCE_STATES State() const { return Writes ? WriteState : ReadState; }
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		bool SideEffects = false;
+		std::vector<Access> Accesses;
+
+		bool Culled = false;
+		Batch Barriers;
+	};
+
+	Access& FindAccess(PassId pass, ResourceId resource);
+
+	void Cull();
+	void ComputeLifetimes();
+	void PlaceTransients();
+	void PlanBarriers();
+
+	// Transients that share memory with resource, for its aliasing barrier.
+	ResourceId FindAliasingBefore(ResourceId resource, bool& aliased) const;
+
+	std::vector<Resource> mResources;
+	std::vector<Pass> mPasses;
+
+	// Kept passes in order; FirstUse and LastUse index into it.
+	std::vector<PassId> mKept;
+
+	std::vector<Barrier> mBarriers;
+	Batch mFinalBatch;
+
+	UINT64 mHeapSize = 0;
+};
@@ -0,0 +1,96 @@
+#include "RenderGraphResources.h"
+
+#include <cassert>
+
+RenderGraphResources::RenderGraphResources(ID3D12Device* device) : mDevice(device)
+{
+}
+
+void RenderGraphResources::Realize(const RenderGraph& graph)
+{
+	mGraph = &graph;
+
+	mTransients.clear();
+	mHeap = nullptr;
+	mHeapSize = graph.GetHeapSize();
+
+	mResources.assign(graph.GetResourceCount(), nullptr);
+
+	if (mHeapSize != 0)
+	{
+		D3D12_HEAP_DESC heapDesc = {};
+		heapDesc.SizeInBytes = mHeapSize;
+		heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+		heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+		heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+		ThrowIfFailed(mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&mHeap)));
+	}
+
+	for (RenderGraph::ResourceId id = 0; id < graph.GetResourceCount(); ++id)
+	{
+		const RenderGraph::Resource& resource = graph.GetResource(id);
+		if (resource.Imported || resource.FirstUse == RenderGraph::None)
+			continue;
+
+		assert(resource.Desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL));
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> d3dResource;
+		ThrowIfFailed(mDevice->CreatePlacedResource(
+			mHeap.Get(),
+			resource.HeapOffset,
+			&resource.Desc,
+			resource.State,
+			resource.HasClearValue ? &resource.ClearValue : nullptr,
+			IID_PPV_ARGS(&d3dResource)));
+
+		mResources[id] = d3dResource.Get();
+		mTransients.push_back(std::move(d3dResource));
+	}
+}
+
+void RenderGraphResources::SetImported(RenderGraph::ResourceId resource, ID3D12Resource* d3dResource)
+{
+	assert(mGraph->GetResource(resource).Imported);
+	mResources[resource] = d3dResource;
+}
+
+void RenderGraphResources::RecordBarriers(ID3D12GraphicsCommandList* cmdList, RenderGraph::PassId pass) const
+{
+	Record(cmdList, mGraph->GetBatch(pass));
+}
+
+void RenderGraphResources::RecordFinalBarriers(ID3D12GraphicsCommandList* cmdList) const
+{
+	Record(cmdList, mGraph->GetFinalBatch());
+}
+
+void RenderGraphResources::Record(ID3D12GraphicsCommandList* cmdList, RenderGraph::Batch batch) const
+{
+	if (batch.Count == 0)
+		return;
+
+	// Small enough for the stack; passes record from several threads.
+	constexpr uint32_t MaxBatch = 32;
+	assert(batch.Count <= MaxBatch);
+
+	D3D12_RESOURCE_BARRIER barriers[MaxBatch];
+	uint32_t count = 0;
+
+	const std::vector<RenderGraph::Barrier>& plan = mGraph->GetBarriers();
+	for (uint32_t i = batch.First; i < batch.First + batch.Count && count < MaxBatch; ++i)
+	{
+		const RenderGraph::Barrier& barrier = plan[i];
+		if (barrier.Kind == RenderGraph::Barrier::Type::Aliasing)
+		{
+			ID3D12Resource* before = barrier.Before == RenderGraph::None ? nullptr : mResources[barrier.Before];
+			barriers[count++] = CD3DX12_RESOURCE_BARRIER::Aliasing(before, mResources[barrier.Resource]);
+		}
+		else
+		{
+			barriers[count++] = CD3DX12_RESOURCE_BARRIER::Transition(mResources[barrier.Resource],
+				barrier.StateBefore, barrier.StateAfter);
+		}
+	}
+
+	cmdList->ResourceBarrier(count, barriers);
+}
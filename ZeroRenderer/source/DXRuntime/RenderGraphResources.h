@@ -0,0 +1,59 @@
+#pragma once
+
+//
+// The device side of a compiled RenderGraph.
+//
+// Realize creates one heap for the transient resources and places each of
+// them at the offset the graph chose, in the state it is created in. The
+// imported resources are handed in with SetImported, the back buffer anew
+// every frame. The passes then record the barrier batches of the plan: the
+// batch of each graph pass before it, the final batch after the last one.
+//
+// The transients are render and depth targets, so the heap only takes those
+// (heap tier 1 keeps them apart from buffers and other textures).
+//
+
+#include "RenderGraph.h"
+
+#include <vector>
+
+class RenderGraphResources
+{
+public:
+	explicit RenderGraphResources(ID3D12Device* device);
+
+	RenderGraphResources(const RenderGraphResources& rhs) = delete;
+	RenderGraphResources& operator=(const RenderGraphResources& rhs) = delete;
+
+	// Creates the heap and the transients of graph, which must stay alive
+	// and compiled, releasing those of the last one. The GPU must be done
+	// with them.
+	void Realize(const RenderGraph& graph);
+
+	// Set before recording the barriers that touch resource.
+	void SetImported(RenderGraph::ResourceId resource, ID3D12Resource* d3dResource);
+
+	// Null for transients no kept pass uses.
+	ID3D12Resource* Get(RenderGraph::ResourceId resource) const { return mResources[resource]; }
+
+	const RenderGraph& Graph() const { return *mGraph; }
+
+	// Records the batch of a graph pass, nothing if it was culled. Lists of
+	// different passes may record at the same time.
+	void RecordBarriers(ID3D12GraphicsCommandList* cmdList, RenderGraph::PassId pass) const;
+	void RecordFinalBarriers(ID3D12GraphicsCommandList* cmdList) const;
+
+	UINT64 GetHeapSize() const { return mHeapSize; }
+
+private:
+	void Record(ID3D12GraphicsCommandList* cmdList, RenderGraph::Batch batch) const;
+
+	ID3D12Device* mDevice = nullptr;
+	const RenderGraph* mGraph = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12Heap> mHeap;
+	UINT64 mHeapSize = 0;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mTransients;
+	std::vector<ID3D12Resource*> mResources;   // by id, transient or imported
+};
@@ -0,0 +1,96 @@
+#include "SceneDeltaBuilder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+void SceneDeltaBuilder::Write(uint32_t destOffset, const void* data, uint32_t byteCount)
+{
+	assert(destOffset % sizeof(uint32_t) == 0 && byteCount % sizeof(uint32_t) == 0);
+
+	PendingWrite write;
+	write.DestOffset = destOffset;
+	write.ByteCount = byteCount;
+	write.StagingWord = (uint32_t)mStaging.size();
+	mWrites.push_back(write);
+
+	mStaging.resize(mStaging.size() + byteCount / sizeof(uint32_t));
+	std::memcpy(mStaging.data() + write.StagingWord, data, byteCount);
+}
+
+void SceneDeltaBuilder::Build()
+{
+	// Stable, so the writes of one range stay in the order they were made.
+	std::stable_sort(mWrites.begin(), mWrites.end(), [](const PendingWrite& a, const PendingWrite& b)
+	{
+		return a.DestOffset < b.DestOffset;
+	});
+
+	// Keep the last write of each range.
+	size_t kept = 0;
+	for (size_t i = 0; i < mWrites.size(); ++i)
+	{
+		if (kept > 0 && mWrites[kept - 1].DestOffset == mWrites[i].DestOffset)
+		{
+			assert(mWrites[kept - 1].ByteCount == mWrites[i].ByteCount);
+			mWrites[kept - 1] = mWrites[i];
+		}
+		else
+		{
+			mWrites[kept++] = mWrites[i];
+		}
+	}
+	mWrites.resize(kept);
+
+	// A write that starts where the previous one ends extends its packet.
+	mPacketCount = 0;
+	uint32_t payloadWords = 0;
+	for (size_t i = 0; i < mWrites.size(); ++i)
+	{
+		assert(i == 0 || mWrites[i - 1].DestOffset + mWrites[i - 1].ByteCount <= mWrites[i].DestOffset);
+		if (i == 0 || mWrites[i - 1].DestOffset + mWrites[i - 1].ByteCount != mWrites[i].DestOffset)
+			++mPacketCount;
+		payloadWords += mWrites[i].ByteCount / sizeof(uint32_t);
+	}
+
+	const uint32_t headerWords = mPacketCount * sizeof(DeltaPacket) / sizeof(uint32_t);
+	mUpload.resize(headerWords + payloadWords);
+
+	DeltaPacket* packets = reinterpret_cast<DeltaPacket*>(mUpload.data());
+	uint32_t* payload = mUpload.data() + headerWords;
+	uint32_t packet = 0;
+	uint32_t word = 0;
+	for (size_t i = 0; i < mWrites.size(); ++i)
+	{
+		const PendingWrite& write = mWrites[i];
+		if (i == 0 || mWrites[i - 1].DestOffset + mWrites[i - 1].ByteCount != write.DestOffset)
+		{
+			DeltaPacket& p = packets[packet++];
+			p.DestOffset = write.DestOffset;
+			p.SrcOffset = (headerWords + word) * sizeof(uint32_t);
+			p.ByteCount = 0;
+		}
+
+		packets[packet - 1].ByteCount += write.ByteCount;
+
+		uint32_t words = write.ByteCount / sizeof(uint32_t);
+		std::memcpy(payload + word, mStaging.data() + write.StagingWord, write.ByteCount);
+		word += words;
+	}
+
+	mWriteCount = (uint32_t)mWrites.size();
+	mWrites.clear();
+	mStaging.clear();
+}
+
+void SceneDeltaBuilder::Clear()
+{
+	mWrites.clear();
+	mStaging.clear();
+}
+
+const DeltaPacket& SceneDeltaBuilder::GetPacket(uint32_t index) const
+{
+	assert(index < mPacketCount);
+	return reinterpret_cast<const DeltaPacket*>(mUpload.data())[index];
+}
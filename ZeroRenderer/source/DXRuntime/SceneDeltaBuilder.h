@@ -0,0 +1,69 @@
+#pragma once
+
+//
+// CPU side of the scene buffer uploads.
+//
+// Records written into the persistent scene buffer during a frame are queued
+// here, then coalesced into packets: writes to the same range keep only the
+// last payload, and writes that follow each other in the buffer share one
+// packet. The result is a single upload of the packet headers followed by
+// their payload, which the SceneScatter compute shader copies into place.
+// It touches no device, so the packing can be checked without a GPU.
+//
+
+#include <cstdint>
+#include <vector>
+
+// One contiguous run of the scene buffer; offsets and sizes are in bytes.
+struct DeltaPacket
+{
+	uint32_t DestOffset;   // into the scene buffer
+	uint32_t SrcOffset;    // into the upload
+	uint32_t ByteCount;
+};
+
+static_assert(sizeof(DeltaPacket) == 12, "DeltaPacket must match SceneScatter.hlsl");
+
+class SceneDeltaBuilder
+{
+public:
+	// Queues byteCount bytes of data for destOffset; both are multiples of 4.
+	// A later write of the same range replaces an earlier one; writes of
+	// different ranges must not overlap.
+	void Write(uint32_t destOffset, const void* data, uint32_t byteCount);
+
+	// Coalesces the queued writes into the upload and empties the queue.
+	void Build();
+
+	// Drops the queued writes.
+	void Clear();
+
+	// Packet headers followed by the payload, as 32-bit words.
+	const std::vector<uint32_t>& Upload() const { return mUpload; }
+
+	uint32_t PacketCount() const { return mPacketCount; }
+
+	// Writes that made it into the last upload, after dropping replaced ones.
+	uint32_t WriteCount() const { return mWriteCount; }
+
+	uint32_t UploadBytes() const { return (uint32_t)mUpload.size() * sizeof(uint32_t); }
+
+	bool Empty() const { return mWrites.empty(); }
+
+	const DeltaPacket& GetPacket(uint32_t index) const;
+
+private:
+	struct PendingWrite
+	{
+		uint32_t DestOffset;
+		uint32_t ByteCount;
+		uint32_t StagingWord;   // first word of the payload in mStaging
+	};
+
+	std::vector<PendingWrite> mWrites;
+	std::vector<uint32_t> mStaging;
+
+	std::vector<uint32_t> mUpload;
+	uint32_t mPacketCount = 0;
+	uint32_t mWriteCount = 0;
+};
@@ -0,0 +1,70 @@
+#include "UploadAllocator.h"
+
+#include <cassert>
+
+UploadAllocator::UploadAllocator(ID3D12Device* device, UINT64 size) : mDevice(device)
+{
+	mBuffer = CreateBuffer(std::max(size, MinSize));
+}
+
+UploadAllocator::Allocation UploadAllocator::Allocate(UINT64 size, UINT64 alignment)
+{
+	// Buffers start at a multiple of 64 KB.
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+	assert(alignment <= D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	UINT64 offset = (mOffset + alignment - 1) & ~(alignment - 1);
+	if (offset + size > mBuffer.Size)
+	{
+		UINT64 bufferSize = mBuffer.Size * 2;
+		while (bufferSize < size)
+			bufferSize *= 2;
+
+		mFullBytes += mOffset;
+		mFullBuffers.push_back(std::move(mBuffer));
+		mBuffer = CreateBuffer(bufferSize);
+		offset = 0;
+	}
+
+	mOffset = offset + size;
+
+	Allocation allocation;
+	allocation.CPU = mBuffer.CPU + offset;
+	allocation.GPU = mBuffer.GPU + offset;
+	allocation.Resource = mBuffer.Resource.Get();
+	allocation.Offset = offset;
+	return allocation;
+}
+
+void UploadAllocator::Reset()
+{
+	// Nothing reads the buffer anymore, so it can be replaced right away.
+	UINT64 size = mCapacity.Update(mBuffer.Size, GetUsedBytes());
+	if (size != mBuffer.Size)
+		mBuffer = CreateBuffer(size);
+
+	mFullBuffers.clear();
+	mFullBytes = 0;
+	mOffset = 0;
+}
+
+UploadAllocator::Buffer UploadAllocator::CreateBuffer(UINT64 size)
+{
+	Buffer buffer;
+	buffer.Size = size;
+
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		get_rvalue_ptr(CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD)),
+		D3D12_HEAP_FLAG_NONE,
+		get_rvalue_ptr(CD3DX12_RESOURCE_DESC::Buffer(size)),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&buffer.Resource)));
+
+	// Mapped for as long as it lives; released resources need no Unmap.
+	ThrowIfFailed(buffer.Resource->Map(0, nullptr, reinterpret_cast<void**>(&buffer.CPU)));
+	buffer.GPU = buffer.Resource->GetGPUVirtualAddress();
+	return buffer;
+}
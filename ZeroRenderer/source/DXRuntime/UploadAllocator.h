@@ -0,0 +1,114 @@
+#pragma once
+
+//
+// Transient upload memory of a frame.
+//
+// Every frame resource owns one persistently mapped upload buffer and hands
+// it out by bumping an offset: pass constants, instance lists, indirect
+// arguments, scene delta packets, anything the GPU reads only in the frame it
+// is written. Allocations are never freed one by one; Reset takes the whole
+// buffer back once the frame resource's fence has completed. The frame
+// resources take turns, so together they form a ring of gNumFrameResources
+// frames.
+//
+// A frame that outgrows the buffer moves on to a new one of at least twice
+// the size. The full buffers stay alive until Reset, which then sizes the
+// buffer for what the frame used (see BufferCapacity): large enough for a
+// whole frame, and smaller again once the frames have used at most a quarter
+// of it for a while. Once it fits a frame, allocating creates nothing and
+// allocates nothing on the heap.
+//
+
+#include "../Common/d3dUtil.h"
+
+#include "../Resource/BufferCapacity.h"
+#include "../Resource/StreamCopy.h"
+
+#include <mutex>
+#include <vector>
+
+class UploadAllocator
+{
+public:
+	struct Allocation
+	{
+		void* CPU = nullptr;                // write-combined, see StreamCopy
+		D3D12_GPU_VIRTUAL_ADDRESS GPU = 0;
+		ID3D12Resource* Resource = nullptr;
+		UINT64 Offset = 0;                  // of GPU in Resource
+	};
+
+	static constexpr UINT64 MinSize = 64 * 1024;
+
+	// Enough for root shader resource views and indirect arguments.
+	static constexpr UINT64 DefaultAlignment = 16;
+
+	UploadAllocator(ID3D12Device* device, UINT64 size);
+
+	UploadAllocator(const UploadAllocator& rhs) = delete;
+	UploadAllocator& operator=(const UploadAllocator& rhs) = delete;
+
+	// size bytes at a multiple of alignment, a power of two up to 64 KB.
+	// Valid until Reset. Safe to call from several threads at once.
+	Allocation Allocate(UINT64 size, UINT64 alignment = DefaultAlignment);
+
+	// Room for count elements of T.
+	template<typename T>
+	Allocation AllocateArray(UINT count, UINT64 alignment = DefaultAlignment)
+	{
+		return Allocate((UINT64)count * sizeof(T), alignment);
+	}
+
+	// A copy of count elements of T.
+	template<typename T>
+	Allocation Copy(const T* data, UINT count, UINT64 alignment = DefaultAlignment)
+	{
+		Allocation allocation = AllocateArray<T>(count, alignment);
+		WriteCombinedCopy(allocation.CPU, data, (size_t)count * sizeof(T));
+		StreamFence();
+		return allocation;
+	}
+
+	// A copy of data for a root constant buffer view.
+	template<typename T>
+	D3D12_GPU_VIRTUAL_ADDRESS CopyConstants(const T& data)
+	{
+		Allocation allocation = Allocate(d3dUtil::CalcConstantBufferByteSize(sizeof(T)),
+			D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+		memcpy(allocation.CPU, &data, sizeof(T));
+		return allocation.GPU;
+	}
+
+	// Takes back every allocation. The GPU must be done with them. Call once
+	// per frame.
+	void Reset();
+
+	// Bytes handed out since Reset, alignment padding included.
+	UINT64 GetUsedBytes() const { return mFullBytes + mOffset; }
+
+	UINT64 GetSize() const { return mBuffer.Size; }
+
+private:
+	struct Buffer
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		BYTE* CPU = nullptr;
+		D3D12_GPU_VIRTUAL_ADDRESS GPU = 0;
+		UINT64 Size = 0;
+	};
+
+	Buffer CreateBuffer(UINT64 size);
+
+	ID3D12Device* mDevice = nullptr;
+
+	std::mutex mMutex;   // guards the allocation state below
+
+	Buffer mBuffer;
+	UINT64 mOffset = 0;
+
+	// Buffers the frame outgrew, and the bytes they handed out.
+	std::vector<Buffer> mFullBuffers;
+	UINT64 mFullBytes = 0;
+
+	BufferCapacity mCapacity{ MinSize };
+};
@@ -0,0 +1,130 @@
+#include "Archetype.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <new>
+
+namespace ecs
+{
+	uint32_t detail::RegisterComponent(uint32_t size, uint32_t align)
+	{
+		auto& registry = ComponentRegistry();
+		assert(registry.size() < MaxComponentTypes);
+
+		registry.push_back({ size, align });
+		return (uint32_t)registry.size() - 1;
+	}
+
+	static uint32_t AlignUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	Archetype::Archetype(ComponentMask mask) : mMask(mask)
+	{
+		for (uint32_t i = 0; i < MaxComponentTypes; ++i)
+		{
+			mOffsets[i] = InvalidOffset;
+			if ((mask & (ComponentMask(1) << i)) && GetComponentInfo(i).Size > 0)
+				mColumns.push_back(i);
+		}
+
+		// bytes needed by one row: its entity handle plus one element of every column
+		uint32_t rowBytes = sizeof(Entity);
+		for (uint32_t id : mColumns)
+			rowBytes += GetComponentInfo(id).Size;
+
+		// Start from the ideal capacity and shrink until the aligned columns fit.
+		mCapacity = ChunkByteSize / rowBytes;
+		while (mCapacity > 1)
+		{
+			uint32_t offset = AlignUp(mCapacity * sizeof(Entity), ColumnAlignment);
+			for (uint32_t id : mColumns)
+				offset = AlignUp(offset, ColumnAlignment) + mCapacity * GetComponentInfo(id).Size;
+
+			if (offset <= ChunkByteSize)
+				break;
+			--mCapacity;
+		}
+
+		uint32_t offset = AlignUp(mCapacity * sizeof(Entity), ColumnAlignment);
+		for (uint32_t id : mColumns)
+		{
+			offset = AlignUp(offset, ColumnAlignment);
+			mOffsets[id] = offset;
+			offset += mCapacity * GetComponentInfo(id).Size;
+		}
+	}
+
+	Archetype::~Archetype()
+	{
+		for (auto& chunk : mChunks)
+			::operator delete(chunk.Data, std::align_val_t(ColumnAlignment));
+	}
+
+	void Archetype::Allocate(Entity e, uint32_t& chunkIndex, uint32_t& row)
+	{
+		AllocateRun(1, chunkIndex, row);
+		mChunks[chunkIndex].Entities()[row] = e;
+	}
+
+	uint32_t Archetype::AllocateRun(uint32_t maxCount, uint32_t& chunkIndex, uint32_t& row)
+	{
+		if (mChunks.empty() || mChunks.back().Count == mCapacity)
+		{
+			Chunk chunk;
+			chunk.Data = static_cast<std::byte*>(::operator new(ChunkByteSize, std::align_val_t(ColumnAlignment)));
+			chunk.Owner = this;
+			mChunks.push_back(chunk);
+		}
+
+		chunkIndex = (uint32_t)mChunks.size() - 1;
+		Chunk& chunk = mChunks.back();
+		uint32_t count = std::min(maxCount, mCapacity - chunk.Count);
+		row = chunk.Count;
+		chunk.Count += count;
+		mSize += count;
+		return count;
+	}
+
+	Entity Archetype::RemoveSwapBack(uint32_t chunkIndex, uint32_t row)
+	{
+		uint32_t lastChunkIndex = (uint32_t)mChunks.size() - 1;
+		Chunk& last = mChunks[lastChunkIndex];
+		uint32_t lastRow = last.Count - 1;
+
+		Entity moved = NullEntity;
+		if (chunkIndex != lastChunkIndex || row != lastRow)
+		{
+			Chunk& hole = mChunks[chunkIndex];
+			for (uint32_t id : mColumns)
+			{
+				uint32_t size = GetComponentInfo(id).Size;
+				std::memcpy(
+					hole.Data + mOffsets[id] + row * size,
+					last.Data + mOffsets[id] + lastRow * size,
+					size);
+			}
+			moved = last.Entities()[lastRow];
+			hole.Entities()[row] = moved;
+		}
+
+		if (--last.Count == 0)
+		{
+			::operator delete(last.Data, std::align_val_t(ColumnAlignment));
+			mChunks.pop_back();
+		}
+		--mSize;
+
+		return moved;
+	}
+
+	void* Archetype::Component(uint32_t chunkIndex, uint32_t row, uint32_t componentId)
+	{
+		uint32_t offset = mOffsets[componentId];
+		if (offset == InvalidOffset)
+			return nullptr;
+		return mChunks[chunkIndex].Data + offset + row * GetComponentInfo(componentId).Size;
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+//
+// An archetype stores every entity that has exactly the same set of components.
+// Entities live in fixed-size chunks; inside a chunk each component is a
+// contiguous column (SoA), so systems walk plain arrays instead of chasing pointers.
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Entity.h"
+
+namespace ecs
+{
+	class Archetype;
+
+	struct Chunk
+	{
+		std::byte*       Data  = nullptr;
+		uint32_t         Count = 0;
+		const Archetype* Owner = nullptr;
+
+		Entity* Entities() { return reinterpret_cast<Entity*>(Data); }
+
+		// Returns nullptr if the archetype has no such column.
+		template<typename T>
+		T* Column();
+	};
+
+	class Archetype
+	{
+	public:
+		static constexpr uint32_t ChunkByteSize = 16 * 1024;
+		static constexpr uint32_t ColumnAlignment = 64;   // one cache line
+		static constexpr uint32_t InvalidOffset = 0xFFFFFFFFu;
+
+		explicit Archetype(ComponentMask mask);
+		~Archetype();
+
+		Archetype(const Archetype&) = delete;
+		Archetype& operator=(const Archetype&) = delete;
+
+		ComponentMask Mask() const { return mMask; }
+
+		uint32_t ChunkCapacity() const { return mCapacity; }
+
+		uint32_t ColumnOffset(uint32_t componentId) const { return mOffsets[componentId]; }
+
+		size_t Size() const { return mSize; }
+
+		std::vector<Chunk>& Chunks() { return mChunks; }
+
+		// Appends a row for e. The component data of the new row is left uninitialized.
+		void Allocate(Entity e, uint32_t& chunkIndex, uint32_t& row);
+
+		// Appends as many rows as fit in the last chunk (or a new one), at most
+		// maxCount, and returns how many. Entity handles and component data of
+		// the new rows are left uninitialized.
+		uint32_t AllocateRun(uint32_t maxCount, uint32_t& chunkIndex, uint32_t& row);
+
+		// Fills the hole at (chunkIndex, row) with the archetype's last row, so every
+		// chunk but the last one stays full. Returns the entity that was moved into
+		// the hole, or NullEntity if the removed row was the last one.
+		Entity RemoveSwapBack(uint32_t chunkIndex, uint32_t row);
+
+		void* Component(uint32_t chunkIndex, uint32_t row, uint32_t componentId);
+
+	private:
+		ComponentMask mMask = 0;
+		uint32_t mCapacity = 0;
+		uint32_t mOffsets[MaxComponentTypes];
+
+		// ids of the components that own a column (tags excluded)
+		std::vector<uint32_t> mColumns;
+
+		std::vector<Chunk> mChunks;
+		size_t mSize = 0;
+	};
+
+	template<typename T>
+	T* Chunk::Column()
+	{
+		uint32_t offset = Owner->ColumnOffset(ComponentId<T>());
+		if (offset == Archetype::InvalidOffset)
+			return nullptr;
+		return reinterpret_cast<T*>(Data + offset);
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+//
+// Entity handles and component type registration for the archetype ECS
+//
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace ecs
+{
+	// An entity is a 24-bit slot index plus an 8-bit generation, so a stale
+	// handle to a destroyed (and later reused) slot can be detected.
+	using Entity = uint32_t;
+
+	constexpr Entity NullEntity = 0xFFFFFFFFu;
+
+	constexpr uint32_t EntityIndexBits = 24;
+	constexpr uint32_t EntityIndexMask = (1u << EntityIndexBits) - 1;
+
+	// The last index is never handed out: with generation 255 it would
+	// encode to NullEntity.
+	constexpr uint32_t MaxEntityIndex = EntityIndexMask - 1;
+
+	inline uint32_t EntityIndex(Entity e) { return e & EntityIndexMask; }
+	inline uint32_t EntityGeneration(Entity e) { return e >> EntityIndexBits; }
+	inline Entity   MakeEntity(uint32_t index, uint32_t generation)
+	{
+		return (generation << EntityIndexBits) | (index & EntityIndexMask);
+	}
+
+	// One bit per registered component type.
+	using ComponentMask = uint64_t;
+	constexpr uint32_t MaxComponentTypes = 64;
+
+	struct ComponentInfo
+	{
+		uint32_t Size  = 0;   // 0 for tag components (no column is allocated)
+		uint32_t Align = 0;
+	};
+
+	namespace detail
+	{
+		inline std::vector<ComponentInfo>& ComponentRegistry()
+		{
+			static std::vector<ComponentInfo> registry;
+			return registry;
+		}
+
+		uint32_t RegisterComponent(uint32_t size, uint32_t align);
+	}
+
+	// Components are moved between chunks with memcpy, so they must be plain data.
+	template<typename T>
+	uint32_t ComponentId()
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "ECS components must be trivially copyable");
+
+		static const uint32_t id = detail::RegisterComponent(
+			std::is_empty_v<T> ? 0u : (uint32_t)sizeof(T),
+			(uint32_t)alignof(T));
+		return id;
+	}
+
+	inline const ComponentInfo& GetComponentInfo(uint32_t id) { return detail::ComponentRegistry()[id]; }
+
+	template<typename... Ts>
+	ComponentMask MaskOf()
+	{
+		return (ComponentMask(0) | ... | (ComponentMask(1) << ComponentId<Ts>()));
+	}
+}
@@ -0,0 +1,158 @@
+#include "World.h"
+
+#include <cassert>
+
+namespace ecs
+{
+	Entity World::CreateEntity(ComponentMask mask)
+	{
+		Archetype* archetype = GetOrCreateArchetype(mask);
+
+		uint32_t chunk, row;
+		archetype->AllocateRun(1, chunk, row);
+
+		Entity e = CreateRecord(archetype, chunk, row);
+		archetype->Chunks()[chunk].Entities()[row] = e;
+		return e;
+	}
+
+	Entity World::CreateRecord(Archetype* archetype, uint32_t chunk, uint32_t row)
+	{
+		uint32_t index;
+		if (!mFreeIndices.empty())
+		{
+			index = mFreeIndices.back();
+			mFreeIndices.pop_back();
+		}
+		else
+		{
+			index = (uint32_t)mRecords.size();
+			assert(index <= MaxEntityIndex);
+			mRecords.emplace_back();
+		}
+
+		EntityRecord& record = mRecords[index];
+		record.Arch = archetype;
+		record.Chunk = chunk;
+		record.Row = row;
+
+		++mAliveCount;
+		return MakeEntity(index, record.Generation);
+	}
+
+	void World::Destroy(Entity e)
+	{
+		if (!IsAlive(e))
+			return;
+
+		EntityRecord& record = mRecords[EntityIndex(e)];
+
+		Entity moved = record.Arch->RemoveSwapBack(record.Chunk, record.Row);
+		OnRowMoved(moved, record.Chunk, record.Row);
+
+		record.Arch = nullptr;
+		record.Generation = (record.Generation + 1) & 0xFF;
+		mFreeIndices.push_back(EntityIndex(e));
+
+		--mAliveCount;
+	}
+
+	bool World::IsAlive(Entity e) const
+	{
+		if (e == NullEntity || EntityIndex(e) >= mRecords.size())
+			return false;
+
+		const EntityRecord& record = mRecords[EntityIndex(e)];
+		return record.Arch != nullptr && record.Generation == EntityGeneration(e);
+	}
+
+	ComponentMask World::GetMask(Entity e) const
+	{
+		if (!IsAlive(e))
+			return 0;
+		return mRecords[EntityIndex(e)].Arch->Mask();
+	}
+
+	size_t World::Count(ComponentMask required) const
+	{
+		size_t count = 0;
+		for (const Archetype* archetype : mArchetypeList)
+		{
+			if ((archetype->Mask() & required) == required)
+				count += archetype->Size();
+		}
+		return count;
+	}
+
+	Archetype* World::GetOrCreateArchetype(ComponentMask mask)
+	{
+		auto it = mArchetypes.find(mask);
+		if (it != mArchetypes.end())
+			return it->second.get();
+
+		auto archetype = std::make_unique<Archetype>(mask);
+		Archetype* ptr = archetype.get();
+		mArchetypes.emplace(mask, std::move(archetype));
+		mArchetypeList.push_back(ptr);
+		return ptr;
+	}
+
+	void* World::GetComponent(Entity e, uint32_t componentId)
+	{
+		if (!IsAlive(e))
+			return nullptr;
+
+		EntityRecord& record = mRecords[EntityIndex(e)];
+		return record.Arch->Component(record.Chunk, record.Row, componentId);
+	}
+
+	void World::ChangeArchetype(Entity e, ComponentMask newMask)
+	{
+		if (!IsAlive(e))
+			return;
+
+		EntityRecord& record = mRecords[EntityIndex(e)];
+		Archetype* src = record.Arch;
+		if (src->Mask() == newMask)
+			return;
+
+		Archetype* dst = GetOrCreateArchetype(newMask);
+
+		uint32_t dstChunk, dstRow;
+		dst->Allocate(e, dstChunk, dstRow);
+
+		// Copy every component the two archetypes share.
+		ComponentMask shared = src->Mask() & newMask;
+		for (uint32_t id = 0; id < MaxComponentTypes; ++id)
+		{
+			if (!(shared & (ComponentMask(1) << id)))
+				continue;
+
+			uint32_t size = GetComponentInfo(id).Size;
+			if (size > 0)
+			{
+				std::memcpy(
+					dst->Component(dstChunk, dstRow, id),
+					src->Component(record.Chunk, record.Row, id),
+					size);
+			}
+		}
+
+		Entity moved = src->RemoveSwapBack(record.Chunk, record.Row);
+		OnRowMoved(moved, record.Chunk, record.Row);
+
+		record.Arch = dst;
+		record.Chunk = dstChunk;
+		record.Row = dstRow;
+	}
+
+	void World::OnRowMoved(Entity moved, uint32_t chunk, uint32_t row)
+	{
+		if (moved == NullEntity)
+			return;
+
+		EntityRecord& record = mRecords[EntityIndex(moved)];
+		record.Chunk = chunk;
+		record.Row = row;
+	}
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+//
+// World owns all entities and archetypes. Systems iterate it chunk by chunk:
+//
+//     world.ForEachChunk<TransformComponent, BoundsComponent>([](ecs::Chunk& chunk) {
+//         auto* transforms = chunk.Column<TransformComponent>();
+//         for (uint32_t i = 0; i < chunk.Count; ++i) ...
+//     });
+//
+// Creating or destroying entities inside ForEachChunk is not allowed.
+//
+
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Archetype.h"
+
+namespace ecs
+{
+	class World
+	{
+	public:
+		World() = default;
+		~World() = default;
+
+		World(const World&) = delete;
+		World& operator=(const World&) = delete;
+
+		template<typename... Ts>
+		Entity Create(const Ts&... components)
+		{
+			Entity e = CreateEntity(MaskOf<Ts...>());
+			(WriteComponent(e, components), ...);
+			return e;
+		}
+
+		// Like Create, but the entity is also given the tag components in 'tags',
+		// which lets callers pick a tag (and so an archetype) at runtime.
+		template<typename... Ts>
+		Entity CreateTagged(ComponentMask tags, const Ts&... components)
+		{
+			Entity e = CreateEntity(tags | MaskOf<Ts...>());
+			(WriteComponent(e, components), ...);
+			return e;
+		}
+
+		// Creates 'count' entities with the components in 'mask' and stores their
+		// handles in 'entities'. They are appended to the archetype's chunks, and
+		// fill(chunk, row, first, n) is called for every run of n new rows starting
+		// at 'row', which hold entities[first] .. entities[first + n - 1], so whole
+		// column ranges can be copied at once. Components are uninitialized until
+		// fill writes them.
+		template<typename F>
+		void CreateMany(ComponentMask mask, uint32_t count, Entity* entities, F&& fill)
+		{
+			Archetype* archetype = GetOrCreateArchetype(mask);
+
+			for (uint32_t first = 0; first < count; )
+			{
+				uint32_t chunkIndex, row;
+				uint32_t n = archetype->AllocateRun(count - first, chunkIndex, row);
+
+				Chunk& chunk = archetype->Chunks()[chunkIndex];
+				for (uint32_t i = 0; i < n; ++i)
+				{
+					entities[first + i] = CreateRecord(archetype, chunkIndex, row + i);
+					chunk.Entities()[row + i] = entities[first + i];
+				}
+
+				fill(chunk, row, first, n);
+				first += n;
+			}
+		}
+
+		void Destroy(Entity e);
+
+		bool IsAlive(Entity e) const;
+
+		ComponentMask GetMask(Entity e) const;
+
+		template<typename T>
+		bool Has(Entity e) const
+		{
+			return (GetMask(e) & (ComponentMask(1) << ComponentId<T>())) != 0;
+		}
+
+		// Returns nullptr if the entity is dead or does not have T.
+		template<typename T>
+		T* Get(Entity e)
+		{
+			return static_cast<T*>(GetComponent(e, ComponentId<T>()));
+		}
+
+		// Moves the entity to the archetype that also contains T.
+		template<typename T>
+		void Add(Entity e, const T& component = T())
+		{
+			ChangeArchetype(e, GetMask(e) | MaskOf<T>());
+			WriteComponent(e, component);
+		}
+
+		template<typename T>
+		void Remove(Entity e)
+		{
+			ChangeArchetype(e, GetMask(e) & ~MaskOf<T>());
+		}
+
+		// Invokes f(Chunk&) for every non-empty chunk of every archetype that has
+		// all of the components in 'required'.
+		template<typename F>
+		void ForEachChunk(ComponentMask required, F&& f)
+		{
+			for (Archetype* archetype : mArchetypeList)
+			{
+				if ((archetype->Mask() & required) != required)
+					continue;
+
+				for (Chunk& chunk : archetype->Chunks())
+					f(chunk);
+			}
+		}
+
+		template<typename... Ts, typename F>
+		void ForEachChunk(F&& f)
+		{
+			ForEachChunk(MaskOf<Ts...>(), std::forward<F>(f));
+		}
+
+		// Number of alive entities that have all of the components in 'required'.
+		size_t Count(ComponentMask required) const;
+
+		size_t Size() const { return mAliveCount; }
+
+	private:
+		struct EntityRecord
+		{
+			Archetype* Arch = nullptr;   // nullptr while the slot is free
+			uint32_t Chunk = 0;
+			uint32_t Row = 0;
+			uint32_t Generation = 0;
+		};
+
+		Entity CreateEntity(ComponentMask mask);
+
+		// Takes a free entity slot for a row that has already been allocated.
+		Entity CreateRecord(Archetype* archetype, uint32_t chunk, uint32_t row);
+
+		Archetype* GetOrCreateArchetype(ComponentMask mask);
+
+		void* GetComponent(Entity e, uint32_t componentId);
+
+		void ChangeArchetype(Entity e, ComponentMask newMask);
+
+		// Patches the record of the entity that RemoveSwapBack moved into a hole.
+		void OnRowMoved(Entity moved, uint32_t chunk, uint32_t row);
+
+		template<typename T>
+		void WriteComponent(Entity e, const T& component)
+		{
+			if constexpr (!std::is_empty_v<T>)
+				std::memcpy(GetComponent(e, ComponentId<T>()), &component, sizeof(T));
+		}
+
+		std::vector<EntityRecord> mRecords;
+		std::vector<uint32_t> mFreeIndices;
+
+		std::unordered_map<ComponentMask, std::unique_ptr<Archetype>> mArchetypes;
+		std::vector<Archetype*> mArchetypeList;  // creation order, keeps iteration deterministic
+
+		size_t mAliveCount = 0;
+	};
+}
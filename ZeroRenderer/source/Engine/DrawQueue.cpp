@@ -0,0 +1,87 @@
+#include "DrawQueue.h"
+
+#include <cstring>
+
+uint32_t SortKey::QuantizeDepth(float viewDepth)
+{
+	if (!(viewDepth > 0.0f))
+		return 0;
+
+	uint32_t bits;
+	std::memcpy(&bits, &viewDepth, sizeof(bits));
+
+	// The sign bit is 0, so the next DepthBits bits hold the exponent and the
+	// top of the mantissa.
+	return bits >> (31 - DepthBits);
+}
+
+uint64_t SortKey::Make(RenderLayer layer, uint32_t submeshId, uint32_t materialIndex, float viewDepth)
+{
+	constexpr uint64_t SubmeshMask = (1ull << SubmeshBits) - 1;
+	constexpr uint64_t DepthMask = (1ull << DepthBits) - 1;
+	constexpr uint64_t MaterialMask = (1ull << MaterialBits) - 1;
+
+	uint64_t depth = QuantizeDepth(viewDepth) & DepthMask;
+	uint64_t key = (uint64_t)layer << (64 - LayerBits);
+
+	if (layer == RenderLayer::Transparent)
+	{
+		key |= (DepthMask - depth) << (SubmeshBits + MaterialBits);
+		key |= (submeshId & SubmeshMask) << MaterialBits;
+	}
+	else
+	{
+		key |= (submeshId & SubmeshMask) << (DepthBits + MaterialBits);
+		key |= depth << MaterialBits;
+	}
+
+	return key | (materialIndex & MaterialMask);
+}
+
+void DrawQueue::Sort()
+{
+	const size_t count = mKeys.size();
+	if (count < 2)
+		return;
+
+	// One pass over the keys counts the digits of every pass.
+	constexpr int Passes = 8;
+	uint32_t histograms[Passes][256] = {};
+	for (uint64_t key : mKeys)
+	{
+		for (int pass = 0; pass < Passes; ++pass)
+			++histograms[pass][(key >> (pass * 8)) & 0xFF];
+	}
+
+	mTempKeys.resize(count);
+	mTempItems.resize(count);
+
+	for (int pass = 0; pass < Passes; ++pass)
+	{
+		uint32_t* histogram = histograms[pass];
+
+		// A digit all keys share would leave the order as it is.
+		const uint64_t digit = (mKeys[0] >> (pass * 8)) & 0xFF;
+		if (histogram[digit] == count)
+			continue;
+
+		uint32_t offset = 0;
+		for (int d = 0; d < 256; ++d)
+		{
+			uint32_t n = histogram[d];
+			histogram[d] = offset;
+			offset += n;
+		}
+
+		const uint32_t shift = pass * 8;
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32_t to = histogram[(mKeys[i] >> shift) & 0xFF]++;
+			mTempKeys[to] = mKeys[i];
+			mTempItems[to] = mItems[i];
+		}
+
+		mKeys.swap(mTempKeys);
+		mItems.swap(mTempItems);
+	}
+}
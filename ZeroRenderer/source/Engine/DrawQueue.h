@@ -0,0 +1,87 @@
+#pragma once
+
+//
+// Sorted draw queue.
+//
+// Every visible item of a layer gets a 64-bit key, and sorting the keys puts
+// the draws in order. The fields, from the most significant bit down:
+//
+//   Opaque:      layer (8) | submesh (20) | depth (24)  | material (12)
+//   Transparent: layer (8) | ~depth (24)  | submesh (20) | material (12)
+//
+// The layer stands in for the PSO, which the passes choose per layer. Opaque
+// items are grouped by submesh, so every run is still one instanced draw, and
+// go front to back inside it so early-z rejects more. Transparent items go
+// back to front across the whole layer, as blending needs; only neighbours
+// that draw the same submesh still share a draw. The material only breaks
+// ties, since materials are indexed per instance.
+//
+// Depth is the view-space z of the item's bounds center. It is quantized by
+// keeping the top bits of the float, whose bit patterns sort like the values
+// when positive, so no depth range is needed.
+//
+// The keys are sorted by an LSD radix sort with 8-bit digits that skips the
+// digits all keys share, so sorting is linear in the number of draws.
+//
+
+#include "../Shader/RenderItem.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace SortKey
+{
+	constexpr uint32_t LayerBits = 8;
+	constexpr uint32_t SubmeshBits = 20;
+	constexpr uint32_t DepthBits = 24;
+	constexpr uint32_t MaterialBits = 12;
+
+	static_assert(LayerBits + SubmeshBits + DepthBits + MaterialBits == 64);
+
+	// Items behind the eye count as depth 0.
+	uint32_t QuantizeDepth(float viewDepth);
+
+	// Submesh ids and material indices wrap past their bits; the draws stay
+	// correct, only their order degrades.
+	uint64_t Make(RenderLayer layer, uint32_t submeshId, uint32_t materialIndex, float viewDepth);
+}
+
+class DrawQueue
+{
+public:
+	void Clear()
+	{
+		mKeys.clear();
+		mItems.clear();
+	}
+
+	void Reserve(size_t count)
+	{
+		mKeys.reserve(count);
+		mItems.reserve(count);
+	}
+
+	void Push(uint64_t key, uint32_t item)
+	{
+		mKeys.push_back(key);
+		mItems.push_back(item);
+	}
+
+	// Orders the items by increasing key; items with equal keys keep the
+	// order they were pushed in.
+	void Sort();
+
+	size_t Size() const { return mItems.size(); }
+
+	// the pushed items, sorted once Sort has run
+	const std::vector<uint32_t>& Items() const { return mItems; }
+	const std::vector<uint64_t>& Keys() const { return mKeys; }
+
+private:
+	std::vector<uint64_t> mKeys;
+	std::vector<uint32_t> mItems;
+
+	// the other half of each radix pass
+	std::vector<uint64_t> mTempKeys;
+	std::vector<uint32_t> mTempItems;
+};
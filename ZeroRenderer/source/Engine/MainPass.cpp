@@ -1,65 +1,77 @@
 #include "MainPass.h"
 
 MainPass::MainPass(SsaoPass* pass, ShadowPass* shadow, UINT s, UINT c) :
-	ssaoPass(pass), shadowPass(shadow), mSkyTexHeapIndex(s), mCbvSrvUavDescriptorSize(c) {}
-
-void MainPass::Render(
-    ComPtr<ID3D12GraphicsCommandList> mCommandList,
-    FrameResource* mCurrFrameResource,
-    ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap,
-    CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv,
-    ComPtr<ID3D12RootSignature> mRootSignature,
-    PSOManager* psoManager,
-    Scene* mScene)
+	ssaoPass(pass), shadowPass(shadow), mSkyTexHeapIndex(s), mCbvSrvUavDescriptorSize(c)
 {
-	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
+	mCullLayers =
+		LayerMask(RenderLayer::Opaque) | LayerMask(RenderLayer::Sky) |
+		LayerMask(RenderLayer::Transparent) | LayerMask(RenderLayer::Highlight);
+}
 
-	mCommandList->RSSetViewports(1, &mScreenViewport);
-	mCommandList->RSSetScissorRects(1, &mScissorRect);
+void MainPass::Declare(RenderGraph& graph, FrameTargets& targets, ID3D12Device* device)
+{
+	mGraphPass = graph.AddPass("Main");
+	graph.Read(mGraphPass, targets.ShadowMap, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Read(mGraphPass, targets.AmbientMap, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Write(mGraphPass, targets.BackBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	graph.Write(mGraphPass, targets.DepthStencil, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+}
 
-	// Rebind state whenever graphics root signature changes.
-	auto matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
-	mCommandList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
+void MainPass::Prepare(const RenderContext& context)
+{
+	ClearPrepared();
 
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(buffer,
-		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET)));
+	PSOManager* psoManager = context.Psos;
+	PrepareLayer(context.CurrentScene, RenderLayer::Opaque, psoManager->GetPipelineState("opaque"), context.Frame);
+	PrepareLayer(context.CurrentScene, RenderLayer::Sky, psoManager->GetPipelineState("sky"), context.Frame);
+	PrepareLayer(context.CurrentScene, RenderLayer::Transparent, psoManager->GetPipelineState("transparent"), context.Frame);
+	PrepareLayer(context.CurrentScene, RenderLayer::Highlight, psoManager->GetPipelineState("highlight"), context.Frame);
+}
+
+void MainPass::BeginPass(CommandRecorder& mCommandList, const RenderContext& context)
+{
+	// The back buffer to RENDER_TARGET, the maps of the earlier passes to
+	// shader resources.
+	context.Graph->RecordBarriers(mCommandList.Get(), mGraphPass);
 
 	// Clear the back buffer.
 	mCommandList->ClearRenderTargetView(rtvHandle, Colors::WhiteSmoke, 0, nullptr);
 
-	// WE ALREADY WROTE THE DEPTH INFO TO THE DEPTH BUFFER IN DrawNormalsAndDepth,
+	// WE ALREADY WROTE THE DEPTH INFO TO THE DEPTH BUFFER IN THE SSAO PASS,
 	// SO DO NOT CLEAR DEPTH.
+}
 
-	// Specify the buffers we are going to render to.
-	mCommandList->OMSetRenderTargets(1, &rtvHandle, true, &dsvHandle);
-
-	mCommandList->SetGraphicsRootDescriptorTable(4, mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+void MainPass::BindState(CommandRecorder& mCommandList, const RenderContext& context)
+{
+	mCommandList.SetGraphicsRootSignature(context.RootSignature);
 
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+	mCommandList->RSSetViewports(1, &mScreenViewport);
+	mCommandList->RSSetScissorRects(1, &mScissorRect);
 
-	CD3DX12_GPU_DESCRIPTOR_HANDLE skyTexDescriptor(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	skyTexDescriptor.Offset(mSkyTexHeapIndex, mCbvSrvUavDescriptorSize);
-	mCommandList->SetGraphicsRootDescriptorTable(3, skyTexDescriptor);
+	// Rebind state whenever graphics root signature changes.
+	mCommandList.SetGraphicsRootShaderResourceView(MaterialBufferRootParameter,
+		mSceneBuffer->Address(GpuSceneBuffer::Region::Materials));
 
-	mCommandList->SetPipelineState(psoManager->GetPipelineState("opaque"));
-	DrawRenderItems(mCommandList.Get(), mScene->GetRenderLayer(RenderLayer::Opaque), mCurrFrameResource);
+	// Specify the buffers we are going to render to.
+	mCommandList->OMSetRenderTargets(1, &rtvHandle, true, &dsvHandle);
 
-	mCommandList->SetPipelineState(psoManager->GetPipelineState("sky"));
-	DrawRenderItems(mCommandList.Get(), mScene->GetRenderLayer(RenderLayer::Sky), mCurrFrameResource);
+	mCommandList.SetGraphicsRootDescriptorTable(4, context.SrvHeap->GetGPUDescriptorHandleForHeapStart());
 
-	mCommandList->SetPipelineState(psoManager->GetPipelineState("transparent"));
-	DrawRenderItems(mCommandList.Get(), mScene->GetRenderLayer(RenderLayer::Transparent), mCurrFrameResource);
+	mCommandList.SetGraphicsRootConstantBufferView(1, mMainPassCBAddress);
 
-	mCommandList->SetPipelineState(psoManager->GetPipelineState("highlight"));
-	DrawRenderItems(mCommandList.Get(), mScene->GetRenderLayer(RenderLayer::Highlight), mCurrFrameResource);
+	CD3DX12_GPU_DESCRIPTOR_HANDLE skyTexDescriptor(context.SrvHeap->GetGPUDescriptorHandleForHeapStart());
+	skyTexDescriptor.Offset(mSkyTexHeapIndex, mCbvSrvUavDescriptorSize);
+	mCommandList.SetGraphicsRootDescriptorTable(3, skyTexDescriptor);
+}
 
+void MainPass::EndPass(CommandRecorder& mCommandList, const RenderContext& context)
+{
 	ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), mCommandList.Get());
+	mCommandList.Invalidate();
 
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(buffer,
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT)));
+	// The back buffer back to PRESENT, and the transients to the state the
+	// next frame starts them in.
+	context.Graph->RecordFinalBarriers(mCommandList.Get());
 }
 
 void MainPass::Update(FrameResource* mCurrFrameResource, Camera& mCamera)
@@ -90,6 +102,8 @@ void MainPass::Update(FrameResource* mCurrFrameResource, Camera& mCamera)
 	XMStoreFloat4x4(&mMainPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
 	XMStoreFloat4x4(&mMainPassCB.ViewProjTex, XMMatrixTranspose(viewProjTex));
 	XMStoreFloat4x4(&mMainPassCB.ShadowTransform, XMMatrixTranspose(shadowTransform));
+
+	SetCullView(view, proj);
 	mMainPassCB.EyePosW = mCamera.GetPosition3f();
 	mMainPassCB.RenderTargetSize = XMFLOAT2((float)mClientWidth, (float)mClientHeight);
 	mMainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / mClientWidth, 1.0f / mClientHeight);
@@ -105,11 +119,11 @@ void MainPass::Update(FrameResource* mCurrFrameResource, Camera& mCamera)
 	mMainPassCB.Lights[2].Direction = shadowPass->mBaseLightDirections[2];
 	mMainPassCB.Lights[2].Strength = { 0.0f, 0.0f, 0.0f };
 
-	auto currPassCB = mCurrFrameResource->PassCB.get();
-	currPassCB->CopyData(0, mMainPassCB);
+	mMainPassCBAddress = mCurrFrameResource->Uploads->CopyConstants(mMainPassCB);
 
 	// update ssaoPass
 	ssaoPass->mMainPassCB = mMainPassCB;
+	ssaoPass->mMainPassCBAddress = mMainPassCBAddress;
 	ssaoPass->mScreenViewport = mScreenViewport;
 	ssaoPass->mScissorRect = mScissorRect;
 }
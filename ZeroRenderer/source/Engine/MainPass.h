@@ -16,14 +16,13 @@ class MainPass : public RenderPass
 public:
     MainPass(SsaoPass*, ShadowPass*, UINT, UINT);
 
-    virtual void Render(
-        ComPtr<ID3D12GraphicsCommandList> mCommandList,
-        FrameResource* mCurrFrameResource,
-        ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap,
-        CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv,
-        ComPtr<ID3D12RootSignature> mRootSignature,
-        PSOManager* psoManager,
-        Scene* mScene) override;
+    virtual void Declare(RenderGraph& graph, FrameTargets& targets, ID3D12Device* device) override;
+
+    virtual void Prepare(const RenderContext& context) override;
+
+    virtual void BeginPass(CommandRecorder& mCommandList, const RenderContext& context) override;
+    virtual void BindState(CommandRecorder& mCommandList, const RenderContext& context) override;
+    virtual void EndPass(CommandRecorder& mCommandList, const RenderContext& context) override;
 
     virtual void Update(FrameResource* mCurrFrameResource, Camera& mCamera) override;
 
@@ -35,7 +34,6 @@ public:
     //  ZeroRenderer::Update и per frame
     D3D12_VIEWPORT mScreenViewport;
     D3D12_RECT mScissorRect;
-    ID3D12Resource* buffer;
     D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle;
     D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle;
     int mClientWidth;
@@ -47,4 +45,5 @@ private:
     SsaoPass* ssaoPass;  // Ϊ˸ ssaoCB ʹõ trick
     ShadowPass* shadowPass;
     PassConstants mMainPassCB;
+    D3D12_GPU_VIRTUAL_ADDRESS mMainPassCBAddress = 0;  // in the frame's upload memory
 };
\ No newline at end of file
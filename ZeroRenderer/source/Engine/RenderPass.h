@@ -1,6 +1,10 @@
 #pragma once
 
 #include "../DXRuntime/FrameResource.h"
+#include "../DXRuntime/CommandRecorder.h"
+#include "../DXRuntime/GpuSceneBuffer.h"
+#include "../DXRuntime/IndirectArguments.h"
+#include "../DXRuntime/RenderGraphResources.h"
 
 #include "../Shader/RenderItem.h"
 
@@ -8,54 +12,359 @@
 
 #include "Scene.h"
 
+#include "DrawQueue.h"
+
 #include "../Common/Camera.h"
 
+#include <atomic>
+#include <chrono>
+
 class Scene;
 
 class PSOManager;
 
-struct RenderItem;
+// What the passes record with; the same for every list of a frame.
+struct RenderContext
+{
+	FrameResource* Frame = nullptr;
+	ID3D12DescriptorHeap* SrvHeap = nullptr;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE NullSrv;
+	ID3D12RootSignature* RootSignature = nullptr;       // of the scene shaders
+	ID3D12RootSignature* SsaoRootSignature = nullptr;
+	PSOManager* Psos = nullptr;
+	Scene* CurrentScene = nullptr;
+	const RenderGraphResources* Graph = nullptr;        // records the barriers
+};
 
+// The resources the passes hand to each other in the render graph.
+struct FrameTargets
+{
+	RenderGraph::ResourceId BackBuffer = RenderGraph::None;
+	RenderGraph::ResourceId DepthStencil = RenderGraph::None;
+	RenderGraph::ResourceId ShadowMap = RenderGraph::None;
+	RenderGraph::ResourceId AmbientMap = RenderGraph::None;
+};
+
+//
+// A pass is recorded in steps, so that it can be split over several command
+// lists recorded on different threads:
+//
+//   Prepare     sorts the visible items and writes their instances and
+//               indirect commands to the frame's upload memory
+//   BeginPass   what runs once before the draws: the barriers of the
+//               render graph, clears
+//   BindState   the state every list of the pass starts with, as command
+//               lists inherit none from the one before
+//   RecordDraws a range of the prepared draws
+//   EndPass     what runs once after the draws
+//
+// The lists of a pass run in order, the first one with BeginPass and the
+// last one with EndPass. Prepare may run concurrently with the Prepare of
+// other passes, and RecordDraws with itself on other lists.
+//
+// Barriers are not written by hand: Declare adds the graph passes of the
+// pass with what they read and write, and the compiled graph's barriers are
+// recorded before each of them (see RenderGraph).
+//
 class RenderPass
 {
 public:
 	RenderPass() = default;
 	virtual ~RenderPass() = default;
 
-	virtual void Render(
-        ComPtr<ID3D12GraphicsCommandList> mCommandList,
-        FrameResource* mCurrFrameResource,
-        ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap,
-        CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv,
-        ComPtr<ID3D12RootSignature> mRootSignature,
-		PSOManager* psoManager,
-        Scene* mScene) = 0;
+	// Adds the graph passes, in the order they run, and the resources the
+	// pass owns, whose ids go to targets for the passes after it.
+	virtual void Declare(RenderGraph& graph, FrameTargets& targets, ID3D12Device* device) = 0;
+
+	// Takes the resources the realized graph created for it.
+	virtual void AttachResources(const RenderGraphResources& resources) {}
+
+	// The graph pass BeginPass starts; if the graph culled it, the pass is
+	// not recorded.
+	RenderGraph::PassId GetGraphPass() const { return mGraphPass; }
+
+	virtual void Prepare(const RenderContext& context) = 0;
+
+	virtual void BeginPass(CommandRecorder& cmdList, const RenderContext& context) {}
+	virtual void BindState(CommandRecorder& cmdList, const RenderContext& context) = 0;
+	virtual void EndPass(CommandRecorder& cmdList, const RenderContext& context) {}
+
+	// Records the whole prepared pass into one list.
+	void Render(CommandRecorder& cmdList, const RenderContext& context)
+	{
+		BeginPass(cmdList, context);
+		BindState(cmdList, context);
+		RecordDraws(cmdList, 0, GetPreparedDrawCount());
+		EndPass(cmdList, context);
+	}
 
 	virtual void Update(FrameResource* mCurrFrameResource, Camera& camera) = 0;
 
-    void DrawRenderItems(
-		ID3D12GraphicsCommandList* cmdList, 
-		std::vector<RenderItem*>& ritems,
-		FrameResource* mCurrFrameResource)
-    {
-		UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	// Culls the scene against the view set by Update; Prepare then
+	// only draws the survivors.
+	void Cull(Scene* mScene)
+	{
+		mScene->Cull(mFrustum, mCullView, mCullProj, mCullLayers, mVisible);
+
+		mDrawCount = 0;
+		mCallCount = 0;
+		mInstanceCount = 0;
+		mSortMilliseconds = 0.0f;
+	}
+
+	// Drops the items of the last Cull hidden behind the occluders. The buffer
+	// must have been rendered from the view of this pass.
+	void OcclusionCull(Scene* mScene, const OcclusionBuffer& buffer)
+	{
+		mScene->OcclusionCull(buffer, mVisible);
+	}
+
+	// Drops the items of the last Cull that the baked sets hide from 'eye'.
+	// Returns false if the scene has no set for that position.
+	bool PvsCull(Scene* mScene, const XMFLOAT3& eye)
+	{
+		return mScene->PvsCull(eye, mVisible);
+	}
+
+	const VisibleSet& GetVisibleSet() const { return mVisible; }
+
+	// Root parameter of the first instance of a draw; the shaders read
+	// instance gInstanceBase + SV_InstanceID of the layer's instance list.
+	static constexpr UINT InstanceBaseRootParameter = 5;
 
-		auto objectCB = mCurrFrameResource->ObjectCB->Resource(); // õ ID3D12Resource
+	// Root parameters of the object and material records of the scene buffer.
+	static constexpr UINT ObjectBufferRootParameter = 6;
+	static constexpr UINT MaterialBufferRootParameter = 2;
 
-		// For each render item...
-		for (size_t i = 0; i < ritems.size(); ++i)
+	// Draws, the API calls that issued them (one per draw, or one per
+	// ExecuteIndirect) and instances prepared and recorded since the last Cull.
+	uint32_t GetDrawCount() const { return mDrawCount; }
+	uint32_t GetCallCount() const { return mCallCount; }
+	uint32_t GetInstanceCount() const { return mInstanceCount; }
+
+	// With a signature (of DrawLayout), the prepared draws are written to
+	// the frame's upload memory and recorded with one ExecuteIndirect per
+	// layer and list, split only where the topology changes. Without one
+	// they are drawn directly. Set before Prepare.
+	void SetDrawSignature(ID3D12CommandSignature* signature) { mDrawSignature = signature; }
+
+	// The object and material records the pass draws with.
+	void SetSceneBuffer(const GpuSceneBuffer* sceneBuffer) { mSceneBuffer = sceneBuffer; }
+
+	// Indirect command of a run of instanceCount instances of item, starting at instanceBase.
+	static IndirectDrawArguments MakeIndirectDraw(const DrawItem& item, UINT instanceBase, UINT instanceCount)
+	{
+		IndirectDrawArguments args;
+		args.InstanceBase = instanceBase;
+		args.VertexBufferView = item.VertexBufferView;
+		args.IndexBufferView = item.IndexBufferView;
+		args.Draw.IndexCountPerInstance = item.IndexCount;
+		args.Draw.InstanceCount = instanceCount;
+		args.Draw.StartIndexLocation = item.StartIndexLocation;
+		args.Draw.BaseVertexLocation = item.BaseVertexLocation;
+		args.Draw.StartInstanceLocation = 0;
+		return args;
+	}
+
+	// Time spent building and sorting the draw keys since the last Cull.
+	float GetSortMilliseconds() const { return mSortMilliseconds; }
+
+	// Draws made by the last Prepare, in the order RecordDraws takes them.
+	uint32_t GetPreparedDrawCount() const { return (uint32_t)mDraws.size(); }
+
+	// Records the prepared draws [begin, end), binding the pipeline state and
+	// the instances of each layer they cover. BindState must come first in
+	// the list.
+	void RecordDraws(CommandRecorder& cmdList, uint32_t begin, uint32_t end)
+	{
+		const D3D12_GPU_VIRTUAL_ADDRESS objects = mSceneBuffer->Address(GpuSceneBuffer::Region::Objects);
+
+		for (const PreparedLayer& layer : mLayers)
 		{
-			auto ri = ritems[i];
+			const uint32_t first = std::max(begin, layer.FirstDraw);
+			const uint32_t last = std::min(end, layer.FirstDraw + layer.DrawCount);
+			if (first >= last)
+				continue;
+
+			cmdList.SetPipelineState(layer.PipelineState);
 
-			cmdList->IASetVertexBuffers(0, 1, get_rvalue_ptr(ri->Geo->VertexBufferView()));
-			cmdList->IASetIndexBuffer(get_rvalue_ptr(ri->Geo->IndexBufferView()));
-			cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+			// Every draw reads the same buffers, offset by its instance base.
+			cmdList.SetGraphicsRootShaderResourceView(0, layer.Instances.GPU);
+			cmdList.SetGraphicsRootShaderResourceView(ObjectBufferRootParameter, objects);
 
-			D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
+			if (layer.Commands.Resource != nullptr)
+			{
+				// Command i of the layer is its draw i. The topology is not
+				// part of the signature, so a change of it splits the calls.
+				for (uint32_t run = first, next; run < last; run = next)
+				{
+					D3D12_PRIMITIVE_TOPOLOGY topology = mDraws[run].Item->PrimitiveType;
+					for (next = run + 1; next < last && mDraws[next].Item->PrimitiveType == topology; ++next)
+						;
 
-			cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
+					cmdList.IASetPrimitiveTopology(topology);
+					cmdList.ExecuteIndirect(mDrawSignature, next - run, layer.Commands.Resource,
+						layer.Commands.Offset + (UINT64)(run - layer.FirstDraw) * sizeof(IndirectDrawArguments));
+					++mCallCount;
+				}
+				continue;
+			}
 
-			cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+			for (uint32_t i = first; i < last; ++i)
+			{
+				const PreparedDraw& draw = mDraws[i];
+				const DrawItem& ri = *draw.Item;
+
+				// Runs of submeshes of one geometry keep the buffers bound.
+				cmdList.IASetVertexBuffers(0, 1, &ri.VertexBufferView);
+				cmdList.IASetIndexBuffer(&ri.IndexBufferView);
+				cmdList.IASetPrimitiveTopology(ri.PrimitiveType);
+
+				cmdList.SetGraphicsRoot32BitConstant(InstanceBaseRootParameter, draw.FirstInstance, 0);
+
+				cmdList->DrawIndexedInstanced(ri.IndexCount, draw.InstanceCount, ri.StartIndexLocation, ri.BaseVertexLocation, 0);
+				++mCallCount;
+			}
 		}
-    }
+	}
+
+protected:
+	// Forgets the draws of the last Prepare.
+	void ClearPrepared()
+	{
+		mLayers.clear();
+		mDraws.clear();
+	}
+
+	// Adds the visible items of the layer, drawn with pso, to the prepared
+	// draws: sorted by their keys (see DrawQueue), one instanced draw per
+	// run of the same submesh. Their object indices and indirect commands go
+	// to blocks of the frame's upload memory; both are gathered first and
+	// copied in one go, as the upload memory is write-combined.
+	void PrepareLayer(Scene* mScene, RenderLayer layer, ID3D12PipelineState* pso, FrameResource* mCurrFrameResource)
+	{
+		const auto& items = mScene->GetDrawItems(layer);
+		const auto& objects = mScene->GetObjectData();
+
+		auto sortStart = std::chrono::steady_clock::now();
+
+		// Depth along the view direction of the pass.
+		const XMFLOAT4X4& view = mCullView;
+
+		mQueue.Clear();
+		mQueue.Reserve(mVisible.Items[(int)layer].size());
+		for (uint32_t index : mVisible.Items[(int)layer])
+		{
+			const DrawItem& item = items[index];
+			XMFLOAT3 c = mScene->GetDrawCenter(layer, index);
+			float depth = c.x * view._13 + c.y * view._23 + c.z * view._33 + view._43;
+
+			mQueue.Push(SortKey::Make(layer, item.SubmeshId, objects[item.ObjectIndex].MaterialIndex, depth), index);
+		}
+		mQueue.Sort();
+
+		mSortMilliseconds += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - sortStart).count();
+
+		const auto& order = mQueue.Items();
+		if (order.empty())
+			return;
+
+		PreparedLayer prepared;
+		prepared.PipelineState = pso;
+		prepared.FirstDraw = (uint32_t)mDraws.size();
+
+		mInstances.clear();
+		mCommands.clear();
+
+		for (size_t begin = 0, end; begin < order.size(); begin = end)
+		{
+			const DrawItem& ri = items[order[begin]];
+
+			UINT firstInstance = (UINT)mInstances.size();
+			for (end = begin; end < order.size() && items[order[end]].SubmeshId == ri.SubmeshId; ++end)
+				mInstances.push_back(items[order[end]].ObjectIndex);
+
+			UINT instanceCount = UINT(end - begin);
+
+			mDraws.push_back({ &ri, firstInstance, instanceCount });
+			if (mDrawSignature)
+				mCommands.push_back(MakeIndirectDraw(ri, firstInstance, instanceCount));
+
+			++mDrawCount;
+			mInstanceCount += instanceCount;
+		}
+
+		prepared.DrawCount = (uint32_t)mDraws.size() - prepared.FirstDraw;
+
+		// The GPU reads them when the lists execute, after they are copied.
+		auto uploads = mCurrFrameResource->Uploads.get();
+		prepared.Instances = uploads->AllocateArray<UINT>((UINT)mInstances.size());
+		WriteCombinedCopy(prepared.Instances.CPU, mInstances.data(), mInstances.size() * sizeof(UINT));
+		if (mDrawSignature)
+		{
+			prepared.Commands = uploads->AllocateArray<IndirectDrawArguments>((UINT)mCommands.size());
+			WriteCombinedCopy(prepared.Commands.CPU, mCommands.data(), mCommands.size() * sizeof(IndirectDrawArguments));
+		}
+		StreamFence();
+
+		mLayers.push_back(prepared);
+	}
+
+	void SetCullView(FXMMATRIX view, CXMMATRIX proj)
+	{
+		XMStoreFloat4x4(&mCullView, view);
+		XMStoreFloat4x4(&mCullProj, proj);
+
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixMultiply(view, proj));
+		mFrustum = Frustum::FromViewProj(viewProj);
+	}
+
+	// World-space frustum of the pass and the layers it draws.
+	Frustum mFrustum;
+	XMFLOAT4X4 mCullView = MathHelper::Identity4x4();
+	XMFLOAT4X4 mCullProj = MathHelper::Identity4x4();
+	ecs::ComponentMask mCullLayers = 0;
+
+	VisibleSet mVisible;
+
+	const GpuSceneBuffer* mSceneBuffer = nullptr;
+
+	RenderGraph::PassId mGraphPass = RenderGraph::None;
+
+private:
+	// One draw of the prepared ones.
+	struct PreparedDraw
+	{
+		const DrawItem* Item;
+		UINT FirstInstance;   // in the instances of its layer
+		UINT InstanceCount;
+	};
+
+	// The prepared draws of one layer, mDraws[FirstDraw, FirstDraw + DrawCount).
+	struct PreparedLayer
+	{
+		ID3D12PipelineState* PipelineState = nullptr;
+		uint32_t FirstDraw = 0;
+		uint32_t DrawCount = 0;
+		UploadAllocator::Allocation Instances;
+		UploadAllocator::Allocation Commands;   // none when drawn directly
+	};
+
+	std::vector<PreparedLayer> mLayers;
+	std::vector<PreparedDraw> mDraws;
+
+	// visible items of the layer being prepared, in draw order
+	DrawQueue mQueue;
+
+	// object indices and indirect commands of the layer being prepared
+	std::vector<UINT> mInstances;
+	std::vector<IndirectDrawArguments> mCommands;
+
+	ID3D12CommandSignature* mDrawSignature = nullptr;
+
+	uint32_t mDrawCount = 0;
+	std::atomic<uint32_t> mCallCount{ 0 };   // the lists of a pass record at once
+	uint32_t mInstanceCount = 0;
+	float mSortMilliseconds = 0.0f;
 };
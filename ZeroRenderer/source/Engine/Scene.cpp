@@ -1,10 +1,111 @@
 #include "Scene.h"
 
+#include "../Utility/JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+// Local box used for culling and the spatial tree. The BVH bounds are exact,
+// and they are real even for submeshes given empty bounds to keep them out of
+// picking (the ground grid).
+static BoundingBox VisibilityBounds(const BoundingBox& bounds, const MeshBVH* bvh)
+{
+	return bvh ? bvh->Bounds().ToBoundingBox() : bounds;
+}
+
 Scene::Scene() {}
 
 Scene::~Scene() {}
 
-void Scene::CreateRenderItem(
+void Scene::Clear()
+{
+	std::vector<ecs::Entity> items;
+	items.reserve(mWorld.Size());
+	mWorld.ForEachChunk(0, [&](ecs::Chunk& chunk)
+	{
+		items.insert(items.end(), chunk.Entities(), chunk.Entities() + chunk.Count);
+	});
+
+	for (ecs::Entity item : items)
+	{
+		if (auto spatial = mWorld.Get<SpatialComponent>(item))
+			mSpatialTree.DestroyProxy(spatial->Proxy);
+		mWorld.Destroy(item);
+	}
+
+	mHierarchy.Clear();
+
+	mFreeObjectIndices.clear();
+	mObjectData.clear();
+	mDirtyItems.clear();
+	mObjectUploads.Clear();
+
+	for (CullLayer& cull : mCullLayers)
+	{
+		cull.Bounds.Clear();
+		cull.Items.clear();
+		cull.Entities.clear();
+		cull.PvsIndices.clear();
+	}
+
+	mPvs.Clear();
+
+	mSubmeshIds.clear();
+
+	mStaticBatchesStale = true;
+}
+
+void Scene::CreateRenderItems(RenderLayer layer, ecs::ComponentMask tags, uint32_t count,
+	const RenderItemColumns& columns, ecs::Entity* items)
+{
+	ecs::ComponentMask mask = LayerMask(layer) | tags | ecs::MaskOf<TransformComponent, BoundsComponent,
+		MeshComponent, MaterialComponent, DirtyComponent, RenderStateComponent, SpatialComponent>();
+
+	mWorld.CreateMany(mask, count, items, [&](ecs::Chunk& chunk, uint32_t row, uint32_t first, uint32_t n)
+	{
+		std::memcpy(chunk.Column<TransformComponent>() + row, columns.Transforms + first, n * sizeof(TransformComponent));
+		std::memcpy(chunk.Column<BoundsComponent>() + row, columns.Bounds + first, n * sizeof(BoundsComponent));
+		std::memcpy(chunk.Column<MeshComponent>() + row, columns.Meshes + first, n * sizeof(MeshComponent));
+		std::memcpy(chunk.Column<MaterialComponent>() + row, columns.Materials + first, n * sizeof(MaterialComponent));
+
+		auto dirty   = chunk.Column<DirtyComponent>() + row;
+		auto states  = chunk.Column<RenderStateComponent>() + row;
+		auto spatial = chunk.Column<SpatialComponent>() + row;
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			dirty[i] = DirtyComponent{};
+			mDirtyItems.push_back(chunk.Entities()[row + i]);
+
+			states[i] = RenderStateComponent{};
+			states[i].ObjectIndex = AllocateObjectIndex();
+
+			spatial[i] = SpatialComponent{};
+			spatial[i].WorldBounds = AABB::Transform(
+				VisibilityBounds(columns.Bounds[first + i].Bounds, columns.Meshes[first + i].BVH),
+				columns.Transforms[first + i].World);
+		}
+	});
+
+	CullLayer& cull = mCullLayers[(int)layer];
+	cull.Bounds.Reserve(cull.Items.size() + count);
+	cull.Items.reserve(cull.Items.size() + count);
+	cull.Entities.reserve(cull.Entities.size() + count);
+	cull.PvsIndices.reserve(cull.PvsIndices.size() + count);
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		mHierarchy.Add(items[i], columns.Locals[i]);
+
+		auto spatial = mWorld.Get<SpatialComponent>(items[i]);
+		spatial->Proxy = mSpatialTree.CreateProxy(spatial->WorldBounds, items[i]);
+
+		AddToCulling(items[i]);
+	}
+}
+
+ecs::Entity Scene::CreateRenderItem(
 	RenderLayer layer,
 	XMMATRIX world,
 	XMMATRIX TexTransform,
@@ -16,48 +117,706 @@ void Scene::CreateRenderItem(
 	BoundingBox bounds,
 	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType)
 {
-	auto item = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&item->World,        world);
-	XMStoreFloat4x4(&item->TexTransform, TexTransform);
-	item->ObjCBIndex = (UINT)GetRitemSize();
-	item->Mat = Mat;
-	item->Geo = Geo;
-	item->IndexCount = IndexCount;
-	item->StartIndexLocation = StartIndexLocation;
-	item->BaseVertexLocation = BaseVertexLocation;
-	item->Bounds = bounds;
-	item->PrimitiveType = PrimitiveType;
+	TransformComponent transform;
+	XMStoreFloat4x4(&transform.World,        world);
+	XMStoreFloat4x4(&transform.TexTransform, TexTransform);
+
+	MeshComponent mesh;
+	mesh.Geo = Geo;
+	mesh.PrimitiveType = PrimitiveType;
+	mesh.IndexCount = IndexCount;
+	mesh.StartIndexLocation = StartIndexLocation;
+	mesh.BaseVertexLocation = BaseVertexLocation;
+
+	for (const auto& [name, submesh] : Geo->DrawArgs)
+	{
+		if (submesh.IndexCount == IndexCount &&
+			submesh.StartIndexLocation == StartIndexLocation &&
+			submesh.BaseVertexLocation == (INT)BaseVertexLocation)
+		{
+			mesh.BVH = submesh.BVH.get();
+			break;
+		}
+	}
+
+	RenderStateComponent state;
+	state.ObjectIndex = AllocateObjectIndex();
 
-	mRitemLayer[(int)layer].push_back(item.get());
-	mAllRitems.push_back(std::move(item));
+	ecs::Entity item = mWorld.CreateTagged(
+		LayerMask(layer),
+		transform,
+		BoundsComponent{ bounds },
+		mesh,
+		MaterialComponent{ Mat },
+		DirtyComponent{},
+		state,
+		SpatialComponent{});
+
+	mHierarchy.Add(item, LocalTransform::FromMatrix(world));
+
+	mDirtyItems.push_back(item);
+
+	auto spatial = mWorld.Get<SpatialComponent>(item);
+	spatial->WorldBounds = AABB::Transform(VisibilityBounds(bounds, mesh.BVH), transform.World);
+	spatial->Proxy = mSpatialTree.CreateProxy(spatial->WorldBounds, item);
+
+	if (state.Visible)
+		AddToCulling(item);
+
+	return item;
+}
+
+ecs::Entity Scene::GetLastRenderItem(RenderLayer layer)
+{
+	ecs::Entity last = ecs::NullEntity;
+	mWorld.ForEachChunk(LayerMask(layer), [&](ecs::Chunk& chunk)
+	{
+		if (!(chunk.Owner->Mask() & ecs::MaskOf<StaticBatchTag>()))
+			last = chunk.Entities()[chunk.Count - 1];
+	});
+	return last;
+}
+
+void Scene::DestroyRenderItem(ecs::Entity item)
+{
+	if (!mWorld.IsAlive(item))
+		return;
+
+	if (auto spatial = mWorld.Get<SpatialComponent>(item))
+		mSpatialTree.DestroyProxy(spatial->Proxy);
+
+	if (auto state = mWorld.Get<RenderStateComponent>(item))
+		mFreeObjectIndices.push_back(state->ObjectIndex);
+
+	if (IsBatched(item) || mWorld.Has<StaticBatchTag>(item))
+		mStaticBatchesStale = true;
+
+	InvalidatePVS(item);
+	RemoveFromCulling(item);
+
+	mHierarchy.Remove(item);
+	mWorld.Destroy(item);
 }
 
 void Scene::DeleteLastRenderItem(RenderLayer layer)
 {
-	if (!mAllRitems.empty() && !mRitemLayer[(int)layer].empty())
+	DestroyRenderItem(GetLastRenderItem(layer));
+}
+
+UINT Scene::AllocateObjectIndex()
+{
+	if (mFreeObjectIndices.empty())
+	{
+		mObjectData.emplace_back();
+		return (UINT)mObjectData.size() - 1;
+	}
+
+	UINT index = mFreeObjectIndices.back();
+	mFreeObjectIndices.pop_back();
+	return index;
+}
+
+void Scene::QueueDirty(ecs::Entity item, DirtyComponent& dirty)
+{
+	if (!dirty.Dirty)
+	{
+		dirty.Dirty = true;
+		mDirtyItems.push_back(item);
+	}
+}
+
+void Scene::MarkDirty(ecs::Entity item)
+{
+	if (auto dirty = mWorld.Get<DirtyComponent>(item))
+		QueueDirty(item, *dirty);
+
+	// The mesh may have changed too.
+	auto spatial = mWorld.Get<SpatialComponent>(item);
+	if (spatial && spatial->CullSlot >= 0)
+	{
+		auto state = mWorld.Get<RenderStateComponent>(item);
+		mCullLayers[(int)GetLayer(item)].Items[spatial->CullSlot] =
+			CompileDrawItem(*mWorld.Get<MeshComponent>(item), state->ObjectIndex);
+	}
+
+	if (IsBatched(item))
+		mStaticBatchesStale = true;
+}
+
+void Scene::UpdateTransforms()
+{
+	mHierarchy.Update();
+
+	const auto& changed = mHierarchy.GetChangedNodes();
+
+	for (CullLayer& cull : mCullLayers)
+		cull.Bounds.BeginUpdate();
+
+	std::atomic<bool> occluderMoved = false;
+
+	JobSystem::getInstance().ParallelFor((uint32_t)changed.size(), 256, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			ecs::Entity item = mHierarchy.NodeEntity(changed[i]);
+			const XMFLOAT4X4& world = mHierarchy.NodeWorld(changed[i]);
+
+			if (auto transform = mWorld.Get<TransformComponent>(item))
+				transform->World = world;
+
+			auto bounds  = mWorld.Get<BoundsComponent>(item);
+			auto mesh    = mWorld.Get<MeshComponent>(item);
+			auto spatial = mWorld.Get<SpatialComponent>(item);
+			if (bounds && mesh && spatial)
+			{
+				spatial->WorldBounds = AABB::Transform(VisibilityBounds(bounds->Bounds, mesh->BVH), world);
+
+				// The baked sets only hold for where the item was. Without
+				// an occluder they do not hold anywhere.
+				if (spatial->PvsIndex >= 0 && mPvs.IsOccluder((uint32_t)spatial->PvsIndex))
+					occluderMoved = true;
+				spatial->PvsIndex = -1;
+
+				if (spatial->CullSlot >= 0)
+				{
+					CullLayer& cull = mCullLayers[(int)GetLayer(item)];
+					cull.Bounds.Set(spatial->CullSlot, spatial->WorldBounds);
+					cull.PvsIndices[spatial->CullSlot] = -1;
+				}
+			}
+		}
+	});
+
+	if (occluderMoved)
+		ClearPVS();
+
+	// The tree and the dirty list are not thread safe; moving a proxy is
+	// usually a no-op anyway because the new bounds are still inside its fat box.
+	for (uint32_t i = 0; i < (uint32_t)changed.size(); ++i)
+	{
+		ecs::Entity item = mHierarchy.NodeEntity(changed[i]);
+		if (auto dirty = mWorld.Get<DirtyComponent>(item))
+			QueueDirty(item, *dirty);
+
+		if (auto spatial = mWorld.Get<SpatialComponent>(item))
+			mSpatialTree.MoveProxy(spatial->Proxy, spatial->WorldBounds);
+
+		// Its batch still holds it where it was.
+		if (IsBatched(item))
+			mStaticBatchesStale = true;
+	}
+}
+
+ecs::Entity Scene::RayCast(FXMVECTOR rayOrigin, FXMVECTOR rayDir, ecs::ComponentMask layers, float* hitDistance)
+{
+	XMFLOAT3 origin, dir;
+	XMStoreFloat3(&origin, rayOrigin);
+	XMStoreFloat3(&dir, XMVector3Normalize(rayDir));
+
+	ecs::Entity nearest = ecs::NullEntity;
+	float nearestT = FLT_MAX;
+
+	mSpatialTree.RayCast(origin, dir, FLT_MAX, [&](int32_t proxy, float maxT)
+	{
+		ecs::Entity item = mSpatialTree.GetUserData(proxy);
+		ecs::ComponentMask mask = mWorld.GetMask(item);
+		if ((mask & layers) == 0 || (mask & ecs::MaskOf<StaticBatchTag>()))
+			return maxT;
+
+		auto state     = mWorld.Get<RenderStateComponent>(item);
+		auto transform = mWorld.Get<TransformComponent>(item);
+		auto bounds    = mWorld.Get<BoundsComponent>(item);
+		auto mesh      = mWorld.Get<MeshComponent>(item);
+		if (!state || !transform || !bounds || !mesh || !state->Visible)
+			return maxT;
+
+		// Transform the ray to the local space of the mesh.
+		XMMATRIX W = XMLoadFloat4x4(&transform->World);
+		XMMATRIX invWorld = XMMatrixInverse(get_rvalue_ptr(XMMatrixDeterminant(W)), W);
+
+		XMVECTOR localOrigin = XMVector3TransformCoord(XMLoadFloat3(&origin), invWorld);
+		XMVECTOR localDir = XMVector3TransformNormal(XMLoadFloat3(&dir), invWorld);
+
+		// Local distances are world distances times the length of localDir.
+		float localScale = XMVectorGetX(XMVector3Length(localDir));
+
+		localDir /= localScale;
+
+		// The box test stays in front of the BVH: submeshes with empty bounds
+		// (the ground grid) are not pickable.
+		float t;
+		if (!bounds->Bounds.Intersects(localOrigin, localDir, t))
+			return maxT;
+
+		// Refine to the nearest triangle. Rays that pass through the box but
+		// miss the mesh do not pick it.
+		if (mesh->BVH)
+		{
+			XMFLOAT3 o, d;
+			XMStoreFloat3(&o, localOrigin);
+			XMStoreFloat3(&d, localDir);
+			if (!mesh->BVH->RayCast(o, d, std::min(maxT, nearestT) * localScale, t))
+				return maxT;
+		}
+
+		t /= localScale;
+		if (t < nearestT)
+		{
+			nearestT = t;
+			nearest = item;
+		}
+
+		// only nodes closer than this hit can still contain a nearer one
+		return std::min(maxT, t);
+	});
+
+	if (hitDistance)
+		*hitDistance = nearestT;
+	return nearest;
+}
+
+RenderLayer Scene::GetLayer(ecs::Entity item) const
+{
+	ecs::ComponentMask mask = mWorld.GetMask(item);
+	for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		if (mask & LayerMask((RenderLayer)layer))
+			return (RenderLayer)layer;
+	}
+	return RenderLayer::Count;
+}
+
+void Scene::AddToCulling(ecs::Entity item)
+{
+	auto spatial = mWorld.Get<SpatialComponent>(item);
+	auto mesh    = mWorld.Get<MeshComponent>(item);
+	auto state   = mWorld.Get<RenderStateComponent>(item);
+	RenderLayer layer = GetLayer(item);
+	if (!spatial || !mesh || !state || layer == RenderLayer::Count || spatial->CullSlot >= 0 || IsBatched(item))
+		return;
+
+	CullLayer& cull = mCullLayers[(int)layer];
+	spatial->CullSlot = (int32_t)cull.Bounds.Add(spatial->WorldBounds);
+	cull.Items.push_back(CompileDrawItem(*mesh, state->ObjectIndex));
+	cull.Entities.push_back(item);
+	cull.PvsIndices.push_back(spatial->PvsIndex);
+}
+
+DrawItem Scene::CompileDrawItem(const MeshComponent& mesh, UINT objectIndex)
+{
+	DrawItem packet;
+
+	// Geometry without GPU buffers, as in headless tests and benchmarks,
+	// gets empty views; only the culling and sorting read those packets.
+	if (mesh.Geo->VertexBufferGPU)
+	{
+		packet.VertexBufferView = mesh.Geo->VertexBufferView();
+		packet.IndexBufferView = mesh.Geo->IndexBufferView();
+	}
+	packet.PrimitiveType = mesh.PrimitiveType;
+	packet.IndexCount = mesh.IndexCount;
+	packet.StartIndexLocation = mesh.StartIndexLocation;
+	packet.BaseVertexLocation = mesh.BaseVertexLocation;
+	packet.ObjectIndex = objectIndex;
+	packet.SubmeshId = GetSubmeshId(mesh);
+	packet.BVH = mesh.BVH;
+	return packet;
+}
+
+uint32_t Scene::GetSubmeshId(const MeshComponent& mesh)
+{
+	return mSubmeshIds.try_emplace(SubmeshKey(mesh), (uint32_t)mSubmeshIds.size()).first->second;
+}
+
+void Scene::RemoveFromCulling(ecs::Entity item)
+{
+	auto spatial = mWorld.Get<SpatialComponent>(item);
+	if (!spatial || spatial->CullSlot < 0)
+		return;
+
+	// Swap the last item of the layer into the hole.
+	CullLayer& cull = mCullLayers[(int)GetLayer(item)];
+	uint32_t slot = (uint32_t)spatial->CullSlot;
+
+	cull.Bounds.Remove(slot);
+	cull.Items[slot] = cull.Items.back();
+	cull.Entities[slot] = cull.Entities.back();
+	cull.PvsIndices[slot] = cull.PvsIndices.back();
+	cull.Items.pop_back();
+	cull.Entities.pop_back();
+	cull.PvsIndices.pop_back();
+
+	if (slot < cull.Entities.size())
+		mWorld.Get<SpatialComponent>(cull.Entities[slot])->CullSlot = (int32_t)slot;
+
+	spatial->CullSlot = -1;
+}
+
+void Scene::SetVisible(ecs::Entity item, bool visible)
+{
+	auto state = mWorld.Get<RenderStateComponent>(item);
+	if (!state || state->Visible == visible)
+		return;
+
+	state->Visible = visible;
+	if (visible)
+	{
+		AddToCulling(item);
+	}
+	else
+	{
+		InvalidatePVS(item);
+		RemoveFromCulling(item);
+	}
+
+	if (IsBatched(item))
+		mStaticBatchesStale = true;
+}
+
+void Scene::InvalidatePVS(ecs::Entity item)
+{
+	auto spatial = mWorld.Get<SpatialComponent>(item);
+	if (spatial && spatial->PvsIndex >= 0 && mPvs.IsOccluder((uint32_t)spatial->PvsIndex))
+		ClearPVS();
+}
+
+void Scene::Cull(const Frustum& frustum, const XMFLOAT4X4& view, const XMFLOAT4X4& proj,
+	ecs::ComponentMask layers, VisibleSet& visible) const
+{
+	auto start = std::chrono::steady_clock::now();
+
+	visible.TotalCount = 0;
+	visible.TestedCount = 0;
+	visible.VisibleCount = 0;
+	visible.OccludedCount = 0;
+	visible.PvsCulledCount = 0;
+	visible.OcclusionMilliseconds = 0.0f;
+
+	for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		if ((layers & LayerMask((RenderLayer)layer)) == 0)
+		{
+			visible.Items[layer].clear();
+			continue;
+		}
+
+		const FrustumCuller& bounds = mCullLayers[layer].Bounds;
+		CullCache& cache = visible.Caches[layer];
+
+		cache.Update(view, proj);
+		bounds.Cull(frustum, cache, visible.Items[layer]);
+
+		visible.TotalCount += (uint32_t)bounds.Size();
+		visible.TestedCount += cache.TestedCount();
+		visible.VisibleCount += (uint32_t)visible.Items[layer].size();
+	}
+
+	visible.CullMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Scene::SetOccluder(ecs::Entity item, bool occluder)
+{
+	if (!mWorld.IsAlive(item) || IsOccluder(item) == occluder)
+		return;
+
+	if (occluder)
+		mWorld.Add<OccluderTag>(item);
+	else
+		mWorld.Remove<OccluderTag>(item);
+}
+
+void Scene::SetStatic(ecs::Entity item, bool isStatic)
+{
+	if (!mWorld.IsAlive(item) || IsStatic(item) == isStatic)
+		return;
+
+	if (isStatic)
+	{
+		mWorld.Add<StaticTag>(item);
+	}
+	else
+	{
+		SetBatched(item, false);
+		mWorld.Remove<StaticTag>(item);
+	}
+
+	mStaticBatchesStale = true;
+}
+
+void Scene::SetBatched(ecs::Entity item, bool batched)
+{
+	if (!mWorld.IsAlive(item) || IsBatched(item) == batched)
+		return;
+
+	if (batched)
+	{
+		RemoveFromCulling(item);
+		mWorld.Add<BatchedTag>(item);
+	}
+	else
+	{
+		mWorld.Remove<BatchedTag>(item);
+		if (mWorld.Get<RenderStateComponent>(item)->Visible)
+			AddToCulling(item);
+	}
+}
+
+void Scene::RenderOcclusion(const XMFLOAT4X4& viewProj, OcclusionBuffer& buffer)
+{
+	mOccluders.clear();
+
+	ecs::ComponentMask mask = LayerMask(RenderLayer::Opaque) |
+		ecs::MaskOf<OccluderTag, TransformComponent, MeshComponent, RenderStateComponent>();
+
+	mWorld.ForEachChunk(mask, [&](ecs::Chunk& chunk)
+	{
+		auto transforms = chunk.Column<TransformComponent>();
+		auto meshes     = chunk.Column<MeshComponent>();
+		auto states     = chunk.Column<RenderStateComponent>();
+
+		for (uint32_t i = 0; i < chunk.Count; ++i)
+		{
+			const MeshBVH* bvh = meshes[i].BVH;
+			if (states[i].Visible && bvh)
+				mOccluders.push_back({ bvh->Vertices().data(), (uint32_t)bvh->TriangleCount(), transforms[i].World });
+		}
+	});
+
+	buffer.Render(viewProj, mOccluders);
+}
+
+void Scene::OcclusionCull(const OcclusionBuffer& buffer, VisibleSet& visible) const
+{
+	auto start = std::chrono::steady_clock::now();
+
+	uint32_t occluded = 0;
+
+	for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
 	{
-		mRitemLayer[(int)layer].pop_back();
-		mAllRitems.pop_back();
+		std::vector<uint32_t>& items = visible.Items[layer];
+		if (items.empty())
+			continue;
+
+		const FrustumCuller& bounds = mCullLayers[layer].Bounds;
+
+		std::vector<uint8_t> keep(items.size());
+		JobSystem::getInstance().ParallelFor((uint32_t)items.size(), 64, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++i)
+				keep[i] = buffer.IsVisible(bounds.GetBox(items[i]));
+		});
+
+		// Compact in place, keeping the order.
+		size_t size = 0;
+		for (size_t i = 0; i < items.size(); ++i)
+		{
+			if (keep[i])
+				items[size++] = items[i];
+		}
+		occluded += (uint32_t)(items.size() - size);
+		items.resize(size);
 	}
+
+	visible.OccludedCount = occluded;
+	visible.VisibleCount -= occluded;
+	visible.OcclusionMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
 
-void Scene::UpdateObjectCBs(UploadBuffer<ObjectConstants>* currObjectCB)
+void Scene::BakePVS(float cellSize, uint32_t raysPerItem)
 {
-	for (auto& item : mAllRitems)
+	ClearPVS();
+
+	// Every visible item gets a bit; the sky is left out of the region the
+	// camera may be in, it is seen from everywhere anyway. Only static items
+	// may hide others, anything else could move away.
+	std::vector<PotentiallyVisibleSet::Item> items;
+	PotentiallyVisibleSet::Settings settings;
+	settings.CellSize = cellSize;
+	settings.RaysPerItem = raysPerItem;
+
+	for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
 	{
-		if (item->NumFramesDirty > 0)
+		CullLayer& cull = mCullLayers[layer];
+		for (size_t slot = 0; slot < cull.Entities.size(); ++slot)
 		{
-			XMMATRIX world = XMLoadFloat4x4(&item->World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&item->TexTransform);
+			ecs::Entity entity = cull.Entities[slot];
+			auto spatial   = mWorld.Get<SpatialComponent>(entity);
+			auto transform = mWorld.Get<TransformComponent>(entity);
+
+			PotentiallyVisibleSet::Item item;
+			item.Bounds = spatial->WorldBounds;
+			item.World = transform->World;
+			if (layer == (int)RenderLayer::Opaque && IsStatic(entity))
+				item.Mesh = cull.Items[slot].BVH;
+
+			spatial->PvsIndex = (int32_t)items.size();
+			cull.PvsIndices[slot] = spatial->PvsIndex;
+			items.push_back(item);
+
+			if (layer != (int)RenderLayer::Sky)
+				settings.Bounds = AABB::Union(settings.Bounds, item.Bounds);
+		}
+	}
 
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
-			objConstants.MaterialIndex = item->Mat->MatCBIndex;
+	// Batched items are drawn by their batch and left out of culling, but
+	// they still hide what is behind them.
+	ecs::ComponentMask batched = LayerMask(RenderLayer::Opaque) |
+		ecs::MaskOf<BatchedTag, SpatialComponent, TransformComponent, MeshComponent, RenderStateComponent>();
 
-			currObjectCB->CopyData(item->ObjCBIndex, objConstants);
+	mWorld.ForEachChunk(batched, [&](ecs::Chunk& chunk)
+	{
+		auto spatial    = chunk.Column<SpatialComponent>();
+		auto transforms = chunk.Column<TransformComponent>();
+		auto meshes     = chunk.Column<MeshComponent>();
+		auto states     = chunk.Column<RenderStateComponent>();
+
+		for (uint32_t i = 0; i < chunk.Count; ++i)
+		{
+			if (!states[i].Visible)
+				continue;
 
-			item->NumFramesDirty--;
+			PotentiallyVisibleSet::Item item;
+			item.Bounds = spatial[i].WorldBounds;
+			item.World = transforms[i].World;
+			item.Mesh = meshes[i].BVH;
+
+			spatial[i].PvsIndex = (int32_t)items.size();
+			items.push_back(item);
+			settings.Bounds = AABB::Union(settings.Bounds, item.Bounds);
 		}
+	});
+
+	settings.Bounds = settings.Bounds.Expanded(cellSize);
+
+	mPvs.Bake(items, settings);
+}
+
+void Scene::ClearPVS()
+{
+	mPvs.Clear();
+
+	mWorld.ForEachChunk<SpatialComponent>([](ecs::Chunk& chunk)
+	{
+		auto spatial = chunk.Column<SpatialComponent>();
+		for (uint32_t i = 0; i < chunk.Count; ++i)
+			spatial[i].PvsIndex = -1;
+	});
+
+	for (CullLayer& cull : mCullLayers)
+		std::fill(cull.PvsIndices.begin(), cull.PvsIndices.end(), -1);
+}
+
+bool Scene::PvsCull(const XMFLOAT3& eye, VisibleSet& visible) const
+{
+	int32_t cell = mPvs.FindCell(eye);
+	if (cell < 0)
+		return false;
+
+	uint32_t set = mPvs.GetSetIndex(cell);
+	uint64_t key = ((uint64_t)mPvs.GetBakeId() << 32) | set;
+	if (visible.PvsKey != key)
+	{
+		mPvs.Decode(set, visible.PvsBits);
+		visible.PvsKey = key;
 	}
+
+	uint32_t culled = 0;
+	for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		const std::vector<int32_t>& pvsIndices = mCullLayers[layer].PvsIndices;
+		std::vector<uint32_t>& items = visible.Items[layer];
+
+		size_t size = 0;
+		for (uint32_t index : items)
+		{
+			int32_t bit = pvsIndices[index];
+			if (bit < 0 || PotentiallyVisibleSet::Test(visible.PvsBits, (uint32_t)bit))
+				items[size++] = index;
+		}
+		culled += (uint32_t)(items.size() - size);
+		items.resize(size);
+	}
+
+	visible.PvsCulledCount = culled;
+	visible.VisibleCount -= culled;
+	return true;
+}
+
+void Scene::CompactObjectIndices()
+{
+	const UINT count = (UINT)GetRitemSize();
+	const UINT size = (UINT)mObjectData.size();
+	if (size <= 64 || count >= size / 2)   // not worth it for a few items
+		return;
+
+	// As many slots below 'count' are free as items sit above it, or more if
+	// some entities hold no slot. Leave the slots alone if that ever fails.
+	std::vector<UINT> lowSlots;
+	for (UINT index : mFreeObjectIndices)
+	{
+		if (index < count)
+			lowSlots.push_back(index);
+	}
+
+	size_t highItems = 0;
+	mWorld.ForEachChunk<RenderStateComponent>([&](ecs::Chunk& chunk)
+	{
+		auto states = chunk.Column<RenderStateComponent>();
+		for (uint32_t i = 0; i < chunk.Count; ++i)
+			highItems += states[i].ObjectIndex >= count;
+	});
+	if (highItems > lowSlots.size())
+		return;
+
+	mWorld.ForEachChunk<DirtyComponent, RenderStateComponent, SpatialComponent>([&](ecs::Chunk& chunk)
+	{
+		auto dirty   = chunk.Column<DirtyComponent>();
+		auto states  = chunk.Column<RenderStateComponent>();
+		auto spatial = chunk.Column<SpatialComponent>();
+
+		for (uint32_t i = 0; i < chunk.Count; ++i)
+		{
+			if (states[i].ObjectIndex < count)
+				continue;
+
+			states[i].ObjectIndex = lowSlots.back();
+			lowSlots.pop_back();
+			QueueDirty(chunk.Entities()[i], dirty[i]);
+
+			if (spatial[i].CullSlot >= 0)
+				mCullLayers[(int)GetLayer(chunk.Entities()[i])].Items[spatial[i].CullSlot].ObjectIndex = states[i].ObjectIndex;
+		}
+	});
+
+	mFreeObjectIndices = std::move(lowSlots);
+	mObjectData.resize(count);
+	mObjectData.shrink_to_fit();
+}
+
+void Scene::UpdateObjectData()
+{
+	for (ecs::Entity item : mDirtyItems)
+	{
+		// Destroyed since it was flagged.
+		auto dirty = mWorld.Get<DirtyComponent>(item);
+		if (!dirty)
+			continue;
+
+		auto transform = mWorld.Get<TransformComponent>(item);
+		auto material  = mWorld.Get<MaterialComponent>(item);
+		auto state     = mWorld.Get<RenderStateComponent>(item);
+
+		XMMATRIX world = XMLoadFloat4x4(&transform->World);
+		XMMATRIX texTransform = XMLoadFloat4x4(&transform->TexTransform);
+
+		ObjectData& data = mObjectData[state->ObjectIndex];
+		XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
+		XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
+		data.MaterialIndex = material->Mat->MatCBIndex;
+
+		dirty->Dirty = false;
+		mObjectUploads.Mark(state->ObjectIndex);
+	}
+
+	mDirtyItems.clear();
 }
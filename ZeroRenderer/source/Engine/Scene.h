@@ -8,17 +8,97 @@
 
 #include "../Resource/UploadBuffer.h"
 
+#include "../DXRuntime/FrameDirtyList.h"
 #include "../DXRuntime/FrameResource.h"
 
+#include "../ECS/World.h"
+
+#include "../Spatial/DynamicAABBTree.h"
+#include "../Spatial/FrustumCuller.h"
+#include "../Spatial/MeshBVH.h"
+#include "../Spatial/OcclusionBuffer.h"
+#include "../Spatial/PotentiallyVisibleSet.h"
+
+#include "TransformHierarchy.h"
+
 #include "../Shader/RenderItem.h"
 
+#include <map>
+
+// Draw packet of a visible item, kept next to its bounds in the culling set.
+// It is compiled from the item's components when the item enters the set or
+// is marked dirty, so drawing reads one cache line per item and never touches
+// the geometry.
+struct alignas(64) DrawItem
+{
+	D3D12_VERTEX_BUFFER_VIEW VertexBufferView = {};
+	D3D12_INDEX_BUFFER_VIEW IndexBufferView = {};
+	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+	// DrawIndexedInstanced parameters.
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	INT BaseVertexLocation = 0;
+
+	UINT ObjectIndex = 0;
+
+	// Equal for the items that draw the same submesh, see Scene::GetSubmeshId.
+	uint32_t SubmeshId = 0;
+
+	// Triangle BVH of the submesh, if it was built.
+	const MeshBVH* BVH = nullptr;
+};
+
+static_assert(sizeof(DrawItem) == 64, "a draw packet should fill one cache line");
+
+// Output of Scene::Cull: for each layer, the indices (into Scene::GetDrawItems)
+// of the items that are at least partly inside the frustum.
+struct VisibleSet
+{
+	std::vector<uint32_t> Items[(int)RenderLayer::Count];
+
+	// results of the previous frames, see FrustumCuller
+	CullCache Caches[(int)RenderLayer::Count];
+
+	uint32_t TotalCount = 0;     // items in the culled layers
+	uint32_t TestedCount = 0;    // items actually tested this frame
+	uint32_t VisibleCount = 0;   // left after frustum and occlusion culling
+	uint32_t OccludedCount = 0;  // inside the frustum but hidden by occluders
+	uint32_t PvsCulledCount = 0; // inside the frustum but not in the camera cell's set
+	float CullMilliseconds = 0.0f;
+	float OcclusionMilliseconds = 0.0f;
+
+	// the last set decoded by Scene::PvsCull
+	std::vector<uint64_t> PvsBits;
+	uint64_t PvsKey = ~0ull;
+};
+
+// Per-item arrays of render items created together, see Scene::CreateRenderItems.
+struct RenderItemColumns
+{
+	const TransformComponent* Transforms;
+	const LocalTransform*     Locals;
+	const BoundsComponent*    Bounds;
+	const MeshComponent*      Meshes;
+	const MaterialComponent*  Materials;
+};
+
 class Scene : PublicSingleton<Scene>
 {
 public:
 	Scene();
 	~Scene();
 
-	void CreateRenderItem(
+	// Removes every item.
+	void Clear();
+
+	// Creates 'count' visible root items of one layer with the tags in 'tags'
+	// and stores their entities in 'items'. The columns are copied range by
+	// range into the ECS chunks; Transforms must match Locals.
+	void CreateRenderItems(RenderLayer layer, ecs::ComponentMask tags, uint32_t count,
+		const RenderItemColumns& columns, ecs::Entity* items);
+
+	ecs::Entity CreateRenderItem(
 		RenderLayer layer,
 		XMMATRIX world,
 		XMMATRIX TexTransform,
@@ -30,22 +110,183 @@ public:
 		BoundingBox bounds,
 		D3D12_PRIMITIVE_TOPOLOGY PrimitiveType= D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
+	// Removes any item in O(1). Its children keep their world transform, and
+	// its object data slot is handed to the next item created.
+	void DestroyRenderItem(ecs::Entity item);
+
 	void DeleteLastRenderItem(RenderLayer layer);
 
-	void UpdateObjectCBs(UploadBuffer<ObjectConstants>*);
+	// The item DeleteLastRenderItem would remove, or NullEntity if the layer is empty.
+	ecs::Entity GetLastRenderItem(RenderLayer layer);
+
+	// Call after editing an item's components so its object data is rebuilt.
+	void MarkDirty(ecs::Entity item);
+
+	// Attaches item to parent (or detaches it if parent is NullEntity) keeping its
+	// world transform. Returns false if that would create a cycle.
+	bool SetParent(ecs::Entity item, ecs::Entity parent) { return mHierarchy.SetParent(item, parent); }
+
+	const LocalTransform& GetLocalTransform(ecs::Entity item) const { return mHierarchy.GetLocal(item); }
+
+	// The world matrix is recomputed by the next UpdateTransforms().
+	void SetLocalTransform(ecs::Entity item, const LocalTransform& local) { mHierarchy.SetLocal(item, local); }
+
+	// Propagates local transform edits down the hierarchy and flags the items
+	// whose world matrix changed for upload.
+	void UpdateTransforms();
+
+	// Rebuilds the object data of the items flagged since the last call and
+	// queues their slots in GetObjectUploads. Items that were not touched are
+	// never visited.
+	void UpdateObjectData();
+
+	// Moves items into the free object data slots below the item count once
+	// fewer than half of the slots are in use, so the data stays dense after a
+	// wave of deletions. Moved items are rebuilt.
+	void CompactObjectIndices();
+
+	// Nearest visible item of the given layers hit by the world-space ray, or
+	// NullEntity. Candidates come from the AABB tree and are then tested
+	// against their local bounds.
+	ecs::Entity RayCast(FXMVECTOR rayOrigin, FXMVECTOR rayDir, ecs::ComponentMask layers, float* hitDistance = nullptr);
+
+	// Hidden items are not drawn or picked.
+	void SetVisible(ecs::Entity item, bool visible);
+
+	// Culls the visible items of the given layers against the frustum built
+	// from view * proj, re-testing only the items whose result may have changed
+	// since the last cull into 'visible'. Passes may cull concurrently.
+	void Cull(const Frustum& frustum, const XMFLOAT4X4& view, const XMFLOAT4X4& proj,
+		ecs::ComponentMask layers, VisibleSet& visible) const;
+
+	// Opaque occluders are rendered into the occlusion buffer by RenderOcclusion.
+	void SetOccluder(ecs::Entity item, bool occluder);
 
-	std::vector<RenderItem*>& GetRenderLayer(RenderLayer layer) { return mRitemLayer[(int)layer]; }
+	bool IsOccluder(ecs::Entity item) const { return mWorld.Has<OccluderTag>(item); }
 
-	size_t GetRitemSize() const { return mAllRitems.size(); }
+	// Only static items block the view when the visible sets are baked, and
+	// the next StaticBatcher::Build merges them into static batches.
+	void SetStatic(ecs::Entity item, bool isStatic);
 
-	size_t GetRenderLayerSize(int layer) const { return mRitemLayer[layer].size(); }
+	bool IsStatic(ecs::Entity item) const { return mWorld.Has<StaticTag>(item); }
 
-	std::vector<std::unique_ptr<RenderItem>>& GetAllRitems() { return mAllRitems; }
+	// A batched item is drawn by its static batch: it leaves the culling set
+	// but keeps everything else.
+	void SetBatched(ecs::Entity item, bool batched);
+
+	bool IsBatched(ecs::Entity item) const { return mWorld.Has<BatchedTag>(item); }
+
+	// Set once a batched item is moved, edited, hidden or destroyed, or static
+	// items are added, so the batches no longer match the scene.
+	bool StaticBatchesStale() const { return mStaticBatchesStale; }
+	void SetStaticBatchesStale(bool stale) { mStaticBatchesStale = stale; }
+
+	// Renders the visible occluders as seen through viewProj.
+	void RenderOcclusion(const XMFLOAT4X4& viewProj, OcclusionBuffer& buffer);
+
+	// Removes the items hidden behind the occluders from the result of Cull.
+	// The buffer must have been rendered from the view that was culled.
+	void OcclusionCull(const OcclusionBuffer& buffer, VisibleSet& visible) const;
+
+	// Bakes the potentially visible sets of the current scene. The cells cover
+	// the items' bounds; static opaque items with a mesh BVH block the view.
+	// Moving, hiding or destroying one of those clears the sets.
+	void BakePVS(float cellSize, uint32_t raysPerItem);
+
+	void ClearPVS();
+
+	const PotentiallyVisibleSet& GetPVS() const { return mPvs; }
+
+	// Removes the items that cannot be seen from the cell of 'eye' from the
+	// result of Cull. Returns false, keeping everything, if 'eye' is outside
+	// the baked cells.
+	bool PvsCull(const XMFLOAT3& eye, VisibleSet& visible) const;
+
+	const std::vector<DrawItem>& GetDrawItems(RenderLayer layer) const { return mCullLayers[(int)layer].Items; }
+
+	// World-space center of the bounds of GetDrawItems(layer)[index].
+	XMFLOAT3 GetDrawCenter(RenderLayer layer, uint32_t index) const { return mCullLayers[(int)layer].Bounds.GetCenter(index); }
+
+	// Small dense id of the submesh the mesh draws, assigned on first use.
+	uint32_t GetSubmeshId(const MeshComponent& mesh);
+
+	// Invokes f(ecs::Chunk&) for every chunk of drawable items in the layer.
+	template<typename F>
+	void ForEachLayerChunk(RenderLayer layer, F&& f)
+	{
+		mWorld.ForEachChunk(LayerMask(layer) | ecs::MaskOf<MeshComponent, RenderStateComponent, SpatialComponent>(), std::forward<F>(f));
+	}
+
+	ecs::World& GetWorld() { return mWorld; }
+
+	TransformHierarchy& GetHierarchy() { return mHierarchy; }
+
+	// World-space bounds of every item; the user data of a proxy is its entity.
+	const DynamicAABBTree& GetSpatialTree() const { return mSpatialTree; }
+
+	size_t GetRitemSize() const { return mWorld.Size(); }
+
+	// Data of every item, by RenderStateComponent::ObjectIndex, as it is
+	// uploaded to the frame's object buffer. Freed slots are reused first, so
+	// it never holds more than the most items that were alive at once.
+	const std::vector<ObjectData>& GetObjectData() const { return mObjectData; }
+
+	// Object data slots not yet written to the scene buffer; there is one
+	// list, as the frames share the buffer. Slots past the end of
+	// GetObjectData belonged to items that were compacted away.
+	FrameDirtyList& GetObjectUploads() { return mObjectUploads; }
+
+	size_t GetRenderLayerSize(int layer) const { return mWorld.Count(LayerMask((RenderLayer)layer)); }
 
-	std::vector<RenderItem*>& GetRenderLayer(int layer) { return mRitemLayer[layer]; }
 private:
-	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
+	RenderLayer GetLayer(ecs::Entity item) const;
+
+	DrawItem CompileDrawItem(const MeshComponent& mesh, UINT objectIndex);
+
+	void AddToCulling(ecs::Entity item);
+	void RemoveFromCulling(ecs::Entity item);
+
+	UINT AllocateObjectIndex();
+
+	// Clears the baked sets if the item blocks the view in them.
+	void InvalidatePVS(ecs::Entity item);
+
+	// Flags the item for UpdateObjectData unless it already is.
+	void QueueDirty(ecs::Entity item, DirtyComponent& dirty);
+
+	ecs::World mWorld;
+
+	std::vector<ObjectData> mObjectData;
+
+	// items whose DirtyComponent is set, each listed once
+	std::vector<ecs::Entity> mDirtyItems;
+
+	FrameDirtyList mObjectUploads{ 1 };
+
+	// object data slots of destroyed items, reused last in first out
+	std::vector<UINT> mFreeObjectIndices;
+
+	TransformHierarchy mHierarchy;
+
+	DynamicAABBTree mSpatialTree;
+
+	// Visible items of one layer; element i of each array describes the same item.
+	struct CullLayer
+	{
+		FrustumCuller Bounds;
+		std::vector<DrawItem> Items;
+		std::vector<ecs::Entity> Entities;
+		std::vector<int32_t> PvsIndices;
+	};
+
+	CullLayer mCullLayers[(int)RenderLayer::Count];
+
+	// kept to reuse its storage
+	std::vector<OcclusionBuffer::Occluder> mOccluders;
+
+	PotentiallyVisibleSet mPvs;
 
-	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
+	bool mStaticBatchesStale = false;
 
+	std::map<decltype(SubmeshKey(MeshComponent())), uint32_t> mSubmeshIds;
 };
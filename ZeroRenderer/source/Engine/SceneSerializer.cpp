@@ -0,0 +1,440 @@
+#include "SceneSerializer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <tuple>
+#include <type_traits>
+
+namespace
+{
+	// Every section starts at a multiple of this.
+	constexpr size_t SectionAlignment = 16;
+
+	struct FileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t StringBytes;
+		uint32_t MaterialCount;
+		uint32_t SubmeshCount;
+		uint32_t ItemCount;
+	};
+
+	struct FileMaterial
+	{
+		uint32_t Name;   // offset into the string table
+		int32_t MatCBIndex;
+		int32_t DiffuseSrvHeapIndex;
+		int32_t NormalSrvHeapIndex;
+		XMFLOAT4 DiffuseAlbedo;
+		XMFLOAT3 FresnelR0;
+		float Roughness;
+		XMFLOAT4X4 MatTransform;
+	};
+
+	struct FileSubmesh
+	{
+		uint32_t Geometry;   // MeshGeometry::Name, offset into the string table
+		uint32_t Submesh;    // key of DrawArgs, offset into the string table
+		uint32_t PrimitiveType;
+	};
+
+	enum ItemFlags : uint8_t
+	{
+		ItemHidden   = 1 << 0,
+		ItemOccluder = 1 << 1,
+		ItemStatic   = 1 << 2,
+	};
+
+	// After the header and string table, the sections are:
+	//
+	//     FileMaterial       Materials[MaterialCount]
+	//     FileSubmesh        Submeshes[SubmeshCount]
+	//     TransformComponent Transforms[ItemCount]
+	//     LocalTransform     Locals[ItemCount]
+	//     BoundsComponent    Bounds[ItemCount]
+	//     uint32_t           ItemSubmeshes[ItemCount]
+	//     uint32_t           ItemMaterials[ItemCount]
+	//     int32_t            Parents[ItemCount]   // item index, -1 for roots
+	//     uint8_t            Layers[ItemCount]
+	//     uint8_t            Flags[ItemCount]     // ItemFlags
+	//
+	// The item arrays are copied into the ECS as they are.
+	static_assert(std::is_trivially_copyable_v<TransformComponent>);
+	static_assert(std::is_trivially_copyable_v<LocalTransform>);
+	static_assert(std::is_trivially_copyable_v<BoundsComponent>);
+
+	void WriteSection(std::ofstream& file, const void* data, size_t bytes)
+	{
+		static const char padding[SectionAlignment] = {};
+
+		file.write(static_cast<const char*>(data), bytes);
+		file.write(padding, (SectionAlignment - bytes % SectionAlignment) % SectionAlignment);
+	}
+
+	template<typename T>
+	void WriteSection(std::ofstream& file, const std::vector<T>& data)
+	{
+		WriteSection(file, data.data(), data.size() * sizeof(T));
+	}
+
+	// Hands out the sections of a file image in order.
+	class SectionReader
+	{
+	public:
+		SectionReader(const std::byte* data, size_t size) : mData(data), mSize(size) {}
+
+		// nullptr if the file is too short
+		template<typename T>
+		const T* Read(uint64_t count)
+		{
+			uint64_t bytes = count * sizeof(T);
+			if (bytes / sizeof(T) != count || bytes > mSize - mOffset)
+				return nullptr;
+
+			const T* section = reinterpret_cast<const T*>(mData + mOffset);
+			mOffset = std::min<uint64_t>(mSize, (mOffset + bytes + SectionAlignment - 1) / SectionAlignment * SectionAlignment);
+			return section;
+		}
+
+	private:
+		const std::byte* mData;
+		size_t mSize;
+		size_t mOffset = 0;
+	};
+}
+
+bool SceneSerializer::Save(const std::string& path, Scene& scene, MatManager& materials)
+{
+	ecs::World& world = scene.GetWorld();
+
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> stringOffsets;
+	auto addString = [&](const std::string& s)
+	{
+		auto [it, inserted] = stringOffsets.try_emplace(s, (uint32_t)strings.size());
+		if (inserted)
+			strings.append(s.c_str(), s.size() + 1);
+		return it->second;
+	};
+
+	// Materials, in buffer order so the file does not depend on hashing.
+	std::vector<const Material*> sortedMaterials;
+	materials.ForEachMaterial([&](const Material& mat) { sortedMaterials.push_back(&mat); });
+	std::sort(sortedMaterials.begin(), sortedMaterials.end(),
+		[](const Material* a, const Material* b) { return a->MatCBIndex < b->MatCBIndex; });
+
+	std::vector<FileMaterial> fileMaterials;
+	std::unordered_map<const Material*, uint32_t> materialIndices;
+	for (const Material* mat : sortedMaterials)
+	{
+		materialIndices[mat] = (uint32_t)fileMaterials.size();
+
+		FileMaterial& record = fileMaterials.emplace_back();
+		record.Name = addString(mat->Name);
+		record.MatCBIndex = mat->MatCBIndex;
+		record.DiffuseSrvHeapIndex = mat->DiffuseSrvHeapIndex;
+		record.NormalSrvHeapIndex = mat->NormalSrvHeapIndex;
+		record.DiffuseAlbedo = mat->DiffuseAlbedo;
+		record.FresnelR0 = mat->FresnelR0;
+		record.Roughness = mat->Roughness;
+		record.MatTransform = mat->MatTransform;
+	}
+
+	// Items, sorted by layer and occluder flag. Static batches are rebuilt
+	// from their items after loading.
+	const ecs::ComponentMask occluderMask = ecs::MaskOf<OccluderTag>();
+	const ecs::ComponentMask batchMask = ecs::MaskOf<StaticBatchTag>();
+	const ecs::ComponentMask itemMask = ecs::MaskOf<TransformComponent, BoundsComponent,
+		MeshComponent, MaterialComponent, RenderStateComponent>();
+
+	std::vector<ecs::Entity> items;
+	std::vector<uint8_t> layers;
+	for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		for (bool occluder : { false, true })
+		{
+			ecs::ComponentMask required = LayerMask((RenderLayer)layer) | itemMask | (occluder ? occluderMask : 0);
+			world.ForEachChunk(required, [&](ecs::Chunk& chunk)
+			{
+				if ((!occluder && (chunk.Owner->Mask() & occluderMask)) || (chunk.Owner->Mask() & batchMask))
+					return;
+
+				items.insert(items.end(), chunk.Entities(), chunk.Entities() + chunk.Count);
+				layers.insert(layers.end(), chunk.Count, (uint8_t)layer);
+			});
+		}
+	}
+
+	const uint32_t itemCount = (uint32_t)items.size();
+
+	std::unordered_map<ecs::Entity, uint32_t> itemIndices;
+	for (uint32_t i = 0; i < itemCount; ++i)
+		itemIndices[items[i]] = i;
+
+	std::vector<FileSubmesh> fileSubmeshes;
+	std::map<std::tuple<const MeshGeometry*, UINT, UINT, int, UINT>, uint32_t> submeshIndices;
+
+	std::vector<TransformComponent> transforms(itemCount);
+	std::vector<LocalTransform> locals(itemCount);
+	std::vector<BoundsComponent> bounds(itemCount);
+	std::vector<uint32_t> itemSubmeshes(itemCount);
+	std::vector<uint32_t> itemMaterials(itemCount);
+	std::vector<int32_t> parents(itemCount);
+	std::vector<uint8_t> flags(itemCount);
+
+	for (uint32_t i = 0; i < itemCount; ++i)
+	{
+		ecs::Entity item = items[i];
+
+		const MeshComponent* mesh = world.Get<MeshComponent>(item);
+		auto key = std::make_tuple((const MeshGeometry*)mesh->Geo, mesh->IndexCount, mesh->StartIndexLocation,
+			mesh->BaseVertexLocation, (UINT)mesh->PrimitiveType);
+
+		auto submesh = submeshIndices.find(key);
+		if (submesh == submeshIndices.end())
+		{
+			const std::string* name = nullptr;
+			for (const auto& [drawName, args] : mesh->Geo->DrawArgs)
+			{
+				if (args.IndexCount == mesh->IndexCount &&
+					args.StartIndexLocation == mesh->StartIndexLocation &&
+					args.BaseVertexLocation == mesh->BaseVertexLocation)
+				{
+					name = &drawName;
+					break;
+				}
+			}
+			if (!name)
+				return false;
+
+			submesh = submeshIndices.emplace(key, (uint32_t)fileSubmeshes.size()).first;
+			fileSubmeshes.push_back({ addString(mesh->Geo->Name), addString(*name), (uint32_t)mesh->PrimitiveType });
+		}
+
+		auto material = materialIndices.find(world.Get<MaterialComponent>(item)->Mat);
+		if (material == materialIndices.end())
+			return false;
+
+		ecs::Entity parent = scene.GetHierarchy().GetParent(item);
+		auto parentIndex = itemIndices.find(parent);
+
+		transforms[i] = *world.Get<TransformComponent>(item);
+		locals[i] = scene.GetLocalTransform(item);
+		bounds[i] = *world.Get<BoundsComponent>(item);
+		itemSubmeshes[i] = submesh->second;
+		itemMaterials[i] = material->second;
+		parents[i] = parentIndex != itemIndices.end() ? (int32_t)parentIndex->second : -1;
+		flags[i] = (world.Get<RenderStateComponent>(item)->Visible ? 0 : ItemHidden) |
+			(scene.IsOccluder(item) ? ItemOccluder : 0) |
+			(scene.IsStatic(item) ? ItemStatic : 0);
+	}
+
+	FileHeader header;
+	header.Magic = Magic;
+	header.Version = Version;
+	header.StringBytes = (uint32_t)strings.size();
+	header.MaterialCount = (uint32_t)fileMaterials.size();
+	header.SubmeshCount = (uint32_t)fileSubmeshes.size();
+	header.ItemCount = itemCount;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	WriteSection(file, &header, sizeof(header));
+	WriteSection(file, strings.data(), strings.size());
+	WriteSection(file, fileMaterials);
+	WriteSection(file, fileSubmeshes);
+	WriteSection(file, transforms);
+	WriteSection(file, locals);
+	WriteSection(file, bounds);
+	WriteSection(file, itemSubmeshes);
+	WriteSection(file, itemMaterials);
+	WriteSection(file, parents);
+	WriteSection(file, layers);
+	WriteSection(file, flags);
+
+	return (bool)file.flush();
+}
+
+bool SceneSerializer::Load(const std::string& path, Scene& scene, MatManager& materials,
+	const std::unordered_map<std::string, std::unique_ptr<MeshGeometry>>& geometries,
+	const Limits& limits)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	size_t size = (size_t)file.tellg();
+
+	// 8-byte words, so the arrays of the image are aligned like in memory.
+	std::vector<uint64_t> image((size + 7) / 8);
+	file.seekg(0);
+	if (!file.read(reinterpret_cast<char*>(image.data()), size))
+		return false;
+
+	SectionReader reader(reinterpret_cast<const std::byte*>(image.data()), size);
+
+	const FileHeader* header = reader.Read<FileHeader>(1);
+	if (!header || header->Magic != Magic || header->Version != Version)
+		return false;
+
+	const uint32_t itemCount = header->ItemCount;
+	if (itemCount > limits.MaxItems)
+		return false;
+
+	const char* strings                 = reader.Read<char>(header->StringBytes);
+	const FileMaterial* fileMaterials   = reader.Read<FileMaterial>(header->MaterialCount);
+	const FileSubmesh* fileSubmeshes    = reader.Read<FileSubmesh>(header->SubmeshCount);
+	const TransformComponent* transforms = reader.Read<TransformComponent>(itemCount);
+	const LocalTransform* locals        = reader.Read<LocalTransform>(itemCount);
+	const BoundsComponent* bounds       = reader.Read<BoundsComponent>(itemCount);
+	const uint32_t* itemSubmeshes       = reader.Read<uint32_t>(itemCount);
+	const uint32_t* itemMaterials       = reader.Read<uint32_t>(itemCount);
+	const int32_t* parents              = reader.Read<int32_t>(itemCount);
+	const uint8_t* layers               = reader.Read<uint8_t>(itemCount);
+	const uint8_t* flags                = reader.Read<uint8_t>(itemCount);
+	if (!strings || !fileMaterials || !fileSubmeshes || !transforms || !locals || !bounds ||
+		!itemSubmeshes || !itemMaterials || !parents || !layers || !flags)
+		return false;
+
+	auto getString = [&](uint32_t offset) -> const char*
+	{
+		if (offset >= header->StringBytes || !std::memchr(strings + offset, 0, header->StringBytes - offset))
+			return nullptr;
+		return strings + offset;
+	};
+
+	// Check everything before anything is changed.
+	for (uint32_t i = 0; i < header->MaterialCount; ++i)
+	{
+		const FileMaterial& record = fileMaterials[i];
+		if (!getString(record.Name) || record.MatCBIndex < 0 || (uint32_t)record.MatCBIndex >= limits.MaxMaterials)
+			return false;
+	}
+
+	std::vector<MeshComponent> submeshes(header->SubmeshCount);
+	for (uint32_t i = 0; i < header->SubmeshCount; ++i)
+	{
+		const char* geometryName = getString(fileSubmeshes[i].Geometry);
+		const char* submeshName = getString(fileSubmeshes[i].Submesh);
+		if (!geometryName || !submeshName)
+			return false;
+
+		auto geometry = geometries.find(geometryName);
+		if (geometry == geometries.end())
+			return false;
+
+		auto args = geometry->second->DrawArgs.find(submeshName);
+		if (args == geometry->second->DrawArgs.end())
+			return false;
+
+		MeshComponent& mesh = submeshes[i];
+		mesh.Geo = geometry->second.get();
+		mesh.PrimitiveType = (D3D12_PRIMITIVE_TOPOLOGY)fileSubmeshes[i].PrimitiveType;
+		mesh.IndexCount = args->second.IndexCount;
+		mesh.StartIndexLocation = args->second.StartIndexLocation;
+		mesh.BaseVertexLocation = args->second.BaseVertexLocation;
+		mesh.BVH = args->second.BVH.get();
+	}
+
+	for (uint32_t i = 0; i < itemCount; ++i)
+	{
+		if (itemSubmeshes[i] >= header->SubmeshCount || itemMaterials[i] >= header->MaterialCount ||
+			parents[i] < -1 || parents[i] >= (int32_t)itemCount || parents[i] == (int32_t)i ||
+			layers[i] >= (uint8_t)RenderLayer::Count)
+			return false;
+	}
+
+	// Every parent chain must end at a root; the hierarchy cannot hold a cycle.
+	{
+		enum : uint8_t { Unvisited, OnPath, Rooted };
+		std::vector<uint8_t> state(itemCount, Unvisited);
+		for (uint32_t i = 0; i < itemCount; ++i)
+		{
+			int32_t node = (int32_t)i;
+			while (node >= 0 && state[node] == Unvisited)
+			{
+				state[node] = OnPath;
+				node = parents[node];
+			}
+
+			// Earlier chains are all rooted, so a node on this path means a loop.
+			if (node >= 0 && state[node] == OnPath)
+				return false;
+
+			for (node = (int32_t)i; node >= 0 && state[node] == OnPath; node = parents[node])
+				state[node] = Rooted;
+		}
+	}
+
+	// Materials first, the items point at them.
+	std::vector<MaterialComponent> itemMaterialComponents(itemCount);
+	{
+		std::vector<Material*> loaded(header->MaterialCount);
+		for (uint32_t i = 0; i < header->MaterialCount; ++i)
+		{
+			const FileMaterial& record = fileMaterials[i];
+
+			Material mat;
+			mat.Name = getString(record.Name);
+			mat.MatCBIndex = record.MatCBIndex;
+			mat.DiffuseSrvHeapIndex = record.DiffuseSrvHeapIndex;
+			mat.NormalSrvHeapIndex = record.NormalSrvHeapIndex;
+			mat.DiffuseAlbedo = record.DiffuseAlbedo;
+			mat.FresnelR0 = record.FresnelR0;
+			mat.Roughness = record.Roughness;
+			mat.MatTransform = record.MatTransform;
+			loaded[i] = materials.SetMaterial(mat);
+		}
+
+		for (uint32_t i = 0; i < itemCount; ++i)
+			itemMaterialComponents[i].Mat = loaded[itemMaterials[i]];
+	}
+
+	std::vector<MeshComponent> meshes(itemCount);
+	for (uint32_t i = 0; i < itemCount; ++i)
+		meshes[i] = submeshes[itemSubmeshes[i]];
+
+	scene.Clear();
+
+	// One batch per run of items that share a layer and tags.
+	const uint8_t tagFlags = ItemOccluder | ItemStatic;
+
+	std::vector<ecs::Entity> items(itemCount);
+	for (uint32_t first = 0; first < itemCount; )
+	{
+		uint8_t tags = flags[first] & tagFlags;
+
+		uint32_t end = first + 1;
+		while (end < itemCount && layers[end] == layers[first] && (flags[end] & tagFlags) == tags)
+			++end;
+
+		RenderItemColumns columns;
+		columns.Transforms = transforms + first;
+		columns.Locals = locals + first;
+		columns.Bounds = bounds + first;
+		columns.Meshes = meshes.data() + first;
+		columns.Materials = itemMaterialComponents.data() + first;
+
+		scene.CreateRenderItems((RenderLayer)layers[first],
+			((tags & ItemOccluder) ? ecs::MaskOf<OccluderTag>() : 0) | ((tags & ItemStatic) ? ecs::MaskOf<StaticTag>() : 0),
+			end - first, columns, items.data() + first);
+
+		first = end;
+	}
+
+	for (uint32_t i = 0; i < itemCount; ++i)
+	{
+		if (parents[i] >= 0)
+			scene.GetHierarchy().SetParent(items[i], items[parents[i]], false);
+
+		if (flags[i] & ItemHidden)
+			scene.SetVisible(items[i], false);
+	}
+
+	return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+//
+// Binary scene files.
+//
+// A scene file is a small header followed by flat arrays: a string table, the
+// materials, the submeshes the items draw (by geometry and DrawArgs name), and
+// one array per item attribute. Items are stored sorted by layer and occluder
+// flag, so loading reads the file in one go and hands every run of items to
+// Scene::CreateRenderItems, which copies the arrays range by range into the
+// ECS chunks. Meshes and textures are not stored: a file refers to them by
+// name and SRV index and loads into a renderer that has built the same ones.
+//
+
+#include "Scene.h"
+
+class SceneSerializer
+{
+public:
+	static constexpr uint32_t Magic = 0x4E43535A;   // "ZSCN"
+	static constexpr uint32_t Version = 1;
+
+	// What a load may create, e.g. the sizes of the frame resources' buffers.
+	struct Limits
+	{
+		uint32_t MaxItems = UINT32_MAX;
+		uint32_t MaxMaterials = UINT32_MAX;   // material buffer slots
+	};
+
+	// Writes every item of the scene and every material. Returns false if the
+	// file cannot be written or an item draws something that is not a submesh
+	// of its geometry.
+	static bool Save(const std::string& path, Scene& scene, MatManager& materials);
+
+	// Replaces the scene's items with the file's; materials are overwritten by
+	// name or added. Returns false and changes nothing if the file cannot be
+	// read, has another version, exceeds the limits, refers to geometry that
+	// is not loaded or has a parent cycle.
+	static bool Load(const std::string& path, Scene& scene, MatManager& materials,
+		const std::unordered_map<std::string, std::unique_ptr<MeshGeometry>>& geometries,
+		const Limits& limits);
+};
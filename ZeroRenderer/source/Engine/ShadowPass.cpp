@@ -5,75 +5,69 @@ ShadowPass::ShadowPass(ID3D12Device* device, UINT size) : mCbvSrvUavDescriptorSi
 	mShadowMap = std::make_unique<ShadowMap>(device, 4096*4, 4096*4);
 	mSceneBounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
 	mSceneBounds.Radius = sqrtf(37.0f * 37.0f + 37.0f * 37.0f);
+
+	mCullLayers = LayerMask(RenderLayer::Opaque) | LayerMask(RenderLayer::Transparent);
 }
 
-void ShadowPass::Render(
-	ComPtr<ID3D12GraphicsCommandList> mCommandList,
-	FrameResource* mCurrFrameResource,
-    ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap,
-    CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv,
-    ComPtr<ID3D12RootSignature> mRootSignature,
-	PSOManager* psoManager,
-	Scene* mScene)
+void ShadowPass::Declare(RenderGraph& graph, FrameTargets& targets, ID3D12Device* device)
 {
-	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
-
-	auto matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
-	mCommandList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
+	D3D12_RESOURCE_DESC desc = mShadowMap->ResourceDesc();
+	D3D12_CLEAR_VALUE clearValue = mShadowMap->ClearValue();
+	mShadowMapResource = graph.CreateTexture("ShadowMap", desc, &clearValue,
+		device->GetResourceAllocationInfo(0, 1, &desc));
+	targets.ShadowMap = mShadowMapResource;
+
+	mGraphPass = graph.AddPass("Shadow");
+	graph.Write(mGraphPass, mShadowMapResource, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+}
 
-	// Bind null SRV for shadow map pass.
-	mCommandList->SetGraphicsRootDescriptorTable(3, mNullSrv);
+void ShadowPass::AttachResources(const RenderGraphResources& resources)
+{
+	mShadowMap->SetResource(resources.Get(mShadowMapResource));
+}
 
-	//CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-	//hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
+void ShadowPass::Prepare(const RenderContext& context)
+{
+	ClearPrepared();
 
-	mCommandList->SetGraphicsRootDescriptorTable(4, mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	// Note the active PSO also must specify a render target count of 0.
+	ID3D12PipelineState* pso = context.Psos->GetPipelineState("shadow_opaque");
 
-	DrawSceneToShadowMap(
-		mCommandList, mCurrFrameResource, mSrvDescriptorHeap,
-		mNullSrv, mRootSignature, psoManager, mScene);
+	PrepareLayer(context.CurrentScene, RenderLayer::Opaque, pso, context.Frame);
+	PrepareLayer(context.CurrentScene, RenderLayer::Transparent, pso, context.Frame);
 }
 
-void ShadowPass::DrawSceneToShadowMap(
-	ComPtr<ID3D12GraphicsCommandList> mCommandList,
-	FrameResource* mCurrFrameResource,
-	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap,
-	CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv,
-	ComPtr<ID3D12RootSignature> mRootSignature,
-	PSOManager* psoManager,
-	Scene* mScene)
+void ShadowPass::BeginPass(CommandRecorder& mCommandList, const RenderContext& context)
 {
-	mCommandList->RSSetViewports(1, get_rvalue_ptr(mShadowMap->Viewport()));
-	mCommandList->RSSetScissorRects(1, get_rvalue_ptr(mShadowMap->ScissorRect()));
-
-	// Change to DEPTH_WRITE.
-	mCommandList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(mShadowMap->Resource(),
-		D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_DEPTH_WRITE)));
-
-	UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
+	// To DEPTH_WRITE, and on to the memory it shares with the SSAO maps.
+	context.Graph->RecordBarriers(mCommandList.Get(), mGraphPass);
 
 	// Clear the back buffer and depth buffer.
 	mCommandList->ClearDepthStencilView(mShadowMap->Dsv(),
 		D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+}
+
+void ShadowPass::BindState(CommandRecorder& mCommandList, const RenderContext& context)
+{
+	mCommandList.SetGraphicsRootSignature(context.RootSignature);
+
+	mCommandList.SetGraphicsRootShaderResourceView(MaterialBufferRootParameter,
+		mSceneBuffer->Address(GpuSceneBuffer::Region::Materials));
+
+	// Bind null SRV for shadow map pass.
+	mCommandList.SetGraphicsRootDescriptorTable(3, context.NullSrv);
+
+	mCommandList.SetGraphicsRootDescriptorTable(4, context.SrvHeap->GetGPUDescriptorHandleForHeapStart());
+
+	mCommandList->RSSetViewports(1, get_rvalue_ptr(mShadowMap->Viewport()));
+	mCommandList->RSSetScissorRects(1, get_rvalue_ptr(mShadowMap->ScissorRect()));
 
 	// Set null render target because we are only going to draw to
 	// depth buffer.  Setting a null render target will disable color writes.
 	mCommandList->OMSetRenderTargets(0, nullptr, false, get_rvalue_ptr(mShadowMap->Dsv()));
 
 	// Bind the pass constant buffer for the shadow map pass.
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	D3D12_GPU_VIRTUAL_ADDRESS passCBAddress = passCB->GetGPUVirtualAddress() + 1 * passCBByteSize;
-	mCommandList->SetGraphicsRootConstantBufferView(1, passCBAddress);
-
-	// Note the active PSO also must specify a render target count of 0.
-	mCommandList->SetPipelineState(psoManager->GetPipelineState("shadow_opaque"));
-
-	DrawRenderItems(mCommandList.Get(), mScene->GetRenderLayer(RenderLayer::Opaque), mCurrFrameResource);
-	DrawRenderItems(mCommandList.Get(), mScene->GetRenderLayer(RenderLayer::Transparent), mCurrFrameResource);
-
-	// Change back to GENERIC_READ so we can read the texture in a shader.
-	mCommandList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(mShadowMap->Resource(),
-		D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_GENERIC_READ)));
+	mCommandList.SetGraphicsRootConstantBufferView(1, mShadowPassCBAddress);
 }
 
 void ShadowPass::Update(FrameResource* mCurrFrameResource, Camera& camera)
@@ -107,8 +101,10 @@ void ShadowPass::UpdateShadowPassCB(FrameResource* mCurrFrameResource)
 	mShadowPassCB.NearZ = mLightNearZ;
 	mShadowPassCB.FarZ = mLightFarZ;
 
-	auto currPassCB = mCurrFrameResource->PassCB.get();
-	currPassCB->CopyData(1, mShadowPassCB);
+	// Casters outside the light volume are clipped by the shadow map anyway.
+	SetCullView(view, proj);
+
+	mShadowPassCBAddress = mCurrFrameResource->Uploads->CopyConstants(mShadowPassCB);
 }
 
 void ShadowPass::UpdateShadowTransform()
@@ -12,26 +12,15 @@ class ShadowPass : public RenderPass
 public:
 	ShadowPass(ID3D12Device* device, UINT);
 
-	virtual void Render(
-        ComPtr<ID3D12GraphicsCommandList> mCommandList,
-        FrameResource* mCurrFrameResource,
-        ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap,
-        CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv,
-        ComPtr<ID3D12RootSignature> mRootSignature,
-        PSOManager* psoManager,
-        Scene* mScene) override;
+	virtual void Declare(RenderGraph& graph, FrameTargets& targets, ID3D12Device* device) override;
+	virtual void AttachResources(const RenderGraphResources& resources) override;
 
-	virtual void Update(FrameResource* mCurrFrameResource, Camera& camera) override;
+	virtual void Prepare(const RenderContext& context) override;
+
+	virtual void BeginPass(CommandRecorder& mCommandList, const RenderContext& context) override;
+	virtual void BindState(CommandRecorder& mCommandList, const RenderContext& context) override;
 
-    void DrawSceneToShadowMap(
-        ComPtr<ID3D12GraphicsCommandList> mCommandList,
-        FrameResource* mCurrFrameResource,
-        ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap,
-        CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv,
-        ComPtr<ID3D12RootSignature> mRootSignature,
-        PSOManager* psoManager,
-        Scene* mScene
-    );
+	virtual void Update(FrameResource* mCurrFrameResource, Camera& camera) override;
 
     void UpdateShadowPassCB(FrameResource* mCurrFrameResource);
 
@@ -43,6 +32,7 @@ public:
 
 private:
 	std::unique_ptr<ShadowMap> mShadowMap;
+	RenderGraph::ResourceId mShadowMapResource = RenderGraph::None;
 
     DirectX::BoundingSphere mSceneBounds;
 
@@ -61,6 +51,7 @@ public:
     };
 
     PassConstants mShadowPassCB;
+    D3D12_GPU_VIRTUAL_ADDRESS mShadowPassCBAddress = 0;  // in the frame's upload memory
 
     UINT mCbvSrvUavDescriptorSize = 0;
 };
@@ -8,68 +8,125 @@ SsaoPass::SsaoPass(
 	mScreenViewport(screenViewport), mScissorRect(scissorRect), dsvHeapHandle(handle)
 {
     mSsao = std::make_unique<Ssao>(device, cmdList, width, height);
+
+    mCullLayers = LayerMask(RenderLayer::Opaque);
 }
 
-void SsaoPass::Render(
-    ComPtr<ID3D12GraphicsCommandList> mCommandList,
-    FrameResource* mCurrFrameResource,
-    ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap,
-    CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv,
-    ComPtr<ID3D12RootSignature> mSsaoRootSignature,
-    PSOManager* psoManager,
-    Scene* mScene)
+// The pass draws the screen normals and depth, then computes the ambient map
+// from them in EndPass.
+
+void SsaoPass::Declare(RenderGraph& graph, FrameTargets& targets, ID3D12Device* device)
 {
-	DrawNormalsAndDepth(mCommandList, mCurrFrameResource, mSrvDescriptorHeap,
-		mNullSrv, mSsaoRootSignature, psoManager, mScene);
+	D3D12_RESOURCE_DESC normalDesc = mSsao->NormalMapDesc();
+	D3D12_CLEAR_VALUE normalClear = Ssao::NormalMapClearValue();
+	mNormalMapResource = graph.CreateTexture("NormalMap", normalDesc, &normalClear,
+		device->GetResourceAllocationInfo(0, 1, &normalDesc));
+
+	D3D12_RESOURCE_DESC ambientDesc = mSsao->AmbientMapDesc();
+	D3D12_CLEAR_VALUE ambientClear = Ssao::AmbientMapClearValue();
+	D3D12_RESOURCE_ALLOCATION_INFO ambientInfo = device->GetResourceAllocationInfo(0, 1, &ambientDesc);
+	mAmbientMapResources[0] = graph.CreateTexture("AmbientMap0", ambientDesc, &ambientClear, ambientInfo);
+	mAmbientMapResources[1] = graph.CreateTexture("AmbientMap1", ambientDesc, &ambientClear, ambientInfo);
+
+	// The SSAO shaders sample the depth buffer, with depth writes off.
+	const D3D12_RESOURCE_STATES depthRead = D3D12_RESOURCE_STATES(
+		D3D12_RESOURCE_STATE_DEPTH_READ | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+	mGraphPass = graph.AddPass("Normals");
+	graph.Write(mGraphPass, mNormalMapResource, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	graph.Write(mGraphPass, targets.DepthStencil, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+	mSsaoGraphPass = graph.AddPass("Ssao");
+	graph.Read(mSsaoGraphPass, mNormalMapResource, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Read(mSsaoGraphPass, targets.DepthStencil, depthRead);
+	graph.Write(mSsaoGraphPass, mAmbientMapResources[0], D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+	// Ping-pong between the two ambient maps, ending in the first.
+	for (int i = 0; i < 2 * BlurCount; ++i)
+	{
+		RenderGraph::PassId pass = graph.AddPass(i % 2 == 0 ? "SsaoBlurH" : "SsaoBlurV");
+		graph.Read(pass, mNormalMapResource, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		graph.Read(pass, targets.DepthStencil, depthRead);
+		graph.Read(pass, mAmbientMapResources[i % 2], D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		graph.Write(pass, mAmbientMapResources[1 - i % 2], D3D12_RESOURCE_STATE_RENDER_TARGET);
+		mBlurGraphPasses[i] = pass;
+	}
+
+	targets.AmbientMap = mAmbientMapResources[0];
+}
 
-	mCommandList->SetGraphicsRootSignature(mSsaoRootSignature.Get());
-	mSsao->ComputeSsao(mCommandList.Get(), mCurrFrameResource, 3);
+void SsaoPass::AttachResources(const RenderGraphResources& resources)
+{
+	mSsao->SetResources(resources.Get(mNormalMapResource),
+		resources.Get(mAmbientMapResources[0]), resources.Get(mAmbientMapResources[1]));
 }
 
-void SsaoPass::DrawNormalsAndDepth(
-    ComPtr<ID3D12GraphicsCommandList> mCommandList,
-    FrameResource* mCurrFrameResource,
-    ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap,
-    CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv,
-    ComPtr<ID3D12RootSignature> mSsaoRootSignature,
-    PSOManager* psoManager,
-    Scene* mScene)
+void SsaoPass::Prepare(const RenderContext& context)
 {
-	mCommandList->RSSetViewports(1, &mScreenViewport);
-	mCommandList->RSSetScissorRects(1, &mScissorRect);
+	ClearPrepared();
 
-	auto normalMap = mSsao->NormalMap();
-	auto normalMapRtv = mSsao->NormalMapRtv();
+	PrepareLayer(context.CurrentScene, RenderLayer::Opaque,
+		context.Psos->GetPipelineState("drawNormals"), context.Frame);
+	//PrepareLayer(context.CurrentScene, RenderLayer::Transparent, ...);
+}
 
-	// Change to RENDER_TARGET.
-	mCommandList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(normalMap,
-		D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET)));
+void SsaoPass::BeginPass(CommandRecorder& mCommandList, const RenderContext& context)
+{
+	context.Graph->RecordBarriers(mCommandList.Get(), mGraphPass);
 
 	// Clear the screen normal map and depth buffer.
 	float clearValue[] = { 0.0f, 0.0f, 1.0f, 0.0f };
-	mCommandList->ClearRenderTargetView(normalMapRtv, clearValue, 0, nullptr);
+	mCommandList->ClearRenderTargetView(mSsao->NormalMapRtv(), clearValue, 0, nullptr);
 	mCommandList->ClearDepthStencilView(dsvHeapHandle, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+}
+
+void SsaoPass::BindState(CommandRecorder& mCommandList, const RenderContext& context)
+{
+	// The normals are drawn with the scene shaders.
+	mCommandList.SetGraphicsRootSignature(context.RootSignature);
+
+	mCommandList.SetGraphicsRootShaderResourceView(MaterialBufferRootParameter,
+		mSceneBuffer->Address(GpuSceneBuffer::Region::Materials));
+	mCommandList.SetGraphicsRootDescriptorTable(3, context.NullSrv);
+	mCommandList.SetGraphicsRootDescriptorTable(4, context.SrvHeap->GetGPUDescriptorHandleForHeapStart());
+
+	mCommandList->RSSetViewports(1, &mScreenViewport);
+	mCommandList->RSSetScissorRects(1, &mScissorRect);
 
 	// Specify the buffers we are going to render to.
+	auto normalMapRtv = mSsao->NormalMapRtv();
 	mCommandList->OMSetRenderTargets(1, &normalMapRtv, true, &dsvHeapHandle);
 
 	// Bind the constant buffer for this pass.
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+	mCommandList.SetGraphicsRootConstantBufferView(1, mMainPassCBAddress);
+}
+
+void SsaoPass::EndPass(CommandRecorder& mCommandList, const RenderContext& context)
+{
+	// Nothing reads the ambient map.
+	if (context.Graph->Graph().IsCulled(mSsaoGraphPass))
+		return;
 
-	mCommandList->SetPipelineState(psoManager->GetPipelineState("drawNormals"));
+	mCommandList.SetGraphicsRootSignature(context.SsaoRootSignature);
 
-	DrawRenderItems(mCommandList.Get(), mScene->GetRenderLayer(RenderLayer::Opaque), mCurrFrameResource);
-	//DrawRenderItems(mCommandList.Get(), mScene->GetRenderLayer(RenderLayer::Transparent), mCurrFrameResource);
+	context.Graph->RecordBarriers(mCommandList.Get(), mSsaoGraphPass);
+	mSsao->ComputeSsao(mCommandList.Get(), mSsaoCBAddress);
 
-	// Change back to GENERIC_READ so we can read the texture in a shader.
-	mCommandList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(normalMap,
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_GENERIC_READ)));
+	for (int i = 0; i < 2 * BlurCount; ++i)
+	{
+		context.Graph->RecordBarriers(mCommandList.Get(), mBlurGraphPasses[i]);
+		mSsao->BlurAmbientMap(mCommandList.Get(), mSsaoCBAddress, i % 2 == 0);
+	}
+
+	// ComputeSsao binds its own PSOs and root arguments.
+	mCommandList.Invalidate();
 }
 
 void SsaoPass::Update(FrameResource* mCurrFrameResource, Camera& camera)
 {
 	UpdateSsaoCB(mCurrFrameResource, camera);
+
+	SetCullView(camera.GetView(), camera.GetProj());
 }
 
 void SsaoPass::UpdateSsaoCB(FrameResource* mCurrFrameResource, Camera& mCamera)
@@ -104,6 +161,5 @@ void SsaoPass::UpdateSsaoCB(FrameResource* mCurrFrameResource, Camera& mCamera)
 	ssaoCB.OcclusionFadeEnd = 1.0f;
 	ssaoCB.SurfaceEpsilon = 0.05f;
 
-	auto currSsaoCB = mCurrFrameResource->SsaoCB.get();
-	currSsaoCB->CopyData(0, ssaoCB);
+	mSsaoCBAddress = mCurrFrameResource->Uploads->CopyConstants(ssaoCB);
 }
@@ -13,14 +13,17 @@ public:
         UINT width, UINT height, D3D12_VIEWPORT screenViewport,
         D3D12_RECT scissorRect, D3D12_CPU_DESCRIPTOR_HANDLE handle);
 
-    virtual void Render(
-        ComPtr<ID3D12GraphicsCommandList> mCommandList,
-        FrameResource* mCurrFrameResource,
-        ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap,
-        CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv,
-        ComPtr<ID3D12RootSignature> mSsaoRootSignature,
-        PSOManager* psoManager,
-        Scene* mScene) override;
+    // Times the ambient map is blurred, horizontally and then vertically.
+    static constexpr int BlurCount = 3;
+
+    virtual void Declare(RenderGraph& graph, FrameTargets& targets, ID3D12Device* device) override;
+    virtual void AttachResources(const RenderGraphResources& resources) override;
+
+    virtual void Prepare(const RenderContext& context) override;
+
+    virtual void BeginPass(CommandRecorder& mCommandList, const RenderContext& context) override;
+    virtual void BindState(CommandRecorder& mCommandList, const RenderContext& context) override;
+    virtual void EndPass(CommandRecorder& mCommandList, const RenderContext& context) override;
 
     virtual void Update(FrameResource* mCurrFrameResource, Camera& camera) override;
 
@@ -28,23 +31,25 @@ public:
 
     Ssao* GetSsao() { return mSsao.get(); }
 
-    void DrawNormalsAndDepth(
-        ComPtr<ID3D12GraphicsCommandList> mCommandList,
-        FrameResource* mCurrFrameResource,
-        ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap,
-        CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv,
-        ComPtr<ID3D12RootSignature> mRootSignature,
-        PSOManager* psoManager,
-        Scene* mScene);
-
     PassConstants mMainPassCB; //  ZeroRenderer е MainPassCB
 
+    D3D12_GPU_VIRTUAL_ADDRESS mMainPassCBAddress = 0;  // the main pass's copy of mMainPassCB
+
     D3D12_VIEWPORT mScreenViewport; // ͬ mMainPassCB
     D3D12_RECT mScissorRect;
 
 private:   
     D3D12_CPU_DESCRIPTOR_HANDLE dsvHeapHandle;
 
+    D3D12_GPU_VIRTUAL_ADDRESS mSsaoCBAddress = 0;  // in the frame's upload memory
+
     std::unique_ptr<Ssao> mSsao;
+
+    RenderGraph::ResourceId mNormalMapResource = RenderGraph::None;
+    RenderGraph::ResourceId mAmbientMapResources[2] = { RenderGraph::None, RenderGraph::None };
+
+    // After the normals pass (mGraphPass), in EndPass.
+    RenderGraph::PassId mSsaoGraphPass = RenderGraph::None;
+    RenderGraph::PassId mBlurGraphPasses[2 * BlurCount] = {};
 };
 
@@ -0,0 +1,212 @@
+#include "StaticBatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+// Opaque draw calls the passes issue when everything is visible: one per
+// distinct submesh, see RenderPass::PrepareLayer.
+static uint32_t CountDraws(const Scene& scene)
+{
+	std::vector<uint32_t> ids;
+	for (const DrawItem& item : scene.GetDrawItems(RenderLayer::Opaque))
+		ids.push_back(item.SubmeshId);
+
+	std::sort(ids.begin(), ids.end());
+	return (uint32_t)(std::unique(ids.begin(), ids.end()) - ids.begin());
+}
+
+// Appends the submesh of an item to the batch, transformed the way the
+// shaders would transform it.
+static void AppendItem(const TransformComponent& transform, const MeshComponent& mesh,
+	std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices, XMVECTOR& vMin, XMVECTOR& vMax)
+{
+	const MeshGeometry* geo = mesh.Geo;
+	const Vertex* srcVertices = (const Vertex*)geo->VertexBufferCPU->GetBufferPointer();
+	const void* srcIndices = geo->IndexBufferCPU->GetBufferPointer();
+	const bool index16 = geo->IndexFormat == DXGI_FORMAT_R16_UINT;
+
+	auto readIndex = [&](UINT i) -> UINT
+	{
+		return index16 ? ((const std::uint16_t*)srcIndices)[i] : ((const std::uint32_t*)srcIndices)[i];
+	};
+
+	if (mesh.IndexCount == 0)
+		return;
+
+	// Only the vertex range the submesh refers to is copied.
+	UINT first = UINT_MAX, last = 0;
+	for (UINT i = 0; i < mesh.IndexCount; ++i)
+	{
+		UINT index = readIndex(mesh.StartIndexLocation + i);
+		first = std::min(first, index);
+		last = std::max(last, index);
+	}
+
+	const UINT base = (UINT)vertices.size();
+	for (UINT i = 0; i < mesh.IndexCount; ++i)
+		indices.push_back(base + readIndex(mesh.StartIndexLocation + i) - first);
+
+	XMMATRIX world = XMLoadFloat4x4(&transform.World);
+	XMMATRIX texTransform = XMLoadFloat4x4(&transform.TexTransform);
+
+	for (UINT v = first; v <= last; ++v)
+	{
+		const Vertex& src = srcVertices[mesh.BaseVertexLocation + v];
+
+		// Normals and tangents take the upper 3x3 of the world matrix, as in the shaders.
+		XMVECTOR P = XMVector3Transform(XMLoadFloat3(&src.Pos), world);
+
+		Vertex dst;
+		XMStoreFloat3(&dst.Pos, P);
+		XMStoreFloat3(&dst.Normal, XMVector3TransformNormal(XMLoadFloat3(&src.Normal), world));
+		XMStoreFloat3(&dst.TangentU, XMVector3TransformNormal(XMLoadFloat3(&src.TangentU), world));
+		XMStoreFloat2(&dst.TexC, XMVector4Transform(XMVectorSet(src.TexC.x, src.TexC.y, 0.0f, 1.0f), texTransform));
+		vertices.push_back(dst);
+
+		vMin = XMVectorMin(vMin, P);
+		vMax = XMVectorMax(vMax, P);
+	}
+}
+
+void StaticBatcher::Build(Scene& scene, ID3D12Device* device, ID3D12GraphicsCommandList* cmdList)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	Clear(scene);
+
+	mStats.DrawsBefore = CountDraws(scene);
+
+	struct Source
+	{
+		ecs::Entity Item;
+		TransformComponent Transform;
+		MeshComponent Mesh;
+	};
+
+	std::map<std::tuple<Material*, int, int, int>, std::vector<Source>> groups;
+
+	auto cell = [](float x) { return (int)std::floor(x / CellSize); };
+
+	ecs::ComponentMask mask = LayerMask(RenderLayer::Opaque) |
+		ecs::MaskOf<StaticTag, TransformComponent, MeshComponent, MaterialComponent, RenderStateComponent>();
+
+	scene.GetWorld().ForEachChunk(mask, [&](ecs::Chunk& chunk)
+	{
+		auto transforms = chunk.Column<TransformComponent>();
+		auto meshes     = chunk.Column<MeshComponent>();
+		auto materials  = chunk.Column<MaterialComponent>();
+		auto states     = chunk.Column<RenderStateComponent>();
+
+		for (uint32_t i = 0; i < chunk.Count; ++i)
+		{
+			const MeshGeometry* geo = meshes[i].Geo;
+			if (!states[i].Visible || meshes[i].PrimitiveType != D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST ||
+				!geo->VertexBufferCPU || !geo->IndexBufferCPU || geo->VertexByteStride != sizeof(Vertex))
+				continue;
+
+			const XMFLOAT4X4& world = transforms[i].World;
+			groups[{ materials[i].Mat, cell(world._41), cell(world._42), cell(world._43) }].push_back(
+				{ chunk.Entities()[i], transforms[i], meshes[i] });
+		}
+	});
+
+	std::vector<Vertex> vertices;
+	std::vector<std::uint32_t> indices;
+
+	for (const auto& [key, sources] : groups)
+	{
+		bool distinct = false;
+		for (const Source& source : sources)
+			distinct |= SubmeshKey(source.Mesh) != SubmeshKey(sources[0].Mesh);
+		if (!distinct)
+			continue;
+
+		vertices.clear();
+		indices.clear();
+
+		XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+		XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+
+		for (const Source& source : sources)
+			AppendItem(source.Transform, source.Mesh, vertices, indices, vMin, vMax);
+
+		const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+		const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint32_t);
+
+		auto geo = std::make_unique<MeshGeometry>();
+		geo->Name = "staticBatch" + std::to_string(mGeometries.size());
+
+		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(device,
+			cmdList, vertices.data(), vbByteSize, geo->VertexBufferUploader);
+
+		geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(device,
+			cmdList, indices.data(), ibByteSize, geo->IndexBufferUploader);
+
+		geo->VertexByteStride = sizeof(Vertex);
+		geo->VertexBufferByteSize = vbByteSize;
+		geo->IndexFormat = DXGI_FORMAT_R32_UINT;
+		geo->IndexBufferByteSize = ibByteSize;
+
+		// The vertices are in world space, so the bounds are too.
+		SubmeshGeometry submesh;
+		submesh.IndexCount = (UINT)indices.size();
+		XMStoreFloat3(&submesh.Bounds.Center, 0.5f * (vMin + vMax));
+		XMStoreFloat3(&submesh.Bounds.Extents, 0.5f * (vMax - vMin));
+		geo->DrawArgs["batch"] = submesh;
+
+		ecs::Entity item = scene.CreateRenderItem(
+			RenderLayer::Opaque,
+			XMMatrixIdentity(),
+			XMMatrixIdentity(),
+			std::get<0>(key),
+			geo.get(),
+			submesh.IndexCount,
+			0,
+			0,
+			submesh.Bounds);
+		scene.GetWorld().Add<StaticBatchTag>(item);
+		mBatchItems.push_back(item);
+
+		for (const Source& source : sources)
+		{
+			scene.SetBatched(source.Item, true);
+			mBatchedItems.push_back(source.Item);
+		}
+
+		mStats.ItemCount += (uint32_t)sources.size();
+		mStats.BatchCount++;
+		mStats.BufferBytes += vbByteSize + ibByteSize;
+
+		mGeometries.push_back(std::move(geo));
+	}
+
+	mStats.DrawsAfter = CountDraws(scene);
+	mStats.BuildMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	scene.SetStaticBatchesStale(false);
+}
+
+void StaticBatcher::Clear(Scene& scene)
+{
+	// Both calls skip the items the scene has destroyed since.
+	for (ecs::Entity item : mBatchItems)
+		scene.DestroyRenderItem(item);
+
+	for (ecs::Entity item : mBatchedItems)
+		scene.SetBatched(item, false);
+
+	mBatchItems.clear();
+	mBatchedItems.clear();
+	mGeometries.clear();
+
+	mStats = Stats();
+
+	scene.SetStaticBatchesStale(false);
+}
+
+void StaticBatcher::DisposeUploaders()
+{
+	for (auto& geo : mGeometries)
+		geo->DisposeUploaders();
+}
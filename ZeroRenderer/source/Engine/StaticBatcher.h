@@ -0,0 +1,56 @@
+#pragma once
+
+//
+// Static batching.
+//
+// Static items never move, so their vertices can be transformed to world
+// space once and merged into one mesh per material and region of the world.
+// Each merged mesh is drawn by a single render item whose bounds are the
+// union of its items', so a batch is still culled as a whole. The merged
+// items stay in the scene (they are still picked, saved and rendered as
+// occluders) but are no longer drawn on their own.
+//
+
+#include "Scene.h"
+
+class StaticBatcher
+{
+public:
+	// Edge of the world-space cells items are grouped by, so a batch does not
+	// span the whole scene and can still be culled.
+	static constexpr float CellSize = 32.0f;
+
+	struct Stats
+	{
+		uint32_t ItemCount = 0;      // items merged into batches
+		uint32_t BatchCount = 0;
+		uint32_t DrawsBefore = 0;    // opaque draw calls without the batches
+		uint32_t DrawsAfter = 0;     // and with them
+		uint64_t BufferBytes = 0;    // vertices and indices of the batches
+		float BuildMilliseconds = 0.0f;
+	};
+
+	// Merges the visible opaque static items, replacing the previous batches.
+	// Items are grouped by material and cell; a group is only merged if it
+	// draws more than one submesh, since instancing already draws copies of
+	// one submesh in a single call. The GPU must be done with the previous
+	// batches. The uploads are recorded into cmdList; call DisposeUploaders
+	// once it has executed.
+	void Build(Scene& scene, ID3D12Device* device, ID3D12GraphicsCommandList* cmdList);
+
+	// Removes the batches and draws their items on their own again. The GPU
+	// must be done with them.
+	void Clear(Scene& scene);
+
+	void DisposeUploaders();
+
+	const Stats& GetStats() const { return mStats; }
+
+private:
+	std::vector<std::unique_ptr<MeshGeometry>> mGeometries;
+
+	std::vector<ecs::Entity> mBatchItems;
+	std::vector<ecs::Entity> mBatchedItems;
+
+	Stats mStats;
+};
@@ -0,0 +1,314 @@
+#include "TransformHierarchy.h"
+
+#include "../Utility/JobSystem.h"
+
+XMMATRIX XM_CALLCONV LocalTransform::ToMatrix() const
+{
+	return
+		XMMatrixScaling(Scale.x, Scale.y, Scale.z) *
+		XMMatrixRotationQuaternion(XMLoadFloat4(&Rotation)) *
+		XMMatrixTranslation(Translation.x, Translation.y, Translation.z);
+}
+
+LocalTransform XM_CALLCONV LocalTransform::FromMatrix(FXMMATRIX m)
+{
+	XMVECTOR scale, rotation, translation;
+	XMMatrixDecompose(&scale, &rotation, &translation, m);
+
+	LocalTransform local;
+	XMStoreFloat3(&local.Scale, scale);
+	XMStoreFloat4(&local.Rotation, XMQuaternionNormalize(rotation));
+	XMStoreFloat3(&local.Translation, translation);
+	return local;
+}
+
+uint32_t TransformHierarchy::NodeOf(ecs::Entity e) const
+{
+	if (e == ecs::NullEntity || ecs::EntityIndex(e) >= mNodeOfEntity.size())
+		return InvalidNode;
+
+	uint32_t node = mNodeOfEntity[ecs::EntityIndex(e)];
+	if (node == InvalidNode || mEntity[node] != e)
+		return InvalidNode;
+	return node;
+}
+
+uint32_t TransformHierarchy::LiveParent(uint32_t node) const
+{
+	uint32_t parent = mParent[node];
+	while (parent != InvalidNode && mEntity[parent] == ecs::NullEntity)
+		parent = mParent[parent];
+	return parent;
+}
+
+XMMATRIX XM_CALLCONV TransformHierarchy::ParentWorld(uint32_t node) const
+{
+	uint32_t parent = LiveParent(node);
+	return parent == InvalidNode ? XMMatrixIdentity() : XMLoadFloat4x4(&mWorld[parent]);
+}
+
+void TransformHierarchy::Add(ecs::Entity e, const LocalTransform& local, ecs::Entity parent)
+{
+	uint32_t node = (uint32_t)mEntity.size();
+
+	mLocal.push_back(local);
+	mWorld.emplace_back();
+	mParent.push_back(NodeOf(parent));
+	mEntity.push_back(e);
+	mDirty.push_back(1);
+
+	// Give the node a valid world matrix right away so it can be picked
+	// before the next Update().
+	XMStoreFloat4x4(&mWorld[node], local.ToMatrix() * ParentWorld(node));
+
+	uint32_t index = ecs::EntityIndex(e);
+	if (index >= mNodeOfEntity.size())
+		mNodeOfEntity.resize(index + 1, InvalidNode);
+	mNodeOfEntity[index] = node;
+
+	mOrderDirty = true;
+	mAnyDirty = true;
+}
+
+void TransformHierarchy::Remove(ecs::Entity e)
+{
+	uint32_t node = NodeOf(e);
+	if (node == InvalidNode)
+		return;
+
+	// Only tombstone the node here; Rebuild() re-attaches its children and
+	// compacts the arrays once per frame no matter how many nodes were removed.
+	mEntity[node] = ecs::NullEntity;
+	mNodeOfEntity[ecs::EntityIndex(e)] = InvalidNode;
+
+	++mRemovedCount;
+	mOrderDirty = true;
+}
+
+ecs::Entity TransformHierarchy::GetParent(ecs::Entity e) const
+{
+	uint32_t node = NodeOf(e);
+	if (node == InvalidNode)
+		return ecs::NullEntity;
+
+	uint32_t parent = LiveParent(node);
+	return parent == InvalidNode ? ecs::NullEntity : mEntity[parent];
+}
+
+void TransformHierarchy::Clear()
+{
+	mLocal.clear();
+	mWorld.clear();
+	mParent.clear();
+	mEntity.clear();
+	mDirty.clear();
+	mLevelEnd.clear();
+	mNodeOfEntity.clear();
+	mChanged.clear();
+
+	mRemovedCount = 0;
+	mOrderDirty = false;
+	mAnyDirty = false;
+}
+
+bool TransformHierarchy::SetParent(ecs::Entity e, ecs::Entity parent, bool keepWorld)
+{
+	uint32_t node = NodeOf(e);
+	uint32_t parentNode = NodeOf(parent);
+	if (node == InvalidNode)
+		return false;
+
+	for (uint32_t ancestor = parentNode; ancestor != InvalidNode; ancestor = mParent[ancestor])
+	{
+		if (ancestor == node)
+			return false;
+	}
+
+	if (keepWorld)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&mWorld[node]);
+		if (parentNode != InvalidNode)
+		{
+			XMMATRIX parentWorld = XMLoadFloat4x4(&mWorld[parentNode]);
+			world = world * XMMatrixInverse(get_rvalue_ptr(XMMatrixDeterminant(parentWorld)), parentWorld);
+		}
+		mLocal[node] = LocalTransform::FromMatrix(world);
+	}
+
+	mParent[node] = parentNode;
+	mDirty[node] = 1;
+
+	mOrderDirty = true;
+	mAnyDirty = true;
+	return true;
+}
+
+void TransformHierarchy::SetLocal(ecs::Entity e, const LocalTransform& local)
+{
+	uint32_t node = NodeOf(e);
+	if (node == InvalidNode)
+		return;
+
+	mLocal[node] = local;
+	mDirty[node] = 1;
+	mAnyDirty = true;
+}
+
+void TransformHierarchy::Rebuild()
+{
+	const uint32_t count = (uint32_t)mEntity.size();
+
+	// Children of removed nodes move up to the nearest live ancestor.
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (mEntity[i] == ecs::NullEntity)
+			continue;
+
+		uint32_t parent = mParent[i];
+		if (parent == InvalidNode || mEntity[parent] != ecs::NullEntity)
+			continue;
+
+		XMMATRIX world = XMLoadFloat4x4(&mWorld[i]);
+		parent = LiveParent(i);
+		if (parent != InvalidNode)
+		{
+			XMMATRIX parentWorld = XMLoadFloat4x4(&mWorld[parent]);
+			world = world * XMMatrixInverse(get_rvalue_ptr(XMMatrixDeterminant(parentWorld)), parentWorld);
+		}
+
+		mParent[i] = parent;
+		mLocal[i] = LocalTransform::FromMatrix(world);
+		mDirty[i] = 1;
+		mAnyDirty = true;
+	}
+
+	// Depth of every live node; each node is visited once.
+	std::vector<uint32_t> depth(count, InvalidNode);
+	std::vector<uint32_t> chain;
+	uint32_t levelCount = 0;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (mEntity[i] == ecs::NullEntity)
+			continue;
+
+		uint32_t node = i;
+		while (node != InvalidNode && depth[node] == InvalidNode)
+		{
+			chain.push_back(node);
+			node = mParent[node];
+		}
+
+		uint32_t d = node == InvalidNode ? 0 : depth[node] + 1;
+		while (!chain.empty())
+		{
+			depth[chain.back()] = d++;
+			chain.pop_back();
+		}
+
+		levelCount = std::max(levelCount, depth[i] + 1);
+	}
+
+	// Stable counting sort by depth.
+	mLevelEnd.assign(levelCount, 0);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (mEntity[i] != ecs::NullEntity)
+			++mLevelEnd[depth[i]];
+	}
+
+	std::vector<uint32_t> levelCursor(levelCount);
+	uint32_t total = 0;
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		levelCursor[level] = total;
+		total += mLevelEnd[level];
+		mLevelEnd[level] = total;
+	}
+
+	std::vector<uint32_t> newIndex(count, InvalidNode);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (mEntity[i] != ecs::NullEntity)
+			newIndex[i] = levelCursor[depth[i]]++;
+	}
+
+	std::vector<LocalTransform> local(total);
+	std::vector<XMFLOAT4X4>     world(total);
+	std::vector<uint32_t>       parent(total);
+	std::vector<ecs::Entity>    entity(total);
+	std::vector<uint8_t>        dirty(total);
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t n = newIndex[i];
+		if (n == InvalidNode)
+			continue;
+
+		local[n]  = mLocal[i];
+		world[n]  = mWorld[i];
+		parent[n] = mParent[i] == InvalidNode ? InvalidNode : newIndex[mParent[i]];
+		entity[n] = mEntity[i];
+		dirty[n]  = mDirty[i];
+
+		mNodeOfEntity[ecs::EntityIndex(mEntity[i])] = n;
+	}
+
+	mLocal  = std::move(local);
+	mWorld  = std::move(world);
+	mParent = std::move(parent);
+	mEntity = std::move(entity);
+	mDirty  = std::move(dirty);
+
+	mRemovedCount = 0;
+	mOrderDirty = false;
+}
+
+void TransformHierarchy::Update()
+{
+	if (mOrderDirty)
+		Rebuild();
+
+	mChanged.clear();
+	if (!mAnyDirty)
+		return;
+
+	auto& jobSystem = JobSystem::getInstance();
+
+	// Level by level: every parent is final before its children read it.
+	uint32_t levelBegin = 0;
+	for (uint32_t levelEnd : mLevelEnd)
+	{
+		jobSystem.ParallelFor(levelEnd - levelBegin, 256, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = levelBegin + begin; i < levelBegin + end; ++i)
+			{
+				uint32_t parent = mParent[i];
+				if (parent != InvalidNode && mDirty[parent])
+					mDirty[i] = 1;
+
+				if (!mDirty[i])
+					continue;
+
+				XMMATRIX world = mLocal[i].ToMatrix();
+				if (parent != InvalidNode)
+					world = world * XMLoadFloat4x4(&mWorld[parent]);
+
+				XMStoreFloat4x4(&mWorld[i], world);
+			}
+		});
+
+		levelBegin = levelEnd;
+	}
+
+	for (uint32_t i = 0; i < (uint32_t)mDirty.size(); ++i)
+	{
+		if (mDirty[i])
+		{
+			mChanged.push_back(i);
+			mDirty[i] = 0;
+		}
+	}
+
+	mAnyDirty = false;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+//
+// Parent/child transforms of the scene.
+//
+// Every node stores a local TRS. Nodes live in one flat (SoA) array sorted by
+// depth, so a parent always comes before its children and all nodes of one
+// depth can be updated in parallel once the level above them is done.
+// Editing a node only flags it dirty; Update() recomputes the world matrices
+// of dirty nodes and their descendants and reports which nodes changed.
+//
+
+#include "../Common/d3dUtil.h"
+
+#include "../Math/Quaternion.h"
+
+#include "../ECS/Entity.h"
+
+struct LocalTransform
+{
+	XMFLOAT3 Translation = { 0.0f, 0.0f, 0.0f };
+	XMFLOAT4 Rotation    = { 0.0f, 0.0f, 0.0f, 1.0f };   // quaternion
+	XMFLOAT3 Scale       = { 1.0f, 1.0f, 1.0f };
+
+	Quaternion GetRotation() const { return Quaternion(XMLoadFloat4(&Rotation)); }
+	void SetRotation(Quaternion q) { XMStoreFloat4(&Rotation, q); }
+
+	// scale, then rotate, then translate
+	XMMATRIX XM_CALLCONV ToMatrix() const;
+
+	static LocalTransform XM_CALLCONV FromMatrix(FXMMATRIX m);
+};
+
+class TransformHierarchy
+{
+public:
+	static constexpr uint32_t InvalidNode = 0xFFFFFFFFu;
+
+	// Adds a node for e. parent must already be in the hierarchy (or NullEntity).
+	void Add(ecs::Entity e, const LocalTransform& local, ecs::Entity parent = ecs::NullEntity);
+
+	// Children of e are re-attached to e's parent and keep their world transform.
+	void Remove(ecs::Entity e);
+
+	bool Contains(ecs::Entity e) const { return NodeOf(e) != InvalidNode; }
+
+	ecs::Entity GetParent(ecs::Entity e) const;
+
+	// Removes every node.
+	void Clear();
+
+	// Re-parents e and keeps its world transform, or its local transform if
+	// keepWorld is false. Returns false if the new parent is e itself or one of
+	// its descendants.
+	bool SetParent(ecs::Entity e, ecs::Entity parent, bool keepWorld = true);
+
+	const LocalTransform& GetLocal(ecs::Entity e) const { return mLocal[NodeOf(e)]; }
+
+	void SetLocal(ecs::Entity e, const LocalTransform& local);
+
+	// Valid as of the last Update().
+	const XMFLOAT4X4& GetWorld(ecs::Entity e) const { return mWorld[NodeOf(e)]; }
+
+	// Recomputes the world matrices of the dirty nodes and their descendants.
+	void Update();
+
+	// Nodes whose world matrix changed in the last Update().
+	const std::vector<uint32_t>& GetChangedNodes() const { return mChanged; }
+
+	ecs::Entity NodeEntity(uint32_t node) const { return mEntity[node]; }
+	const XMFLOAT4X4& NodeWorld(uint32_t node) const { return mWorld[node]; }
+
+	size_t Size() const { return mEntity.size() - mRemovedCount; }
+
+	size_t LevelCount() const { return mLevelEnd.size(); }
+
+private:
+	uint32_t NodeOf(ecs::Entity e) const;
+
+	// Nearest ancestor of the node that has not been removed.
+	uint32_t LiveParent(uint32_t node) const;
+
+	XMMATRIX XM_CALLCONV ParentWorld(uint32_t node) const;
+
+	// Drops removed nodes and re-sorts the nodes by depth.
+	void Rebuild();
+
+	// SoA node data. Sorted by depth unless mOrderDirty is set.
+	std::vector<LocalTransform> mLocal;
+	std::vector<XMFLOAT4X4>     mWorld;
+	std::vector<uint32_t>       mParent;
+	std::vector<ecs::Entity>    mEntity;   // NullEntity for removed nodes
+	std::vector<uint8_t>        mDirty;
+
+	// Exclusive end of each depth level in the sorted arrays.
+	std::vector<uint32_t> mLevelEnd;
+
+	// ecs::EntityIndex -> node
+	std::vector<uint32_t> mNodeOfEntity;
+
+	std::vector<uint32_t> mChanged;
+
+	size_t mRemovedCount = 0;
+	bool mOrderDirty = false;
+	bool mAnyDirty = false;
+};
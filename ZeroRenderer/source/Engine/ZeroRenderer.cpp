@@ -1,12 +1,18 @@
 #include "ZeroRenderer.h"
 #include <windowsx.h>
+#include <chrono>
 #include "ResourceUploadBatch.h"
 #include "DDSTextureLoader.h"
 #include "WICTextureLoader.h"
 
+#include "../Utility/JobSystem.h"
+
 const int gNumFrameResources = 3;
 
-const int maxObjectNum = 100;
+// Passes are split into lists of at least this many draws.
+const uint32_t gMinDrawsPerList = 64;
+
+const char* sceneFilePath = "asset\\scene.zscn";
 
 const int mouseMoveSensity = 1;
 
@@ -35,6 +41,8 @@ bool ZeroRenderer::Initialize()
 {
 	if (!D3DApp::Initialize()) return false;
 
+	mFramePacer = std::make_unique<FramePacer>(mFence.Get(), gNumFrameResources);
+
 	// Reset the command list to prepare for initialization commands.
 	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
@@ -60,8 +68,13 @@ bool ZeroRenderer::Initialize()
 	BuildModelGeometry("asset\\models\\Squirtle.txt", "squirtle", "squiGeo", false, false);
 	BuildModelGeometry("asset\\models\\marry.txt", "marry", "marryGeo", true, true);
 	BuildModelGeometry("asset\\models\\cow.txt", "cow", "cowGeo", true, true);
+	for (auto& [name, geo] : mGeometries)
+		BuildSubmeshBVHs(*geo);
 	BuildMaterials();
-	BuildRenderItems();
+	if (!LoadScene())
+		BuildRenderItems();
+	if (enable_static_batching)
+		mStaticBatcher.Build(*mScene, md3dDevice.Get(), mCommandList.Get());
 	BuildFrameResources();
 
 	// Setup Platform/Renderer backends
@@ -82,6 +95,14 @@ bool ZeroRenderer::Initialize()
 
 	ssaoPass->GetSsao()->SetPSOs(psoManager->GetPipelineState("ssao"), psoManager->GetPipelineState("ssaoBlur"));
 
+	mSceneBuffer = std::make_unique<GpuSceneBuffer>(md3dDevice.Get(), shaderManager->mShaders["sceneScatterCS"].Get(),
+		(UINT)sizeof(ObjectData), (UINT)sizeof(MaterialData));
+	for (RenderPass* pass : { (RenderPass*)shadowPass.get(), (RenderPass*)ssaoPass.get(), (RenderPass*)mainPass.get() })
+		pass->SetSceneBuffer(mSceneBuffer.get());
+
+	mGraphResources = std::make_unique<RenderGraphResources>(md3dDevice.Get());
+	BuildRenderGraph();
+
 	// Execute the initialization commands.
 	ThrowIfFailed(mCommandList->Close());
 	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
@@ -90,6 +111,8 @@ bool ZeroRenderer::Initialize()
 	// Wait until initialization is complete.
 	FlushCommandQueue();
 
+	mStaticBatcher.DisposeUploaders();
+
 	return true;
 }
 
@@ -102,9 +125,35 @@ void ZeroRenderer::OnResize()
 	if (ssaoPass != nullptr && ssaoPass->GetSsao() != nullptr)
 	{
 		ssaoPass->GetSsao()->OnResize(mClientWidth, mClientHeight);
-
-		ssaoPass->GetSsao()->RebuildDescriptors(mDepthStencilBuffer.Get());
 	}
+
+	// The SSAO maps follow the window size and the depth buffer is new.
+	if (mGraphResources != nullptr)
+		BuildRenderGraph();
+}
+
+void ZeroRenderer::BuildRenderGraph()
+{
+	mRenderGraph.Clear();
+	mFrameTargets = FrameTargets();
+	mFrameTargets.BackBuffer = mRenderGraph.Import("BackBuffer", D3D12_RESOURCE_STATE_PRESENT);
+	mFrameTargets.DepthStencil = mRenderGraph.Import("DepthStencil", D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+	// In the order they run. The shadow map comes after the SSAO passes so it
+	// can take over the memory of the normal map and a blur target.
+	RenderPass* passes[] = { ssaoPass.get(), shadowPass.get(), mainPass.get() };
+	for (RenderPass* pass : passes)
+		pass->Declare(mRenderGraph, mFrameTargets, md3dDevice.Get());
+
+	mRenderGraph.Compile();
+
+	// D3DApp::OnResize flushed the queue; nothing in flight uses the old ones.
+	mGraphResources->Realize(mRenderGraph);
+	mGraphResources->SetImported(mFrameTargets.DepthStencil, mDepthStencilBuffer.Get());
+	for (RenderPass* pass : passes)
+		pass->AttachResources(*mGraphResources);
+
+	ssaoPass->GetSsao()->RebuildDescriptors(mDepthStencilBuffer.Get());
 }
 
 //
@@ -113,22 +162,19 @@ void ZeroRenderer::OnResize()
 
 void ZeroRenderer::Update(const GameTimer& gt)
 {
-	OnKeyboardInput(gt);
-
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
 	mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
 
-	// Has the GPU finished processing the commands of the current frame resource?
-	// If not, wait until the GPU has completed commands up to this fence point.
-	if (mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
-	{
-		HANDLE eventHandle = CreateEventEx(nullptr, nullptr, false, EVENT_ALL_ACCESS);
-		ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
-		WaitForSingleObject(eventHandle, INFINITE);
-		CloseHandle(eventHandle);
-	}
+	// Waits until the GPU is done with the frame resource and the frames in
+	// flight are within the limit, and with pacing sleeps until the input
+	// should be read, so everything from here on sees the freshest input.
+	mFramePacer->BeginFrame(mCurrFrameResource->Fence);
+
+	OnKeyboardInput(gt);
+
+	// The GPU is done with everything the frame resource uploaded.
+	mCurrFrameResource->Uploads->Reset();
 
-	mainPass->buffer = CurrentBackBuffer();
 	mainPass->rtvHandle = CurrentBackBufferView();
 	mainPass->dsvHandle = DepthStencilView();
 	mainPass->mScreenViewport = mScreenViewport;
@@ -139,8 +185,7 @@ void ZeroRenderer::Update(const GameTimer& gt)
 	mainPass->DeltaTime = gt.DeltaTime();
 
 	AnimateMaterials(gt);
-	UpdateObjectCBs(gt);
-	UpdateMaterialBuffer(gt);
+	mScene->UpdateTransforms();
 	mainPass->Update(mCurrFrameResource, mCamera);
 	shadowPass->Update(mCurrFrameResource, mCamera);
 	ssaoPass->Update(mCurrFrameResource, mCamera);
@@ -176,11 +221,115 @@ void ZeroRenderer::DrawImGui()
 
 		ImGui::Text("\nApplication average %.3f ms/frame (%.1f FPS)\n", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
-		if (show_style) ImGui::ShowStyleEditor();
+		// frames in flight and latency, see FrameScheduler
+		FrameScheduler& scheduler = mFramePacer->Scheduler();
+		int framesInFlight = scheduler.GetFramesInFlight();
+		if (ImGui::SliderInt("Frames In Flight", &framesInFlight, 1, gNumFrameResources))
+			scheduler.SetFramesInFlight(framesInFlight);
+		bool pacing = scheduler.GetPacing();
+		if (ImGui::Checkbox("Latency Pacing", &pacing))
+			scheduler.SetPacing(pacing);
+		ImGui::SameLine();
+		float targetLatency = float(scheduler.GetTargetLatency() * 1000.0);
+		if (ImGui::SliderFloat("Target (ms)", &targetLatency, 0.0f, 50.0f))
+			scheduler.SetTargetLatency(targetLatency / 1000.0);
+		ImGui::Checkbox("VSync", &enable_vsync);
+		ImGui::Text("CPU %.2f ms, GPU %.2f ms, latency %.2f ms; waited %.2f ms, slept %.2f ms",
+			scheduler.GetCpuTime() * 1000.0, scheduler.GetGpuTime() * 1000.0, scheduler.GetLatency() * 1000.0,
+			mFramePacer->GetWaitMilliseconds(), mFramePacer->GetSleepMilliseconds());
+
+		// visible / tested items of each pass in the last frame
+		for (auto [name, pass] : { std::pair<const char*, RenderPass*>{ "Shadow", shadowPass.get() },
+			{ "Ssao", ssaoPass.get() }, { "Main", mainPass.get() } })
+		{
+			const VisibleSet& visible = pass->GetVisibleSet();
+			float skipped = visible.TotalCount ? 100.0f * (visible.TotalCount - visible.TestedCount) / visible.TotalCount : 0.0f;
+			ImGui::Text("%s culling: %u / %u visible, %.0f%% tests skipped, %.3f ms",
+				name, visible.VisibleCount, visible.TotalCount, skipped, visible.CullMilliseconds);
+			ImGui::Text("    %u draws in %u calls for %u instances, sorted in %.3f ms",
+				pass->GetDrawCount(), pass->GetCallCount(), pass->GetInstanceCount(), pass->GetSortMilliseconds());
+			if (visible.PvsCulledCount)
+				ImGui::Text("    %u hidden by the PVS", visible.PvsCulledCount);
+			if (visible.OccludedCount || visible.OcclusionMilliseconds > 0.0f)
+				ImGui::Text("    %u occluded, %.3f ms", visible.OccludedCount, visible.OcclusionMilliseconds);
+		}
+
+		ImGui::Checkbox("ExecuteIndirect", &enable_indirect_draws);
+
+		ImGui::Text("Scene uploads: %u records in %u packets, %.1f KB of a %.1f MB buffer",
+			mSceneBuffer->GetRecordCount(), mSceneBuffer->GetPacketCount(),
+			mSceneBuffer->GetUploadBytes() / 1024.0f, mSceneBuffer->GetSize() / (1024.0f * 1024.0f));
+
+		// The last frame is recorded in full; the current one is not yet.
+		const UploadAllocator* lastUploads =
+			mFrameResources[(mCurrFrameResourceIndex + gNumFrameResources - 1) % gNumFrameResources]->Uploads.get();
+		ImGui::Text("Frame upload memory: %.1f KB of %.1f KB",
+			lastUploads->GetUsedBytes() / 1024.0f, lastUploads->GetSize() / 1024.0f);
+
+		ImGui::Checkbox("Parallel Recording", &enable_parallel_recording);
+		ImGui::Text("Command lists: %u, recorded in %.3f ms",
+			mFrameResources[(mCurrFrameResourceIndex + gNumFrameResources - 1) % gNumFrameResources]->CommandLists->Count(),
+			record_milliseconds);
+
+		// state changes of the last frame, over all of its lists
+		const CommandRecorder::Stats& commands = mRecorderStats;
+		ImGui::Text("State changes: %u issued, %u redundant ones filtered",
+			commands.TotalIssued(), commands.TotalFiltered());
+		for (int call = 0; call < (int)CommandRecorder::Call::Count; ++call)
+		{
+			if (commands.Issued[call] || commands.Filtered[call])
+				ImGui::Text("    %s: %u issued, %u filtered", CommandRecorder::CallName((CommandRecorder::Call)call),
+					commands.Issued[call], commands.Filtered[call]);
+		}
+
+		ImGui::Text("Render graph: %u passes, %u culled, %u barriers",
+			mRenderGraph.GetPassCount(), mRenderGraph.GetCulledCount(), (UINT)mRenderGraph.GetBarriers().size());
+		ImGui::Text("    transient heap %.1f MB, %.1f MB without aliasing",
+			mRenderGraph.GetHeapSize() / (1024.0f * 1024.0f), mRenderGraph.GetTransientSize() / (1024.0f * 1024.0f));
+
+		ImGui::Checkbox("PVS", &enable_pvs);
+		ImGui::SameLine();
+		ImGui::SliderFloat("Cell Size", &pvs_cell_size, 1.0f, 16.0f);
+		if (ImGui::Button("Bake PVS"))
+			mScene->BakePVS(pvs_cell_size, 32);
+		ImGui::SameLine();
+		if (ImGui::Button("Clear PVS"))
+			mScene->ClearPVS();
+
+		const PotentiallyVisibleSet& pvs = mScene->GetPVS();
+		if (!pvs.Empty())
+		{
+			ImGui::Text("PVS: %u cells, %u distinct sets of %u items, %.1f KB, baked in %.0f ms",
+				pvs.CellCount(), pvs.SetCount(), pvs.ItemCount(), pvs.CompressedBytes() / 1024.0f, pvs.BakeMilliseconds());
+		}
+
+		if (ImGui::Button("Save Scene"))
+			scene_file_status = SceneSerializer::Save(sceneFilePath, *mScene, *matManager) ? "Scene saved" : "Saving the scene failed";
+		ImGui::SameLine();
+		if (ImGui::Button("Load Scene"))
+			LoadScene();
+		if (scene_file_status)
+			ImGui::Text("%s, last load took %.3f ms", scene_file_status, scene_load_milliseconds);
+
+		if (ImGui::Checkbox("Static Batching", &enable_static_batching))
+			mScene->SetStaticBatchesStale(true);
+		const StaticBatcher::Stats& batches = mStaticBatcher.GetStats();
+		if (batches.BatchCount)
+		{
+			ImGui::Text("Static batches: %u items in %u batches, opaque draws %u -> %u, %.1f KB, built in %.3f ms",
+				batches.ItemCount, batches.BatchCount, batches.DrawsBefore, batches.DrawsAfter,
+				batches.BufferBytes / 1024.0f, batches.BuildMilliseconds);
+		}
+
+		ImGui::Checkbox("Occlusion Culling", &enable_occlusion_culling);
+		if (enable_occlusion_culling)
+		{
+			ImGui::Text("Occluders: %u, %u / %u triangles rasterized, %.3f ms",
+				mOcclusionBuffer.OccluderCount(), mOcclusionBuffer.RasterizedCount(),
+				mOcclusionBuffer.TriangleCount(), mOcclusionBuffer.RenderMilliseconds());
+		}
 
-		static float pos_x = 0.0f;
-		static float pos_y = 0.0f;
-		static float pos_z = 0.0f;
+		if (show_style) ImGui::ShowStyleEditor();
 
 		static XMFLOAT3 obj_rotate_axis = { 0.0f, 1.0f, 0.0f };
 		static float obj_rotate_angle = 0.0f;
@@ -188,14 +337,12 @@ void ZeroRenderer::DrawImGui()
 		static XMFLOAT3 last_obj_rotate_axis = { 0.0f, 1.0f, 0.0f };
 		static float last_obj_rotate_angle = 0.0f;
 
-		if (mPickedRitem)
+		if (mScene->GetHierarchy().Contains(mPickedRitem))
 		{
-			ImGui::Text("\nChange Position and Orientation of the Picked\n");
+			ImGui::Text("\nChange Position, Orientation and Scale of the Picked\n");
 
-			XMMATRIX world_matrix = XMLoadFloat4x4(&mPickedRitem->World);
-			pos_x = mPickedRitem->World._41;
-			pos_y = mPickedRitem->World._42;
-			pos_z = mPickedRitem->World._43;
+			LocalTransform local = mScene->GetLocalTransform(mPickedRitem);
+			bool local_changed = false;
 
 			// rotation
 			ImGui::InputFloat3("rotate axis", (float*)&(obj_rotate_axis));
@@ -210,28 +357,63 @@ void ZeroRenderer::DrawImGui()
 					XMLoadFloat3(&last_obj_rotate_axis),
 					XMConvertToRadians(last_obj_rotate_angle))))
 			{
-				XMStoreFloat4x4(
-					&(mPickedRitem->World),
-					XMMatrixRotationQuaternion(
-						Quaternion(
-							XMLoadFloat3(&obj_rotate_axis),
-							XMConvertToRadians(obj_rotate_angle))) *
-					world_matrix
-				);
+				local.SetRotation(
+					local.GetRotation() *
+					Quaternion(
+						XMLoadFloat3(&obj_rotate_axis),
+						XMConvertToRadians(obj_rotate_angle)));
+				local_changed = true;
 			}
 			
-			// translation
-			ImGui::SliderFloat("X_Pos", &pos_x, -50.f, 50.f);
-			ImGui::SliderFloat("Y_Pos", &pos_y, -50.f, 50.f);
-			ImGui::SliderFloat("Z_Pos", &pos_z, -50.f, 50.f);
-			mPickedRitem->World._41 = pos_x;
-			mPickedRitem->World._42 = pos_y;
-			mPickedRitem->World._43 = pos_z;
+			// translation (relative to the parent)
+			local_changed |= ImGui::SliderFloat("X_Pos", &local.Translation.x, -50.f, 50.f);
+			local_changed |= ImGui::SliderFloat("Y_Pos", &local.Translation.y, -50.f, 50.f);
+			local_changed |= ImGui::SliderFloat("Z_Pos", &local.Translation.z, -50.f, 50.f);
+
+			local_changed |= ImGui::InputFloat3("scale", (float*)&(local.Scale));
 
-			mPickedRitem->NumFramesDirty = gNumFrameResources;
+			if (local_changed)
+				mScene->SetLocalTransform(mPickedRitem, local);
 
 			last_obj_rotate_axis = obj_rotate_axis;
 			last_obj_rotate_angle = obj_rotate_angle;
+
+			// hierarchy
+			ecs::Entity parent = mScene->GetHierarchy().GetParent(mPickedRitem);
+			ImGui::Text("\nParent: %s", parent == ecs::NullEntity ? "none" : "attached");
+
+			if (mScene->GetHierarchy().Contains(mLastPickedRitem) && mLastPickedRitem != mPickedRitem)
+			{
+				if (ImGui::Button("Attach To Last Picked"))
+					mScene->SetParent(mPickedRitem, mLastPickedRitem);
+			}
+
+			if (parent != ecs::NullEntity && ImGui::Button("Detach"))
+				mScene->SetParent(mPickedRitem, ecs::NullEntity);
+
+			auto mesh = mScene->GetWorld().Get<MeshComponent>(mPickedRitem);
+			if (mesh && mesh->BVH)
+			{
+				ImGui::Text("\nTriangles: %zu, BVH nodes: %zu, build %.2f ms",
+					mesh->BVH->TriangleCount(), mesh->BVH->NodeCount(), mesh->BVH->BuildMilliseconds());
+
+				// moves the item to another archetype; 'mesh' is stale afterwards
+				bool occluder = mScene->IsOccluder(mPickedRitem);
+				if (ImGui::Checkbox("Occluder", &occluder))
+					mScene->SetOccluder(mPickedRitem, occluder);
+			}
+
+			bool isStatic = mScene->IsStatic(mPickedRitem);
+			if (ImGui::Checkbox("Static", &isStatic))
+				mScene->SetStatic(mPickedRitem, isStatic);
+
+			if (ImGui::Button("Delete Picked"))
+			{
+				mScene->DestroyRenderItem(mPickedRitem);
+				if (mLastPickedRitem == mPickedRitem)
+					mLastPickedRitem = ecs::NullEntity;
+				mPickedRitem = ecs::NullEntity;
+			}
 		}
 
 		ImGui::End();
@@ -277,45 +459,42 @@ void ZeroRenderer::DrawImGui()
 
 		if (ImGui::Button("CreateItem"))
 		{
-			// Ƴ
-			if (mScene->GetRitemSize() + 1 <= maxObjectNum)
-			{
-				MeshGeometry* general_geo;
-				if (shape_item < 4)
-					general_geo = mGeometries["shapeGeo"].get();
-				else if (shape_item == 4)
-					general_geo = mGeometries["marryGeo"].get();
-				else if (shape_item == 5)
-					general_geo = mGeometries["squiGeo"].get();
-				else if(shape_item == 6)
-					general_geo = mGeometries["pikaGeo"].get();
-				else
-					general_geo = mGeometries["cowGeo"].get();
-
-				mScene->CreateRenderItem(
-					static_cast<RenderLayer>(layer),
-					/* first scale, rotate, then translation */
-					XMMatrixScaling(world_scale.x, world_scale.y, world_scale.z) * 
-					XMMatrixRotationQuaternion(Quaternion(XMLoadFloat3(&rotate_axis), XMConvertToRadians(rotate_angle))) *
-					XMMatrixTranslation(world_pos.x, world_pos.y, world_pos.z),
-					XMMatrixScaling(tex_transform.x, tex_transform.y, tex_transform.z),
-					matManager->GetMaterial(material_items[material_item]),
-					general_geo,
-					general_geo->DrawArgs[shape_items[shape_item]].IndexCount,
-					general_geo->DrawArgs[shape_items[shape_item]].StartIndexLocation,
-					general_geo->DrawArgs[shape_items[shape_item]].BaseVertexLocation,
-					general_geo->DrawArgs[shape_items[shape_item]].Bounds
-				);
-			}
+			MeshGeometry* general_geo;
+			if (shape_item < 4)
+				general_geo = mGeometries["shapeGeo"].get();
+			else if (shape_item == 4)
+				general_geo = mGeometries["marryGeo"].get();
+			else if (shape_item == 5)
+				general_geo = mGeometries["squiGeo"].get();
+			else if(shape_item == 6)
+				general_geo = mGeometries["pikaGeo"].get();
+			else
+				general_geo = mGeometries["cowGeo"].get();
+
+			mScene->CreateRenderItem(
+				static_cast<RenderLayer>(layer),
+				/* first scale, rotate, then translation */
+				XMMatrixScaling(world_scale.x, world_scale.y, world_scale.z) * 
+				XMMatrixRotationQuaternion(Quaternion(XMLoadFloat3(&rotate_axis), XMConvertToRadians(rotate_angle))) *
+				XMMatrixTranslation(world_pos.x, world_pos.y, world_pos.z),
+				XMMatrixScaling(tex_transform.x, tex_transform.y, tex_transform.z),
+				matManager->GetMaterial(material_items[material_item]),
+				general_geo,
+				general_geo->DrawArgs[shape_items[shape_item]].IndexCount,
+				general_geo->DrawArgs[shape_items[shape_item]].StartIndexLocation,
+				general_geo->DrawArgs[shape_items[shape_item]].BaseVertexLocation,
+				general_geo->DrawArgs[shape_items[shape_item]].Bounds
+			);
 		}
 
 		if (ImGui::Button("DeleteLastItem"))
 		{
-			if ((mScene->GetRenderLayer(RenderLayer(layer))[mScene->GetRenderLayerSize(layer)-1] == mPickedRitem))
-			{
-				mPickedRitem = nullptr;
-			}
-			mScene->DeleteLastRenderItem(RenderLayer(layer));
+			ecs::Entity last = mScene->GetLastRenderItem(RenderLayer(layer));
+			if (last == mPickedRitem)
+				mPickedRitem = ecs::NullEntity;
+			if (last == mLastPickedRitem)
+				mLastPickedRitem = ecs::NullEntity;
+			mScene->DestroyRenderItem(last);
 		}
 
 		ImGui::End();
@@ -326,43 +505,163 @@ void ZeroRenderer::DrawImGui()
 
 void ZeroRenderer::PopulateCommandList(const GameTimer& gt)
 {
-	auto cmdListHandle = mCurrFrameResource->Command();
+	//************************ Culling ***********************************
 
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+	shadowPass->Cull(mScene.get());
+	ssaoPass->Cull(mScene.get());
+	mainPass->Cull(mScene.get());
+
+	// The camera passes also skip what is hidden behind the occluders. Inside
+	// the baked cells the PVS answers that without rendering the occluders.
+	XMFLOAT3 eye = mCamera.GetPosition3f();
+	bool inPvs = enable_pvs && ssaoPass->PvsCull(mScene.get(), eye);
+	if (inPvs)
+		mainPass->PvsCull(mScene.get(), eye);
+
+	if (!inPvs && enable_occlusion_culling)
+	{
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixMultiply(mCamera.GetView(), mCamera.GetProj()));
+		mScene->RenderOcclusion(viewProj, mOcclusionBuffer);
+
+		ssaoPass->OcclusionCull(mScene.get(), mOcclusionBuffer);
+		mainPass->OcclusionCull(mScene.get(), mOcclusionBuffer);
+	}
+
+	for (RenderPass* pass : { (RenderPass*)shadowPass.get(), (RenderPass*)ssaoPass.get(), (RenderPass*)mainPass.get() })
+		pass->SetDrawSignature(enable_indirect_draws ? mDrawSignature.Get() : nullptr);
+
+	RenderContext context;
+	context.Frame = mCurrFrameResource;
+	context.SrvHeap = mSrvDescriptorHeap.Get();
+	context.NullSrv = mNullSrv;
+	context.RootSignature = mRootSignature.Get();
+	context.SsaoRootSignature = mSsaoRootSignature.Get();
+	context.Psos = psoManager.get();
+	context.CurrentScene = mScene.get();
+	context.Graph = mGraphResources.get();
+
+	// The swap chain hands out a different back buffer each frame.
+	mGraphResources->SetImported(mFrameTargets.BackBuffer, CurrentBackBuffer());
+
+	//************************ Prepare ***********************************
+
+	// Each pass sorts its own draws and writes them to the upload memory.
+	// Listed in the order the render graph runs them.
+	RenderPass* passes[] = { ssaoPass.get(), shadowPass.get(), mainPass.get() };
+	JobSystem::getInstance().ParallelFor(_countof(passes), 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+			passes[i]->Prepare(context);
+	});
 
 	//************************ Render Pass *******************************
 
-	shadowPass->Render(
-		mCommandList, mCurrFrameResource, mSrvDescriptorHeap,
-		mNullSrv, mRootSignature, psoManager.get(), mScene.get());
+	auto recordStart = std::chrono::steady_clock::now();
+
+	// The scene buffer upload, then the passes in the order they run, each
+	// split into ranges of draws on lists of their own.
+	mRecordRanges.clear();
+	mRecordRanges.push_back({});
+
+	uint32_t threadCount = JobSystem::getInstance().ThreadCount();
+	for (RenderPass* pass : passes)
+	{
+		// Nothing later reads what a culled pass writes.
+		if (mRenderGraph.IsCulled(pass->GetGraphPass()))
+			continue;
+
+		uint32_t draws = pass->GetPreparedDrawCount();
+		uint32_t ranges = enable_parallel_recording ?
+			std::clamp((draws + gMinDrawsPerList - 1) / gMinDrawsPerList, 1u, threadCount) : 1u;
+		for (uint32_t i = 0; i < ranges; ++i)
+			mRecordRanges.push_back({ pass, draws * i / ranges, draws * (i + 1) / ranges, i == 0, i == ranges - 1 });
+	}
+
+	// One list per range, or a single one for everything when recording on
+	// this thread alone.
+	UINT listCount = enable_parallel_recording ? (UINT)mRecordRanges.size() : 1;
+	CommandListPool& lists = *mCurrFrameResource->CommandLists;
+	lists.Reset(listCount);
+	mRecorders.resize(listCount);
+
+	auto record = [&](UINT list, size_t firstRange, size_t lastRange)
+	{
+		auto cmdListHandle = lists.Open(list);
+
+		CommandRecorder& recorder = mRecorders[list];
+		recorder.Begin(cmdListHandle.CmdList());
+
+		ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
+		recorder.SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+		for (size_t i = firstRange; i < lastRange; ++i)
+		{
+			const RecordRange& range = mRecordRanges[i];
+			if (range.Pass == nullptr)
+			{
+				// The frame's changes reach the scene buffer before anything reads it.
+				mSceneBuffer->Flush(recorder.Get(), *mCurrFrameResource->Uploads);
+				recorder.Invalidate();
+				continue;
+			}
 
-	ssaoPass->Render(
-		mCommandList, mCurrFrameResource, mSrvDescriptorHeap,
-		mNullSrv, mSsaoRootSignature, psoManager.get(), mScene.get());
+			if (range.First)
+				range.Pass->BeginPass(recorder, context);
+			range.Pass->BindState(recorder, context);
+			range.Pass->RecordDraws(recorder, range.Begin, range.End);
+			if (range.Last)
+				range.Pass->EndPass(recorder, context);
+		}
+	};
 
-	mainPass->Render(
-		mCommandList, mCurrFrameResource, mSrvDescriptorHeap,
-		mNullSrv, mRootSignature, psoManager.get(), mScene.get());
+	if (enable_parallel_recording)
+	{
+		JobSystem::getInstance().ParallelFor(listCount, 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++i)
+				record(i, i, i + 1);
+		});
+	}
+	else
+	{
+		record(0, 0, mRecordRanges.size());
+	}
+
+	mRecorderStats = CommandRecorder::Stats();
+	for (UINT i = 0; i < listCount; ++i)
+		mRecorderStats += mRecorders[i].GetStats();
+
+	record_milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
 }
 
 // Sync
 void ZeroRenderer::SubmitCommandList(const GameTimer& gt)
 {
-	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	// One submission, in the order the lists were laid out.
+	mCurrFrameResource->CommandLists->Execute(mCommandQueue.Get());
 
-	ThrowIfFailed(mSwapChain->Present(0, 0));
+	ThrowIfFailed(mSwapChain->Present(enable_vsync ? 1 : 0, 0));
 	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
 
 	mCurrFrameResource->Fence = ++mCurrentFence;
 
 	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+
+	mFramePacer->EndFrame(mCurrentFence);
 }
 
 void ZeroRenderer::Draw(const GameTimer& gt)
 {
 	DrawImGui();
+
+	if (mScene->StaticBatchesStale())
+		RebuildStaticBatches();
+
+	// After the UI, so items it created are uploaded before they are drawn.
+	UpdateObjectData(gt);
+	UpdateMaterialBuffer(gt);
+
 	PopulateCommandList(gt);
 	SubmitCommandList(gt);
 }
@@ -440,11 +739,7 @@ void ZeroRenderer::OnKeyboardInput(const GameTimer& gt)
 			shadowPass->mBaseLightDirections[0].y -= 1.0f * dt;
 
 		if (GetAsyncKeyState('R') & 0x8000)
-			if (mPickedRitem)
-			{
-				mPickedRitem->Visible = true;
-				mPickedRitem = nullptr;
-			}
+			mPickedRitem = ecs::NullEntity;
 
 		mCamera.UpdateViewMatrix();
 	}
@@ -455,18 +750,31 @@ void ZeroRenderer::AnimateMaterials(const GameTimer& gt)
 
 }
 
-void ZeroRenderer::UpdateObjectCBs(const GameTimer& gt)
+void ZeroRenderer::UpdateObjectData(const GameTimer& gt)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
+	mScene->CompactObjectIndices();
+	mScene->UpdateObjectData();
+
+	// Both regions are sized before any record is written; a recreated
+	// buffer needs every record again.
+	const auto& objects = mScene->GetObjectData();
+	auto& uploads = mScene->GetObjectUploads();
+	if (mSceneBuffer->Reserve(md3dDevice.Get(), (UINT)objects.size(), matManager->GetBufferSize()))
+	{
+		uploads.MarkAll((uint32_t)objects.size());
+		matManager->MarkAllDirty();
+	}
 
-	mScene->UpdateObjectCBs(currObjectCB);
+	uploads.Drain(0, [&](uint32_t index)
+	{
+		if (index < objects.size())
+			mSceneBuffer->Write(GpuSceneBuffer::Region::Objects, index, &objects[index]);
+	});
 }
 
 void ZeroRenderer::UpdateMaterialBuffer(const GameTimer& gt)
 {
-	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
-
-	matManager->UpdateMaterialBuffer(currMaterialBuffer);
+	matManager->UpdateMaterialBuffer(*mSceneBuffer);
 }
 
 void ZeroRenderer::LoadTextures()
@@ -534,19 +842,21 @@ void ZeroRenderer::BuildRootSignature()
 	texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 10, 3, 0);
 
 	// Root parameter can be a table, root descriptor or root constants.
-	CD3DX12_ROOT_PARAMETER slotRootParameter[5];
+	CD3DX12_ROOT_PARAMETER slotRootParameter[7];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
-	slotRootParameter[0].InitAsConstantBufferView(0);
+	slotRootParameter[0].InitAsShaderResourceView(1, 1);   // object index of each instance
 	slotRootParameter[1].InitAsConstantBufferView(1);
 	slotRootParameter[2].InitAsShaderResourceView(0, 1);
 	slotRootParameter[3].InitAsDescriptorTable(1, &texTable0, D3D12_SHADER_VISIBILITY_PIXEL);
 	slotRootParameter[4].InitAsDescriptorTable(1, &texTable1, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[RenderPass::InstanceBaseRootParameter].InitAsConstants(1, 0);   // first instance of the draw
+	slotRootParameter[RenderPass::ObjectBufferRootParameter].InitAsShaderResourceView(2, 1);
 
 	auto staticSamplers = GlobalSamplers::GetSamplers();;
 
 	// A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(5, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(7, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -567,6 +877,15 @@ void ZeroRenderer::BuildRootSignature()
 		serializedRootSig->GetBufferPointer(),
 		serializedRootSig->GetBufferSize(),
 		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+
+	// Indirect draws set the instance base root constant, so the signature
+	// needs the root signature.
+	mDrawLayout = DrawLayout(RenderPass::InstanceBaseRootParameter);
+	D3D12_COMMAND_SIGNATURE_DESC drawSignatureDesc = mDrawLayout.Desc();
+	ThrowIfFailed(md3dDevice->CreateCommandSignature(
+		&drawSignatureDesc,
+		mRootSignature.Get(),
+		IID_PPV_ARGS(mDrawSignature.GetAddressOf())));
 }
 
 void ZeroRenderer::BuildSsaoRootSignature()
@@ -1026,12 +1345,56 @@ void ZeroRenderer::BuildShapeGeometry()
 	mGeometries[geo->Name] = std::move(geo);
 }
 
+bool ZeroRenderer::LoadScene()
+{
+	// The object and material buffers grow with the scene.
+	SceneSerializer::Limits limits;
+
+	auto start = std::chrono::steady_clock::now();
+	bool loaded = SceneSerializer::Load(sceneFilePath, *mScene, *matManager, mGeometries, limits);
+	scene_load_milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	scene_file_status = loaded ? "Scene loaded" : "Loading the scene failed";
+	if (loaded)
+	{
+		mPickedRitem = ecs::NullEntity;
+		mLastPickedRitem = ecs::NullEntity;
+	}
+	return loaded;
+}
+
+void ZeroRenderer::RebuildStaticBatches()
+{
+	// The old batches may still be drawn by the frames in flight.
+	FlushCommandQueue();
+
+	ThrowIfFailed(mDirectCmdListAlloc->Reset());
+	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
+
+	if (enable_static_batching)
+		mStaticBatcher.Build(*mScene, md3dDevice.Get(), mCommandList.Get());
+	else
+		mStaticBatcher.Clear(*mScene);
+
+	ThrowIfFailed(mCommandList->Close());
+	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+	FlushCommandQueue();
+
+	mStaticBatcher.DisposeUploaders();
+}
+
 void ZeroRenderer::BuildFrameResources()
 {
+	// Room for an instance and an indirect command of every object in each of
+	// the three passes; the frames grow it when they need more.
+	UINT64 uploadSize = 3 * (UINT64)mScene->GetObjectData().size() * (sizeof(UINT) + sizeof(IndirectDrawArguments));
+
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			2, (UINT)maxObjectNum, (UINT)matManager->GetSize(), mCommandList));
+			uploadSize));
 	}
 }
 
@@ -1095,7 +1458,7 @@ void ZeroRenderer::BuildRenderItems()
 			BaseVertexLocation : ڶ㻺е offset
 			PrimitiveType      : ͼԪ (ĬΪ TRIANGLELIST)
 			Bounds
-		ÿ RItem  ObjCBIndex ˳ (0, 1, 2, ...)
+		ÿ RItem  ObjectIndex ˳ (0, 1, 2, ...)
 	*/
 
 	mScene->CreateRenderItem(
@@ -1110,7 +1473,7 @@ void ZeroRenderer::BuildRenderItems()
 		general_geo->DrawArgs["sphere"].Bounds
 	);
 
-	mScene->CreateRenderItem(
+	ecs::Entity ground = mScene->CreateRenderItem(
 		RenderLayer::Opaque,
 		XMMatrixScaling(3.0f, 3.0f, 3.0f),
 		XMMatrixScaling(8.0f, 8.0f, 0.8f),
@@ -1122,6 +1485,10 @@ void ZeroRenderer::BuildRenderItems()
 		general_geo->DrawArgs["grid"].Bounds
 	);
 
+	// The ground hides everything below it and never moves.
+	mScene->SetOccluder(ground, true);
+	mScene->SetStatic(ground, true);
+
 	//mScene->CreateRenderItem(
 	//	RenderLayer::Opaque,
 	//	XMMatrixScaling(4.0f, 4.0f, 4.0f) * XMMatrixTranslation(0.0f, 6.0f, 0.0f),
@@ -1220,72 +1587,21 @@ void ZeroRenderer::Pick(int sx, int sy)
 	float vx = (+2.0f * sx / mClientWidth - 1.0f - 660.f / mClientWidth) / P(0, 0);
 	float vy = (-2.0f * sy / mClientHeight + 1.0f) / P(1, 1);
 
-	// Ray definition in view space.
-	XMVECTOR rayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-	XMVECTOR rayDir = XMVectorSet(vx, vy, 1.0f, 0.0f);
-
 	XMMATRIX V = mCamera.GetView();
 	XMMATRIX invView = XMMatrixInverse(get_rvalue_ptr(XMMatrixDeterminant(V)), V);
 
-	if (mPickedRitem) mPickedRitem->Visible = false;
-	
-	for (const auto& ri : mScene->GetRenderLayer((int)RenderLayer::Opaque))
-	{
-		rayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		rayDir = XMVectorSet(vx, vy, 1.0f, 0.0f);
-
-		auto geo = ri->Geo;
-		if (ri->Visible == false)
-			continue;
-
-		XMMATRIX W = XMLoadFloat4x4(&ri->World);
-		XMMATRIX invWorld = XMMatrixInverse(get_rvalue_ptr(XMMatrixDeterminant(W)), W);
-
-		// Tranform ray to vi space of Mesh.
-		XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
+	// Picking ray in world space.
+	XMVECTOR rayOrigin = XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), invView);
+	XMVECTOR rayDir = XMVector3TransformNormal(XMVectorSet(vx, vy, 1.0f, 0.0f), invView);
 
-		rayOrigin = XMVector3TransformCoord(rayOrigin, toLocal);
-		rayDir = XMVector3TransformNormal(rayDir, toLocal);
-
-		// Make the ray direction unit length for the intersection tests.
-		rayDir = XMVector3Normalize(rayDir);
-
-		float tmin = 0.001f;
-		if (ri->Bounds.Intersects(rayOrigin, rayDir, tmin))
-		{
-			//OutputDebugString(L"InInnerPick\n");
-			if (mPickedRitem) mPickedRitem->Visible = true;
-			mPickedRitem = ri;
-		}
-	}
+	ecs::Entity hit = mScene->RayCast(
+		rayOrigin, rayDir,
+		LayerMask(RenderLayer::Opaque) | LayerMask(RenderLayer::Transparent));
 
-	for (const auto& ri : mScene->GetRenderLayer((int)RenderLayer::Transparent))
+	if (hit != ecs::NullEntity)
 	{
-		rayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		rayDir = XMVectorSet(vx, vy, 1.0f, 0.0f);
-
-		auto geo = ri->Geo;
-		if (ri->Visible == false)
-			continue;
-
-		XMMATRIX W = XMLoadFloat4x4(&ri->World);
-		XMMATRIX invWorld = XMMatrixInverse(get_rvalue_ptr(XMMatrixDeterminant(W)), W);
-
-		// Tranform ray to vi space of Mesh.
-		XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
-
-		rayOrigin = XMVector3TransformCoord(rayOrigin, toLocal);
-		rayDir = XMVector3TransformNormal(rayDir, toLocal);
-
-		// Make the ray direction unit length for the intersection tests.
-		rayDir = XMVector3Normalize(rayDir);
-
-		float tmin = 0.001f;
-		if (ri->Bounds.Intersects(rayOrigin, rayDir, tmin))
-		{
-			//OutputDebugString(L"InInnerPick\n");
-			if (mPickedRitem) mPickedRitem->Visible = true;
-			mPickedRitem = ri;
-		}
+		if (mPickedRitem != ecs::NullEntity && mPickedRitem != hit)
+			mLastPickedRitem = mPickedRitem;
+		mPickedRitem = hit;
 	}
 }
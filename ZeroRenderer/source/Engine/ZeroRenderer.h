@@ -13,6 +13,11 @@
 
 #include "../DXRuntime/FrameResource.h"
 #include "../DXRuntime/CommandListHandle.h"
+#include "../DXRuntime/CommandRecorder.h"
+#include "../DXRuntime/FramePacer.h"
+#include "../DXRuntime/GpuSceneBuffer.h"
+#include "../DXRuntime/IndirectArguments.h"
+#include "../DXRuntime/RenderGraphResources.h"
 
 #include "../Resource/UploadBuffer.h"
 #include "../Resource/Mesh.h"
@@ -29,6 +34,8 @@
 #include "ShadowPass.h"
 #include "SsaoPass.h"
 #include "MainPass.h"
+#include "SceneSerializer.h"
+#include "StaticBatcher.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -59,7 +66,7 @@ private:
 
     void OnKeyboardInput(const GameTimer& gt);
     void AnimateMaterials(const GameTimer& gt);
-    void UpdateObjectCBs(const GameTimer& gt);
+    void UpdateObjectData(const GameTimer& gt);
     void UpdateMaterialBuffer(const GameTimer& gt);
 
     void LoadTextures();
@@ -72,6 +79,16 @@ private:
     void BuildMaterials();
     void BuildRenderItems();
 
+    // Declares the passes into the render graph, compiles it and creates its
+    // transient targets; again whenever the window size changes them.
+    void BuildRenderGraph();
+
+    // Replaces the scene with the saved one; false if there is none that fits.
+    bool LoadScene();
+
+    // Rebuilds (or removes, if disabled) the static batches between frames.
+    void RebuildStaticBatches();
+
     void DrawImGui();
     void PopulateCommandList(const GameTimer& gt);
     void SubmitCommandList(const GameTimer& gt);
@@ -85,9 +102,19 @@ private:
     FrameResource* mCurrFrameResource = nullptr;
     int mCurrFrameResourceIndex = 0;
 
+    // Runs up to gNumFrameResources frames ahead of the GPU, fewer or paced
+    // for latency as set in the UI.
+    std::unique_ptr<FramePacer> mFramePacer;
+    bool enable_vsync = false;
+
     ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
     ComPtr<ID3D12RootSignature> mSsaoRootSignature = nullptr;
 
+    // One ExecuteIndirect per layer and pass when enabled, see RenderPass.
+    IndirectArgumentLayout mDrawLayout;
+    ComPtr<ID3D12CommandSignature> mDrawSignature = nullptr;
+    bool enable_indirect_draws = true;
+
     ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
     std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
@@ -119,7 +146,54 @@ private:
     std::unique_ptr<SsaoPass>   ssaoPass;
     std::unique_ptr<MainPass>   mainPass;
 
+    // The passes of a frame, their barriers and the targets only they use.
+    RenderGraph mRenderGraph;
+    std::unique_ptr<RenderGraphResources> mGraphResources;
+    FrameTargets mFrameTargets;
+
+    // A range of the prepared draws of a pass, recorded into a list of its
+    // own; the first range of a pass begins it, the last one ends it. The
+    // range without a pass uploads the scene buffer.
+    struct RecordRange
+    {
+        RenderPass* Pass = nullptr;
+        uint32_t Begin = 0;
+        uint32_t End = 0;
+        bool First = false;
+        bool Last = false;
+    };
+    std::vector<RecordRange> mRecordRanges;
+
+    // Record the lists of a frame, one each, dropping redundant state changes.
+    std::vector<CommandRecorder> mRecorders;
+    CommandRecorder::Stats mRecorderStats;   // of the last frame
+
+    // Records the ranges on the job system's threads when enabled, else all
+    // of them into one list on this thread.
+    bool enable_parallel_recording = true;
+    float record_milliseconds = 0.0f;
+
+    // Object and material records, shared by the frame resources.
+    std::unique_ptr<GpuSceneBuffer> mSceneBuffer;
+
+    // Occluders rendered from the camera; hides items from the camera passes.
+    OcclusionBuffer mOcclusionBuffer;
+    bool enable_occlusion_culling = true;
+
+    // Potentially visible sets, baked from the UI.
+    bool enable_pvs = true;
+    float pvs_cell_size = 4.0f;
+
+    // Result of the last scene save or load, shown in the UI.
+    const char* scene_file_status = nullptr;
+    float scene_load_milliseconds = 0.0f;
+
+    // Static items merged at load time, rebuilt when the scene changes them.
+    StaticBatcher mStaticBatcher;
+    bool enable_static_batching = true;
+
     bool enable_camera_move = true;
 
-    RenderItem* mPickedRitem = nullptr;
+    ecs::Entity mPickedRitem = ecs::NullEntity;
+    ecs::Entity mLastPickedRitem = ecs::NullEntity;   // parent candidate for the picked item
 };
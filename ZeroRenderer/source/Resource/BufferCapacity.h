@@ -0,0 +1,63 @@
+#pragma once
+
+//
+// Size policy of a buffer that follows how much of it is in use.
+//
+// A buffer grows to the next power of two (times the minimum) as soon as a
+// frame needs more than it holds. It shrinks once no more than a quarter of it
+// was used during a whole window of frames, to the size that holds twice the
+// peak of that window, and never past the size it already has.
+//
+
+#include <algorithm>
+#include <cstdint>
+
+class BufferCapacity
+{
+public:
+	static constexpr uint32_t ShrinkWindow = 256;   // Update calls
+
+	explicit BufferCapacity(uint64_t minimum) : mMinimum(minimum) {}
+
+	// Smallest size of the policy that holds count.
+	uint64_t Fit(uint64_t count) const
+	{
+		uint64_t capacity = mMinimum;
+		while (capacity < count)
+			capacity *= 2;
+		return capacity;
+	}
+
+	// Size for a frame that uses 'used' of a buffer of 'capacity'. Call once
+	// per frame; the window starts over whenever the size changes.
+	uint64_t Update(uint64_t capacity, uint64_t used)
+	{
+		mPeak = std::max(mPeak, used);
+
+		uint64_t wanted = capacity;
+		if (used > capacity)
+		{
+			wanted = Fit(used);
+		}
+		else if (++mFrames >= ShrinkWindow)
+		{
+			if (mPeak <= capacity / 4)
+				wanted = std::min(Fit(2 * mPeak), capacity);
+
+			mFrames = 0;
+			mPeak = used;
+		}
+
+		if (wanted != capacity)
+		{
+			mFrames = 0;
+			mPeak = used;
+		}
+		return wanted;
+	}
+
+private:
+	uint64_t mMinimum;
+	uint64_t mPeak = 0;     // most used in the current window
+	uint32_t mFrames = 0;   // Update calls in the current window
+};
@@ -2,6 +2,8 @@
 
 #include "../Common/d3dUtil.h"
 
+class MeshBVH;
+
 struct SubmeshGeometry
 {
 	UINT IndexCount = 0;
@@ -9,6 +11,9 @@ struct SubmeshGeometry
 	INT BaseVertexLocation = 0;
 
 	DirectX::BoundingBox Bounds;
+
+	// Triangle BVH for exact ray queries, see BuildSubmeshBVHs.
+	std::shared_ptr<MeshBVH> BVH;
 };
 
 /* һ MeshGeometry пܺж SubmeshGeometryͨ map Ӧ */
@@ -0,0 +1,74 @@
+#pragma once
+
+//
+// Copies into write-combined memory, such as mapped upload heaps.
+//
+// The CPU does not cache that memory: it gathers stores in a few
+// write-combining buffers and sends a buffer out when it is full or when it
+// needs it for another line. Filling whole lines in ascending order keeps
+// that to one transfer per line, while small copies scattered over the
+// buffer flush partial lines. Never read the destination back; reads are
+// uncached.
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <emmintrin.h>
+
+// Copies byteCount bytes with non-temporal stores, 16-byte blocks in
+// ascending order. Call StreamFence after the last copy of a batch.
+inline void StreamCopy(void* dest, const void* src, size_t byteCount)
+{
+	auto d = static_cast<uint8_t*>(dest);
+	auto s = static_cast<const uint8_t*>(src);
+
+	// Plain stores up to the first 16-byte boundary of the destination.
+	size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+	if (head > byteCount)
+		head = byteCount;
+	std::memcpy(d, s, head);
+	d += head;
+	s += head;
+	byteCount -= head;
+
+	// A cache line per iteration.
+	for (; byteCount >= 64; d += 64, s += 64, byteCount -= 64)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+		__m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d), a);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), b);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), c);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), e);
+	}
+
+	for (; byteCount >= 16; d += 16, s += 16, byteCount -= 16)
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d), _mm_loadu_si128(reinterpret_cast<const __m128i*>(s)));
+
+	std::memcpy(d, s, byteCount);
+}
+
+// Runs shorter than a page are copied with plain stores, which the
+// write-combining buffers merge as well as long as they ascend.
+constexpr size_t MinStreamBytes = 4096;
+
+// Copies byteCount bytes the way that suits their size. Call StreamFence
+// after the last copy of a batch.
+inline void WriteCombinedCopy(void* dest, const void* src, size_t byteCount)
+{
+	if (byteCount >= MinStreamBytes)
+		StreamCopy(dest, src, byteCount);
+	else if (byteCount > 0)
+		std::memcpy(dest, src, byteCount);
+}
+
+// Orders the streamed stores before anything that follows, so they are
+// visible before the commands that read them are submitted.
+inline void StreamFence()
+{
+	_mm_sfence();
+}
@@ -9,6 +9,28 @@ Material* MatManager::GetMaterial(const std::string& name)
 	return mMaterials.at(name).get();
 }
 
+Material* MatManager::FindMaterial(const std::string& name)
+{
+	auto it = mMaterials.find(name);
+	return it != mMaterials.end() ? it->second.get() : nullptr;
+}
+
+Material* MatManager::SetMaterial(const Material& values)
+{
+	auto& mat = mMaterials[values.Name];
+	if (!mat)
+		mat = std::make_unique<Material>();
+
+	// The slot of the old values no longer belongs to it.
+	if (mat->MatCBIndex >= 0 && mat->MatCBIndex != values.MatCBIndex &&
+		mat->MatCBIndex < (int)mMaterialsByIndex.size() && mMaterialsByIndex[mat->MatCBIndex] == mat.get())
+		mMaterialsByIndex[mat->MatCBIndex] = nullptr;
+
+	*mat = values;
+	Track(mat.get());
+	return mat.get();
+}
+
 void MatManager::CreateMaterial(
 	const std::string& name,
 	int MatCBIndex,
@@ -27,30 +49,53 @@ void MatManager::CreateMaterial(
 	mat->FresnelR0 = FresnelR0;
 	mat->Roughness = Roughness;
 
-	mMaterials.try_emplace(name, std::move(mat));
+	auto [it, inserted] = mMaterials.try_emplace(name, std::move(mat));
+	if (inserted)
+		Track(it->second.get());
+}
+
+void MatManager::Track(Material* mat)
+{
+	if (mat->MatCBIndex < 0)
+		return;
+
+	if (mat->MatCBIndex >= (int)mMaterialsByIndex.size())
+		mMaterialsByIndex.resize(mat->MatCBIndex + 1, nullptr);
+
+	mMaterialsByIndex[mat->MatCBIndex] = mat;
+	mDirty.Mark(mat->MatCBIndex);
+}
+
+void MatManager::MarkDirty(const Material* mat)
+{
+	if (mat->MatCBIndex >= 0)
+		mDirty.Mark(mat->MatCBIndex);
 }
 
-void MatManager::UpdateMaterialBuffer(UploadBuffer<MaterialData>* currMaterialBuffer)
+void MatManager::MarkAllDirty()
 {
-	// update every material data
-	for (auto& item : mMaterials)
+	mDirty.MarkAll(GetBufferSize());
+}
+
+void MatManager::UpdateMaterialBuffer(GpuSceneBuffer& sceneBuffer)
+{
+	// update the materials changed since the last frame
+	mDirty.Drain(0, [&](uint32_t index)
 	{
-		Material* mat = item.second.get();
-		if (mat->NumFramesDirty > 0)
-		{
-			XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
-
-			MaterialData matData;
-			matData.DiffuseAlbedo = mat->DiffuseAlbedo;
-			matData.FresnelR0 = mat->FresnelR0;
-			matData.Roughness = mat->Roughness;
-			XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
-			matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
-			matData.NormalMapIndex = mat->NormalSrvHeapIndex;
-
-			currMaterialBuffer->CopyData(mat->MatCBIndex, matData);
-
-			mat->NumFramesDirty--;
-		}
-	}
+		Material* mat = mMaterialsByIndex[index];
+		if (!mat)
+			return;
+
+		XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+
+		MaterialData matData;
+		matData.DiffuseAlbedo = mat->DiffuseAlbedo;
+		matData.FresnelR0 = mat->FresnelR0;
+		matData.Roughness = mat->Roughness;
+		XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
+		matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
+		matData.NormalMapIndex = mat->NormalSrvHeapIndex;
+
+		sceneBuffer.Write(GpuSceneBuffer::Region::Materials, mat->MatCBIndex, &matData);
+	});
 }
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "../Common/d3dUtil.h"
+#include "../DXRuntime/FrameDirtyList.h"
 #include "../DXRuntime/FrameResource.h"
+#include "../DXRuntime/GpuSceneBuffer.h"
 
 #include "../Resource/UploadBuffer.h"
 
@@ -22,8 +24,6 @@ struct Material
 	// Index into SRV heap for normal texture.
 	int NormalSrvHeapIndex = -1;
 
-	int NumFramesDirty = gNumFrameResources;
-
 	// Material constant buffer data used for shading.
 	DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
 	DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
@@ -46,11 +46,45 @@ public:
 		float Roughness,
 		int NormalSrvHeapIndex = -1);
 
-	void UpdateMaterialBuffer(UploadBuffer<MaterialData> *);
+	// Writes the materials changed since the last call to the scene buffer.
+	void UpdateMaterialBuffer(GpuSceneBuffer& sceneBuffer);
+
+	// Call after editing a material in place so it is uploaded again.
+	void MarkDirty(const Material* mat);
+
+	// Uploads every material again, e.g. into recreated buffers.
+	void MarkAllDirty();
+
+	// Elements the material buffer needs: one past the highest MatCBIndex.
+	UINT GetBufferSize() const { return (UINT)mMaterialsByIndex.size(); }
 
 	Material* GetMaterial(const std::string &name);
 
+	// nullptr if there is no such material
+	Material* FindMaterial(const std::string& name);
+
+	// Overwrites the material of the same name, or adds it. Existing materials
+	// keep their address, so the render items that use them stay valid.
+	Material* SetMaterial(const Material& values);
+
+	// Invokes f(const Material&) for every material.
+	template<typename F>
+	void ForEachMaterial(F&& f) const
+	{
+		for (const auto& item : mMaterials)
+			f(*item.second);
+	}
+
 	size_t GetSize() { return mMaterials.size(); }
 private:
+	// Indexes the material by its MatCBIndex and queues it for upload.
+	void Track(Material* mat);
+
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
+
+	// by MatCBIndex; nullptr for unused indices
+	std::vector<Material*> mMaterialsByIndex;
+
+	// one list, as the frames share the scene buffer
+	FrameDirtyList mDirty{ 1 };
 };
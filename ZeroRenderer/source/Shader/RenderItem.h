@@ -8,8 +8,14 @@
 
 #include "../Resource/Mesh.h"
 
+#include "../ECS/World.h"
+
+#include "../Spatial/AABB.h"
+
 #include "MatManager.h"
 
+#include <tuple>
+
 using namespace DirectX;
 
 enum class RenderLayer : int
@@ -22,24 +28,62 @@ enum class RenderLayer : int
 	Count
 };
 
-// Lightweight structure stores parameters to draw a shape..
-struct RenderItem
-{
-	RenderItem() = default;
-	RenderItem(const RenderItem& rhs) = delete;
+//
+// A render item is an entity of the scene world made of the components below.
+// Each component is stored as its own contiguous column inside the ECS chunks.
+//
+
+// Layer membership is a tag, so every layer lives in its own archetype and
+// drawing a layer walks exactly the chunks of that layer.
+template<RenderLayer L>
+struct LayerTag {};
 
-	bool Visible = true;
+// Rendered into the occlusion buffer to hide the items behind it; change with
+// Scene::SetOccluder. Only items with a mesh BVH can be occluders.
+struct OccluderTag {};
 
+// Never moves, so it may block the view in the baked visible sets and its
+// mesh may be merged into a static batch; change with Scene::SetStatic.
+struct StaticTag {};
+
+// A static item merged into a static batch: it is drawn by the batch instead
+// of on its own, but still picked, saved and rendered as an occluder.
+struct BatchedTag {};
+
+// The item that draws a static batch, see StaticBatcher. It is neither picked
+// nor saved.
+struct StaticBatchTag {};
+
+struct TransformComponent
+{
+	// Written by Scene::UpdateTransforms from the transform hierarchy;
+	// edit the item's local transform instead of this matrix.
 	XMFLOAT4X4 World = MathHelper::Identity4x4();
 
 	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+};
 
-	int NumFramesDirty = gNumFrameResources;
+// Bounds of the mesh in local space.
+struct BoundsComponent
+{
+	BoundingBox Bounds;
+};
 
-	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
-	UINT ObjCBIndex = -1;
+// Leaf of the item in Scene's AABB tree, its slot in the frustum culling set of
+// its layer (-1 while it is hidden), and the world-space bounds both were last given.
+// PvsIndex is the item's bit in the baked visible sets, -1 if it was not baked
+// or has moved since.
+struct SpatialComponent
+{
+	int32_t Proxy = -1;
+	int32_t CullSlot = -1;
+	int32_t PvsIndex = -1;
 
-	Material* Mat = nullptr;
+	AABB WorldBounds;
+};
+
+struct MeshComponent
+{
 	MeshGeometry* Geo = nullptr;
 
 	// Primitive topology.
@@ -49,5 +93,47 @@ struct RenderItem
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
-	BoundingBox Bounds;
+
+	// Triangle BVH of the submesh, if it was built (owned by Geo->DrawArgs).
+	const MeshBVH* BVH = nullptr;
 };
+
+// Items with the same key draw the same submesh.
+inline auto SubmeshKey(const MeshComponent& mesh)
+{
+	return std::make_tuple(mesh.Geo, mesh.StartIndexLocation, mesh.BaseVertexLocation, mesh.IndexCount, mesh.PrimitiveType);
+}
+
+struct MaterialComponent
+{
+	Material* Mat = nullptr;
+};
+
+// Set when the item's entry in the scene's object data is stale; the scene
+// keeps a list of the items it is set on.
+struct DirtyComponent
+{
+	bool Dirty = true;
+};
+
+struct RenderStateComponent
+{
+	// Index of the item's instance data in Scene::GetObjectData.
+	UINT ObjectIndex = -1;
+
+	bool Visible = true;   // change with Scene::SetVisible
+};
+
+inline ecs::ComponentMask LayerMask(RenderLayer layer)
+{
+	static const ecs::ComponentMask masks[(int)RenderLayer::Count] =
+	{
+		ecs::MaskOf<LayerTag<RenderLayer::Opaque>>(),
+		ecs::MaskOf<LayerTag<RenderLayer::Sky>>(),
+		ecs::MaskOf<LayerTag<RenderLayer::Transparent>>(),
+		ecs::MaskOf<LayerTag<RenderLayer::Debug>>(),
+		ecs::MaskOf<LayerTag<RenderLayer::Highlight>>(),
+	};
+
+	return masks[(int)layer];
+}
@@ -29,6 +29,8 @@ ShaderManager::ShaderManager()
 	mShaders["skyVS"] = d3dUtil::CompileShader(L"shaders\\Sky.hlsl", nullptr, "VS", "vs_5_1");
 	mShaders["skyPS"] = d3dUtil::CompileShader(L"shaders\\Sky.hlsl", nullptr, "PS", "ps_5_1");
 
+	mShaders["sceneScatterCS"] = d3dUtil::CompileShader(L"shaders\\SceneScatter.hlsl", nullptr, "CS", "cs_5_1");
+
 	mInputLayout =
 	{
 		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
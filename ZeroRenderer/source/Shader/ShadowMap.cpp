@@ -6,8 +6,6 @@ ShadowMap::ShadowMap(ID3D12Device* device, UINT width, UINT height) : mWidth(wid
 
 	mViewport = { 0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f };
 	mScissorRect = { 0, 0, (int)width, (int)height };
-
-	BuildResource();
 }
 
 UINT ShadowMap::Width()const
@@ -22,7 +20,7 @@ UINT ShadowMap::Height()const
 
 ID3D12Resource* ShadowMap::Resource()
 {
-	return mShadowMap.Get();
+	return mShadowMap;
 }
 
 CD3DX12_GPU_DESCRIPTOR_HANDLE ShadowMap::Srv()const
@@ -65,15 +63,25 @@ void ShadowMap::OnResize(UINT newWidth, UINT newHeight)
 		mWidth = newWidth;
 		mHeight = newHeight;
 
-		BuildResource();
-
-		// New resource, so we need new descriptors to that resource.
-		BuildDescriptors();
+		mViewport = { 0.0f, 0.0f, (float)newWidth, (float)newHeight, 0.0f, 1.0f };
+		mScissorRect = { 0, 0, (int)newWidth, (int)newHeight };
 	}
 }
 
+void ShadowMap::SetResource(ID3D12Resource* resource)
+{
+	mShadowMap = resource;
+
+	// New resource, so we need new descriptors to that resource.
+	BuildDescriptors();
+}
+
 void ShadowMap::BuildDescriptors()
 {
+	// Built again once the render graph hands the map over.
+	if (mShadowMap == nullptr)
+		return;
+
 	// Create SRV to resource so we can sample the shadow map in a shader program.
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -83,7 +91,7 @@ void ShadowMap::BuildDescriptors()
 	srvDesc.Texture2D.MipLevels = 1;
 	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
 	srvDesc.Texture2D.PlaneSlice = 0;
-	md3dDevice->CreateShaderResourceView(mShadowMap.Get(), &srvDesc, mhCpuSrv);
+	md3dDevice->CreateShaderResourceView(mShadowMap, &srvDesc, mhCpuSrv);
 
 	// Create DSV to resource so we can render to the shadow map.
 	D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc;
@@ -91,10 +99,10 @@ void ShadowMap::BuildDescriptors()
 	dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
 	dsvDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
 	dsvDesc.Texture2D.MipSlice = 0;
-	md3dDevice->CreateDepthStencilView(mShadowMap.Get(), &dsvDesc, mhCpuDsv);
+	md3dDevice->CreateDepthStencilView(mShadowMap, &dsvDesc, mhCpuDsv);
 }
 
-void ShadowMap::BuildResource()
+D3D12_RESOURCE_DESC ShadowMap::ResourceDesc() const
 {
 	D3D12_RESOURCE_DESC texDesc;
 	ZeroMemory(&texDesc, sizeof(D3D12_RESOURCE_DESC));
@@ -109,17 +117,14 @@ void ShadowMap::BuildResource()
 	texDesc.SampleDesc.Quality = 0;
 	texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
 	texDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+	return texDesc;
+}
 
+D3D12_CLEAR_VALUE ShadowMap::ClearValue() const
+{
 	D3D12_CLEAR_VALUE optClear;
 	optClear.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
 	optClear.DepthStencil.Depth = 1.0f;
 	optClear.DepthStencil.Stencil = 0;
-
-	ThrowIfFailed(md3dDevice->CreateCommittedResource(
-		get_rvalue_ptr(CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT)), // default heap
-		D3D12_HEAP_FLAG_NONE,
-		&texDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		&optClear,
-		IID_PPV_ARGS(&mShadowMap)));
+	return optClear;
 }
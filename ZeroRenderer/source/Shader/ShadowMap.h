@@ -25,11 +25,17 @@ public:
 		CD3DX12_GPU_DESCRIPTOR_HANDLE hGpuSrv,
 		CD3DX12_CPU_DESCRIPTOR_HANDLE hCpuDsv);
 
+	// The map at the current size; the render graph creates it, see
+	// ShadowPass. Resizing takes a new one.
+	D3D12_RESOURCE_DESC ResourceDesc() const;
+	D3D12_CLEAR_VALUE ClearValue() const;
+
+	void SetResource(ID3D12Resource* resource);
+
 	void OnResize(UINT newWidth, UINT newHeight);
 
 private:
 	void BuildDescriptors();
-	void BuildResource();
 
 private:
 
@@ -46,5 +52,5 @@ private:
 	CD3DX12_GPU_DESCRIPTOR_HANDLE mhGpuSrv;
 	CD3DX12_CPU_DESCRIPTOR_HANDLE mhCpuDsv;
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> mShadowMap = nullptr;
+	ID3D12Resource* mShadowMap = nullptr;   // owned by the render graph
 };
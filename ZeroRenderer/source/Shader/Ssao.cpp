@@ -69,12 +69,12 @@ std::vector<float> Ssao::CalcGaussWeights(float sigma)
 
 ID3D12Resource* Ssao::NormalMap()
 {
-    return mNormalMap.Get();
+    return mNormalMap;
 }
 
 ID3D12Resource* Ssao::AmbientMap()
 {
-    return mAmbientMap0.Get();
+    return mAmbientMap0;
 }
 
 CD3DX12_CPU_DESCRIPTOR_HANDLE Ssao::NormalMapRtv()const
@@ -131,7 +131,7 @@ void Ssao::RebuildDescriptors(ID3D12Resource* depthStencilBuffer)
     srvDesc.Format = NormalMapFormat;
     srvDesc.Texture2D.MostDetailedMip = 0;
     srvDesc.Texture2D.MipLevels = 1;
-    md3dDevice->CreateShaderResourceView(mNormalMap.Get(), &srvDesc, mhNormalMapCpuSrv);
+    md3dDevice->CreateShaderResourceView(mNormalMap, &srvDesc, mhNormalMapCpuSrv);
 
     srvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
     md3dDevice->CreateShaderResourceView(depthStencilBuffer, &srvDesc, mhDepthMapCpuSrv);
@@ -140,19 +140,19 @@ void Ssao::RebuildDescriptors(ID3D12Resource* depthStencilBuffer)
     md3dDevice->CreateShaderResourceView(mRandomVectorMap.Get(), &srvDesc, mhRandomVectorMapCpuSrv);
 
     srvDesc.Format = AmbientMapFormat;
-    md3dDevice->CreateShaderResourceView(mAmbientMap0.Get(), &srvDesc, mhAmbientMap0CpuSrv);
-    md3dDevice->CreateShaderResourceView(mAmbientMap1.Get(), &srvDesc, mhAmbientMap1CpuSrv);
+    md3dDevice->CreateShaderResourceView(mAmbientMap0, &srvDesc, mhAmbientMap0CpuSrv);
+    md3dDevice->CreateShaderResourceView(mAmbientMap1, &srvDesc, mhAmbientMap1CpuSrv);
 
     D3D12_RENDER_TARGET_VIEW_DESC rtvDesc = {};
     rtvDesc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
     rtvDesc.Format = NormalMapFormat;
     rtvDesc.Texture2D.MipSlice = 0;
     rtvDesc.Texture2D.PlaneSlice = 0;
-    md3dDevice->CreateRenderTargetView(mNormalMap.Get(), &rtvDesc, mhNormalMapCpuRtv);
+    md3dDevice->CreateRenderTargetView(mNormalMap, &rtvDesc, mhNormalMapCpuRtv);
 
     rtvDesc.Format = AmbientMapFormat;
-    md3dDevice->CreateRenderTargetView(mAmbientMap0.Get(), &rtvDesc, mhAmbientMap0CpuRtv);
-    md3dDevice->CreateRenderTargetView(mAmbientMap1.Get(), &rtvDesc, mhAmbientMap1CpuRtv);
+    md3dDevice->CreateRenderTargetView(mAmbientMap0, &rtvDesc, mhAmbientMap0CpuRtv);
+    md3dDevice->CreateRenderTargetView(mAmbientMap1, &rtvDesc, mhAmbientMap1CpuRtv);
 }
 
 void Ssao::SetPSOs(ID3D12PipelineState* ssaoPso, ID3D12PipelineState* ssaoBlurPso)
@@ -177,24 +177,17 @@ void Ssao::OnResize(UINT newWidth, UINT newHeight)
         mViewport.MaxDepth = 1.0f;
 
         mScissorRect = { 0, 0, (int)mRenderTargetWidth / 2, (int)mRenderTargetHeight / 2 };
-
-        BuildResources();
     }
 }
 
 void Ssao::ComputeSsao(
     ID3D12GraphicsCommandList* cmdList,
-    FrameResource* currFrame, 
-    int blurCount)
+    D3D12_GPU_VIRTUAL_ADDRESS ssaoCBAddress)
 {
 	cmdList->RSSetViewports(1, &mViewport);
     cmdList->RSSetScissorRects(1, &mScissorRect);
 
 	// We compute the initial SSAO to AmbientMap0.
-
-    // Change to RENDER_TARGET.
-    cmdList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(mAmbientMap0.Get(),
-        D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET)));
   
 	float clearValue[] = {1.0f, 1.0f, 1.0f, 1.0f};
     cmdList->ClearRenderTargetView(mhAmbientMap0CpuRtv, clearValue, 0, nullptr);
@@ -203,7 +196,6 @@ void Ssao::ComputeSsao(
     cmdList->OMSetRenderTargets(1, &mhAmbientMap0CpuRtv, true, nullptr);
 
     // Bind the constant buffer for this pass.
-    auto ssaoCBAddress = currFrame->SsaoCB->Resource()->GetGPUVirtualAddress();
     cmdList->SetGraphicsRootConstantBufferView(0, ssaoCBAddress);
     cmdList->SetGraphicsRoot32BitConstant(1, 0, 0);
 
@@ -220,31 +212,14 @@ void Ssao::ComputeSsao(
     cmdList->IASetIndexBuffer(nullptr);
     cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	cmdList->DrawInstanced(6, 1, 0, 0);
-   
-	// Change back to GENERIC_READ so we can read the texture in a shader.
-    cmdList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(mAmbientMap0.Get(),
-        D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_GENERIC_READ)));
-
-    BlurAmbientMap(cmdList, currFrame, blurCount);
 }
- 
-void Ssao::BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame, int blurCount)
+
+void Ssao::BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, D3D12_GPU_VIRTUAL_ADDRESS ssaoCBAddress, bool horzBlur)
 {
     cmdList->SetPipelineState(mBlurPso);
 
-    auto ssaoCBAddress = currFrame->SsaoCB->Resource()->GetGPUVirtualAddress();
     cmdList->SetGraphicsRootConstantBufferView(0, ssaoCBAddress);
- 
-    for(int i = 0; i < blurCount; ++i)
-    {
-        BlurAmbientMap(cmdList, true);
-        BlurAmbientMap(cmdList, false);
-    }
-}
 
-void Ssao::BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, bool horzBlur)
-{
-	ID3D12Resource* output = nullptr;
 	CD3DX12_GPU_DESCRIPTOR_HANDLE inputSrv;
 	CD3DX12_CPU_DESCRIPTOR_HANDLE outputRtv;
 	
@@ -252,21 +227,16 @@ void Ssao::BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, bool horzBlur)
 	// horizontal and vertical blur passes.
 	if(horzBlur == true)
 	{
-		output = mAmbientMap1.Get();
 		inputSrv = mhAmbientMap0GpuSrv;
 		outputRtv = mhAmbientMap1CpuRtv;
         cmdList->SetGraphicsRoot32BitConstant(1, 1, 0);
 	}
 	else
 	{
-		output = mAmbientMap0.Get();
 		inputSrv = mhAmbientMap1GpuSrv;
 		outputRtv = mhAmbientMap0CpuRtv;
         cmdList->SetGraphicsRoot32BitConstant(1, 0, 0);
 	}
- 
-    cmdList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(output,
-        D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET)));
 
 	float clearValue[] = { 1.0f, 1.0f, 1.0f, 1.0f };
     cmdList->ClearRenderTargetView(outputRtv, clearValue, 0, nullptr);
@@ -287,18 +257,10 @@ void Ssao::BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, bool horzBlur)
     cmdList->IASetIndexBuffer(nullptr);
     cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	cmdList->DrawInstanced(6, 1, 0, 0);
-   
-    cmdList->ResourceBarrier(1, get_rvalue_ptr(CD3DX12_RESOURCE_BARRIER::Transition(output,
-        D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_GENERIC_READ)));
 }
  
-void Ssao::BuildResources()
+D3D12_RESOURCE_DESC Ssao::NormalMapDesc()const
 {
-	// Free the old resources if they exist.
-    mNormalMap = nullptr;
-    mAmbientMap0 = nullptr;
-    mAmbientMap1 = nullptr;
-
     D3D12_RESOURCE_DESC texDesc;
     ZeroMemory(&texDesc, sizeof(D3D12_RESOURCE_DESC));
     texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
@@ -312,41 +274,36 @@ void Ssao::BuildResources()
     texDesc.SampleDesc.Quality = 0;
     texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
     texDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;  // Ⱦ
+    return texDesc;
+}
 
-
-    float normalClearColor[] = { 0.0f, 0.0f, 1.0f, 0.0f };
-    CD3DX12_CLEAR_VALUE optClear(NormalMapFormat, normalClearColor);
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        get_rvalue_ptr(CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT)),
-        D3D12_HEAP_FLAG_NONE,
-        &texDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-        &optClear,
-        IID_PPV_ARGS(&mNormalMap)));
-
+D3D12_RESOURCE_DESC Ssao::AmbientMapDesc()const
+{
 	// Ambient occlusion maps are at half resolution.
+    D3D12_RESOURCE_DESC texDesc = NormalMapDesc();
     texDesc.Width = mRenderTargetWidth / 2;
     texDesc.Height = mRenderTargetHeight / 2;
     texDesc.Format = Ssao::AmbientMapFormat;
+    return texDesc;
+}
 
-    float ambientClearColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    optClear = CD3DX12_CLEAR_VALUE(AmbientMapFormat, ambientClearColor);
+D3D12_CLEAR_VALUE Ssao::NormalMapClearValue()
+{
+    float normalClearColor[] = { 0.0f, 0.0f, 1.0f, 0.0f };
+    return CD3DX12_CLEAR_VALUE(NormalMapFormat, normalClearColor);
+}
 
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        get_rvalue_ptr(CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT)),
-        D3D12_HEAP_FLAG_NONE,
-        &texDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        &optClear,
-        IID_PPV_ARGS(&mAmbientMap0)));
+D3D12_CLEAR_VALUE Ssao::AmbientMapClearValue()
+{
+    float ambientClearColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    return CD3DX12_CLEAR_VALUE(AmbientMapFormat, ambientClearColor);
+}
 
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        get_rvalue_ptr(CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT)),
-        D3D12_HEAP_FLAG_NONE,
-        &texDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        &optClear,
-        IID_PPV_ARGS(&mAmbientMap1)));
+void Ssao::SetResources(ID3D12Resource* normalMap, ID3D12Resource* ambientMap0, ID3D12Resource* ambientMap1)
+{
+    mNormalMap = normalMap;
+    mAmbientMap0 = ambientMap0;
+    mAmbientMap1 = ambientMap1;
 }
 
 void Ssao::BuildRandomVectorTexture(ID3D12GraphicsCommandList* cmdList)
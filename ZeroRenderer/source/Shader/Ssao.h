@@ -43,10 +43,19 @@ public:
 
     void RebuildDescriptors(ID3D12Resource* depthStencilBuffer);
 
+    // The normal and ambient maps at the current size. The render graph
+    // creates them, see SsaoPass; RebuildDescriptors must follow SetResources.
+    D3D12_RESOURCE_DESC NormalMapDesc()const;
+    D3D12_RESOURCE_DESC AmbientMapDesc()const;
+    static D3D12_CLEAR_VALUE NormalMapClearValue();
+    static D3D12_CLEAR_VALUE AmbientMapClearValue();
+
+    void SetResources(ID3D12Resource* normalMap, ID3D12Resource* ambientMap0, ID3D12Resource* ambientMap1);
+
     void SetPSOs(ID3D12PipelineState* ssaoPso, ID3D12PipelineState* ssaoBlurPso);
 
 	///<summary>
-	/// Call when the backbuffer is resized.  
+	/// Call when the backbuffer is resized, then recreate the maps.
 	///</summary>
 	void OnResize(UINT newWidth, UINT newHeight);
   
@@ -55,24 +64,22 @@ public:
     /// quad to kick off the pixel shader to compute the AmbientMap.  We still keep the
     /// main depth buffer binded to the pipeline, but depth buffer read/writes
     /// are disabled, as we do not need the depth buffer computing the Ambient map.
+    /// AmbientMap0 must be a render target, the normal and depth maps readable.
     ///</summary>
 	void ComputeSsao(
         ID3D12GraphicsCommandList* cmdList, 
-        FrameResource* currFrame, 
-        int blurCount);
- 
+        D3D12_GPU_VIRTUAL_ADDRESS ssaoCBAddress);
 
-private:
- 
     ///<summary>
     /// Blurs the ambient map to smooth out the noise caused by only taking a
     /// few random samples per pixel.  We use an edge preserving blur so that 
     /// we do not blur across discontinuities--we want edges to remain edges.
+    /// The horizontal blur goes from AmbientMap0 to AmbientMap1, the vertical
+    /// one back; the output must be a render target, the input readable.
     ///</summary>
-    void BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame, int blurCount);
-	void BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, bool horzBlur);
+    void BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, D3D12_GPU_VIRTUAL_ADDRESS ssaoCBAddress, bool horzBlur);
 
-    void BuildResources();
+private:
     void BuildRandomVectorTexture(ID3D12GraphicsCommandList* cmdList);
  
 	void BuildOffsetVectors();
@@ -88,9 +95,11 @@ private:
 	 
     Microsoft::WRL::ComPtr<ID3D12Resource> mRandomVectorMap;
 	Microsoft::WRL::ComPtr<ID3D12Resource> mRandomVectorMapUploadBuffer;
-    Microsoft::WRL::ComPtr<ID3D12Resource> mNormalMap;
-    Microsoft::WRL::ComPtr<ID3D12Resource> mAmbientMap0;
-    Microsoft::WRL::ComPtr<ID3D12Resource> mAmbientMap1;
+
+    // Owned by the render graph.
+    ID3D12Resource* mNormalMap = nullptr;
+    ID3D12Resource* mAmbientMap0 = nullptr;
+    ID3D12Resource* mAmbientMap1 = nullptr;
 
     CD3DX12_CPU_DESCRIPTOR_HANDLE mhNormalMapCpuSrv;
     CD3DX12_GPU_DESCRIPTOR_HANDLE mhNormalMapGpuSrv;
@@ -0,0 +1,178 @@
+#pragma once
+
+//
+// Min/max boxes and frustum planes used by the spatial structures.
+// DirectX::BoundingBox (center/extents) is kept for the mesh data; the min/max
+// form is cheaper to merge and to test against rays and planes.
+//
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+struct AABB
+{
+	XMFLOAT3 Min = { +FLT_MAX, +FLT_MAX, +FLT_MAX };
+	XMFLOAT3 Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	static AABB FromBoundingBox(const BoundingBox& box)
+	{
+		AABB r;
+		r.Min = { box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z };
+		r.Max = { box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z };
+		return r;
+	}
+
+	BoundingBox ToBoundingBox() const
+	{
+		return BoundingBox(
+			XMFLOAT3((Min.x + Max.x) * 0.5f, (Min.y + Max.y) * 0.5f, (Min.z + Max.z) * 0.5f),
+			XMFLOAT3((Max.x - Min.x) * 0.5f, (Max.y - Min.y) * 0.5f, (Max.z - Min.z) * 0.5f));
+	}
+
+	// Box enclosing 'local' after it is transformed by the (row-vector) matrix 'world'.
+	static AABB Transform(const BoundingBox& local, const XMFLOAT4X4& world)
+	{
+		const float c[3] = { local.Center.x, local.Center.y, local.Center.z };
+		const float e[3] = { local.Extents.x, local.Extents.y, local.Extents.z };
+
+		float center[3], extents[3];
+		for (int j = 0; j < 3; ++j)
+		{
+			center[j] = world.m[3][j];
+			extents[j] = 0.0f;
+			for (int i = 0; i < 3; ++i)
+			{
+				center[j] += c[i] * world.m[i][j];
+				extents[j] += e[i] * std::fabs(world.m[i][j]);
+			}
+		}
+
+		AABB r;
+		r.Min = { center[0] - extents[0], center[1] - extents[1], center[2] - extents[2] };
+		r.Max = { center[0] + extents[0], center[1] + extents[1], center[2] + extents[2] };
+		return r;
+	}
+
+	static AABB Union(const AABB& a, const AABB& b)
+	{
+		AABB r;
+		r.Min = { std::min(a.Min.x, b.Min.x), std::min(a.Min.y, b.Min.y), std::min(a.Min.z, b.Min.z) };
+		r.Max = { std::max(a.Max.x, b.Max.x), std::max(a.Max.y, b.Max.y), std::max(a.Max.z, b.Max.z) };
+		return r;
+	}
+
+	AABB Expanded(float margin) const
+	{
+		AABB r;
+		r.Min = { Min.x - margin, Min.y - margin, Min.z - margin };
+		r.Max = { Max.x + margin, Max.y + margin, Max.z + margin };
+		return r;
+	}
+
+	bool IsEmpty() const { return Min.x > Max.x; }
+
+	bool Contains(const AABB& b) const
+	{
+		return
+			Min.x <= b.Min.x && Min.y <= b.Min.y && Min.z <= b.Min.z &&
+			Max.x >= b.Max.x && Max.y >= b.Max.y && Max.z >= b.Max.z;
+	}
+
+	bool Overlaps(const AABB& b) const
+	{
+		return
+			Min.x <= b.Max.x && Max.x >= b.Min.x &&
+			Min.y <= b.Max.y && Max.y >= b.Min.y &&
+			Min.z <= b.Max.z && Max.z >= b.Min.z;
+	}
+
+	bool Overlaps(const BoundingSphere& s) const
+	{
+		float dx = std::max(std::max(Min.x - s.Center.x, 0.0f), s.Center.x - Max.x);
+		float dy = std::max(std::max(Min.y - s.Center.y, 0.0f), s.Center.y - Max.y);
+		float dz = std::max(std::max(Min.z - s.Center.z, 0.0f), s.Center.z - Max.z);
+		return dx * dx + dy * dy + dz * dz <= s.Radius * s.Radius;
+	}
+
+	// Half of the surface area; only ever compared, so the factor 2 is dropped.
+	float HalfArea() const
+	{
+		float dx = Max.x - Min.x, dy = Max.y - Min.y, dz = Max.z - Min.z;
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	// Slab test. invDir is 1/dir per axis. On a hit, tEntry is the ray
+	// parameter where the ray enters the box (0 if the origin is inside).
+	bool IntersectRay(const XMFLOAT3& origin, const XMFLOAT3& invDir, float tMax, float& tEntry) const
+	{
+		float t0 = (Min.x - origin.x) * invDir.x, t1 = (Max.x - origin.x) * invDir.x;
+		float tNear = std::min(t0, t1), tFar = std::max(t0, t1);
+
+		t0 = (Min.y - origin.y) * invDir.y; t1 = (Max.y - origin.y) * invDir.y;
+		tNear = std::max(tNear, std::min(t0, t1)); tFar = std::min(tFar, std::max(t0, t1));
+
+		t0 = (Min.z - origin.z) * invDir.z; t1 = (Max.z - origin.z) * invDir.z;
+		tNear = std::max(tNear, std::min(t0, t1)); tFar = std::min(tFar, std::max(t0, t1));
+
+		tEntry = std::max(tNear, 0.0f);
+		return tNear <= tFar && tFar >= 0.0f && tEntry <= tMax;
+	}
+};
+
+// Six inward-facing planes (ax + by + cz + d >= 0 inside).
+struct Frustum
+{
+	enum { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+
+	XMFLOAT4 Planes[PlaneCount];
+
+	// Planes of a D3D (row-vector, z in [0, 1]) view-projection matrix, in the
+	// space the matrix transforms from.
+	static Frustum FromViewProj(const XMFLOAT4X4& m)
+	{
+		auto column = [&](int j) { return XMFLOAT4(m.m[0][j], m.m[1][j], m.m[2][j], m.m[3][j]); };
+		auto add = [](XMFLOAT4 a, XMFLOAT4 b, float s) { return XMFLOAT4(a.x + s * b.x, a.y + s * b.y, a.z + s * b.z, a.w + s * b.w); };
+
+		XMFLOAT4 c0 = column(0), c1 = column(1), c2 = column(2), c3 = column(3);
+
+		Frustum f;
+		f.Planes[Left]   = add(c3, c0, +1.0f);
+		f.Planes[Right]  = add(c3, c0, -1.0f);
+		f.Planes[Bottom] = add(c3, c1, +1.0f);
+		f.Planes[Top]    = add(c3, c1, -1.0f);
+		f.Planes[Near]   = c2;
+		f.Planes[Far]    = add(c3, c2, -1.0f);
+
+		for (auto& p : f.Planes)
+		{
+			float invLength = 1.0f / std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+			p = XMFLOAT4(p.x * invLength, p.y * invLength, p.z * invLength, p.w * invLength);
+		}
+		return f;
+	}
+
+	// DISJOINT, INTERSECTS or CONTAINS.
+	ContainmentType Test(const AABB& box) const
+	{
+		bool inside = true;
+		for (const auto& p : Planes)
+		{
+			// corner furthest along the plane normal, and the one opposite to it
+			float px = p.x > 0.0f ? box.Max.x : box.Min.x, nx = p.x > 0.0f ? box.Min.x : box.Max.x;
+			float py = p.y > 0.0f ? box.Max.y : box.Min.y, ny = p.y > 0.0f ? box.Min.y : box.Max.y;
+			float pz = p.z > 0.0f ? box.Max.z : box.Min.z, nz = p.z > 0.0f ? box.Min.z : box.Max.z;
+
+			if (p.x * px + p.y * py + p.z * pz + p.w < 0.0f)
+				return DISJOINT;
+			if (p.x * nx + p.y * ny + p.z * nz + p.w < 0.0f)
+				inside = false;
+		}
+		return inside ? CONTAINS : INTERSECTS;
+	}
+};
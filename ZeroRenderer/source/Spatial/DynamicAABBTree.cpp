@@ -0,0 +1,322 @@
+#include "DynamicAABBTree.h"
+
+#include <cassert>
+
+DynamicAABBTree::DynamicAABBTree(float margin) : mMargin(margin)
+{
+}
+
+int32_t DynamicAABBTree::AllocateNode()
+{
+	if (mFreeList == NullNode)
+	{
+		mNodes.emplace_back();
+		mNodes.back().Next = mFreeList;
+		mFreeList = (int32_t)mNodes.size() - 1;
+	}
+
+	int32_t index = mFreeList;
+	Node& node = mNodes[index];
+	mFreeList = node.Next;
+
+	node.Parent = NullNode;
+	node.Child1 = NullNode;
+	node.Child2 = NullNode;
+	node.Height = 0;
+	node.UserData = 0;
+	return index;
+}
+
+void DynamicAABBTree::FreeNode(int32_t index)
+{
+	Node& node = mNodes[index];
+	node.Next = mFreeList;
+	node.Height = -1;
+	mFreeList = index;
+}
+
+int32_t DynamicAABBTree::CreateProxy(const AABB& box, uint32_t userData)
+{
+	int32_t proxy = AllocateNode();
+
+	mNodes[proxy].Box = box.Expanded(mMargin);
+	mNodes[proxy].UserData = userData;
+
+	InsertLeaf(proxy);
+	++mProxyCount;
+	return proxy;
+}
+
+void DynamicAABBTree::DestroyProxy(int32_t proxy)
+{
+	assert(mNodes[proxy].IsLeaf());
+
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	--mProxyCount;
+}
+
+bool DynamicAABBTree::MoveProxy(int32_t proxy, const AABB& box)
+{
+	assert(mNodes[proxy].IsLeaf());
+
+	AABB fat = box.Expanded(mMargin);
+	const AABB& current = mNodes[proxy].Box;
+
+	// Still inside the old fat box, and the old fat box is not so much larger
+	// (e.g. after the object shrank) that it would hurt the queries.
+	if (current.Contains(box) && fat.Expanded(4.0f * mMargin).Contains(current))
+		return false;
+
+	RemoveLeaf(proxy);
+	mNodes[proxy].Box = fat;
+	InsertLeaf(proxy);
+	return true;
+}
+
+void DynamicAABBTree::InsertLeaf(int32_t leaf)
+{
+	if (mRoot == NullNode)
+	{
+		mRoot = leaf;
+		mNodes[mRoot].Parent = NullNode;
+		return;
+	}
+
+	// Find the best sibling by descending the tree with the surface area
+	// heuristic: the cost of a subtree is the area added to its ancestors.
+	AABB leafBox = mNodes[leaf].Box;
+	int32_t index = mRoot;
+	while (!mNodes[index].IsLeaf())
+	{
+		const Node& node = mNodes[index];
+		int32_t child1 = node.Child1;
+		int32_t child2 = node.Child2;
+
+		float area = node.Box.HalfArea();
+		float combinedArea = AABB::Union(node.Box, leafBox).HalfArea();
+
+		// cost of making a new parent for this node and the new leaf
+		float cost = 2.0f * combinedArea;
+
+		// minimum cost of pushing the leaf further down the tree
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto descendCost = [&](int32_t child)
+		{
+			float unionArea = AABB::Union(leafBox, mNodes[child].Box).HalfArea();
+			if (mNodes[child].IsLeaf())
+				return unionArea + inheritanceCost;
+			return unionArea - mNodes[child].Box.HalfArea() + inheritanceCost;
+		};
+
+		float cost1 = descendCost(child1);
+		float cost2 = descendCost(child2);
+
+		if (cost < cost1 && cost < cost2)
+			break;
+
+		index = cost1 < cost2 ? child1 : child2;
+	}
+
+	int32_t sibling = index;
+
+	// Create a new parent.
+	int32_t oldParent = mNodes[sibling].Parent;
+	int32_t newParent = AllocateNode();
+	mNodes[newParent].Parent = oldParent;
+	mNodes[newParent].Box = AABB::Union(leafBox, mNodes[sibling].Box);
+	mNodes[newParent].Height = mNodes[sibling].Height + 1;
+	mNodes[newParent].Child1 = sibling;
+	mNodes[newParent].Child2 = leaf;
+	mNodes[sibling].Parent = newParent;
+	mNodes[leaf].Parent = newParent;
+
+	if (oldParent != NullNode)
+	{
+		if (mNodes[oldParent].Child1 == sibling)
+			mNodes[oldParent].Child1 = newParent;
+		else
+			mNodes[oldParent].Child2 = newParent;
+	}
+	else
+	{
+		mRoot = newParent;
+	}
+
+	// Walk back up fixing heights and boxes.
+	index = mNodes[leaf].Parent;
+	while (index != NullNode)
+	{
+		index = Balance(index);
+
+		Node& node = mNodes[index];
+		node.Height = 1 + std::max(mNodes[node.Child1].Height, mNodes[node.Child2].Height);
+		node.Box = AABB::Union(mNodes[node.Child1].Box, mNodes[node.Child2].Box);
+
+		index = node.Parent;
+	}
+}
+
+void DynamicAABBTree::RemoveLeaf(int32_t leaf)
+{
+	if (leaf == mRoot)
+	{
+		mRoot = NullNode;
+		return;
+	}
+
+	int32_t parent = mNodes[leaf].Parent;
+	int32_t grandParent = mNodes[parent].Parent;
+	int32_t sibling = mNodes[parent].Child1 == leaf ? mNodes[parent].Child2 : mNodes[parent].Child1;
+
+	if (grandParent == NullNode)
+	{
+		mRoot = sibling;
+		mNodes[sibling].Parent = NullNode;
+		FreeNode(parent);
+		return;
+	}
+
+	// Destroy the parent and connect the sibling to the grand parent.
+	if (mNodes[grandParent].Child1 == parent)
+		mNodes[grandParent].Child1 = sibling;
+	else
+		mNodes[grandParent].Child2 = sibling;
+	mNodes[sibling].Parent = grandParent;
+	FreeNode(parent);
+
+	int32_t index = grandParent;
+	while (index != NullNode)
+	{
+		index = Balance(index);
+
+		Node& node = mNodes[index];
+		node.Box = AABB::Union(mNodes[node.Child1].Box, mNodes[node.Child2].Box);
+		node.Height = 1 + std::max(mNodes[node.Child1].Height, mNodes[node.Child2].Height);
+
+		index = node.Parent;
+	}
+}
+
+/*
+	Performs a left or right rotation if node A is imbalanced:
+
+	         A                 C
+	       /   \             /   \
+	      B     C    ==>    A     F (or G)
+	           / \         / \
+	          F   G       B   G (or F)
+*/
+int32_t DynamicAABBTree::Balance(int32_t iA)
+{
+	Node* A = &mNodes[iA];
+	if (A->IsLeaf() || A->Height < 2)
+		return iA;
+
+	int32_t iB = A->Child1;
+	int32_t iC = A->Child2;
+	Node* B = &mNodes[iB];
+	Node* C = &mNodes[iC];
+
+	int32_t balance = C->Height - B->Height;
+
+	// Rotate C up, or symmetrically B up.
+	auto rotate = [&](int32_t iUp, Node* up, Node* other, bool upIsChild2) -> int32_t
+	{
+		int32_t iF = up->Child1;
+		int32_t iG = up->Child2;
+		Node* F = &mNodes[iF];
+		Node* G = &mNodes[iG];
+
+		// Swap A and the rising node.
+		up->Child1 = iA;
+		up->Parent = A->Parent;
+		A->Parent = iUp;
+
+		// A's old parent should point to the rising node.
+		if (up->Parent != NullNode)
+		{
+			if (mNodes[up->Parent].Child1 == iA)
+				mNodes[up->Parent].Child1 = iUp;
+			else
+				mNodes[up->Parent].Child2 = iUp;
+		}
+		else
+		{
+			mRoot = iUp;
+		}
+
+		// Keep the taller grandchild next to the rising node, give the other one to A.
+		int32_t iKeep = iF, iGive = iG;
+		Node* keep = F;
+		Node* give = G;
+		if (F->Height <= G->Height)
+		{
+			iKeep = iG; iGive = iF;
+			keep = G; give = F;
+		}
+
+		up->Child2 = iKeep;
+		if (upIsChild2)
+			A->Child2 = iGive;
+		else
+			A->Child1 = iGive;
+		give->Parent = iA;
+
+		A->Box = AABB::Union(other->Box, give->Box);
+		up->Box = AABB::Union(A->Box, keep->Box);
+
+		A->Height = 1 + std::max(other->Height, give->Height);
+		up->Height = 1 + std::max(A->Height, keep->Height);
+
+		return iUp;
+	};
+
+	if (balance > 1)
+		return rotate(iC, C, B, true);
+
+	if (balance < -1)
+		return rotate(iB, B, C, false);
+
+	return iA;
+}
+
+void DynamicAABBTree::Validate() const
+{
+#if defined(DEBUG) | defined(_DEBUG)
+	if (mRoot != NullNode)
+	{
+		assert(mNodes[mRoot].Parent == NullNode);
+		ValidateNode(mRoot);
+	}
+
+	size_t freeCount = 0;
+	for (int32_t index = mFreeList; index != NullNode; index = mNodes[index].Next)
+		++freeCount;
+
+	// a tree with n leaves has n - 1 internal nodes
+	size_t used = mNodes.size() - freeCount;
+	assert(used == (mProxyCount == 0 ? 0 : 2 * mProxyCount - 1));
+#endif
+}
+
+void DynamicAABBTree::ValidateNode(int32_t index) const
+{
+	const Node& node = mNodes[index];
+	if (node.IsLeaf())
+	{
+		assert(node.Height == 0);
+		return;
+	}
+
+	const Node& child1 = mNodes[node.Child1];
+	const Node& child2 = mNodes[node.Child2];
+
+	assert(child1.Parent == index && child2.Parent == index);
+	assert(node.Height == 1 + std::max(child1.Height, child2.Height));
+	assert(node.Box.Contains(child1.Box) && node.Box.Contains(child2.Box));
+
+	ValidateNode(node.Child1);
+	ValidateNode(node.Child2);
+}
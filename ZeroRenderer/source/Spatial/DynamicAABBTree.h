@@ -0,0 +1,259 @@
+#pragma once
+
+//
+// Dynamic bounding volume tree (in the style of Box2D's b2DynamicTree).
+//
+// Leaves hold "fat" boxes: the object's box grown by a margin, so an object
+// that moves a little stays inside its leaf and the tree is not touched.
+// Inserts pick the sibling with the smallest surface-area cost, and AVL-like
+// rotations keep the tree balanced, so queries visit O(log n) nodes.
+//
+
+#include <cstdint>
+#include <vector>
+
+#include "AABB.h"
+
+class DynamicAABBTree
+{
+public:
+	static constexpr int32_t NullNode = -1;
+
+	explicit DynamicAABBTree(float margin = 0.5f);
+
+	// Returns the proxy id of the new leaf. userData is handed back by the queries.
+	int32_t CreateProxy(const AABB& box, uint32_t userData);
+
+	void DestroyProxy(int32_t proxy);
+
+	// Re-inserts the leaf only if 'box' left its fat box (or the fat box became
+	// much larger than needed). Returns true if the tree was changed.
+	bool MoveProxy(int32_t proxy, const AABB& box);
+
+	uint32_t GetUserData(int32_t proxy) const { return mNodes[proxy].UserData; }
+
+	const AABB& GetFatAABB(int32_t proxy) const { return mNodes[proxy].Box; }
+
+	int32_t GetHeight() const { return mRoot == NullNode ? 0 : mNodes[mRoot].Height; }
+
+	size_t GetProxyCount() const { return mProxyCount; }
+
+	// Calls f(proxy) for every leaf whose fat box overlaps 'box'.
+	// f returns false to stop the query. Queries do not modify the tree, so
+	// several threads may run them at the same time.
+	template<typename F>
+	void Query(const AABB& box, F&& f) const
+	{
+		QueryIf([&](const AABB& nodeBox) { return nodeBox.Overlaps(box); }, f);
+	}
+
+	template<typename F>
+	void Query(const BoundingSphere& sphere, F&& f) const
+	{
+		QueryIf([&](const AABB& nodeBox) { return nodeBox.Overlaps(sphere); }, f);
+	}
+
+	// Leaves of subtrees that are completely inside the frustum are reported
+	// without testing them one by one.
+	template<typename F>
+	void Query(const Frustum& frustum, F&& f) const
+	{
+		if (mRoot == NullNode)
+			return;
+
+		std::vector<int32_t> stack;
+		stack.reserve(64);
+		stack.push_back(mRoot);
+
+		while (!stack.empty())
+		{
+			int32_t index = stack.back();
+			stack.pop_back();
+
+			const Node& node = mNodes[index];
+			ContainmentType containment = frustum.Test(node.Box);
+			if (containment == DISJOINT)
+				continue;
+
+			if (containment == CONTAINS)
+			{
+				if (!ReportSubtree(index, f))
+					return;
+			}
+			else if (node.IsLeaf())
+			{
+				if (!f(index))
+					return;
+			}
+			else
+			{
+				stack.push_back(node.Child1);
+				stack.push_back(node.Child2);
+			}
+		}
+	}
+
+	// Walks the leaves hit by the ray origin + t * dir, t in [0, maxT], nearest
+	// nodes first. f(proxy, maxT) returns the new maxT: the distance of an
+	// exact hit to clip the ray, maxT to keep going, or a negative value to stop.
+	template<typename F>
+	void RayCast(const XMFLOAT3& origin, const XMFLOAT3& dir, float maxT, F&& f) const
+	{
+		if (mRoot == NullNode)
+			return;
+
+		XMFLOAT3 invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+
+		struct Entry { int32_t Index; float T; };
+		std::vector<Entry> stack;
+		stack.reserve(64);
+
+		float t;
+		if (!mNodes[mRoot].Box.IntersectRay(origin, invDir, maxT, t))
+			return;
+		stack.push_back({ mRoot, t });
+
+		while (!stack.empty())
+		{
+			Entry entry = stack.back();
+			stack.pop_back();
+
+			if (entry.T > maxT)
+				continue;
+
+			const Node& node = mNodes[entry.Index];
+			if (node.IsLeaf())
+			{
+				float newMaxT = f(entry.Index, maxT);
+				if (newMaxT < 0.0f)
+					return;
+				maxT = newMaxT;
+				continue;
+			}
+
+			float t1, t2;
+			bool hit1 = mNodes[node.Child1].Box.IntersectRay(origin, invDir, maxT, t1);
+			bool hit2 = mNodes[node.Child2].Box.IntersectRay(origin, invDir, maxT, t2);
+
+			// push the far child first so the near one is visited next
+			if (hit1 && hit2)
+			{
+				if (t1 <= t2)
+				{
+					stack.push_back({ node.Child2, t2 });
+					stack.push_back({ node.Child1, t1 });
+				}
+				else
+				{
+					stack.push_back({ node.Child1, t1 });
+					stack.push_back({ node.Child2, t2 });
+				}
+			}
+			else if (hit1)
+				stack.push_back({ node.Child1, t1 });
+			else if (hit2)
+				stack.push_back({ node.Child2, t2 });
+		}
+	}
+
+	// Checks parent links, heights and boxes. Debug builds only.
+	void Validate() const;
+
+private:
+	struct Node
+	{
+		AABB Box;
+
+		union
+		{
+			int32_t Parent;
+			int32_t Next;    // free list link
+		};
+
+		int32_t Child1 = NullNode;
+		int32_t Child2 = NullNode;
+
+		// leaf = 0, free node = -1
+		int32_t Height = -1;
+
+		uint32_t UserData = 0;
+
+		bool IsLeaf() const { return Child1 == NullNode; }
+	};
+
+	template<typename Overlaps, typename F>
+	void QueryIf(Overlaps&& overlaps, F& f) const
+	{
+		if (mRoot == NullNode)
+			return;
+
+		std::vector<int32_t> stack;
+		stack.reserve(64);
+		stack.push_back(mRoot);
+
+		while (!stack.empty())
+		{
+			const Node& node = mNodes[stack.back()];
+			int32_t index = stack.back();
+			stack.pop_back();
+
+			if (!overlaps(node.Box))
+				continue;
+
+			if (node.IsLeaf())
+			{
+				if (!f(index))
+					return;
+			}
+			else
+			{
+				stack.push_back(node.Child1);
+				stack.push_back(node.Child2);
+			}
+		}
+	}
+
+	template<typename F>
+	bool ReportSubtree(int32_t root, F& f) const
+	{
+		std::vector<int32_t> stack;
+		stack.push_back(root);
+
+		while (!stack.empty())
+		{
+			const Node& node = mNodes[stack.back()];
+			int32_t index = stack.back();
+			stack.pop_back();
+
+			if (node.IsLeaf())
+			{
+				if (!f(index))
+					return false;
+			}
+			else
+			{
+				stack.push_back(node.Child1);
+				stack.push_back(node.Child2);
+			}
+		}
+		return true;
+	}
+
+	int32_t AllocateNode();
+	void FreeNode(int32_t node);
+
+	void InsertLeaf(int32_t leaf);
+	void RemoveLeaf(int32_t leaf);
+
+	// Rotates the subtree rooted at 'a' if it is unbalanced; returns its new root.
+	int32_t Balance(int32_t a);
+
+	void ValidateNode(int32_t index) const;
+
+	std::vector<Node> mNodes;
+	int32_t mRoot = NullNode;
+	int32_t mFreeList = NullNode;
+	size_t mProxyCount = 0;
+
+	float mMargin;
+};
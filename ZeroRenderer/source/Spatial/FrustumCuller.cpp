@@ -0,0 +1,410 @@
+#include "FrustumCuller.h"
+
+#include <emmintrin.h>
+
+#include <cstring>
+
+#include "../Utility/JobSystem.h"
+
+namespace
+{
+	// The accumulated motion is kept in floats per box; start over before the
+	// differences lose precision.
+	constexpr double MaxAccumulated = 1024.0;
+
+	// Plane evaluation is not exact; keep a little distance from the boundary.
+	constexpr float ToleranceBase = 1e-3f;
+	constexpr float ToleranceScale = 1e-5f;
+
+	struct Affine
+	{
+		double A[3][3];
+		double T[3];
+	};
+
+	Affine ToAffine(const XMFLOAT4X4& m)
+	{
+		Affine r;
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+				r.A[i][j] = m.m[i][j];
+			r.T[i] = m.m[3][i];
+		}
+		return r;
+	}
+
+	// Inverse of a row-vector affine transform: x * A + T.
+	Affine Inverse(const Affine& m)
+	{
+		const double (&a)[3][3] = m.A;
+		double det =
+			a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) -
+			a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0]) +
+			a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+		double invDet = 1.0 / det;
+
+		Affine r;
+		r.A[0][0] = (a[1][1] * a[2][2] - a[1][2] * a[2][1]) * invDet;
+		r.A[0][1] = (a[0][2] * a[2][1] - a[0][1] * a[2][2]) * invDet;
+		r.A[0][2] = (a[0][1] * a[1][2] - a[0][2] * a[1][1]) * invDet;
+		r.A[1][0] = (a[1][2] * a[2][0] - a[1][0] * a[2][2]) * invDet;
+		r.A[1][1] = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) * invDet;
+		r.A[1][2] = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) * invDet;
+		r.A[2][0] = (a[1][0] * a[2][1] - a[1][1] * a[2][0]) * invDet;
+		r.A[2][1] = (a[0][1] * a[2][0] - a[0][0] * a[2][1]) * invDet;
+		r.A[2][2] = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) * invDet;
+
+		for (int j = 0; j < 3; ++j)
+			r.T[j] = -(m.T[0] * r.A[0][j] + m.T[1] * r.A[1][j] + m.T[2] * r.A[2][j]);
+		return r;
+	}
+
+	void Apply(const Affine& m, const double p[3], double out[3])
+	{
+		for (int j = 0; j < 3; ++j)
+			out[j] = p[0] * m.A[0][j] + p[1] * m.A[1][j] + p[2] * m.A[2][j] + m.T[j];
+	}
+
+	double Distance(const double a[3], const double b[3])
+	{
+		return std::sqrt((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+	}
+
+	struct PlaneSplat
+	{
+		__m128 nx[Frustum::PlaneCount], ny[Frustum::PlaneCount], nz[Frustum::PlaneCount], nw[Frustum::PlaneCount];
+		__m128 ax[Frustum::PlaneCount], ay[Frustum::PlaneCount], az[Frustum::PlaneCount];
+
+		explicit PlaneSplat(const Frustum& frustum)
+		{
+			for (int p = 0; p < Frustum::PlaneCount; ++p)
+			{
+				const XMFLOAT4& plane = frustum.Planes[p];
+				nx[p] = _mm_set1_ps(plane.x);
+				ny[p] = _mm_set1_ps(plane.y);
+				nz[p] = _mm_set1_ps(plane.z);
+				nw[p] = _mm_set1_ps(plane.w);
+				ax[p] = _mm_set1_ps(std::fabs(plane.x));
+				ay[p] = _mm_set1_ps(std::fabs(plane.y));
+				az[p] = _mm_set1_ps(std::fabs(plane.z));
+			}
+		}
+
+		// Smallest (center distance + projected radius) over the planes; the box
+		// is outside iff it is negative.
+		__m128 MinDistance(__m128 cx, __m128 cy, __m128 cz, __m128 ex, __m128 ey, __m128 ez) const
+		{
+			__m128 result = _mm_set1_ps(FLT_MAX);
+			for (int p = 0; p < Frustum::PlaneCount; ++p)
+			{
+				__m128 d = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+					_mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+				__m128 r = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)),
+					_mm_mul_ps(az[p], ez));
+				result = _mm_min_ps(result, _mm_add_ps(d, r));
+			}
+			return result;
+		}
+	};
+
+	inline void AppendLanes(uint32_t mask, uint32_t base, uint32_t* out, uint32_t& outCount)
+	{
+		while (mask)
+		{
+			uint32_t lane = 0;
+			while (!(mask & (1u << lane)))
+				++lane;
+			mask &= mask - 1;
+			out[outCount++] = base + lane;
+		}
+	}
+
+	inline uint32_t PopCount4(uint32_t mask)
+	{
+		return (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+	}
+}
+
+void CullCache::Update(const XMFLOAT4X4& view, const XMFLOAT4X4& proj)
+{
+	if (mHasView && std::memcmp(&proj, &mProj, sizeof(proj)) != 0)
+		mValid = false;
+	mProj = proj;
+
+	Affine newView = ToAffine(view);
+	Affine newInverse = Inverse(newView);
+
+	const double origin[3] = { 0.0, 0.0, 0.0 };
+	double newEye[3];
+	Apply(newInverse, origin, newEye);
+
+	if (mHasView)
+	{
+		// A point x is classified by the new frustum like x * M is by the old
+		// one, with M = newView * oldView^-1. x * M - x is at most
+		// |oldEye * M - oldEye| + |linear(M) - I| * |x - oldEye|.
+		Affine oldView = ToAffine(mView);
+		Affine oldInverse = Inverse(oldView);
+
+		double oldEye[3], inNew[3], moved[3];
+		Apply(oldInverse, origin, oldEye);
+		Apply(newView, oldEye, inNew);
+		Apply(oldInverse, inNew, moved);
+
+		double deviation = 0.0;
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				double l = newView.A[i][0] * oldInverse.A[0][j] + newView.A[i][1] * oldInverse.A[1][j] + newView.A[i][2] * oldInverse.A[2][j];
+				double d = l - (i == j ? 1.0 : 0.0);
+				deviation += d * d;
+			}
+		}
+
+		mShift += Distance(moved, oldEye);
+		mDeviation += std::sqrt(deviation);
+		mTravel += Distance(newEye, oldEye);
+
+		if (mShift > MaxAccumulated || mDeviation > MaxAccumulated || mTravel > MaxAccumulated)
+			mValid = false;
+	}
+
+	mView = view;
+	mHasView = true;
+	mEye = XMFLOAT3((float)newEye[0], (float)newEye[1], (float)newEye[2]);
+}
+
+void FrustumCuller::Clear()
+{
+	mCenterX.clear(); mCenterY.clear(); mCenterZ.clear();
+	mExtentX.clear(); mExtentY.clear(); mExtentZ.clear();
+	mStamp.clear();
+	mCount = 0;
+	++mStructure;
+}
+
+void FrustumCuller::Reserve(size_t count)
+{
+	size_t padded = (count + Width - 1) / Width * Width;
+	for (auto* v : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ })
+		v->reserve(padded);
+	mStamp.reserve(padded);
+}
+
+uint32_t FrustumCuller::Add(const AABB& box)
+{
+	// Grow by a whole group; the padding lanes are masked off by Cull.
+	if (mCount % Width == 0)
+	{
+		for (auto* v : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ })
+			v->resize(v->size() + Width, 0.0f);
+		mStamp.resize(mStamp.size() + Width, 0);
+	}
+
+	uint32_t index = (uint32_t)mCount++;
+	Set(index, box);
+	++mStructure;
+	return index;
+}
+
+void FrustumCuller::Remove(uint32_t index)
+{
+	size_t last = mCount - 1;
+	for (auto* v : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ })
+	{
+		(*v)[index] = (*v)[last];
+		(*v)[last] = 0.0f;
+	}
+	mStamp[index] = mEpoch;
+	mStamp[last] = 0;
+
+	// drop the last group once it is empty
+	if (--mCount % Width == 0)
+	{
+		for (auto* v : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ })
+			v->resize(mCount);
+		mStamp.resize(mCount);
+	}
+	++mStructure;
+}
+
+void FrustumCuller::Set(uint32_t index, const AABB& box)
+{
+	mCenterX[index] = (box.Min.x + box.Max.x) * 0.5f;
+	mCenterY[index] = (box.Min.y + box.Max.y) * 0.5f;
+	mCenterZ[index] = (box.Min.z + box.Max.z) * 0.5f;
+	mExtentX[index] = (box.Max.x - box.Min.x) * 0.5f;
+	mExtentY[index] = (box.Max.y - box.Min.y) * 0.5f;
+	mExtentZ[index] = (box.Max.z - box.Min.z) * 0.5f;
+	mStamp[index] = mEpoch;
+}
+
+void FrustumCuller::CullGroups(const Frustum& frustum, uint32_t firstGroup, uint32_t lastGroup, uint32_t* out, uint32_t& outCount) const
+{
+	PlaneSplat planes(frustum);
+	const __m128 zero = _mm_setzero_ps();
+
+	outCount = 0;
+	for (uint32_t group = firstGroup; group < lastGroup; ++group)
+	{
+		size_t base = (size_t)group * Width;
+		__m128 minDistance = planes.MinDistance(
+			_mm_loadu_ps(&mCenterX[base]), _mm_loadu_ps(&mCenterY[base]), _mm_loadu_ps(&mCenterZ[base]),
+			_mm_loadu_ps(&mExtentX[base]), _mm_loadu_ps(&mExtentY[base]), _mm_loadu_ps(&mExtentZ[base]));
+
+		uint32_t inside = ~(uint32_t)_mm_movemask_ps(_mm_cmplt_ps(minDistance, zero)) & LaneMask(group);
+		AppendLanes(inside, (uint32_t)base, out, outCount);
+	}
+}
+
+void FrustumCuller::CullGroupsCoherent(const Frustum& frustum, CullCache& cache, bool testAll,
+	uint32_t firstGroup, uint32_t lastGroup, uint32_t* out, uint32_t& outCount, uint32_t& tested) const
+{
+	PlaneSplat planes(frustum);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+	const __m128 shift = _mm_set1_ps((float)cache.mShift);
+	const __m128 deviation = _mm_set1_ps((float)cache.mDeviation);
+	const __m128 travel = _mm_set1_ps((float)cache.mTravel);
+	const __m128 eyeX = _mm_set1_ps(cache.mEye.x);
+	const __m128 eyeY = _mm_set1_ps(cache.mEye.y);
+	const __m128 eyeZ = _mm_set1_ps(cache.mEye.z);
+	const __m128 toleranceBase = _mm_set1_ps(ToleranceBase);
+	const __m128 toleranceScale = _mm_set1_ps(ToleranceScale);
+	const __m128i epoch = _mm_set1_epi32((int)cache.mEpoch);
+
+	outCount = 0;
+	tested = 0;
+	for (uint32_t group = firstGroup; group < lastGroup; ++group)
+	{
+		size_t base = (size_t)group * Width;
+		uint32_t lanes = LaneMask(group);
+
+		bool retest = testAll;
+		if (!retest)
+		{
+			__m128 margin = _mm_loadu_ps(&cache.mMargin[base]);
+			__m128 reach = _mm_loadu_ps(&cache.mReach[base]);
+
+			// How far any point of the box may have moved relative to the
+			// frustum since it was tested.
+			__m128 dShift = _mm_sub_ps(shift, _mm_loadu_ps(&cache.mShift0[base]));
+			__m128 dDeviation = _mm_sub_ps(deviation, _mm_loadu_ps(&cache.mDeviation0[base]));
+			__m128 dTravel = _mm_sub_ps(travel, _mm_loadu_ps(&cache.mTravel0[base]));
+			__m128 bound = _mm_add_ps(dShift, _mm_mul_ps(dDeviation, _mm_add_ps(_mm_add_ps(reach, margin), dTravel)));
+			bound = _mm_add_ps(bound, _mm_add_ps(toleranceBase, _mm_mul_ps(toleranceScale, reach)));
+
+			__m128i stamps = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&mStamp[base]));
+			__m128 moved = _mm_castsi128_ps(_mm_cmpgt_epi32(stamps, epoch));
+
+			retest = (_mm_movemask_ps(_mm_or_ps(_mm_cmpge_ps(bound, margin), moved)) & lanes) != 0;
+		}
+
+		if (retest)
+		{
+			__m128 cx = _mm_loadu_ps(&mCenterX[base]), cy = _mm_loadu_ps(&mCenterY[base]), cz = _mm_loadu_ps(&mCenterZ[base]);
+			__m128 ex = _mm_loadu_ps(&mExtentX[base]), ey = _mm_loadu_ps(&mExtentY[base]), ez = _mm_loadu_ps(&mExtentZ[base]);
+
+			__m128 minDistance = planes.MinDistance(cx, cy, cz, ex, ey, ez);
+
+			// Inside boxes stay inside until one plane passes them, outside
+			// boxes stay outside while the most separating plane still does.
+			// Either way the margin is |minDistance|.
+			_mm_storeu_ps(&cache.mMargin[base], _mm_and_ps(minDistance, absMask));
+
+			__m128 dx = _mm_sub_ps(cx, eyeX), dy = _mm_sub_ps(cy, eyeY), dz = _mm_sub_ps(cz, eyeZ);
+			__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+			__m128 radius = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)), _mm_mul_ps(ez, ez)));
+			_mm_storeu_ps(&cache.mReach[base], _mm_add_ps(distance, radius));
+
+			_mm_storeu_ps(&cache.mShift0[base], shift);
+			_mm_storeu_ps(&cache.mDeviation0[base], deviation);
+			_mm_storeu_ps(&cache.mTravel0[base], travel);
+
+			cache.mInside[group] = (uint8_t)(~(uint32_t)_mm_movemask_ps(_mm_cmplt_ps(minDistance, zero)) & 0xF);
+			tested += PopCount4(lanes);
+		}
+
+		AppendLanes(cache.mInside[group] & lanes, (uint32_t)base, out, outCount);
+	}
+}
+
+void FrustumCuller::Cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+	uint32_t groupCount = (uint32_t)((mCount + Width - 1) / Width);
+
+	// Every job compacts its visible indices in place at the start of its own
+	// slice of 'visible'; the slices are then moved together.
+	visible.resize((size_t)groupCount * Width);
+
+	uint32_t jobCount = (groupCount + GroupsPerJob - 1) / GroupsPerJob;
+	std::vector<uint32_t> jobCounts(jobCount);
+
+	JobSystem::getInstance().ParallelFor(groupCount, GroupsPerJob, [&](uint32_t begin, uint32_t end)
+	{
+		CullGroups(frustum, begin, end, visible.data() + (size_t)begin * Width, jobCounts[begin / GroupsPerJob]);
+	});
+
+	size_t size = 0;
+	for (uint32_t job = 0; job < jobCount; ++job)
+	{
+		size_t start = (size_t)job * GroupsPerJob * Width;
+		if (start != size)
+			std::memmove(visible.data() + size, visible.data() + start, jobCounts[job] * sizeof(uint32_t));
+		size += jobCounts[job];
+	}
+	visible.resize(size);
+}
+
+void FrustumCuller::Cull(const Frustum& frustum, CullCache& cache, std::vector<uint32_t>& visible) const
+{
+	uint32_t groupCount = (uint32_t)((mCount + Width - 1) / Width);
+	size_t padded = (size_t)groupCount * Width;
+
+	bool testAll = !cache.mValid || cache.mOwner != this || cache.mStructure != mStructure;
+	if (testAll)
+	{
+		for (auto* v : { &cache.mMargin, &cache.mReach, &cache.mShift0, &cache.mDeviation0, &cache.mTravel0 })
+			v->resize(padded);
+		cache.mInside.resize(groupCount);
+
+		cache.mShift = cache.mDeviation = cache.mTravel = 0.0;
+		cache.mOwner = this;
+		cache.mStructure = mStructure;
+		cache.mValid = true;
+	}
+
+	visible.resize(padded);
+
+	uint32_t jobCount = (groupCount + GroupsPerJob - 1) / GroupsPerJob;
+	std::vector<uint32_t> jobCounts(jobCount);
+	cache.mJobTested.assign(jobCount, 0);
+
+	JobSystem::getInstance().ParallelFor(groupCount, GroupsPerJob, [&](uint32_t begin, uint32_t end)
+	{
+		uint32_t job = begin / GroupsPerJob;
+		CullGroupsCoherent(frustum, cache, testAll, begin, end,
+			visible.data() + (size_t)begin * Width, jobCounts[job], cache.mJobTested[job]);
+	});
+
+	size_t size = 0;
+	uint32_t tested = 0;
+	for (uint32_t job = 0; job < jobCount; ++job)
+	{
+		size_t start = (size_t)job * GroupsPerJob * Width;
+		if (start != size)
+			std::memmove(visible.data() + size, visible.data() + start, jobCounts[job] * sizeof(uint32_t));
+		size += jobCounts[job];
+		tested += cache.mJobTested[job];
+	}
+	visible.resize(size);
+
+	cache.mEpoch = mEpoch;
+	cache.mTestedCount = tested;
+	cache.mSkippedCount = (uint32_t)mCount - tested;
+}
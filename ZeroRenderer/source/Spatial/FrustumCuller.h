@@ -0,0 +1,142 @@
+#pragma once
+
+//
+// Frustum culling of many world-space boxes.
+//
+// The boxes are kept as center/extents in structure-of-arrays form, padded to
+// a multiple of four, so one SSE instruction tests four boxes against a plane.
+// Large sets are split across the job system; the result is a compact list of
+// the indices of the boxes that are not completely outside the frustum.
+//
+// Culling with a CullCache is temporally coherent: every box remembers how far
+// it was from changing state when it was last tested, and it is only tested
+// again once the view may have moved that far, or the box itself moved.
+//
+
+#include <cstdint>
+#include <vector>
+
+#include "AABB.h"
+
+class FrustumCuller;
+
+// Visibility of one culling set as seen by one view, carried across frames.
+class CullCache
+{
+public:
+	// Accumulates the motion of the view since the last call. A change of
+	// projection forgets everything. Call once per frame before culling.
+	void Update(const XMFLOAT4X4& view, const XMFLOAT4X4& proj);
+
+	// Drops all cached results; the next cull tests every box.
+	void Invalidate() { mValid = false; }
+
+	// boxes tested / reused by the last cull
+	uint32_t TestedCount() const { return mTestedCount; }
+	uint32_t SkippedCount() const { return mSkippedCount; }
+
+private:
+	friend class FrustumCuller;
+
+	// Accumulated per-frame bounds, see Update. Positions are rebased (and
+	// the cache invalidated) once they grow large enough to lose precision.
+	double mShift = 0.0;       // distance moved by the old eye
+	double mDeviation = 0.0;   // norm of (linear part - identity)
+	double mTravel = 0.0;      // distance travelled by the eye
+
+	XMFLOAT3 mEye = { 0.0f, 0.0f, 0.0f };
+	XMFLOAT4X4 mView;
+	XMFLOAT4X4 mProj;
+	bool mHasView = false;
+	bool mValid = false;
+
+	// The set this cache was filled from and the epoch of its last cull.
+	const FrustumCuller* mOwner = nullptr;
+	uint64_t mStructure = 0;
+	uint32_t mEpoch = 0;
+
+	// per box, padded like the culler's arrays
+	std::vector<float> mMargin;    // |distance| the box may move relative to the frustum
+	std::vector<float> mReach;     // |center - eye| + |extents| at test time
+	std::vector<float> mShift0, mDeviation0, mTravel0;
+	std::vector<uint8_t> mInside;  // bit per lane of each group
+
+	std::vector<uint32_t> mJobTested;
+
+	uint32_t mTestedCount = 0;
+	uint32_t mSkippedCount = 0;
+};
+
+class FrustumCuller
+{
+public:
+	static constexpr uint32_t Width = 4;
+
+	void Clear();
+
+	void Reserve(size_t count);
+
+	// Returns the index of the box.
+	uint32_t Add(const AABB& box);
+
+	// Moves the last box into 'index'.
+	void Remove(uint32_t index);
+
+	// Updates a box. Boxes may be set concurrently from several threads as
+	// long as each index is set by one thread; call BeginUpdate first.
+	void Set(uint32_t index, const AABB& box);
+
+	// Starts a new round of Set calls; the caches re-test the boxes set after it.
+	void BeginUpdate() { ++mEpoch; }
+
+	size_t Size() const { return mCount; }
+
+	AABB GetBox(uint32_t index) const
+	{
+		AABB box;
+		box.Min = { mCenterX[index] - mExtentX[index], mCenterY[index] - mExtentY[index], mCenterZ[index] - mExtentZ[index] };
+		box.Max = { mCenterX[index] + mExtentX[index], mCenterY[index] + mExtentY[index], mCenterZ[index] + mExtentZ[index] };
+		return box;
+	}
+
+	XMFLOAT3 GetCenter(uint32_t index) const { return { mCenterX[index], mCenterY[index], mCenterZ[index] }; }
+
+	// Replaces 'visible' with the indices of the boxes that intersect or are
+	// inside the frustum, in increasing order. Several threads may cull the
+	// same set at the same time.
+	void Cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+	// Same result, reusing the cached results of the boxes that cannot have
+	// changed state since the cache's last cull. cache.Update must have been
+	// given the view and projection the frustum was built from.
+	void Cull(const Frustum& frustum, CullCache& cache, std::vector<uint32_t>& visible) const;
+
+private:
+	// groups of Width boxes per job
+	static constexpr uint32_t GroupsPerJob = 256;
+
+	void CullGroups(const Frustum& frustum, uint32_t firstGroup, uint32_t lastGroup, uint32_t* out, uint32_t& outCount) const;
+
+	void CullGroupsCoherent(const Frustum& frustum, CullCache& cache, bool testAll,
+		uint32_t firstGroup, uint32_t lastGroup, uint32_t* out, uint32_t& outCount, uint32_t& tested) const;
+
+	// lane mask of the boxes that exist in 'group'
+	uint32_t LaneMask(uint32_t group) const
+	{
+		size_t base = (size_t)group * Width;
+		return base + Width <= mCount ? 0xFu : (1u << (mCount - base)) - 1;
+	}
+
+	std::vector<float> mCenterX, mCenterY, mCenterZ;
+	std::vector<float> mExtentX, mExtentY, mExtentZ;
+
+	// epoch of the last Set of each box
+	std::vector<uint32_t> mStamp;
+
+	size_t mCount = 0;
+
+	uint32_t mEpoch = 1;
+
+	// bumped by Add, Remove and Clear; caches of another structure start over
+	uint64_t mStructure = 1;
+};
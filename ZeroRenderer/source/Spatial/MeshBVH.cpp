@@ -0,0 +1,505 @@
+#include "MeshBVH.h"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "../Resource/Mesh.h"
+#include "../Utility/JobSystem.h"
+
+namespace
+{
+	// Nodes with more triangles than this bin them on the worker threads.
+	constexpr uint32_t ParallelBinThreshold = 16 * 1024;
+	constexpr uint32_t ParallelBinGrain = 4 * 1024;
+
+	// Subtrees below this size are built by a single thread.
+	constexpr uint32_t MinSubtreeTaskSize = 1024;
+
+	// Leaves may exceed MaxLeafSize up to this size when splitting does not pay off.
+	constexpr uint32_t MaxSahLeafSize = 16;
+
+	struct Bin
+	{
+		AABB Box;
+		uint32_t Count = 0;
+	};
+
+	struct Bins
+	{
+		Bin Axis[3][MeshBVH::BinCount];
+	};
+
+	struct Split
+	{
+		int Axis = -1;
+		uint32_t Bin = 0;     // triangles in bins <= Bin go left
+		float Cost = FLT_MAX;
+	};
+
+	struct Range
+	{
+		uint32_t Node;
+		uint32_t First;
+		uint32_t Count;
+	};
+
+	inline float Component(const XMFLOAT3& v, int axis) { return (&v.x)[axis]; }
+
+	inline void Grow(AABB& box, const XMFLOAT3& p)
+	{
+		box.Min = { std::min(box.Min.x, p.x), std::min(box.Min.y, p.y), std::min(box.Min.z, p.z) };
+		box.Max = { std::max(box.Max.x, p.x), std::max(box.Max.y, p.y), std::max(box.Max.z, p.z) };
+	}
+
+	// Horizontal min/max of the x, y, z lanes; w is ignored.
+	inline float MinXYZ(__m128 v)
+	{
+		__m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+		return _mm_cvtss_f32(_mm_min_ss(_mm_min_ss(v, y), z));
+	}
+
+	inline float MaxXYZ(__m128 v)
+	{
+		__m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+		return _mm_cvtss_f32(_mm_max_ss(_mm_max_ss(v, y), z));
+	}
+
+	// Slab test of all three axes at once. The w lane of the node loads holds
+	// LeftOrFirst/Count and is never looked at.
+	inline bool IntersectNode(const MeshBVH::Node& node, __m128 origin, __m128 invDir, float tMax, float& tNear)
+	{
+		__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.Min.x), origin), invDir);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.Max.x), origin), invDir);
+
+		tNear = std::max(MaxXYZ(_mm_min_ps(t0, t1)), 0.0f);
+		float tFar = std::min(MinXYZ(_mm_max_ps(t0, t1)), tMax);
+		return tNear <= tFar;
+	}
+
+	// Moller-Trumbore, both faces.
+	inline bool IntersectTriangle(
+		const XMFLOAT3& o, const XMFLOAT3& d,
+		const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2,
+		float& t)
+	{
+		XMFLOAT3 e1(v1.x - v0.x, v1.y - v0.y, v1.z - v0.z);
+		XMFLOAT3 e2(v2.x - v0.x, v2.y - v0.y, v2.z - v0.z);
+
+		XMFLOAT3 p(d.y * e2.z - d.z * e2.y, d.z * e2.x - d.x * e2.z, d.x * e2.y - d.y * e2.x);
+		float det = e1.x * p.x + e1.y * p.y + e1.z * p.z;
+		if (std::fabs(det) < 1e-12f)
+			return false;
+		float invDet = 1.0f / det;
+
+		XMFLOAT3 s(o.x - v0.x, o.y - v0.y, o.z - v0.z);
+		float u = (s.x * p.x + s.y * p.y + s.z * p.z) * invDet;
+		if (u < 0.0f || u > 1.0f)
+			return false;
+
+		XMFLOAT3 q(s.y * e1.z - s.z * e1.y, s.z * e1.x - s.x * e1.z, s.x * e1.y - s.y * e1.x);
+		float v = (d.x * q.x + d.y * q.y + d.z * q.z) * invDet;
+		if (v < 0.0f || u + v > 1.0f)
+			return false;
+
+		t = (e2.x * q.x + e2.y * q.y + e2.z * q.z) * invDet;
+		return t >= 0.0f;
+	}
+}
+
+struct MeshBVH::BuildContext
+{
+	std::vector<AABB> TriangleBounds;
+	std::vector<XMFLOAT3> Centroids;
+
+	// Triangle indices, partitioned in place as the tree is built.
+	std::vector<uint32_t> Indices;
+
+	void ComputeBounds(uint32_t first, uint32_t count, AABB& bounds, AABB& centroidBounds) const
+	{
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			uint32_t tri = Indices[i];
+			bounds = AABB::Union(bounds, TriangleBounds[tri]);
+			Grow(centroidBounds, Centroids[tri]);
+		}
+	}
+
+	void BinTriangles(uint32_t first, uint32_t count, const AABB& centroidBounds, Bins& bins) const
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float lo = Component(centroidBounds.Min, axis);
+			float extent = Component(centroidBounds.Max, axis) - lo;
+			if (extent <= 0.0f)
+				continue;
+
+			float scale = BinCount / extent;
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				uint32_t tri = Indices[i];
+				uint32_t b = std::min(BinCount - 1, (uint32_t)((Component(Centroids[tri], axis) - lo) * scale));
+
+				Bin& bin = bins.Axis[axis][b];
+				bin.Box = AABB::Union(bin.Box, TriangleBounds[tri]);
+				++bin.Count;
+			}
+		}
+	}
+
+	// Bounds and bins of a node, split across the worker threads for large nodes.
+	void Gather(uint32_t first, uint32_t count, bool parallel, AABB& bounds, AABB& centroidBounds, Bins& bins) const
+	{
+		if (!parallel || count < ParallelBinThreshold)
+		{
+			ComputeBounds(first, count, bounds, centroidBounds);
+			BinTriangles(first, count, centroidBounds, bins);
+			return;
+		}
+
+		auto& jobSystem = JobSystem::getInstance();
+		uint32_t batchCount = (count + ParallelBinGrain - 1) / ParallelBinGrain;
+
+		std::vector<AABB> partialBounds(batchCount), partialCentroids(batchCount);
+		jobSystem.ParallelFor(count, ParallelBinGrain, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t batch = begin / ParallelBinGrain;
+			ComputeBounds(first + begin, end - begin, partialBounds[batch], partialCentroids[batch]);
+		});
+		for (uint32_t batch = 0; batch < batchCount; ++batch)
+		{
+			bounds = AABB::Union(bounds, partialBounds[batch]);
+			centroidBounds = AABB::Union(centroidBounds, partialCentroids[batch]);
+		}
+
+		std::vector<Bins> partialBins(batchCount);
+		jobSystem.ParallelFor(count, ParallelBinGrain, [&](uint32_t begin, uint32_t end)
+		{
+			BinTriangles(first + begin, end - begin, centroidBounds, partialBins[begin / ParallelBinGrain]);
+		});
+		for (const Bins& partial : partialBins)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				for (uint32_t b = 0; b < BinCount; ++b)
+				{
+					bins.Axis[axis][b].Box = AABB::Union(bins.Axis[axis][b].Box, partial.Axis[axis][b].Box);
+					bins.Axis[axis][b].Count += partial.Axis[axis][b].Count;
+				}
+			}
+		}
+	}
+
+	// Fills node's bounds. Returns true and the end of the left half in 'mid'
+	// if the node should be split, false if it becomes a leaf.
+	bool SplitNode(uint32_t first, uint32_t count, bool parallel, Node& node, uint32_t& mid)
+	{
+		AABB bounds, centroidBounds;
+		Bins bins;
+		Gather(first, count, parallel && count > MaxLeafSize, bounds, centroidBounds, bins);
+
+		node.Min = bounds.Min;
+		node.Max = bounds.Max;
+
+		if (count <= MaxLeafSize)
+			return false;
+
+		// Sweep the bins from both sides and keep the cheapest split plane.
+		Split best;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const Bin* axisBins = bins.Axis[axis];
+
+			float rightArea[BinCount];
+			uint32_t rightCount[BinCount];
+			AABB box;
+			uint32_t sum = 0;
+			for (int b = BinCount - 1; b > 0; --b)
+			{
+				box = AABB::Union(box, axisBins[b].Box);
+				sum += axisBins[b].Count;
+				rightArea[b] = box.IsEmpty() ? 0.0f : box.HalfArea();
+				rightCount[b] = sum;
+			}
+
+			box = AABB();
+			sum = 0;
+			for (uint32_t b = 0; b + 1 < BinCount; ++b)
+			{
+				box = AABB::Union(box, axisBins[b].Box);
+				sum += axisBins[b].Count;
+				if (sum == 0 || rightCount[b + 1] == 0)
+					continue;
+
+				float cost = sum * box.HalfArea() + rightCount[b + 1] * rightArea[b + 1];
+				if (cost < best.Cost)
+				{
+					best.Axis = axis;
+					best.Bin = b;
+					best.Cost = cost;
+				}
+			}
+		}
+
+		// All centroids coincide; no plane separates them.
+		if (best.Axis < 0)
+			return false;
+
+		float leafCost = count * bounds.HalfArea();
+		if (best.Cost >= leafCost && count <= MaxSahLeafSize)
+			return false;
+
+		float lo = Component(centroidBounds.Min, best.Axis);
+		float scale = BinCount / (Component(centroidBounds.Max, best.Axis) - lo);
+
+		auto middle = std::partition(Indices.begin() + first, Indices.begin() + first + count, [&](uint32_t tri)
+		{
+			uint32_t b = std::min(BinCount - 1, (uint32_t)((Component(Centroids[tri], best.Axis) - lo) * scale));
+			return b <= best.Bin;
+		});
+		mid = (uint32_t)(middle - Indices.begin());
+		return true;
+	}
+
+	// Builds the subtree of nodes[index] on the calling thread.
+	void BuildSubtree(std::vector<Node>& nodes, uint32_t index, uint32_t first, uint32_t count)
+	{
+		uint32_t mid;
+		if (!SplitNode(first, count, false, nodes[index], mid))
+		{
+			nodes[index].LeftOrFirst = first;
+			nodes[index].Count = count;
+			return;
+		}
+
+		uint32_t left = (uint32_t)nodes.size();
+		nodes.emplace_back();
+		nodes.emplace_back();
+		nodes[index].LeftOrFirst = left;
+		nodes[index].Count = 0;
+
+		BuildSubtree(nodes, left, first, mid - first);
+		BuildSubtree(nodes, left + 1, mid, first + count - mid);
+	}
+};
+
+MeshBVH::MeshBVH(std::vector<XMFLOAT3> triangleVertices)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	const uint32_t triangleCount = (uint32_t)(triangleVertices.size() / 3);
+	if (triangleCount == 0)
+		return;
+
+	auto& jobSystem = JobSystem::getInstance();
+
+	BuildContext ctx;
+	ctx.TriangleBounds.resize(triangleCount);
+	ctx.Centroids.resize(triangleCount);
+	ctx.Indices.resize(triangleCount);
+
+	jobSystem.ParallelFor(triangleCount, ParallelBinGrain, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			AABB box;
+			Grow(box, triangleVertices[i * 3 + 0]);
+			Grow(box, triangleVertices[i * 3 + 1]);
+			Grow(box, triangleVertices[i * 3 + 2]);
+
+			ctx.TriangleBounds[i] = box;
+			ctx.Centroids[i] = XMFLOAT3(
+				(box.Min.x + box.Max.x) * 0.5f,
+				(box.Min.y + box.Max.y) * 0.5f,
+				(box.Min.z + box.Max.z) * 0.5f);
+			ctx.Indices[i] = i;
+		}
+	});
+
+	// Split the top of the tree on this thread (binning in parallel) until
+	// there are enough independent subtrees to keep every thread busy.
+	uint32_t subtreeTaskSize = std::max(MinSubtreeTaskSize, triangleCount / (jobSystem.ThreadCount() * 4));
+
+	mNodes.reserve(2 * triangleCount / MaxLeafSize + 1);
+	mNodes.emplace_back();
+
+	std::vector<Range> pending = { { 0, 0, triangleCount } };
+	std::vector<Range> tasks;
+	while (!pending.empty())
+	{
+		Range range = pending.back();
+		pending.pop_back();
+
+		if (range.Count <= subtreeTaskSize)
+		{
+			tasks.push_back(range);
+			continue;
+		}
+
+		uint32_t mid;
+		if (!ctx.SplitNode(range.First, range.Count, true, mNodes[range.Node], mid))
+		{
+			mNodes[range.Node].LeftOrFirst = range.First;
+			mNodes[range.Node].Count = range.Count;
+			continue;
+		}
+
+		uint32_t left = (uint32_t)mNodes.size();
+		mNodes.emplace_back();
+		mNodes.emplace_back();
+		mNodes[range.Node].LeftOrFirst = left;
+		mNodes[range.Node].Count = 0;
+
+		pending.push_back({ left, range.First, mid - range.First });
+		pending.push_back({ left + 1, mid, range.First + range.Count - mid });
+	}
+
+	// Each task owns a disjoint slice of ctx.Indices, so the subtrees can be
+	// built concurrently into local arrays and appended afterwards.
+	std::vector<std::vector<Node>> subtrees(tasks.size());
+	jobSystem.ParallelFor((uint32_t)tasks.size(), 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			subtrees[i].emplace_back();
+			ctx.BuildSubtree(subtrees[i], 0, tasks[i].First, tasks[i].Count);
+		}
+	});
+
+	for (size_t i = 0; i < tasks.size(); ++i)
+	{
+		const std::vector<Node>& local = subtrees[i];
+
+		// local node k > 0 lands at offset + k
+		uint32_t offset = (uint32_t)mNodes.size() - 1;
+		auto relocate = [&](Node node)
+		{
+			if (!node.IsLeaf())
+				node.LeftOrFirst += offset;
+			return node;
+		};
+
+		mNodes[tasks[i].Node] = relocate(local[0]);
+		for (size_t k = 1; k < local.size(); ++k)
+			mNodes.push_back(relocate(local[k]));
+	}
+
+	// Store the triangles in leaf order so a leaf reads one contiguous run.
+	mVertices.resize(triangleCount * 3);
+	for (uint32_t i = 0; i < triangleCount; ++i)
+	{
+		uint32_t tri = ctx.Indices[i];
+		mVertices[i * 3 + 0] = triangleVertices[tri * 3 + 0];
+		mVertices[i * 3 + 1] = triangleVertices[tri * 3 + 1];
+		mVertices[i * 3 + 2] = triangleVertices[tri * 3 + 2];
+	}
+	mTriangleIds = std::move(ctx.Indices);
+
+	mBuildMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+AABB MeshBVH::Bounds() const
+{
+	AABB box;
+	if (!mNodes.empty())
+	{
+		box.Min = mNodes[0].Min;
+		box.Max = mNodes[0].Max;
+	}
+	return box;
+}
+
+bool MeshBVH::RayCast(const XMFLOAT3& origin, const XMFLOAT3& dir, float maxT, float& t, uint32_t* triangle) const
+{
+	if (mNodes.empty())
+		return false;
+
+	__m128 o = _mm_set_ps(0.0f, origin.z, origin.y, origin.x);
+	__m128 invDir = _mm_set_ps(0.0f, 1.0f / dir.z, 1.0f / dir.y, 1.0f / dir.x);
+
+	struct Entry { uint32_t Index; float T; };
+	Entry stack[256];
+	uint32_t stackSize = 0;
+
+	float best = maxT;
+	uint32_t bestTriangle = UINT32_MAX;
+
+	float tNear;
+	if (!IntersectNode(mNodes[0], o, invDir, best, tNear))
+		return false;
+	stack[stackSize++] = { 0, tNear };
+
+	while (stackSize > 0)
+	{
+		Entry entry = stack[--stackSize];
+		if (entry.T > best)
+			continue;
+
+		const Node& node = mNodes[entry.Index];
+		if (node.IsLeaf())
+		{
+			for (uint32_t i = node.LeftOrFirst; i < node.LeftOrFirst + node.Count; ++i)
+			{
+				float hitT;
+				if (IntersectTriangle(origin, dir, mVertices[i * 3 + 0], mVertices[i * 3 + 1], mVertices[i * 3 + 2], hitT) &&
+					hitT < best)
+				{
+					best = hitT;
+					bestTriangle = i;
+				}
+			}
+			continue;
+		}
+
+		float t1, t2;
+		bool hit1 = IntersectNode(mNodes[node.LeftOrFirst], o, invDir, best, t1);
+		bool hit2 = IntersectNode(mNodes[node.LeftOrFirst + 1], o, invDir, best, t2);
+
+		// push the far child first so the near one is visited next
+		if (hit1 && hit2)
+		{
+			bool leftFirst = t1 <= t2;
+			stack[stackSize++] = leftFirst ? Entry{ node.LeftOrFirst + 1, t2 } : Entry{ node.LeftOrFirst, t1 };
+			stack[stackSize++] = leftFirst ? Entry{ node.LeftOrFirst, t1 } : Entry{ node.LeftOrFirst + 1, t2 };
+		}
+		else if (hit1)
+			stack[stackSize++] = { node.LeftOrFirst, t1 };
+		else if (hit2)
+			stack[stackSize++] = { node.LeftOrFirst + 1, t2 };
+	}
+
+	if (bestTriangle == UINT32_MAX)
+		return false;
+
+	t = best;
+	if (triangle)
+		*triangle = mTriangleIds[bestTriangle];
+	return true;
+}
+
+void BuildSubmeshBVHs(MeshGeometry& geo)
+{
+	auto vertexData = static_cast<const uint8_t*>(geo.VertexBufferCPU->GetBufferPointer());
+	auto indexData = geo.IndexBufferCPU->GetBufferPointer();
+	bool indices16 = geo.IndexFormat == DXGI_FORMAT_R16_UINT;
+
+	for (auto& [name, submesh] : geo.DrawArgs)
+	{
+		std::vector<XMFLOAT3> vertices(submesh.IndexCount);
+		for (UINT i = 0; i < submesh.IndexCount; ++i)
+		{
+			UINT index = indices16 ?
+				static_cast<const uint16_t*>(indexData)[submesh.StartIndexLocation + i] :
+				static_cast<const uint32_t*>(indexData)[submesh.StartIndexLocation + i];
+
+			// Vertex::Pos is the first member of every vertex.
+			std::memcpy(&vertices[i], vertexData + (index + submesh.BaseVertexLocation) * geo.VertexByteStride, sizeof(XMFLOAT3));
+		}
+
+		submesh.BVH = std::make_shared<MeshBVH>(std::move(vertices));
+	}
+}
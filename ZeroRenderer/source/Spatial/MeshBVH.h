@@ -0,0 +1,71 @@
+#pragma once
+
+//
+// Triangle BVH of one submesh, used for exact ray queries (picking).
+//
+// Built top-down with the binned surface area heuristic. Large nodes are
+// binned on the worker threads, and once there are enough independent
+// subtrees they are built in parallel. Nodes are 32 bytes and siblings are
+// stored next to each other, so a node only needs one child index.
+//
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AABB.h"
+
+struct MeshGeometry;
+
+class MeshBVH
+{
+public:
+	struct Node
+	{
+		XMFLOAT3 Min;
+		uint32_t LeftOrFirst;   // inner node: left child (right = left + 1); leaf: first triangle
+		XMFLOAT3 Max;
+		uint32_t Count;         // triangles in a leaf, 0 for inner nodes
+
+		bool IsLeaf() const { return Count != 0; }
+	};
+
+	static constexpr uint32_t MaxLeafSize = 4;
+	static constexpr uint32_t BinCount = 16;
+
+	// triangleVertices holds three positions per triangle.
+	explicit MeshBVH(std::vector<XMFLOAT3> triangleVertices);
+
+	// Nearest hit of the ray origin + t * dir (dir normalized) with t <= maxT.
+	// On a hit, t is the distance and triangle the index of the triangle in
+	// the submesh (index buffer order).
+	bool RayCast(const XMFLOAT3& origin, const XMFLOAT3& dir, float maxT, float& t, uint32_t* triangle = nullptr) const;
+
+	AABB Bounds() const;
+
+	// The triangles in leaf order, three vertices each; nearby triangles are
+	// close in memory.
+	const std::vector<XMFLOAT3>& Vertices() const { return mVertices; }
+
+	size_t NodeCount() const { return mNodes.size(); }
+	size_t TriangleCount() const { return mTriangleIds.size(); }
+
+	float BuildMilliseconds() const { return mBuildMilliseconds; }
+
+private:
+	struct BuildContext;
+
+	std::vector<Node> mNodes;
+
+	// Triangle vertices in leaf order, three per triangle.
+	std::vector<XMFLOAT3> mVertices;
+
+	// Original index of each triangle in leaf order.
+	std::vector<uint32_t> mTriangleIds;
+
+	float mBuildMilliseconds = 0.0f;
+};
+
+// Reads the CPU copies of the vertex and index buffers and builds a BVH for
+// every submesh in geo.DrawArgs.
+void BuildSubmeshBVHs(MeshGeometry& geo);
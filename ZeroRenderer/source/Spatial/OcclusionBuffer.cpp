@@ -0,0 +1,378 @@
+#include "OcclusionBuffer.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "../Utility/JobSystem.h"
+
+namespace
+{
+	constexpr uint32_t TileCount = OcclusionBuffer::TilesX * OcclusionBuffer::TilesY;
+
+	// Clip-space triangles are clipped against z = 0 only; x and y are handled
+	// by the screen bounds of the triangle.
+	uint32_t ClipNear(const XMFLOAT4* in, XMFLOAT4* out)
+	{
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			const XMFLOAT4& a = in[i];
+			const XMFLOAT4& b = in[(i + 1) % 3];
+
+			if (a.z >= 0.0f)
+				out[count++] = a;
+
+			if ((a.z >= 0.0f) != (b.z >= 0.0f))
+			{
+				float t = a.z / (a.z - b.z);
+				out[count++] = XMFLOAT4(
+					a.x + (b.x - a.x) * t,
+					a.y + (b.y - a.y) * t,
+					0.0f,
+					a.w + (b.w - a.w) * t);
+			}
+		}
+		return count;
+	}
+
+	// All three vertices are outside the same clip plane.
+	bool OutsideSamePlane(const XMFLOAT4* v)
+	{
+		return (v[0].x >  v[0].w && v[1].x >  v[1].w && v[2].x >  v[2].w) ||
+		       (v[0].x < -v[0].w && v[1].x < -v[1].w && v[2].x < -v[2].w) ||
+		       (v[0].y >  v[0].w && v[1].y >  v[1].w && v[2].y >  v[2].w) ||
+		       (v[0].y < -v[0].w && v[1].y < -v[1].w && v[2].y < -v[2].w) ||
+		       (v[0].z < 0.0f && v[1].z < 0.0f && v[2].z < 0.0f);
+	}
+
+	// Max of 2 x 2 texels of src (srcWidth wide) for the dst texels [x0, x1) x [y0, y1).
+	void Downsample(const float* src, uint32_t srcWidth, float* dst, uint32_t dstWidth,
+		uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+	{
+		for (uint32_t y = y0; y < y1; ++y)
+		{
+			const float* row0 = src + (2 * y) * srcWidth;
+			const float* row1 = row0 + srcWidth;
+			for (uint32_t x = x0; x < x1; ++x)
+			{
+				dst[y * dstWidth + x] = std::max(
+					std::max(row0[2 * x], row0[2 * x + 1]),
+					std::max(row1[2 * x], row1[2 * x + 1]));
+			}
+		}
+	}
+}
+
+OcclusionBuffer::OcclusionBuffer()
+{
+	for (uint32_t level = 0; level < LevelCount; ++level)
+		mLevels[level].assign((size_t)(Width >> level) * (Height >> level), 1.0f);
+
+	XMStoreFloat4x4(&mViewProj, XMMatrixIdentity());
+}
+
+void OcclusionBuffer::Render(const XMFLOAT4X4& viewProj, const std::vector<Occluder>& occluders)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	mViewProj = viewProj;
+	std::fill(mLevels[0].begin(), mLevels[0].end(), 1.0f);
+
+	mFirstTriangle.resize(occluders.size() + 1);
+	mFirstTriangle[0] = 0;
+	for (size_t i = 0; i < occluders.size(); ++i)
+		mFirstTriangle[i + 1] = mFirstTriangle[i] + occluders[i].TriangleCount;
+
+	uint32_t triangleCount = mFirstTriangle.back();
+	uint32_t jobCount = (triangleCount + SetupGrain - 1) / SetupGrain;
+
+	// The jobs keep their storage from frame to frame.
+	if (mJobs.size() < jobCount)
+		mJobs.resize(jobCount);
+
+	for (uint32_t i = 0; i < jobCount; ++i)
+	{
+		mJobs[i].Triangles.clear();
+		for (auto& bin : mJobs[i].Bins)
+			bin.clear();
+	}
+
+	JobSystem::getInstance().ParallelFor(triangleCount, SetupGrain, [&](uint32_t begin, uint32_t end)
+	{
+		SetupTriangles(occluders, begin, end, mJobs[begin / SetupGrain]);
+	});
+
+	// Every tile only writes its own pixels and their texels in the upper
+	// levels that still lie inside the tile.
+	JobSystem::getInstance().ParallelFor(TileCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t tile = begin; tile < end; ++tile)
+			RasterizeTile(tile, jobCount);
+	});
+
+	BuildLevels();
+
+	mOccluderCount = (uint32_t)occluders.size();
+	mTriangleCount = triangleCount;
+	mRasterizedCount = 0;
+	for (uint32_t i = 0; i < jobCount; ++i)
+		mRasterizedCount += (uint32_t)mJobs[i].Triangles.size();
+
+	mRenderMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void OcclusionBuffer::SetupTriangles(const std::vector<Occluder>& occluders, uint32_t begin, uint32_t end, SetupJob& job) const
+{
+	XMMATRIX viewProj = XMLoadFloat4x4(&mViewProj);
+
+	// occluder of the first triangle
+	uint32_t occluder = (uint32_t)(std::upper_bound(mFirstTriangle.begin(), mFirstTriangle.end(), begin) - mFirstTriangle.begin()) - 1;
+
+	XMMATRIX toClip = XMMatrixMultiply(XMLoadFloat4x4(&occluders[occluder].World), viewProj);
+
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		while (i >= mFirstTriangle[occluder + 1])
+		{
+			++occluder;
+			toClip = XMMatrixMultiply(XMLoadFloat4x4(&occluders[occluder].World), viewProj);
+		}
+
+		const XMFLOAT3* vertices = occluders[occluder].Vertices + (size_t)(i - mFirstTriangle[occluder]) * 3;
+
+		XMFLOAT4 clip[3];
+		for (uint32_t k = 0; k < 3; ++k)
+			XMStoreFloat4(&clip[k], XMVector3Transform(XMLoadFloat3(&vertices[k]), toClip));
+
+		if (OutsideSamePlane(clip))
+			continue;
+
+		if (clip[0].z >= 0.0f && clip[1].z >= 0.0f && clip[2].z >= 0.0f)
+		{
+			AddTriangle(clip, job);
+			continue;
+		}
+
+		// Crosses the near plane: the clipped polygon has three or four vertices.
+		XMFLOAT4 polygon[4];
+		uint32_t count = ClipNear(clip, polygon);
+		for (uint32_t k = 2; k < count; ++k)
+		{
+			XMFLOAT4 fan[3] = { polygon[0], polygon[k - 1], polygon[k] };
+			AddTriangle(fan, job);
+		}
+	}
+}
+
+void OcclusionBuffer::AddTriangle(const XMFLOAT4* clip, SetupJob& job) const
+{
+	float x[3], y[3], z[3];
+	for (uint32_t k = 0; k < 3; ++k)
+	{
+		// On the near plane w is still positive for a perspective projection.
+		if (clip[k].w <= 1e-6f)
+			return;
+
+		float invW = 1.0f / clip[k].w;
+		x[k] = (clip[k].x * invW * 0.5f + 0.5f) * Width;
+		y[k] = (0.5f - clip[k].y * invW * 0.5f) * Height;
+		z[k] = clip[k].z * invW;
+	}
+
+	// Clockwise on screen (y down) is front facing, as in the default
+	// rasterizer state. Degenerate triangles cover nothing.
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(area > 0.0f))
+		return;
+
+	float minX = std::min({ x[0], x[1], x[2] });
+	float maxX = std::max({ x[0], x[1], x[2] });
+	float minY = std::min({ y[0], y[1], y[2] });
+	float maxY = std::max({ y[0], y[1], y[2] });
+	if (maxX < 0.0f || maxY < 0.0f || minX >= (float)Width || minY >= (float)Height)
+		return;
+
+	Triangle tri;
+	tri.MinX = (uint16_t)std::max(minX, 0.0f);
+	tri.MinY = (uint16_t)std::max(minY, 0.0f);
+	tri.MaxX = (uint16_t)std::min(maxX, (float)(Width - 1));
+	tri.MaxY = (uint16_t)std::min(maxY, (float)(Height - 1));
+
+	for (uint32_t k = 0; k < 3; ++k)
+	{
+		uint32_t n = (k + 1) % 3;
+		tri.EdgeA[k] = y[k] - y[n];
+		tri.EdgeB[k] = x[n] - x[k];
+		tri.EdgeC[k] = -(tri.EdgeA[k] * x[k] + tri.EdgeB[k] * y[k]);
+	}
+
+	float dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+	float dzdy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+
+	// The depth is sampled at pixel centers; push it to the farthest value
+	// inside the pixel, so the occluder is never nearer than it really is.
+	tri.DepthA = dzdx;
+	tri.DepthB = dzdy;
+	tri.DepthC = z[0] - dzdx * x[0] - dzdy * y[0] + 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+	tri.MaxDepth = std::max({ z[0], z[1], z[2] });
+
+	uint32_t index = (uint32_t)job.Triangles.size();
+	job.Triangles.push_back(tri);
+
+	for (uint32_t ty = tri.MinY / TileHeight; ty <= tri.MaxY / TileHeight; ++ty)
+	{
+		for (uint32_t tx = tri.MinX / TileWidth; tx <= tri.MaxX / TileWidth; ++tx)
+			job.Bins[ty * TilesX + tx].push_back(index);
+	}
+}
+
+void OcclusionBuffer::RasterizeTile(uint32_t tile, uint32_t jobCount)
+{
+	const uint32_t tileX = (tile % TilesX) * TileWidth;
+	const uint32_t tileY = (tile / TilesX) * TileHeight;
+
+	float* depth = mLevels[0].data();
+
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+
+	// Bins are walked in job order, the order the triangles were submitted in.
+	for (uint32_t j = 0; j < jobCount; ++j)
+	{
+		const SetupJob& job = mJobs[j];
+		for (uint32_t index : job.Bins[tile])
+		{
+			const Triangle& tri = job.Triangles[index];
+
+			uint32_t x0 = std::max<uint32_t>(tri.MinX, tileX) & ~3u;
+			uint32_t x1 = std::min<uint32_t>(tri.MaxX, tileX + TileWidth - 1);
+			uint32_t y0 = std::max<uint32_t>(tri.MinY, tileY);
+			uint32_t y1 = std::min<uint32_t>(tri.MaxY, tileY + TileHeight - 1);
+
+			__m128 xs = _mm_add_ps(_mm_set1_ps((float)x0), laneOffsets);
+
+			__m128 edgeA[3], edgeStep[3];
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				edgeA[k] = _mm_set1_ps(tri.EdgeA[k]);
+				edgeStep[k] = _mm_set1_ps(tri.EdgeA[k] * 4.0f);
+			}
+			__m128 depthA = _mm_set1_ps(tri.DepthA);
+			__m128 depthStep = _mm_set1_ps(tri.DepthA * 4.0f);
+			__m128 maxDepth = _mm_set1_ps(tri.MaxDepth);
+
+			for (uint32_t y = y0; y <= y1; ++y)
+			{
+				float yc = (float)y + 0.5f;
+
+				__m128 e[3];
+				for (uint32_t k = 0; k < 3; ++k)
+					e[k] = _mm_add_ps(_mm_mul_ps(edgeA[k], xs), _mm_set1_ps(tri.EdgeB[k] * yc + tri.EdgeC[k]));
+				__m128 z = _mm_add_ps(_mm_mul_ps(depthA, xs), _mm_set1_ps(tri.DepthB * yc + tri.DepthC));
+
+				float* row = depth + y * Width;
+				for (uint32_t x = x0; x <= x1; x += 4)
+				{
+					__m128 inside = _mm_and_ps(_mm_and_ps(
+						_mm_cmpge_ps(e[0], zero),
+						_mm_cmpge_ps(e[1], zero)),
+						_mm_cmpge_ps(e[2], zero));
+
+					if (_mm_movemask_ps(inside))
+					{
+						__m128 old = _mm_loadu_ps(row + x);
+						__m128 nearer = _mm_min_ps(old, _mm_min_ps(z, maxDepth));
+						_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+					}
+
+					for (uint32_t k = 0; k < 3; ++k)
+						e[k] = _mm_add_ps(e[k], edgeStep[k]);
+					z = _mm_add_ps(z, depthStep);
+				}
+			}
+		}
+	}
+
+	// The levels whose texels still fit in one tile.
+	for (uint32_t level = 1; level < LevelCount && (TileWidth >> level) && (TileHeight >> level); ++level)
+	{
+		Downsample(mLevels[level - 1].data(), Width >> (level - 1), mLevels[level].data(), Width >> level,
+			tileX >> level, tileY >> level, (tileX + TileWidth) >> level, (tileY + TileHeight) >> level);
+	}
+}
+
+void OcclusionBuffer::BuildLevels()
+{
+	uint32_t first = 1;
+	while ((TileWidth >> first) && (TileHeight >> first))
+		++first;
+
+	for (uint32_t level = first; level < LevelCount; ++level)
+	{
+		Downsample(mLevels[level - 1].data(), Width >> (level - 1), mLevels[level].data(), Width >> level,
+			0, 0, Width >> level, Height >> level);
+	}
+}
+
+bool OcclusionBuffer::IsVisible(const AABB& box) const
+{
+	XMMATRIX viewProj = XMLoadFloat4x4(&mViewProj);
+
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float minZ = FLT_MAX;
+
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		XMVECTOR corner = XMVectorSet(
+			(i & 1) ? box.Max.x : box.Min.x,
+			(i & 2) ? box.Max.y : box.Min.y,
+			(i & 4) ? box.Max.z : box.Min.z,
+			1.0f);
+
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(corner, viewProj));
+
+		// The box reaches the near plane: nothing can be in front of it.
+		if (clip.z < 0.0f || clip.w <= 1e-6f)
+			return true;
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * Width;
+		float y = (0.5f - clip.y * invW * 0.5f) * Height;
+
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, clip.z * invW);
+	}
+
+	// Nothing is known outside the buffer.
+	if (maxX < 0.0f || maxY < 0.0f || minX >= (float)Width || minY >= (float)Height)
+		return true;
+
+	// A pixel takes an occluder's depth when its center is covered, even if
+	// the silhouette leaves part of it open. One more pixel on every side
+	// reaches a center past the silhouette.
+	uint32_t x0 = (uint32_t)std::max(minX - 1.0f, 0.0f);
+	uint32_t y0 = (uint32_t)std::max(minY - 1.0f, 0.0f);
+	uint32_t x1 = (uint32_t)std::min(maxX + 1.0f, (float)(Width - 1));
+	uint32_t y1 = (uint32_t)std::min(maxY + 1.0f, (float)(Height - 1));
+
+	// The finest level at which the rectangle spans at most 4 x 4 texels.
+	uint32_t level = 0;
+	while (level + 1 < LevelCount && ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3))
+		++level;
+
+	for (uint32_t y = y0 >> level; y <= y1 >> level; ++y)
+	{
+		for (uint32_t x = x0 >> level; x <= x1 >> level; ++x)
+		{
+			if (GetMaxDepth(level, x, y) >= minZ)
+				return true;
+		}
+	}
+	return false;
+}
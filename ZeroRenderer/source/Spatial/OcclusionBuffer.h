@@ -0,0 +1,105 @@
+#pragma once
+
+//
+// Software depth buffer for occlusion culling on the CPU.
+//
+// A few large occluder meshes are rasterized at low resolution. Triangles are
+// set up and binned into screen tiles on the job system, then every tile is
+// rasterized by one job, four pixels per SSE instruction. A max-depth mip
+// chain built on top answers "is anything of this box in front of the
+// occluders" with a handful of texel reads.
+//
+// The test is conservative: a box is only reported hidden if every pixel it
+// may cover has been written by an occluder that is nearer than the box.
+// Occluders write the pixels whose centers they cover, so the test also reads
+// a ring of one pixel around the box's rectangle.
+//
+
+#include <cstdint>
+#include <vector>
+
+#include "AABB.h"
+
+class OcclusionBuffer
+{
+public:
+	static constexpr uint32_t Width = 320;
+	static constexpr uint32_t Height = 192;
+
+	static constexpr uint32_t TileWidth = 32;
+	static constexpr uint32_t TileHeight = 16;
+	static constexpr uint32_t TilesX = Width / TileWidth;
+	static constexpr uint32_t TilesY = Height / TileHeight;
+
+	// Mip levels down to 5 x 3 texels.
+	static constexpr uint32_t LevelCount = 7;
+
+	struct Occluder
+	{
+		const XMFLOAT3* Vertices;   // three positions per triangle, in local space
+		uint32_t TriangleCount;
+		XMFLOAT4X4 World;
+	};
+
+	OcclusionBuffer();
+
+	// Clears the buffer and renders the occluders as seen through viewProj
+	// (row vectors, z in [0, 1]). Back faces are skipped like the GPU does.
+	void Render(const XMFLOAT4X4& viewProj, const std::vector<Occluder>& occluders);
+
+	// False if the world-space box is completely behind the occluders. May be
+	// called from several threads at once.
+	bool IsVisible(const AABB& box) const;
+
+	// z / w of the nearest occluder at pixel (x, y) (y down), 1 if none.
+	float GetDepth(uint32_t x, uint32_t y) const { return mLevels[0][y * Width + x]; }
+
+	// Farthest depth in texel (x, y) of a mip level.
+	float GetMaxDepth(uint32_t level, uint32_t x, uint32_t y) const { return mLevels[level][y * (Width >> level) + x]; }
+
+	uint32_t OccluderCount() const { return mOccluderCount; }
+	uint32_t TriangleCount() const { return mTriangleCount; }       // submitted
+	uint32_t RasterizedCount() const { return mRasterizedCount; }   // after clipping and back-face culling
+	float RenderMilliseconds() const { return mRenderMilliseconds; }
+
+private:
+	// triangles per setup job
+	static constexpr uint32_t SetupGrain = 1024;
+
+	// Edge functions and depth plane of a screen-space triangle. A pixel center
+	// (x, y) is covered if all three EdgeA * x + EdgeB * y + EdgeC are >= 0.
+	struct Triangle
+	{
+		float EdgeA[3], EdgeB[3], EdgeC[3];
+		float DepthA, DepthB, DepthC;   // z = DepthA * x + DepthB * y + DepthC
+		float MaxDepth;
+		uint16_t MinX, MinY, MaxX, MaxY;   // pixel bounds, inclusive
+	};
+
+	struct SetupJob
+	{
+		std::vector<Triangle> Triangles;
+		std::vector<uint32_t> Bins[TilesX * TilesY];   // indices into Triangles
+	};
+
+	void SetupTriangles(const std::vector<Occluder>& occluders, uint32_t begin, uint32_t end, SetupJob& job) const;
+
+	void AddTriangle(const XMFLOAT4* clip, SetupJob& job) const;
+
+	void RasterizeTile(uint32_t tile, uint32_t jobCount);
+
+	void BuildLevels();
+
+	XMFLOAT4X4 mViewProj;
+
+	// Level 0 is the depth buffer, level i + 1 holds the max of 2 x 2 texels of level i.
+	std::vector<float> mLevels[LevelCount];
+
+	std::vector<SetupJob> mJobs;
+	std::vector<uint32_t> mFirstTriangle;   // prefix sum over the occluders
+
+	uint32_t mOccluderCount = 0;
+	uint32_t mTriangleCount = 0;
+	uint32_t mRasterizedCount = 0;
+	float mRenderMilliseconds = 0.0f;
+};
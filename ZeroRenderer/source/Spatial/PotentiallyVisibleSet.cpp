@@ -0,0 +1,259 @@
+#include "PotentiallyVisibleSet.h"
+
+#include <chrono>
+#include <map>
+#include <random>
+
+#include "DynamicAABBTree.h"
+#include "MeshBVH.h"
+
+#include "../Utility/JobSystem.h"
+
+namespace
+{
+	struct Occluder
+	{
+		const MeshBVH* Mesh;
+		XMFLOAT4X4 InvWorld;
+	};
+
+	// Item whose triangles the ray from origin hits first within 'length', or -1.
+	int32_t FirstHit(const DynamicAABBTree& tree, const std::vector<Occluder>& occluders,
+		const XMFLOAT3& origin, const XMFLOAT3& dir, float length)
+	{
+		int32_t nearest = -1;
+
+		tree.RayCast(origin, dir, length, [&](int32_t proxy, float maxT)
+		{
+			uint32_t item = tree.GetUserData(proxy);
+			const Occluder& occluder = occluders[item];
+
+			XMMATRIX invWorld = XMLoadFloat4x4(&occluder.InvWorld);
+			XMVECTOR localOrigin = XMVector3TransformCoord(XMLoadFloat3(&origin), invWorld);
+			XMVECTOR localDir = XMVector3TransformNormal(XMLoadFloat3(&dir), invWorld);
+
+			// Local distances are world distances times the length of localDir.
+			float localScale = XMVectorGetX(XMVector3Length(localDir));
+
+			XMFLOAT3 o, d;
+			XMStoreFloat3(&o, localOrigin);
+			XMStoreFloat3(&d, localDir / localScale);
+
+			float t;
+			if (!occluder.Mesh->RayCast(o, d, maxT * localScale, t))
+				return maxT;
+
+			nearest = (int32_t)item;
+			return t / localScale;
+		});
+
+		return nearest;
+	}
+
+	XMFLOAT3 RandomPoint(const AABB& box, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		return XMFLOAT3(
+			box.Min.x + (box.Max.x - box.Min.x) * unit(rng),
+			box.Min.y + (box.Max.y - box.Min.y) * unit(rng),
+			box.Min.z + (box.Max.z - box.Min.z) * unit(rng));
+	}
+}
+
+void PotentiallyVisibleSet::Clear()
+{
+	mDims[0] = mDims[1] = mDims[2] = 0;
+	mItemCount = 0;
+	mOccluders.clear();
+	mCellSets.clear();
+	mSetOffsets.clear();
+	mCode.clear();
+	++mBakeId;
+}
+
+void PotentiallyVisibleSet::Bake(const std::vector<Item>& items, const Settings& settings)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	Clear();
+
+	if (settings.Bounds.IsEmpty() || settings.CellSize <= 0.0f)
+		return;
+
+	mOrigin = settings.Bounds.Min;
+	mCellSize = settings.CellSize;
+	mDims[0] = std::max(1u, (uint32_t)std::ceil((settings.Bounds.Max.x - settings.Bounds.Min.x) / mCellSize));
+	mDims[1] = std::max(1u, (uint32_t)std::ceil((settings.Bounds.Max.y - settings.Bounds.Min.y) / mCellSize));
+	mDims[2] = std::max(1u, (uint32_t)std::ceil((settings.Bounds.Max.z - settings.Bounds.Min.z) / mCellSize));
+	mItemCount = (uint32_t)items.size();
+
+	// The items that block the view, found through a tree of their boxes.
+	DynamicAABBTree tree(0.0f);
+	std::vector<Occluder> occluders(items.size());
+	mOccluders.assign((mItemCount + 63) / 64, 0);
+	for (uint32_t i = 0; i < mItemCount; ++i)
+	{
+		if (!items[i].Mesh)
+			continue;
+
+		mOccluders[i >> 6] |= 1ull << (i & 63);
+
+		XMMATRIX world = XMLoadFloat4x4(&items[i].World);
+		occluders[i].Mesh = items[i].Mesh;
+		XMVECTOR determinant = XMMatrixDeterminant(world);
+		XMStoreFloat4x4(&occluders[i].InvWorld, XMMatrixInverse(&determinant, world));
+		tree.CreateProxy(items[i].Bounds, i);
+	}
+
+	uint32_t cellCount = mDims[0] * mDims[1] * mDims[2];
+	uint32_t wordCount = (mItemCount + 63) / 64;
+
+	std::vector<uint64_t> sets((size_t)cellCount * wordCount, 0);
+
+	JobSystem::getInstance().ParallelFor(cellCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t cell = begin; cell < end; ++cell)
+		{
+			uint64_t* bits = sets.data() + (size_t)cell * wordCount;
+			auto see = [bits](uint32_t item) { bits[item >> 6] |= 1ull << (item & 63); };
+			auto seen = [bits](uint32_t item) { return ((bits[item >> 6] >> (item & 63)) & 1) != 0; };
+
+			uint32_t x = cell % mDims[0];
+			uint32_t y = cell / mDims[0] % mDims[1];
+			uint32_t z = cell / (mDims[0] * mDims[1]);
+
+			AABB cellBox;
+			cellBox.Min = { mOrigin.x + x * mCellSize, mOrigin.y + y * mCellSize, mOrigin.z + z * mCellSize };
+			cellBox.Max = { cellBox.Min.x + mCellSize, cellBox.Min.y + mCellSize, cellBox.Min.z + mCellSize };
+
+			// The same rays whatever thread bakes the cell.
+			std::mt19937 rng(cell * 2654435761u + 1u);
+
+			for (uint32_t item = 0; item < mItemCount; ++item)
+			{
+				if (seen(item))
+					continue;
+
+				if (items[item].Bounds.Overlaps(cellBox))
+				{
+					see(item);
+					continue;
+				}
+
+				for (uint32_t ray = 0; ray < settings.RaysPerItem; ++ray)
+				{
+					XMFLOAT3 from = RandomPoint(cellBox, rng);
+					XMFLOAT3 to = RandomPoint(items[item].Bounds, rng);
+
+					XMVECTOR delta = XMLoadFloat3(&to) - XMLoadFloat3(&from);
+					float length = XMVectorGetX(XMVector3Length(delta));
+					if (length < 1e-6f)
+					{
+						see(item);
+						break;
+					}
+
+					XMFLOAT3 dir;
+					XMStoreFloat3(&dir, delta / length);
+
+					int32_t hit = FirstHit(tree, occluders, from, dir, length);
+					if (hit < 0 || hit == (int32_t)item)
+					{
+						see(item);
+						break;
+					}
+
+					// Whatever blocked the ray is visible itself.
+					see((uint32_t)hit);
+				}
+			}
+		}
+	});
+
+	// Code every distinct set once.
+	std::map<std::vector<uint64_t>, uint32_t> setIndices;
+	mCellSets.resize(cellCount);
+	for (uint32_t cell = 0; cell < cellCount; ++cell)
+	{
+		const uint64_t* bits = sets.data() + (size_t)cell * wordCount;
+		auto [it, inserted] = setIndices.try_emplace(std::vector<uint64_t>(bits, bits + wordCount), (uint32_t)mSetOffsets.size());
+		if (inserted)
+			Encode(bits, wordCount);
+		mCellSets[cell] = it->second;
+	}
+
+	mBakeMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int32_t PotentiallyVisibleSet::FindCell(const XMFLOAT3& position) const
+{
+	if (mCellSets.empty())
+		return -1;
+
+	float local[3] = { position.x - mOrigin.x, position.y - mOrigin.y, position.z - mOrigin.z };
+
+	uint32_t index[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		float cell = local[k] / mCellSize;
+		if (!(cell >= 0.0f && cell < (float)mDims[k]))
+			return -1;
+		index[k] = std::min((uint32_t)cell, mDims[k] - 1);
+	}
+
+	return (int32_t)(index[0] + mDims[0] * (index[1] + mDims[1] * index[2]));
+}
+
+void PotentiallyVisibleSet::Encode(const uint64_t* bits, uint32_t wordCount)
+{
+	mSetOffsets.push_back((uint32_t)mCode.size());
+
+	uint32_t word = 0;
+	while (word < wordCount)
+	{
+		uint64_t header = 0;
+
+		if (bits[word] == 0 || bits[word] == ~0ull)
+		{
+			uint64_t fill = bits[word];
+			uint32_t fillCount = 0;
+			while (word < wordCount && bits[word] == fill)
+			{
+				++fillCount;
+				++word;
+			}
+			header = fillCount | (fill ? FillOnes : 0);
+		}
+
+		uint32_t first = word;
+		while (word < wordCount && bits[word] != 0 && bits[word] != ~0ull)
+			++word;
+
+		header |= (uint64_t)(word - first) << 32;
+		mCode.push_back(header);
+		mCode.insert(mCode.end(), bits + first, bits + word);
+	}
+}
+
+void PotentiallyVisibleSet::Decode(uint32_t set, std::vector<uint64_t>& bits) const
+{
+	bits.assign((mItemCount + 63) / 64, 0);
+
+	size_t code = mSetOffsets[set];
+	size_t end = set + 1 < mSetOffsets.size() ? mSetOffsets[set + 1] : mCode.size();
+
+	size_t word = 0;
+	while (code < end)
+	{
+		uint64_t header = mCode[code++];
+
+		uint32_t fillCount = (uint32_t)(header & (FillOnes - 1));
+		uint64_t fill = (header & FillOnes) ? ~0ull : 0;
+		for (uint32_t i = 0; i < fillCount; ++i)
+			bits[word++] = fill;
+
+		uint32_t literalCount = (uint32_t)(header >> 32);
+		for (uint32_t i = 0; i < literalCount; ++i)
+			bits[word++] = mCode[code++];
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+//
+// Potentially visible sets of a static scene.
+//
+// The region the camera may be in is divided into a grid of cells. For every
+// cell the baker finds the items that can be seen from somewhere inside it by
+// casting rays from random points of the cell to random points of each item's
+// box against the triangles of the occluders. Neighbouring cells mostly
+// see the same items, so equal sets are stored once, as run-length coded
+// bitsets. At runtime the camera position gives the cell in O(1), and each
+// item is then one bit test.
+//
+// The sets are sampled: an item seen only through gaps narrower than the rays
+// are apart may be missed. Items that move after the bake are not covered,
+// and once an occluder moves the sets are wrong for what it used to hide, so
+// the owner has to clear them.
+//
+
+#include <cstdint>
+#include <vector>
+
+#include "AABB.h"
+
+class MeshBVH;
+
+class PotentiallyVisibleSet
+{
+public:
+	struct Item
+	{
+		AABB Bounds;                    // world space
+		const MeshBVH* Mesh = nullptr;  // blocks the view if set
+		XMFLOAT4X4 World;               // of Mesh
+	};
+
+	struct Settings
+	{
+		AABB Bounds;               // region the camera may be in
+		float CellSize = 4.0f;
+		uint32_t RaysPerItem = 32; // per cell, before an item is given up as hidden
+	};
+
+	// Replaces the sets. Items are numbered in the order they are given.
+	void Bake(const std::vector<Item>& items, const Settings& settings);
+
+	void Clear();
+
+	bool Empty() const { return mCellSets.empty(); }
+
+	// Cell that contains the point, or -1 outside the baked region.
+	int32_t FindCell(const XMFLOAT3& position) const;
+
+	// Cells that see the same items share a set.
+	uint32_t GetSetIndex(uint32_t cell) const { return mCellSets[cell]; }
+
+	// Changes with every bake, so decoded sets can be told apart.
+	uint32_t GetBakeId() const { return mBakeId; }
+
+	// Expands a set to one bit per item.
+	void Decode(uint32_t set, std::vector<uint64_t>& bits) const;
+
+	static bool Test(const std::vector<uint64_t>& bits, uint32_t item)
+	{
+		return (bits[item >> 6] >> (item & 63)) & 1;
+	}
+
+	// True if the item was given a mesh, so the sets depend on where it is.
+	bool IsOccluder(uint32_t item) const { return item < mItemCount && Test(mOccluders, item); }
+
+	uint32_t ItemCount() const { return mItemCount; }
+	uint32_t CellCount() const { return (uint32_t)mCellSets.size(); }
+	uint32_t SetCount() const { return (uint32_t)mSetOffsets.size(); }
+	size_t CompressedBytes() const { return mCode.size() * sizeof(uint64_t) + mCellSets.size() * sizeof(uint32_t); }
+	float BakeMilliseconds() const { return mBakeMilliseconds; }
+
+private:
+	// A coded set is a sequence of runs. The header word of a run holds the
+	// number of fill words (bits 0-30), their value (bit 31, all zeros or all
+	// ones) and the number of literal words that follow the header (bits 32-63).
+	static constexpr uint64_t FillOnes = 1ull << 31;
+
+	void Encode(const uint64_t* bits, uint32_t wordCount);
+
+	XMFLOAT3 mOrigin = { 0.0f, 0.0f, 0.0f };
+	float mCellSize = 1.0f;
+	uint32_t mDims[3] = { 0, 0, 0 };
+
+	uint32_t mItemCount = 0;
+	uint32_t mBakeId = 0;
+
+	std::vector<uint64_t> mOccluders;    // one bit per item
+
+	std::vector<uint32_t> mCellSets;     // x fastest, then y, then z
+	std::vector<uint32_t> mSetOffsets;   // start of each set in mCode
+	std::vector<uint64_t> mCode;
+
+	float mBakeMilliseconds = 0.0f;
+};
@@ -0,0 +1,110 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+// Set on worker threads and on a thread that is inside ParallelFor, so nested
+// calls run inline instead of waiting on the pool they are running on.
+static thread_local bool tInsideJob = false;
+
+JobSystem::JobSystem()
+{
+	uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (uint32_t i = 0; i + 1 < hardwareThreads; ++i)
+		mWorkers.emplace_back(&JobSystem::WorkerMain, this);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWakeWorkers.notify_all();
+
+	for (auto& worker : mWorkers)
+		worker.join();
+}
+
+void JobSystem::Dispatch(uint32_t count, uint32_t grain, BatchFunc func, void* context)
+{
+	if (count == 0)
+		return;
+
+	grain = std::max(1u, grain);
+
+	uint32_t batchCount = (count + grain - 1) / grain;
+	if (batchCount == 1 || mWorkers.empty() || tInsideJob)
+	{
+		func(context, 0, count);
+		return;
+	}
+
+	std::lock_guard<std::mutex> submitLock(mSubmitMutex);
+
+	Job job;
+	job.Func = func;
+	job.Context = context;
+	job.Count = count;
+	job.Grain = grain;
+	job.BatchCount = batchCount;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJob = &job;
+		++mJobSerial;
+	}
+	mWakeWorkers.notify_all();
+
+	tInsideJob = true;
+	RunBatches(job);
+	tInsideJob = false;
+
+	// Every batch has been claimed; wait for the workers still running one.
+	std::unique_lock<std::mutex> lock(mMutex);
+	mJobFinished.wait(lock, [&] { return job.ActiveWorkers == 0; });
+	mJob = nullptr;
+}
+
+void JobSystem::RunBatches(Job& job)
+{
+	for (;;)
+	{
+		uint32_t batch = job.NextBatch.fetch_add(1, std::memory_order_relaxed);
+		if (batch >= job.BatchCount)
+			break;
+
+		uint32_t begin = batch * job.Grain;
+		uint32_t end = std::min(job.Count, begin + job.Grain);
+		job.Func(job.Context, begin, end);
+	}
+}
+
+void JobSystem::WorkerMain()
+{
+	tInsideJob = true;
+
+	uint64_t seenSerial = 0;
+	for (;;)
+	{
+		Job* job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeWorkers.wait(lock, [&] { return mQuit || (mJob != nullptr && mJobSerial != seenSerial); });
+			if (mQuit)
+				return;
+
+			job = mJob;
+			seenSerial = mJobSerial;
+			++job->ActiveWorkers;
+		}
+
+		RunBatches(*job);
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (--job->ActiveWorkers == 0)
+				mJobFinished.notify_all();
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+//
+// A small fork-join thread pool. ParallelFor splits a range into batches that
+// the worker threads and the calling thread pull from a shared counter, and
+// returns once every batch has run.
+//
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "public_singleton.h"
+
+class JobSystem : public PublicSingleton<JobSystem>
+{
+public:
+	JobSystem();
+	~JobSystem();
+
+	// Worker threads plus the calling thread.
+	uint32_t ThreadCount() const { return (uint32_t)mWorkers.size() + 1; }
+
+	// Calls f(begin, end) for consecutive sub-ranges of [0, count) of at most
+	// 'grain' elements. f may run concurrently on several threads, so it must
+	// only write to data owned by its sub-range. A ParallelFor issued from
+	// inside another one runs serially on the calling thread.
+	template<typename F>
+	void ParallelFor(uint32_t count, uint32_t grain, F&& f)
+	{
+		auto invoke = [](void* context, uint32_t begin, uint32_t end)
+		{
+			(*static_cast<std::remove_reference_t<F>*>(context))(begin, end);
+		};
+		Dispatch(count, grain, invoke, &f);
+	}
+
+private:
+	using BatchFunc = void(*)(void* context, uint32_t begin, uint32_t end);
+
+	struct Job
+	{
+		BatchFunc Func = nullptr;
+		void* Context = nullptr;
+		uint32_t Count = 0;
+		uint32_t Grain = 1;
+		uint32_t BatchCount = 0;
+
+		std::atomic<uint32_t> NextBatch{ 0 };
+		uint32_t ActiveWorkers = 0;   // guarded by mMutex
+	};
+
+	void Dispatch(uint32_t count, uint32_t grain, BatchFunc func, void* context);
+
+	static void RunBatches(Job& job);
+
+	void WorkerMain();
+
+	std::vector<std::thread> mWorkers;
+
+	std::mutex mSubmitMutex;   // one ParallelFor at a time
+
+	std::mutex mMutex;
+	std::condition_variable mWakeWorkers;
+	std::condition_variable mJobFinished;
+	Job* mJob = nullptr;
+	uint64_t mJobSerial = 0;
+	bool mQuit = false;
+};
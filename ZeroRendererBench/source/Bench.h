@@ -0,0 +1,80 @@
+#pragma once
+
+//
+// A minimal benchmark registry for the renderer's hot paths.
+//
+//     BENCH(SortDrawQueue)
+//     {
+//         double ms = bench::BestOf(10, [&] { queue.Sort(); });
+//         bench::Report("radix sort, 1M draws", ms);
+//     }
+//
+// BestOf runs a body several times and keeps the fastest run, which filters
+// out page faults and scheduler noise. Main runs every benchmark, or those
+// whose name contains the first argument. Build and run Release.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+struct ID3D12Device;
+
+namespace bench
+{
+	struct Benchmark
+	{
+		const char* Name;
+		void (*Func)();
+	};
+
+	std::vector<Benchmark>& Registry();
+
+	// Prints one result line; perItem > 0 adds the cost per item.
+	void Report(const char* label, double ms, uint64_t perItem = 0);
+
+	// Keeps a result alive so the optimizer cannot drop the work behind it.
+	void Consume(uint64_t value);
+
+	// A hardware device, else WARP, created on first use; null when neither
+	// exists. Benchmarks that need GPU memory skip without one.
+	ID3D12Device* Device();
+
+	template<typename F>
+	double BestOf(int repeats, F&& body)
+	{
+		double best = 1e300;
+		for (int i = 0; i < repeats; ++i)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			body();
+			auto end = std::chrono::high_resolution_clock::now();
+			best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+		}
+		return best;
+	}
+
+	// Same, but runs setup untimed before every run.
+	template<typename S, typename F>
+	double BestOf(int repeats, S&& setup, F&& body)
+	{
+		double best = 1e300;
+		for (int i = 0; i < repeats; ++i)
+		{
+			setup();
+			best = std::min(best, BestOf(1, body));
+		}
+		return best;
+	}
+
+	struct Registrar
+	{
+		Registrar(const char* name, void (*func)()) { Registry().push_back({ name, func }); }
+	};
+}
+
+#define BENCH(name) \
+	static void name(); \
+	static bench::Registrar name##Registrar(#name, name); \
+	static void name()
@@ -0,0 +1,48 @@
+#include "BenchScene.h"
+
+namespace bench
+{
+	MeshGeometry* BoxGeometry()
+	{
+		static MeshGeometry geo = []
+		{
+			MeshGeometry g;
+			g.Name = "benchBox";
+
+			SubmeshGeometry box;
+			box.IndexCount = 36;
+			box.Bounds = BoundingBox({ 0.0f, 0.0f, 0.0f }, { 0.5f, 0.5f, 0.5f });
+			g.DrawArgs["box"] = box;
+			return g;
+		}();
+		return &geo;
+	}
+
+	Material* BoxMaterial()
+	{
+		static Material mat = []
+		{
+			Material m;
+			m.Name = "benchBox";
+			m.MatCBIndex = 0;
+			return m;
+		}();
+		return &mat;
+	}
+
+	std::vector<ecs::Entity> AddBoxes(Scene& scene, uint32_t count, float extent, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> position(-extent, extent);
+
+		const SubmeshGeometry& box = BoxGeometry()->DrawArgs["box"];
+
+		std::vector<ecs::Entity> items(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			XMMATRIX world = XMMatrixTranslation(position(rng), position(rng), position(rng));
+			items[i] = scene.CreateRenderItem(RenderLayer::Opaque, world, XMMatrixIdentity(),
+				BoxMaterial(), BoxGeometry(), box.IndexCount, 0, 0, box.Bounds);
+		}
+		return items;
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+//
+// Scenes of unit boxes for the benchmarks. The geometry has no GPU buffers,
+// so a scene can be built without a device.
+//
+
+#include "Engine/Scene.h"
+
+#include <random>
+
+namespace bench
+{
+	// A box submesh and one material shared by every item.
+	MeshGeometry* BoxGeometry();
+	Material* BoxMaterial();
+
+	// Adds count boxes to the Opaque layer, scattered over a cube of the given
+	// half extent, and returns them in creation order.
+	std::vector<ecs::Entity> AddBoxes(Scene& scene, uint32_t count, float extent, std::mt19937& rng);
+}
@@ -0,0 +1,58 @@
+#include "Bench.h"
+
+#include "Common/d3dUtil.h"
+#include "Spatial/FrustumCuller.h"
+
+#include <cstdio>
+#include <random>
+
+namespace
+{
+	const uint32_t kCounts[] = { 100000, 1000000 };
+}
+
+BENCH(FrustumCullThroughput)
+{
+	XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 50.0f, -600.0f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi, 16.0f / 9.0f, 1.0f, 2000.0f);
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, view * proj);
+	Frustum frustum = Frustum::FromViewProj(viewProj);
+
+	for (uint32_t count : kCounts)
+	{
+		std::mt19937 rng(30);
+		std::uniform_real_distribution<float> position(-1000.0f, 1000.0f), size(0.5f, 4.0f);
+
+		FrustumCuller culler;
+		std::vector<AABB> boxes(count);
+		culler.Reserve(count);
+		for (AABB& box : boxes)
+		{
+			box.Min = { position(rng), position(rng), position(rng) };
+			box.Max = { box.Min.x + size(rng), box.Min.y + size(rng), box.Min.z + size(rng) };
+			culler.Add(box);
+		}
+
+		char label[96];
+		std::vector<uint32_t> visible;
+		visible.reserve(count);
+
+		// One box at a time, as DrawRenderItems would test each item.
+		double scalar = bench::BestOf(10, [&]
+		{
+			visible.clear();
+			for (uint32_t i = 0; i < count; ++i)
+				if (frustum.Test(boxes[i]) != DISJOINT)
+					visible.push_back(i);
+		});
+		std::snprintf(label, sizeof(label), "one box at a time, %u boxes", count);
+		bench::Report(label, scalar, count);
+
+		double simd = bench::BestOf(10, [&] { culler.Cull(frustum, visible); });
+		std::snprintf(label, sizeof(label), "FrustumCuller, %u boxes, %zu visible", count, visible.size());
+		bench::Report(label, simd, count);
+
+		bench::Consume(visible.size());
+	}
+}
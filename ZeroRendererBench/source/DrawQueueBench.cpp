@@ -0,0 +1,56 @@
+#include "Bench.h"
+
+#include "Engine/DrawQueue.h"
+
+#include <cstdio>
+#include <random>
+#include <utility>
+
+namespace
+{
+	const uint32_t kDraws = 1000000;
+}
+
+BENCH(DrawQueueSort)
+{
+	std::mt19937 rng(39);
+	std::uniform_real_distribution<float> depth(0.1f, 1000.0f);
+
+	for (RenderLayer layer : { RenderLayer::Opaque, RenderLayer::Transparent })
+	{
+		// 2000 submeshes and 300 materials spread over the draws.
+		std::vector<uint64_t> keys(kDraws);
+		for (uint64_t& key : keys)
+			key = SortKey::Make(layer, rng() % 2000, rng() % 300, depth(rng));
+
+		const char* name = layer == RenderLayer::Opaque ? "opaque" : "transparent";
+		char label[96];
+
+		DrawQueue queue;
+		queue.Reserve(kDraws);
+		double radix = bench::BestOf(10, [&]
+		{
+			queue.Clear();
+			for (uint32_t i = 0; i < kDraws; ++i)
+				queue.Push(keys[i], i);
+		}, [&] { queue.Sort(); });
+		std::snprintf(label, sizeof(label), "radix sort, %s, %u draws", name, kDraws);
+		bench::Report(label, radix, kDraws);
+
+		// The same ordering, equal keys included, with a comparison sort.
+		std::vector<std::pair<uint64_t, uint32_t>> pairs(kDraws);
+		double comparison = bench::BestOf(10, [&]
+		{
+			for (uint32_t i = 0; i < kDraws; ++i)
+				pairs[i] = { keys[i], i };
+		}, [&]
+		{
+			std::stable_sort(pairs.begin(), pairs.end(),
+				[](const auto& a, const auto& b) { return a.first < b.first; });
+		});
+		std::snprintf(label, sizeof(label), "std::stable_sort, %s, %u draws", name, kDraws);
+		bench::Report(label, comparison, kDraws);
+
+		bench::Consume(queue.Items()[kDraws / 2] + pairs[kDraws / 2].second);
+	}
+}
@@ -0,0 +1,69 @@
+#include "Bench.h"
+
+#include "Common/d3dUtil.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Scene and the frame resources size their rings by this, as in the app.
+const int gNumFrameResources = 3;
+
+namespace bench
+{
+	static volatile uint64_t sSink = 0;
+
+	std::vector<Benchmark>& Registry()
+	{
+		static std::vector<Benchmark> registry;
+		return registry;
+	}
+
+	void Report(const char* label, double ms, uint64_t perItem)
+	{
+		if (perItem)
+			std::printf("  %-48s %10.3f ms %8.2f ns/item\n", label, ms, ms * 1e6 / double(perItem));
+		else
+			std::printf("  %-48s %10.3f ms\n", label, ms);
+	}
+
+	void Consume(uint64_t value)
+	{
+		sSink = sSink + value;
+	}
+
+	ID3D12Device* Device()
+	{
+		static Microsoft::WRL::ComPtr<ID3D12Device> device;
+		static bool created = false;
+		if (created)
+			return device.Get();
+		created = true;
+
+		if (SUCCEEDED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&device))))
+			return device.Get();
+
+		Microsoft::WRL::ComPtr<IDXGIFactory4> factory;
+		Microsoft::WRL::ComPtr<IDXGIAdapter> warp;
+		if (SUCCEEDED(CreateDXGIFactory1(IID_PPV_ARGS(&factory))) &&
+			SUCCEEDED(factory->EnumWarpAdapter(IID_PPV_ARGS(&warp))))
+			D3D12CreateDevice(warp.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&device));
+
+		return device.Get();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+
+	for (const bench::Benchmark& benchmark : bench::Registry())
+	{
+		if (filter && !std::strstr(benchmark.Name, filter))
+			continue;
+
+		std::printf("%s\n", benchmark.Name);
+		benchmark.Func();
+	}
+
+	return 0;
+}
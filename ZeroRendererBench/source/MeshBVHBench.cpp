@@ -0,0 +1,156 @@
+#include "Bench.h"
+
+#include "Spatial/MeshBVH.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+
+namespace
+{
+	// Three positions per triangle, read from a model in the app's text
+	// format; empty if the file is missing.
+	std::vector<XMFLOAT3> LoadTriangles(const char* path)
+	{
+		std::ifstream fin(path);
+		if (!fin)
+			return {};
+
+		uint32_t vcount = 0;
+		uint32_t tcount = 0;
+		std::string ignore;
+
+		fin >> ignore >> vcount;
+		fin >> ignore >> tcount;
+		fin >> ignore >> ignore >> ignore >> ignore;
+
+		std::vector<XMFLOAT3> positions(vcount);
+		for (XMFLOAT3& p : positions)
+		{
+			float normalAndTexC[5];
+			fin >> p.x >> p.y >> p.z;
+			for (float& f : normalAndTexC)
+				fin >> f;
+		}
+
+		fin >> ignore >> ignore >> ignore;
+
+		std::vector<XMFLOAT3> triangles(3 * tcount);
+		for (XMFLOAT3& v : triangles)
+		{
+			uint32_t index;
+			fin >> index;
+			v = positions[index];
+		}
+		return triangles;
+	}
+
+	// Moller-Trumbore, the test a BVH-less exact pick runs per triangle.
+	bool RayTriangle(const XMFLOAT3& o, const XMFLOAT3& d, const XMFLOAT3* tri, float& t)
+	{
+		const XMFLOAT3& a = tri[0];
+		float e1[3] = { tri[1].x - a.x, tri[1].y - a.y, tri[1].z - a.z };
+		float e2[3] = { tri[2].x - a.x, tri[2].y - a.y, tri[2].z - a.z };
+
+		float p[3] = { d.y * e2[2] - d.z * e2[1], d.z * e2[0] - d.x * e2[2], d.x * e2[1] - d.y * e2[0] };
+		float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+		if (std::fabs(det) < 1e-12f)
+			return false;
+
+		float s[3] = { o.x - a.x, o.y - a.y, o.z - a.z };
+		float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+		if (u < 0.0f || u > 1.0f)
+			return false;
+
+		float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+		float v = (d.x * q[0] + d.y * q[1] + d.z * q[2]) / det;
+		if (v < 0.0f || u + v > 1.0f)
+			return false;
+
+		t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+		return t >= 0.0f;
+	}
+
+	const uint32_t kRays = 10000;
+}
+
+BENCH(MeshBVHBuildAndQuery)
+{
+	const char* models[] = { "../ZeroRenderer/asset/models/marry.txt", "../ZeroRenderer/asset/models/cow.txt" };
+	for (const char* path : models)
+	{
+		std::vector<XMFLOAT3> triangles = LoadTriangles(path);
+		if (triangles.empty())
+		{
+			std::printf("  %s not found, skipped\n", path);
+			continue;
+		}
+
+		const uint32_t triangleCount = uint32_t(triangles.size() / 3);
+		char label[96];
+
+		std::unique_ptr<MeshBVH> bvh;
+		double build = bench::BestOf(10, [&] { bvh = std::make_unique<MeshBVH>(triangles); });
+		std::snprintf(label, sizeof(label), "%s build, %u triangles", std::strrchr(path, '/') + 1, triangleCount);
+		bench::Report(label, build);
+
+		// Rays from a sphere around the model through random points of its
+		// bounds, so some hit and some miss.
+		AABB bounds = bvh->Bounds();
+		XMFLOAT3 center = { (bounds.Min.x + bounds.Max.x) * 0.5f, (bounds.Min.y + bounds.Max.y) * 0.5f, (bounds.Min.z + bounds.Max.z) * 0.5f };
+		float radius = std::sqrt(
+			(bounds.Max.x - bounds.Min.x) * (bounds.Max.x - bounds.Min.x) +
+			(bounds.Max.y - bounds.Min.y) * (bounds.Max.y - bounds.Min.y) +
+			(bounds.Max.z - bounds.Min.z) * (bounds.Max.z - bounds.Min.z));
+
+		std::mt19937 rng(29);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<XMFLOAT3> origins(kRays), dirs(kRays);
+		for (uint32_t i = 0; i < kRays; ++i)
+		{
+			XMVECTOR onSphere = XMVector3Normalize(XMVectorSet(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f, 0.0f));
+			XMVECTOR origin = XMLoadFloat3(&center) + onSphere * radius;
+			XMVECTOR target = XMVectorSet(
+				bounds.Min.x + unit(rng) * (bounds.Max.x - bounds.Min.x),
+				bounds.Min.y + unit(rng) * (bounds.Max.y - bounds.Min.y),
+				bounds.Min.z + unit(rng) * (bounds.Max.z - bounds.Min.z), 1.0f);
+			XMStoreFloat3(&origins[i], origin);
+			XMStoreFloat3(&dirs[i], XMVector3Normalize(target - origin));
+		}
+
+		uint64_t hits = 0;
+		double query = bench::BestOf(5, [&]
+		{
+			for (uint32_t i = 0; i < kRays; ++i)
+			{
+				float t;
+				hits += bvh->RayCast(origins[i], dirs[i], FLT_MAX, t);
+			}
+		});
+		std::snprintf(label, sizeof(label), "%s BVH ray, %u rays", std::strrchr(path, '/') + 1, kRays);
+		bench::Report(label, query, kRays);
+
+		// Every triangle for a tenth of the rays; it is that slow.
+		const uint32_t bruteRays = kRays / 10;
+		double brute = bench::BestOf(1, [&]
+		{
+			for (uint32_t i = 0; i < bruteRays; ++i)
+			{
+				float nearest = FLT_MAX, t;
+				for (uint32_t k = 0; k < triangleCount; ++k)
+					if (RayTriangle(origins[i], dirs[i], &triangles[k * 3], t) && t < nearest)
+						nearest = t;
+				hits += nearest != FLT_MAX;
+			}
+		});
+		std::snprintf(label, sizeof(label), "%s every triangle, %u rays", std::strrchr(path, '/') + 1, bruteRays);
+		bench::Report(label, brute, bruteRays);
+
+		bench::Consume(hits);
+	}
+}
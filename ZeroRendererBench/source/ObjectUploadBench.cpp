@@ -0,0 +1,65 @@
+#include "Bench.h"
+#include "BenchScene.h"
+
+#include <cstdio>
+
+namespace
+{
+	const uint32_t kItems = 100000;
+	const uint32_t kMovedPerFrame = 100;
+}
+
+BENCH(ObjectUploadPerFrame)
+{
+	std::mt19937 rng(44);
+
+	Scene scene;
+	std::vector<ecs::Entity> items = bench::AddBoxes(scene, kItems, 1000.0f, rng);
+	scene.UpdateTransforms();
+	scene.UpdateObjectData();
+
+	// Stands in for the scene buffer the records are written to.
+	const std::vector<ObjectData>& objects = scene.GetObjectData();
+	std::vector<ObjectData> uploaded = objects;
+	scene.GetObjectUploads().Discard(0);
+
+	// A mostly static scene: a few items move every frame. Moving them and
+	// propagating the transforms is left out of the timings.
+	auto moveSome = [&]
+	{
+		for (uint32_t k = 0; k < kMovedPerFrame; ++k)
+		{
+			ecs::Entity item = items[rng() % kItems];
+			LocalTransform local = scene.GetLocalTransform(item);
+			local.Translation.y += 0.01f;
+			scene.SetLocalTransform(item, local);
+		}
+		scene.UpdateTransforms();
+	};
+
+	char label[96];
+	double drained = bench::BestOf(300, moveSome, [&]
+	{
+		scene.UpdateObjectData();
+		scene.GetObjectUploads().Drain(0, [&](uint32_t index)
+		{
+			if (index < objects.size())
+				uploaded[index] = objects[index];
+		});
+	});
+	std::snprintf(label, sizeof(label), "dirty list, %u items, %u moved", kItems, kMovedPerFrame);
+	bench::Report(label, drained);
+
+	// What a frame cost when every item's record was rewritten.
+	double copied = bench::BestOf(300, moveSome, [&]
+	{
+		scene.UpdateObjectData();
+		scene.GetObjectUploads().Discard(0);
+		for (size_t i = 0; i < objects.size(); ++i)
+			uploaded[i] = objects[i];
+	});
+	std::snprintf(label, sizeof(label), "full copy, %u items, %u moved", kItems, kMovedPerFrame);
+	bench::Report(label, copied);
+
+	bench::Consume(uploaded[kItems / 2].MaterialIndex);
+}
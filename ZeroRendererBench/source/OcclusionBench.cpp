@@ -0,0 +1,118 @@
+#include "Bench.h"
+
+#include "Common/d3dUtil.h"
+#include "Spatial/OcclusionBuffer.h"
+
+#include <cstdio>
+#include <random>
+
+namespace
+{
+	const uint32_t kGridCells = 100;
+	const uint32_t kOccluderBoxes = 200;
+	const uint32_t kTestedBoxes = 100000;
+
+	// Appends the 12 triangles of a box, clockwise seen from outside.
+	void AddBox(std::vector<XMFLOAT3>& vertices, const AABB& box)
+	{
+		const float lo[3] = { box.Min.x, box.Min.y, box.Min.z };
+		const float hi[3] = { box.Max.x, box.Max.y, box.Max.z };
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+			for (int side = 0; side < 2; ++side)
+			{
+				XMFLOAT3 quad[4];
+				for (int k = 0; k < 4; ++k)
+				{
+					float p[3];
+					p[axis] = side ? hi[axis] : lo[axis];
+					p[u] = (k == 1 || k == 2) ? hi[u] : lo[u];
+					p[v] = k >= 2 ? hi[v] : lo[v];
+					quad[k] = { p[0], p[1], p[2] };
+				}
+
+				const int order[2][6] = { { 0, 2, 1, 0, 3, 2 }, { 0, 1, 2, 0, 2, 3 } };
+				for (int k : order[side])
+					vertices.push_back(quad[k]);
+			}
+		}
+	}
+
+	// A ground grid facing up, cells x cells quads over [-extent, extent].
+	std::vector<XMFLOAT3> Grid(uint32_t cells, float extent)
+	{
+		std::vector<XMFLOAT3> vertices;
+		float step = 2.0f * extent / cells;
+		for (uint32_t j = 0; j < cells; ++j)
+		{
+			for (uint32_t i = 0; i < cells; ++i)
+			{
+				float x0 = -extent + i * step, z0 = -extent + j * step;
+				XMFLOAT3 a = { x0, 0.0f, z0 }, b = { x0, 0.0f, z0 + step };
+				XMFLOAT3 c = { x0 + step, 0.0f, z0 + step }, d = { x0 + step, 0.0f, z0 };
+				vertices.insert(vertices.end(), { a, b, c, a, c, d });
+			}
+		}
+		return vertices;
+	}
+}
+
+BENCH(OcclusionRasterizeAndTest)
+{
+	std::mt19937 rng(32);
+	std::uniform_real_distribution<float> position(-300.0f, 300.0f), size(2.0f, 20.0f), height(5.0f, 40.0f);
+
+	// The ground and buildings standing on it, as seen by a camera on the
+	// ground looking across them.
+	std::vector<XMFLOAT3> ground = Grid(kGridCells, 400.0f);
+	std::vector<XMFLOAT3> buildings;
+	for (uint32_t i = 0; i < kOccluderBoxes; ++i)
+	{
+		AABB box;
+		box.Min = { position(rng), 0.0f, position(rng) };
+		box.Max = { box.Min.x + size(rng), height(rng), box.Min.z + size(rng) };
+		AddBox(buildings, box);
+	}
+
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	std::vector<OcclusionBuffer::Occluder> occluders;
+	occluders.push_back({ ground.data(), (uint32_t)ground.size() / 3, identity });
+	for (size_t first = 0; first < buildings.size(); first += 36)
+		occluders.push_back({ buildings.data() + first, 12, identity });
+
+	XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 3.0f, -350.0f, 1.0f), XMVectorSet(0.0f, 3.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi, 16.0f / 9.0f, 1.0f, 1000.0f);
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, view * proj);
+
+	OcclusionBuffer buffer;
+	char label[96];
+
+	double render = bench::BestOf(20, [&] { buffer.Render(viewProj, occluders); });
+	std::snprintf(label, sizeof(label), "render, %u occluders, %u triangles", buffer.OccluderCount(), buffer.TriangleCount());
+	bench::Report(label, render, buffer.TriangleCount());
+
+	// Items the size of props spread over the same ground.
+	std::uniform_real_distribution<float> propSize(0.5f, 4.0f);
+	std::vector<AABB> boxes(kTestedBoxes);
+	for (AABB& box : boxes)
+	{
+		box.Min = { position(rng), 0.0f, position(rng) };
+		box.Max = { box.Min.x + propSize(rng), propSize(rng), box.Min.z + propSize(rng) };
+	}
+
+	uint32_t hidden = 0;
+	double test = bench::BestOf(10, [&]
+	{
+		hidden = 0;
+		for (const AABB& box : boxes)
+			hidden += !buffer.IsVisible(box);
+	});
+	std::snprintf(label, sizeof(label), "IsVisible, %u boxes, %u hidden", kTestedBoxes, hidden);
+	bench::Report(label, test, kTestedBoxes);
+
+	bench::Consume(hidden);
+}
@@ -0,0 +1,73 @@
+#include "Bench.h"
+#include "BenchScene.h"
+
+#include <cfloat>
+#include <cstdio>
+
+namespace
+{
+	const uint32_t kItems = 100000;
+	const uint32_t kRays = 1000;
+}
+
+BENCH(PickAmongOneHundredThousandItems)
+{
+	std::mt19937 rng(28);
+	Scene scene;
+	std::vector<ecs::Entity> items = bench::AddBoxes(scene, kItems, 500.0f, rng);
+	scene.UpdateTransforms();
+
+	// Rays from outside the scene through random points inside it, as a
+	// click through the camera would be.
+	std::uniform_real_distribution<float> inside(-500.0f, 500.0f);
+	std::vector<XMFLOAT3> origins(kRays), dirs(kRays);
+	for (uint32_t i = 0; i < kRays; ++i)
+	{
+		XMVECTOR origin = XMVectorSet(inside(rng), 800.0f, inside(rng), 1.0f);
+		XMVECTOR target = XMVectorSet(inside(rng), inside(rng), inside(rng), 1.0f);
+		XMStoreFloat3(&origins[i], origin);
+		XMStoreFloat3(&dirs[i], XMVector3Normalize(target - origin));
+	}
+
+	uint64_t hits = 0;
+	double tree = bench::BestOf(5, [&]
+	{
+		for (uint32_t i = 0; i < kRays; ++i)
+		{
+			ecs::Entity item = scene.RayCast(XMLoadFloat3(&origins[i]), XMLoadFloat3(&dirs[i]), LayerMask(RenderLayer::Opaque));
+			hits += item != ecs::NullEntity;
+		}
+	});
+	bench::Report("AABB tree, per ray", tree / kRays);
+
+	// The pick this replaced: invert every world matrix, move the ray to
+	// local space and test the local bounds.
+	ecs::World& world = scene.GetWorld();
+	double linear = bench::BestOf(3, [&]
+	{
+		for (uint32_t i = 0; i < kRays; ++i)
+		{
+			ecs::Entity nearest = ecs::NullEntity;
+			float nearestT = FLT_MAX;
+			for (ecs::Entity item : items)
+			{
+				XMMATRIX W = XMLoadFloat4x4(&world.Get<TransformComponent>(item)->World);
+				XMMATRIX invWorld = XMMatrixInverse(get_rvalue_ptr(XMMatrixDeterminant(W)), W);
+
+				XMVECTOR localOrigin = XMVector3TransformCoord(XMLoadFloat3(&origins[i]), invWorld);
+				XMVECTOR localDir = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&dirs[i]), invWorld));
+
+				float t;
+				if (world.Get<BoundsComponent>(item)->Bounds.Intersects(localOrigin, localDir, t) && t < nearestT)
+				{
+					nearest = item;
+					nearestT = t;
+				}
+			}
+			hits += nearest != ecs::NullEntity;
+		}
+	});
+	bench::Report("linear scan, per ray", linear / kRays);
+
+	bench::Consume(hits);
+}
@@ -0,0 +1,74 @@
+#include "Bench.h"
+#include "BenchScene.h"
+
+#include "Engine/SceneSerializer.h"
+
+#include <cstdio>
+#include <filesystem>
+
+namespace
+{
+	const uint32_t kItems = 100000;
+}
+
+BENCH(SceneFileLoad)
+{
+	std::mt19937 rng(34);
+
+	// A load resolves geometry by name.
+	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> geometries;
+	geometries[bench::BoxGeometry()->Name] = std::make_unique<MeshGeometry>(*bench::BoxGeometry());
+
+	MatManager materials;
+	materials.CreateMaterial(bench::BoxMaterial()->Name, 0, 0, { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.01f, 0.01f, 0.01f }, 0.25f);
+
+	std::vector<TransformComponent> worlds;
+	{
+		Scene scene;
+		std::vector<ecs::Entity> items = bench::AddBoxes(scene, kItems, 1000.0f, rng);
+		scene.UpdateTransforms();
+
+		// Only materials of the manager can be saved.
+		for (ecs::Entity item : items)
+		{
+			scene.GetWorld().Get<MaterialComponent>(item)->Mat = materials.GetMaterial(bench::BoxMaterial()->Name);
+			worlds.push_back(*scene.GetWorld().Get<TransformComponent>(item));
+		}
+
+		const std::string path = (std::filesystem::temp_directory_path() / "ZeroRendererBench.zscn").string();
+		if (!SceneSerializer::Save(path, scene, materials))
+		{
+			std::printf("  cannot write %s, skipped\n", path.c_str());
+			return;
+		}
+
+		char label[96];
+		double load = bench::BestOf(5, [&]
+		{
+			Scene loaded;
+			SceneSerializer::Load(path, loaded, materials, geometries, {});
+			bench::Consume(loaded.GetRitemSize());
+		});
+		std::snprintf(label, sizeof(label), "SceneSerializer::Load, %u items", kItems);
+		bench::Report(label, load, kItems);
+
+		std::filesystem::remove(path);
+	}
+
+	// What building the same scene item by item costs.
+	const SubmeshGeometry& box = bench::BoxGeometry()->DrawArgs["box"];
+	char label[96];
+	double create = bench::BestOf(5, [&]
+	{
+		Scene scene;
+		for (const TransformComponent& transform : worlds)
+		{
+			scene.CreateRenderItem(RenderLayer::Opaque, XMLoadFloat4x4(&transform.World), XMLoadFloat4x4(&transform.TexTransform),
+				materials.GetMaterial(bench::BoxMaterial()->Name), bench::BoxGeometry(),
+				box.IndexCount, box.StartIndexLocation, box.BaseVertexLocation, box.Bounds);
+		}
+		bench::Consume(scene.GetRitemSize());
+	});
+	std::snprintf(label, sizeof(label), "CreateRenderItem per item, %u items", kItems);
+	bench::Report(label, create, kItems);
+}
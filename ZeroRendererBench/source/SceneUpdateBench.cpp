@@ -0,0 +1,115 @@
+#include "Bench.h"
+#include "BenchScene.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+
+namespace
+{
+	// The render item as it was before the ECS: one heap allocation per item,
+	// walked by pointer and checked for NumFramesDirty every frame.
+	struct HeapRenderItem
+	{
+		XMFLOAT4X4 World = MathHelper::Identity4x4();
+		XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+		int NumFramesDirty = gNumFrameResources;
+		UINT ObjCBIndex = 0;
+		Material* Mat = nullptr;
+		MeshGeometry* Geo = nullptr;
+		D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		BoundingBox Bounds;
+		UINT IndexCount = 0;
+		UINT StartIndexLocation = 0;
+		int BaseVertexLocation = 0;
+		bool Visible = true;
+	};
+
+	const uint32_t kCounts[] = { 10000, 100000, 1000000 };
+}
+
+BENCH(SceneUpdatePerFrame)
+{
+	for (uint32_t count : kCounts)
+	{
+		std::mt19937 rng(26);
+		const int repeats = count >= 1000000 ? 3 : 10;
+		char label[96];
+
+		Scene scene;
+		std::vector<ecs::Entity> items = bench::AddBoxes(scene, count, 1000.0f, rng);
+		scene.UpdateTransforms();
+		scene.UpdateObjectData();
+
+		double moved = bench::BestOf(repeats, [&]
+		{
+			for (ecs::Entity item : items)
+			{
+				LocalTransform local = scene.GetLocalTransform(item);
+				local.Translation.y += 0.01f;
+				scene.SetLocalTransform(item, local);
+			}
+			scene.UpdateTransforms();
+			scene.UpdateObjectData();
+		});
+		std::snprintf(label, sizeof(label), "ECS, %u items, all moved", count);
+		bench::Report(label, moved, count);
+
+		double still = bench::BestOf(repeats, [&]
+		{
+			scene.UpdateTransforms();
+			scene.UpdateObjectData();
+		});
+		std::snprintf(label, sizeof(label), "ECS, %u items, none moved", count);
+		bench::Report(label, still, count);
+
+		// The same frames over heap items. Other allocations in between
+		// scatter them the way a loaded scene did.
+		std::vector<std::unique_ptr<HeapRenderItem>> heapItems;
+		std::vector<std::unique_ptr<char[]>> padding;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			heapItems.push_back(std::make_unique<HeapRenderItem>());
+			heapItems.back()->ObjCBIndex = i;
+			heapItems.back()->Mat = bench::BoxMaterial();
+			padding.push_back(std::make_unique<char[]>(16 + rng() % 256));
+		}
+		std::shuffle(heapItems.begin(), heapItems.end(), rng);
+
+		std::vector<ObjectData> objectData(count);
+		auto updateObjectCBs = [&]
+		{
+			for (auto& item : heapItems)
+			{
+				if (item->NumFramesDirty > 0)
+				{
+					ObjectData& data = objectData[item->ObjCBIndex];
+					XMStoreFloat4x4(&data.World, XMMatrixTranspose(XMLoadFloat4x4(&item->World)));
+					XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&item->TexTransform)));
+					data.MaterialIndex = item->Mat->MatCBIndex;
+					item->NumFramesDirty--;
+				}
+			}
+		};
+
+		moved = bench::BestOf(repeats, [&]
+		{
+			for (auto& item : heapItems)
+			{
+				item->World._42 += 0.01f;
+				item->NumFramesDirty = gNumFrameResources;
+			}
+			updateObjectCBs();
+		});
+		std::snprintf(label, sizeof(label), "heap items, %u items, all moved", count);
+		bench::Report(label, moved, count);
+
+		for (int i = 0; i < gNumFrameResources; ++i)
+			updateObjectCBs();
+		still = bench::BestOf(repeats, updateObjectCBs);
+		std::snprintf(label, sizeof(label), "heap items, %u items, none moved", count);
+		bench::Report(label, still, count);
+
+		bench::Consume(objectData[count / 2].MaterialIndex + scene.GetObjectData().size());
+	}
+}
@@ -0,0 +1,138 @@
+#include "Bench.h"
+
+#include "Engine/Scene.h"
+
+#include <cstdio>
+#include <random>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	const uint32_t kDraws = 10000;
+	const uint32_t kGeometries = 256;
+
+	// What drawing read before packets: the item's components, from which
+	// the views were rebuilt on every draw.
+	struct ComponentItem
+	{
+		MeshComponent Mesh;
+		UINT ObjectIndex = 0;
+	};
+
+	ComPtr<ID3D12Resource> CreateBuffer(ID3D12Device* device, UINT64 size)
+	{
+		ComPtr<ID3D12Resource> buffer;
+		ThrowIfFailed(device->CreateCommittedResource(
+			get_rvalue_ptr(CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT)),
+			D3D12_HEAP_FLAG_NONE,
+			get_rvalue_ptr(CD3DX12_RESOURCE_DESC::Buffer(size)),
+			D3D12_RESOURCE_STATE_COMMON,
+			nullptr,
+			IID_PPV_ARGS(&buffer)));
+		return buffer;
+	}
+}
+
+BENCH(DrawSubmission)
+{
+	ID3D12Device* device = bench::Device();
+	if (!device)
+	{
+		std::printf("  no D3D12 device, skipped\n");
+		return;
+	}
+
+	ComPtr<ID3D12CommandAllocator> allocator;
+	ComPtr<ID3D12GraphicsCommandList> cmdList;
+	ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&allocator)));
+	ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator.Get(), nullptr, IID_PPV_ARGS(&cmdList)));
+	ThrowIfFailed(cmdList->Close());
+
+	// Geometries are allocated among others, as when a level is loaded, so
+	// the ones a frame draws are spread over the heap.
+	std::mt19937 rng(40);
+	std::vector<std::unique_ptr<MeshGeometry>> geometries;
+	std::vector<MeshGeometry*> drawn;
+	for (uint32_t g = 0; g < kGeometries; ++g)
+	{
+		auto geo = std::make_unique<MeshGeometry>();
+		geo->VertexBufferGPU = CreateBuffer(device, 64 * 1024);
+		geo->IndexBufferGPU = CreateBuffer(device, 64 * 1024);
+		geo->VertexByteStride = 48;
+		geo->VertexBufferByteSize = 48 * 1000;
+		geo->IndexBufferByteSize = 2 * 3000;
+		drawn.push_back(geo.get());
+		geometries.push_back(std::move(geo));
+
+		for (int pad = 0; pad < 8; ++pad)
+			geometries.push_back(std::make_unique<MeshGeometry>());
+	}
+
+	std::vector<ComponentItem> items(kDraws);
+	std::vector<DrawItem> packets(kDraws);
+	std::vector<uint32_t> order(kDraws);
+	for (uint32_t i = 0; i < kDraws; ++i)
+	{
+		MeshComponent& mesh = items[i].Mesh;
+		mesh.Geo = drawn[rng() % kGeometries];
+		mesh.IndexCount = 36 + i % 7;
+		mesh.StartIndexLocation = i % 100;
+		mesh.BaseVertexLocation = i % 50;
+		items[i].ObjectIndex = i;
+
+		DrawItem& packet = packets[i];
+		packet.VertexBufferView = mesh.Geo->VertexBufferView();
+		packet.IndexBufferView = mesh.Geo->IndexBufferView();
+		packet.PrimitiveType = mesh.PrimitiveType;
+		packet.IndexCount = mesh.IndexCount;
+		packet.StartIndexLocation = mesh.StartIndexLocation;
+		packet.BaseVertexLocation = mesh.BaseVertexLocation;
+		packet.ObjectIndex = i;
+
+		order[i] = i;
+	}
+
+	// Sorted draws visit the items in no particular memory order.
+	std::shuffle(order.begin(), order.end(), rng);
+
+	auto reset = [&]
+	{
+		ThrowIfFailed(allocator->Reset());
+		ThrowIfFailed(cmdList->Reset(allocator.Get(), nullptr));
+	};
+
+	double components = bench::BestOf(20, reset, [&]
+	{
+		for (uint32_t i : order)
+		{
+			const MeshComponent& mesh = items[i].Mesh;
+			D3D12_VERTEX_BUFFER_VIEW vbv = mesh.Geo->VertexBufferView();
+			D3D12_INDEX_BUFFER_VIEW ibv = mesh.Geo->IndexBufferView();
+			cmdList->IASetVertexBuffers(0, 1, &vbv);
+			cmdList->IASetIndexBuffer(&ibv);
+			cmdList->IASetPrimitiveTopology(mesh.PrimitiveType);
+			cmdList->DrawIndexedInstanced(mesh.IndexCount, 1, mesh.StartIndexLocation, mesh.BaseVertexLocation, 0);
+		}
+		ThrowIfFailed(cmdList->Close());
+	});
+
+	double packed = bench::BestOf(20, reset, [&]
+	{
+		for (uint32_t i : order)
+		{
+			const DrawItem& packet = packets[i];
+			cmdList->IASetVertexBuffers(0, 1, &packet.VertexBufferView);
+			cmdList->IASetIndexBuffer(&packet.IndexBufferView);
+			cmdList->IASetPrimitiveTopology(packet.PrimitiveType);
+			cmdList->DrawIndexedInstanced(packet.IndexCount, 1, packet.StartIndexLocation, packet.BaseVertexLocation, 0);
+		}
+		ThrowIfFailed(cmdList->Close());
+	});
+
+	char label[96];
+	std::snprintf(label, sizeof(label), "views rebuilt from components, %u draws", kDraws);
+	bench::Report(label, components, kDraws);
+	std::snprintf(label, sizeof(label), "draw packets, %u draws", kDraws);
+	bench::Report(label, packed, kDraws);
+}
@@ -0,0 +1,85 @@
+#include "Bench.h"
+
+#include "DXRuntime/FrameResource.h"
+#include "DXRuntime/UploadAllocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+	const UINT kElements = 100000;
+	const UINT kDirty = 20000;
+
+	// dest has room for kElements records.
+	void TimeCopies(ObjectData* dest, const char* memory)
+	{
+		std::mt19937 rng(46);
+
+		std::vector<ObjectData> objects(kElements);
+		for (UINT i = 0; i < kElements; ++i)
+			objects[i].MaterialIndex = i;
+
+		// A frame's dirty items, in the order they were marked.
+		std::vector<UINT> dirty(kElements);
+		for (UINT i = 0; i < kElements; ++i)
+			dirty[i] = i;
+		std::shuffle(dirty.begin(), dirty.end(), rng);
+		dirty.resize(kDirty);
+
+		char label[96];
+		double ms = bench::BestOf(30, [&]
+		{
+			for (UINT i : dirty)
+				memcpy(&dest[i], &objects[i], sizeof(ObjectData));
+		});
+		std::snprintf(label, sizeof(label), "per record, %u of %u, %s", kDirty, kElements, memory);
+		bench::Report(label, ms, kDirty);
+
+		// What the scene delta upload and the passes do: gather the records
+		// on the CPU, then write them out in one ascending copy.
+		std::vector<ObjectData> staged(kDirty);
+		ms = bench::BestOf(30, [&]
+		{
+			for (UINT i = 0; i < kDirty; ++i)
+				staged[i] = objects[dirty[i]];
+			WriteCombinedCopy(dest, staged.data(), kDirty * sizeof(ObjectData));
+			StreamFence();
+		});
+		std::snprintf(label, sizeof(label), "gathered, %u of %u, %s", kDirty, kElements, memory);
+		bench::Report(label, ms, kDirty);
+
+		ms = bench::BestOf(30, [&]
+		{
+			for (UINT i = 0; i < kElements; ++i)
+				memcpy(&dest[i], &objects[i], sizeof(ObjectData));
+		});
+		std::snprintf(label, sizeof(label), "per record, all %u, %s", kElements, memory);
+		bench::Report(label, ms, kElements);
+
+		ms = bench::BestOf(30, [&]
+		{
+			WriteCombinedCopy(dest, objects.data(), kElements * sizeof(ObjectData));
+			StreamFence();
+		});
+		std::snprintf(label, sizeof(label), "WriteCombinedCopy, all %u, %s", kElements, memory);
+		bench::Report(label, ms, kElements);
+	}
+}
+
+BENCH(UploadCopies)
+{
+	if (ID3D12Device* device = bench::Device())
+	{
+		UploadAllocator uploads(device, kElements * sizeof(ObjectData));
+		TimeCopies(static_cast<ObjectData*>(uploads.AllocateArray<ObjectData>(kElements).CPU), "upload heap");
+		return;
+	}
+
+	// Cached memory shows the cost of the copies but not what
+	// write-combining adds to scattered ones.
+	std::printf("  no D3D12 device, ordinary memory instead of an upload heap\n");
+	std::vector<ObjectData> memory(kElements);
+	TimeCopies(memory.data(), "ordinary memory");
+}
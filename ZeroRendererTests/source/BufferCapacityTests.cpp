@@ -0,0 +1,74 @@
+#include "Test.h"
+
+#include "Resource/BufferCapacity.h"
+
+TEST(BufferCapacityGrowsToThePowerOfTwoThatFits)
+{
+	BufferCapacity policy(64);
+	CHECK(policy.Fit(0) == 64);
+	CHECK(policy.Fit(64) == 64);
+	CHECK(policy.Fit(65) == 128);
+	CHECK(policy.Fit(1000) == 1024);
+
+	CHECK(policy.Update(64, 64) == 64);
+	CHECK(policy.Update(64, 65) == 128);
+	CHECK(policy.Update(128, 3000) == 4096);
+}
+
+TEST(BufferCapacityShrinksOnlyAfterAQuietWindow)
+{
+	BufferCapacity policy(64);
+
+	// A quarter used is not enough to shrink, so a full window changes nothing.
+	uint64_t capacity = 1024;
+	for (uint32_t frame = 0; frame < 2 * BufferCapacity::ShrinkWindow; ++frame)
+		capacity = policy.Update(capacity, 257);
+	CHECK(capacity == 1024);
+
+	// One busy frame keeps the window from shrinking the buffer.
+	for (uint32_t frame = 0; frame + 1 < BufferCapacity::ShrinkWindow; ++frame)
+		capacity = policy.Update(capacity, frame == 100 ? 600 : 100);
+	CHECK(capacity == 1024);
+	capacity = policy.Update(capacity, 100);
+	CHECK(capacity == 1024);
+
+	// A whole window at 100 shrinks to what holds twice that, on its last frame.
+	for (uint32_t frame = 0; frame + 1 < BufferCapacity::ShrinkWindow; ++frame)
+		capacity = policy.Update(capacity, 100);
+	CHECK(capacity == 1024);
+	capacity = policy.Update(capacity, 100);
+	CHECK(capacity == 256);
+
+	// Growing starts the window over, with the frame that grew in it.
+	capacity = policy.Update(capacity, 300);
+	CHECK(capacity == 512);
+	for (uint32_t frame = 0; frame < BufferCapacity::ShrinkWindow; ++frame)
+		capacity = policy.Update(capacity, 10);
+	CHECK(capacity == 512);
+	for (uint32_t frame = 0; frame < BufferCapacity::ShrinkWindow; ++frame)
+		capacity = policy.Update(capacity, 10);
+	CHECK(capacity == 64);
+}
+
+TEST(BufferCapacityNeverShrinksUpward)
+{
+	// Twice the peak rounds up past small buffers, even those below the
+	// minimum; they must stay as they are.
+	BufferCapacity policy(64);
+	for (uint64_t start : { 40ull, 64ull, 100ull, 128ull })
+	{
+		uint64_t capacity = start;
+		for (uint32_t frame = 0; frame < 4 * BufferCapacity::ShrinkWindow; ++frame)
+		{
+			capacity = policy.Update(capacity, frame % 5);
+			CHECK(capacity <= start);
+		}
+	}
+
+	// Sizes off the power-of-two ladder, as given at creation.
+	BufferCapacity bytes(64 * 1024);
+	uint64_t capacity = 3 * 64 * 1024;
+	for (uint32_t frame = 0; frame < BufferCapacity::ShrinkWindow; ++frame)
+		capacity = bytes.Update(capacity, 1000);
+	CHECK(capacity == 64 * 1024);
+}
@@ -0,0 +1,156 @@
+#include "Test.h"
+
+#include "Spatial/FrustumCuller.h"
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+	XMFLOAT4X4 View(const XMFLOAT3& eye, float yaw, float pitch)
+	{
+		XMVECTOR dir = XMVectorSet(std::cos(pitch) * std::sin(yaw), std::sin(pitch), std::cos(pitch) * std::cos(yaw), 0.0f);
+
+		XMFLOAT4X4 view;
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMLoadFloat3(&eye), dir, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+		return view;
+	}
+
+	XMFLOAT4X4 Proj(float fovY)
+	{
+		XMFLOAT4X4 proj;
+		XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(fovY, 1.6f, 1.0f, 1000.0f));
+		return proj;
+	}
+
+	Frustum FrustumOf(const XMFLOAT4X4& view, const XMFLOAT4X4& proj)
+	{
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMLoadFloat4x4(&view) * XMLoadFloat4x4(&proj));
+		return Frustum::FromViewProj(viewProj);
+	}
+}
+
+// A scripted camera path over moving boxes: the cached cull must return
+// exactly what testing every box returns, on every frame.
+TEST(CachedCullMatchesExhaustiveCull)
+{
+	std::mt19937 rng(31);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f), size(0.1f, 4.0f), jitter(-1.0f, 1.0f);
+
+	auto randomBox = [&]
+	{
+		AABB box;
+		box.Min = { position(rng), position(rng) * 0.2f, position(rng) };
+		box.Max = { box.Min.x + size(rng), box.Min.y + size(rng), box.Min.z + size(rng) };
+		return box;
+	};
+
+	FrustumCuller culler;
+	std::vector<AABB> boxes;
+	for (int i = 0; i < 20000; ++i)
+	{
+		boxes.push_back(randomBox());
+		culler.Add(boxes.back());
+	}
+
+	CullCache cache;
+	XMFLOAT4X4 proj = Proj(0.25f * 3.1415926f);
+	XMFLOAT3 eye = { 0.0f, 5.0f, -50.0f };
+	float yaw = 0.0f, pitch = 0.0f;
+
+	uint64_t stillTested = 0, stillTotal = 0;
+	int mismatches = 0;
+
+	for (int frame = 0; frame < 600; ++frame)
+	{
+		// 100 frames each of a still, a slowly turning and a jumping camera.
+		int phase = (frame / 100) % 3;
+		if (phase == 1)
+		{
+			eye.x += 0.05f;
+			yaw += 0.002f;
+		}
+		else if (phase == 2)
+		{
+			eye.x += jitter(rng) * 2.0f;
+			eye.z += jitter(rng) * 2.0f;
+			yaw += jitter(rng) * 0.05f;
+			pitch = jitter(rng) * 0.1f;
+		}
+
+		// A zoom forgets every cached result.
+		if (frame == 250)
+			proj = Proj(0.3f * 3.1415926f);
+
+		culler.BeginUpdate();
+		for (int k = 0; k < 20; ++k)
+		{
+			uint32_t i = rng() % boxes.size();
+			float dx = jitter(rng);
+			boxes[i].Min.x += dx;
+			boxes[i].Max.x += dx;
+			culler.Set(i, boxes[i]);
+		}
+
+		if (frame % 97 == 5)
+		{
+			culler.Remove(3);
+			boxes[3] = boxes.back();
+			boxes.pop_back();
+
+			boxes.push_back(randomBox());
+			culler.Add(boxes.back());
+		}
+
+		XMFLOAT4X4 view = View(eye, yaw, pitch);
+		cache.Update(view, proj);
+		Frustum frustum = FrustumOf(view, proj);
+
+		std::vector<uint32_t> cached, exhaustive;
+		culler.Cull(frustum, cache, cached);
+		culler.Cull(frustum, exhaustive);
+		if (cached != exhaustive)
+			++mismatches;
+
+		if (phase == 0 && frame % 97 != 5)
+		{
+			stillTested += cache.TestedCount();
+			stillTotal += culler.Size();
+		}
+	}
+
+	CHECK(mismatches == 0);
+
+	// A still camera only re-tests the boxes that moved.
+	CHECK(stillTested * 10 < stillTotal);
+}
+
+TEST(CullMatchesFrustumTestAtEveryCount)
+{
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f), size(0.1f, 5.0f);
+
+	XMFLOAT4X4 proj = Proj(0.25f * 3.1415926f);
+	Frustum frustum = FrustumOf(View({ 0.0f, 0.0f, -120.0f }, 0.3f, 0.1f), proj);
+
+	// Counts around the SIMD width and the job size.
+	for (int count : { 0, 1, 3, 4, 5, 1023, 1024, 1025, 100003 })
+	{
+		FrustumCuller culler;
+		std::vector<uint32_t> expected;
+		for (int i = 0; i < count; ++i)
+		{
+			AABB box;
+			box.Min = { position(rng), position(rng), position(rng) };
+			box.Max = { box.Min.x + size(rng), box.Min.y + size(rng), box.Min.z + size(rng) };
+			culler.Add(box);
+			if (frustum.Test(box) != DISJOINT)
+				expected.push_back(i);
+		}
+
+		std::vector<uint32_t> visible;
+		culler.Cull(frustum, visible);
+		CHECK(visible == expected);
+	}
+}
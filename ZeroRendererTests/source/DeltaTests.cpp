@@ -0,0 +1,124 @@
+#include "Test.h"
+
+#include "DXRuntime/SceneDeltaBuilder.h"
+
+#include <cstring>
+#include <random>
+
+namespace
+{
+	// What SceneScatter does with the upload: copies every packet's payload
+	// into place.
+	void Scatter(const SceneDeltaBuilder& builder, std::vector<uint32_t>& buffer)
+	{
+		const char* upload = (const char*)builder.Upload().data();
+		for (uint32_t p = 0; p < builder.PacketCount(); ++p)
+		{
+			const DeltaPacket& packet = builder.GetPacket(p);
+			std::memcpy((char*)buffer.data() + packet.DestOffset, upload + packet.SrcOffset, packet.ByteCount);
+		}
+	}
+}
+
+TEST(DeltaLastWriteWinsPerRange)
+{
+	const uint32_t first[4] = { 1, 2, 3, 4 }, second[4] = { 5, 6, 7, 8 }, other[4] = { 9, 9, 9, 9 };
+
+	SceneDeltaBuilder builder;
+	builder.Write(0, first, 16);
+	builder.Write(32, other, 16);
+	builder.Write(0, second, 16);
+	builder.Build();
+
+	CHECK(builder.WriteCount() == 2);
+	CHECK(builder.PacketCount() == 2);
+
+	std::vector<uint32_t> buffer(12, 0);
+	Scatter(builder, buffer);
+	CHECK(std::memcmp(&buffer[0], second, 16) == 0);
+	CHECK(std::memcmp(&buffer[8], other, 16) == 0);
+}
+
+TEST(DeltaAdjacentRangesMergeIntoOnePacket)
+{
+	const uint32_t record[4] = { 1, 2, 3, 4 };
+
+	// Written backwards, with one range twice and one far away.
+	SceneDeltaBuilder builder;
+	for (int i = 9; i >= 0; --i)
+		builder.Write(i * 16, record, 16);
+	builder.Write(3 * 16, record, 16);
+	builder.Write(100 * 16, record, 16);
+	builder.Build();
+
+	CHECK(builder.PacketCount() == 2);
+	CHECK(builder.WriteCount() == 11);
+	CHECK(builder.GetPacket(0).DestOffset == 0);
+	CHECK(builder.GetPacket(0).ByteCount == 10 * 16);
+	CHECK(builder.GetPacket(1).DestOffset == 100 * 16);
+	CHECK(builder.GetPacket(1).ByteCount == 16);
+
+	// The queue was emptied.
+	builder.Build();
+	CHECK(builder.PacketCount() == 0);
+	CHECK(builder.UploadBytes() == 0);
+}
+
+TEST(DeltaSrcOffsetSkipsPacketHeaders)
+{
+	const uint32_t a[2] = { 11, 12 }, b[3] = { 21, 22, 23 };
+
+	SceneDeltaBuilder builder;
+	builder.Write(400, b, 12);
+	builder.Write(0, a, 8);
+	builder.Build();
+
+	// Three words of header per packet come first, then the payload in
+	// packet order.
+	const uint32_t headerBytes = 2 * sizeof(DeltaPacket);
+	CHECK(builder.PacketCount() == 2);
+	CHECK(builder.GetPacket(0).SrcOffset == headerBytes);
+	CHECK(builder.GetPacket(1).SrcOffset == headerBytes + 8);
+	CHECK(builder.UploadBytes() == headerBytes + 8 + 12);
+
+	const std::vector<uint32_t>& upload = builder.Upload();
+	CHECK(std::memcmp(upload.data(), &builder.GetPacket(0), headerBytes) == 0);
+	CHECK(upload[6] == 11 && upload[7] == 12);
+	CHECK(upload[8] == 21 && upload[10] == 23);
+}
+
+TEST(DeltaUploadReproducesEveryWrite)
+{
+	std::mt19937 rng(45);
+
+	for (int round = 0; round < 200; ++round)
+	{
+		// Records the size of ObjectData, written in any order.
+		const uint32_t stride = 132, count = 1 + rng() % 500;
+		std::vector<uint32_t> expected(count * stride / 4, 0), buffer(expected);
+
+		SceneDeltaBuilder builder;
+		int writes = rng() % 800;
+		for (int w = 0; w < writes; ++w)
+		{
+			uint32_t index = rng() % count;
+			uint32_t record[stride / 4];
+			for (uint32_t& word : record)
+				word = rng();
+			builder.Write(index * stride, record, stride);
+			std::memcpy(&expected[index * stride / 4], record, stride);
+		}
+		builder.Build();
+
+		// Packets are sorted and never touch, or they would have merged.
+		for (uint32_t p = 1; p < builder.PacketCount(); ++p)
+		{
+			const DeltaPacket& previous = builder.GetPacket(p - 1);
+			CHECK(builder.GetPacket(p).DestOffset > previous.DestOffset + previous.ByteCount);
+		}
+
+		Scatter(builder, buffer);
+		CHECK(buffer == expected);
+		CHECK(builder.Empty());
+	}
+}
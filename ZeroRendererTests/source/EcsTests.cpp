@@ -0,0 +1,96 @@
+#include "Test.h"
+
+#include "ECS/World.h"
+
+namespace
+{
+	struct Position { float X, Y, Z; };
+	struct Velocity { float X, Y, Z; };
+	struct Hidden {};
+}
+
+TEST(WorldKeepsComponentsAcrossSwapBack)
+{
+	ecs::World world;
+
+	std::vector<ecs::Entity> entities;
+	for (int i = 0; i < 1000; ++i)
+	{
+		entities.push_back(i % 2 ?
+			world.Create(Position{ float(i), 0, 0 }, Velocity{ 0, float(i), 0 }) :
+			world.CreateTagged(ecs::MaskOf<Hidden>(), Position{ float(i), 0, 0 }));
+	}
+
+	for (int i = 0; i < 1000; i += 3)
+		world.Destroy(entities[i]);
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		if (i % 3 == 0)
+		{
+			CHECK(!world.IsAlive(entities[i]));
+			CHECK(world.Get<Position>(entities[i]) == nullptr);
+			continue;
+		}
+
+		CHECK(world.Get<Position>(entities[i])->X == float(i));
+		CHECK(world.Has<Hidden>(entities[i]) == (i % 2 == 0));
+		if (i % 2)
+			CHECK(world.Get<Velocity>(entities[i])->Y == float(i));
+	}
+
+	CHECK(world.Size() == 1000 - 334);
+}
+
+TEST(WorldMovesEntitiesBetweenArchetypes)
+{
+	ecs::World world;
+	ecs::Entity e = world.CreateTagged(ecs::MaskOf<Hidden>(), Position{ 1, 2, 3 });
+
+	world.Add(e, Velocity{ 4, 5, 6 });
+	CHECK(world.Has<Hidden>(e) && world.Has<Velocity>(e));
+	CHECK(world.Get<Position>(e)->Z == 3 && world.Get<Velocity>(e)->X == 4);
+
+	world.Remove<Hidden>(e);
+	CHECK(!world.Has<Hidden>(e));
+	CHECK(world.Get<Position>(e)->Y == 2 && world.Get<Velocity>(e)->Z == 6);
+
+	size_t rows = 0;
+	world.ForEachChunk<Position>([&](ecs::Chunk& chunk) { rows += chunk.Count; });
+	CHECK(rows == 1);
+}
+
+TEST(StaleHandlesStayDeadAcrossGenerationWrap)
+{
+	ecs::World world;
+
+	// One slot, reused until its generation wraps around.
+	std::vector<ecs::Entity> handles;
+	for (int i = 0; i < 300; ++i)
+	{
+		ecs::Entity e = world.Create(Position{});
+		CHECK(ecs::EntityIndex(e) == 0);
+		CHECK(e != ecs::NullEntity);
+		handles.push_back(e);
+		world.Destroy(e);
+	}
+
+	ecs::Entity live = world.Create(Position{});
+	for (ecs::Entity handle : handles)
+	{
+		if (handle != live)
+			CHECK(!world.IsAlive(handle));
+	}
+
+	CHECK(world.IsAlive(live));
+	CHECK(!world.IsAlive(ecs::NullEntity));
+}
+
+TEST(NullEntityIsNoValidHandle)
+{
+	// The last index is reserved, so no slot and generation encode to it.
+	for (uint32_t generation = 0; generation < 256; ++generation)
+		CHECK(ecs::MakeEntity(ecs::MaxEntityIndex, generation) != ecs::NullEntity);
+
+	CHECK(ecs::MakeEntity(ecs::EntityIndexMask, 255) == ecs::NullEntity);
+}
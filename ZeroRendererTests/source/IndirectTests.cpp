@@ -0,0 +1,50 @@
+#include "Test.h"
+
+#include "DXRuntime/IndirectArguments.h"
+
+#include <cstddef>
+
+// The command signature and the CPU-side packing must agree byte for byte:
+// root constant, VBV, IBV, then DrawIndexed, in 56 bytes.
+TEST(DrawLayoutMatchesIndirectDrawArguments)
+{
+	IndirectArgumentLayout layout = DrawLayout(5);
+	CHECK(layout.IsComplete());
+	CHECK(layout.ArgumentCount() == 4);
+	CHECK(layout.ByteStride() == 56);
+	CHECK(layout.ByteStride() == sizeof(IndirectDrawArguments));
+
+	CHECK(layout.Offset(0) == 0);
+	CHECK(layout.Offset(1) == 4);
+	CHECK(layout.Offset(2) == 20);
+	CHECK(layout.Offset(3) == 36);
+
+	CHECK(layout.Offset(0) == offsetof(IndirectDrawArguments, InstanceBase));
+	CHECK(layout.Offset(1) == offsetof(IndirectDrawArguments, VertexBufferView));
+	CHECK(layout.Offset(2) == offsetof(IndirectDrawArguments, IndexBufferView));
+	CHECK(layout.Offset(3) == offsetof(IndirectDrawArguments, Draw));
+
+	CHECK(layout.Size(0) == sizeof(UINT));
+	CHECK(layout.Size(1) == sizeof(D3D12_VERTEX_BUFFER_VIEW));
+	CHECK(layout.Size(2) == sizeof(D3D12_INDEX_BUFFER_VIEW));
+	CHECK(layout.Size(3) == sizeof(D3D12_DRAW_INDEXED_ARGUMENTS));
+
+	D3D12_COMMAND_SIGNATURE_DESC desc = layout.Desc();
+	CHECK(desc.ByteStride == 56);
+	CHECK(desc.NumArgumentDescs == 4);
+	CHECK(desc.pArgumentDescs[0].Type == D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT);
+	CHECK(desc.pArgumentDescs[0].Constant.RootParameterIndex == 5);
+	CHECK(desc.pArgumentDescs[0].Constant.Num32BitValuesToSet == 1);
+	CHECK(desc.pArgumentDescs[1].Type == D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW);
+	CHECK(desc.pArgumentDescs[1].VertexBuffer.Slot == 0);
+	CHECK(desc.pArgumentDescs[2].Type == D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW);
+	CHECK(desc.pArgumentDescs[3].Type == D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED);
+}
+
+TEST(LayoutWithoutDrawIsIncomplete)
+{
+	IndirectArgumentLayout layout;
+	layout.Constants(0, 0, 2);
+	CHECK(!layout.IsComplete());
+	CHECK(layout.ByteStride() == 8);
+}
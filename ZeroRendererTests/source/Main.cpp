@@ -0,0 +1,59 @@
+#include "Test.h"
+
+#include "Common/d3dUtil.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Scene and the frame resources size their rings by this, as in the app.
+const int gNumFrameResources = 3;
+
+namespace test
+{
+	static int sFailures = 0;
+
+	std::vector<TestCase>& Registry()
+	{
+		static std::vector<TestCase> registry;
+		return registry;
+	}
+
+	void Fail(const char* file, int line, const char* expr)
+	{
+		std::printf("  %s(%d): CHECK(%s) failed\n", file, line, expr);
+		++sFailures;
+	}
+
+	void CheckText(const std::string& actual, const std::string& expected, const char* file, int line)
+	{
+		if (actual == expected)
+			return;
+
+		std::printf("  %s(%d): text differs\n--- expected\n%s--- actual\n%s---\n",
+			file, line, expected.c_str(), actual.c_str());
+		++sFailures;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+
+	int run = 0, failed = 0;
+	for (const test::TestCase& testCase : test::Registry())
+	{
+		if (filter && !std::strstr(testCase.Name, filter))
+			continue;
+
+		std::printf("%s\n", testCase.Name);
+
+		int failures = test::sFailures;
+		testCase.Func();
+		++run;
+		if (test::sFailures != failures)
+			++failed;
+	}
+
+	std::printf("%d of %d tests failed\n", failed, run);
+	return failed;
+}
@@ -0,0 +1,287 @@
+#include "Test.h"
+
+#include "Spatial/OcclusionBuffer.h"
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+	const float kFovY = 0.25f * 3.1415926f;
+	const float kNear = 1.0f;
+	const float kFar = 500.0f;
+	const XMFLOAT3 kEye = { 0.0f, 2.0f, -20.0f };
+
+	// Appends the 12 triangles of a box, clockwise seen from outside as the
+	// rasterizer state expects.
+	void AddBox(std::vector<XMFLOAT3>& vertices, const AABB& box)
+	{
+		const float lo[3] = { box.Min.x, box.Min.y, box.Min.z };
+		const float hi[3] = { box.Max.x, box.Max.y, box.Max.z };
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+			for (int side = 0; side < 2; ++side)
+			{
+				XMFLOAT3 quad[4];
+				for (int k = 0; k < 4; ++k)
+				{
+					float p[3];
+					p[axis] = side ? hi[axis] : lo[axis];
+					p[u] = (k == 1 || k == 2) ? hi[u] : lo[u];
+					p[v] = k >= 2 ? hi[v] : lo[v];
+					quad[k] = { p[0], p[1], p[2] };
+				}
+
+				// (u, v) turns counter-clockwise around +axis, which is
+				// clockwise seen from the + side.
+				const int order[2][6] = { { 0, 2, 1, 0, 3, 2 }, { 0, 1, 2, 0, 2, 3 } };
+				for (int k : order[side])
+					vertices.push_back(quad[k]);
+			}
+		}
+	}
+
+	// Nearest hit of the ray origin + t * dir with any triangle, either
+	// side, as t; FLT_MAX if none. A positive tolerance grows every
+	// triangle by that much in barycentric terms, a negative one shrinks it.
+	float RayCast(const std::vector<XMFLOAT3>& triangles, XMVECTOR origin, XMVECTOR dir, float tolerance)
+	{
+		float nearest = FLT_MAX;
+		for (size_t i = 0; i < triangles.size(); i += 3)
+		{
+			XMVECTOR v0 = XMLoadFloat3(&triangles[i]);
+			XMVECTOR e1 = XMLoadFloat3(&triangles[i + 1]) - v0;
+			XMVECTOR e2 = XMLoadFloat3(&triangles[i + 2]) - v0;
+
+			XMVECTOR p = XMVector3Cross(dir, e2);
+			float det = XMVectorGetX(XMVector3Dot(e1, p));
+			if (std::fabs(det) < 1e-12f)
+				continue;
+
+			XMVECTOR s = origin - v0;
+			float u = XMVectorGetX(XMVector3Dot(s, p)) / det;
+			XMVECTOR q = XMVector3Cross(s, e1);
+			float v = XMVectorGetX(XMVector3Dot(dir, q)) / det;
+			float t = XMVectorGetX(XMVector3Dot(e2, q)) / det;
+
+			if (u >= -tolerance && v >= -tolerance && u + v <= 1.0f + tolerance && t > 0.0f)
+				nearest = std::min(nearest, t);
+		}
+		return nearest;
+	}
+
+	// z / w of a point viewZ in front of the eye.
+	float DepthOf(float viewZ)
+	{
+		return kFar / (kFar - kNear) * (1.0f - kNear / viewZ);
+	}
+
+	// A wall in front of the camera, a ground slab that reaches behind it
+	// (so its triangles are clipped at the near plane) and a box turned
+	// about y, drawn through its World matrix.
+	struct OccluderScene
+	{
+		std::vector<XMFLOAT3> Wall, Ground, Turned;
+		std::vector<XMFLOAT3> WorldTriangles;   // all of them, for the ray casts
+		std::vector<OcclusionBuffer::Occluder> Occluders;
+		XMFLOAT4X4 ViewProj;
+
+		OccluderScene()
+		{
+			AddBox(Wall, { { -10.3f, -1.1f, 10.2f }, { 10.1f, 8.3f, 11.1f } });
+			AddBox(Ground, { { -200.0f, -1.6f, -100.0f }, { 200.0f, -1.1f, 300.0f } });
+			AddBox(Turned, { { -2.1f, -2.1f, -2.1f }, { 2.1f, 2.1f, 2.1f } });
+
+			XMFLOAT4X4 identity, turned;
+			XMStoreFloat4x4(&identity, XMMatrixIdentity());
+			XMStoreFloat4x4(&turned, XMMatrixRotationY(0.5f) * XMMatrixTranslation(16.3f, 1.2f, 30.7f));
+
+			Occluders.push_back({ Wall.data(), (uint32_t)Wall.size() / 3, identity });
+			Occluders.push_back({ Ground.data(), (uint32_t)Ground.size() / 3, identity });
+			Occluders.push_back({ Turned.data(), (uint32_t)Turned.size() / 3, turned });
+
+			WorldTriangles = Wall;
+			WorldTriangles.insert(WorldTriangles.end(), Ground.begin(), Ground.end());
+			for (const XMFLOAT3& local : Turned)
+			{
+				XMFLOAT3 world;
+				XMStoreFloat3(&world, XMVector3Transform(XMLoadFloat3(&local), XMLoadFloat4x4(&turned)));
+				WorldTriangles.push_back(world);
+			}
+
+			XMMATRIX view = XMMatrixLookToLH(XMLoadFloat3(&kEye), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+			XMMATRIX proj = XMMatrixPerspectiveFovLH(kFovY, (float)OcclusionBuffer::Width / OcclusionBuffer::Height, kNear, kFar);
+			XMStoreFloat4x4(&ViewProj, view * proj);
+		}
+
+		// True if the world-space point is on screen and nothing, grown by
+		// a small margin, lies between it and the eye.
+		bool SeesPoint(const XMFLOAT3& point) const
+		{
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector4Transform(XMVectorSet(point.x, point.y, point.z, 1.0f), XMLoadFloat4x4(&ViewProj)));
+			if (clip.w <= 0.0f || std::fabs(clip.x) > clip.w || std::fabs(clip.y) > clip.w || clip.z < 0.0f || clip.z > clip.w)
+				return false;
+
+			XMVECTOR eye = XMLoadFloat3(&kEye);
+			return RayCast(WorldTriangles, eye, XMLoadFloat3(&point) - eye, 1e-3f) >= 1.0f;
+		}
+
+		// The reference for IsVisible: some point of a grid over the box's
+		// faces can be seen.
+		bool SeesBox(const AABB& box) const
+		{
+			const int n = 6;
+			const float lo[3] = { box.Min.x, box.Min.y, box.Min.z };
+			const float hi[3] = { box.Max.x, box.Max.y, box.Max.z };
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+				for (int side = 0; side < 2; ++side)
+				{
+					for (int i = 0; i <= n; ++i)
+					{
+						for (int j = 0; j <= n; ++j)
+						{
+							float p[3];
+							p[axis] = side ? hi[axis] : lo[axis];
+							p[u] = lo[u] + (hi[u] - lo[u]) * i / n;
+							p[v] = lo[v] + (hi[v] - lo[v]) * j / n;
+							if (SeesPoint({ p[0], p[1], p[2] }))
+								return true;
+						}
+					}
+				}
+			}
+			return false;
+		}
+	};
+}
+
+TEST(OcclusionDepthMatchesRayCast)
+{
+	OccluderScene scene;
+	OcclusionBuffer buffer;
+	buffer.Render(scene.ViewProj, scene.Occluders);
+
+	CHECK(buffer.OccluderCount() == 3);
+	CHECK(buffer.TriangleCount() == 36);
+
+	// The camera looks down +z from kEye, so the ray through a pixel center
+	// reaches view depth t at eye + t * dir.
+	const float tanY = std::tan(0.5f * kFovY);
+	const float tanX = tanY * OcclusionBuffer::Width / OcclusionBuffer::Height;
+	const XMVECTOR eye = XMLoadFloat3(&kEye);
+
+	int nearer = 0, uncovered = 0, covered = 0;
+	for (uint32_t y = 0; y < OcclusionBuffer::Height; ++y)
+	{
+		for (uint32_t x = 0; x < OcclusionBuffer::Width; ++x)
+		{
+			float ndcX = (x + 0.5f) / OcclusionBuffer::Width * 2.0f - 1.0f;
+			float ndcY = 1.0f - (y + 0.5f) / OcclusionBuffer::Height * 2.0f;
+			XMVECTOR dir = XMVectorSet(ndcX * tanX, ndcY * tanY, 1.0f, 0.0f);
+
+			float depth = buffer.GetDepth(x, y);
+
+			// Never nearer than the triangles, even grown a little at the
+			// edges, and nothing where they are not.
+			float loose = RayCast(scene.WorldTriangles, eye, dir, 1e-3f);
+			if (loose == FLT_MAX ? depth != 1.0f : depth < DepthOf(loose) - 1e-5f)
+				++nearer;
+
+			// Pixels well inside a triangle are written.
+			float strict = RayCast(scene.WorldTriangles, eye, dir, -1e-3f);
+			if (strict != FLT_MAX && strict < kFar)
+			{
+				++covered;
+				if (depth >= 1.0f)
+					++uncovered;
+			}
+		}
+	}
+
+	CHECK(nearer == 0);
+	CHECK(uncovered == 0);
+	CHECK(covered > (int)(OcclusionBuffer::Width * OcclusionBuffer::Height / 4));
+
+	// Every texel of a level is the farthest of the four below it.
+	for (uint32_t level = 1; level < OcclusionBuffer::LevelCount; ++level)
+	{
+		bool farthest = true;
+		for (uint32_t y = 0; y < (OcclusionBuffer::Height >> level); ++y)
+		{
+			for (uint32_t x = 0; x < (OcclusionBuffer::Width >> level); ++x)
+			{
+				float below = std::max(
+					std::max(buffer.GetMaxDepth(level - 1, 2 * x, 2 * y), buffer.GetMaxDepth(level - 1, 2 * x + 1, 2 * y)),
+					std::max(buffer.GetMaxDepth(level - 1, 2 * x, 2 * y + 1), buffer.GetMaxDepth(level - 1, 2 * x + 1, 2 * y + 1)));
+				farthest &= buffer.GetMaxDepth(level, x, y) == below;
+			}
+		}
+		CHECK(farthest);
+	}
+}
+
+TEST(OcclusionCullingIsConservative)
+{
+	OccluderScene scene;
+	OcclusionBuffer buffer;
+	buffer.Render(scene.ViewProj, scene.Occluders);
+
+	// Boxes around and behind the wall. Every other one is small and close
+	// to the wall's right or top silhouette, where a pixel whose center the
+	// wall covers can still show a box through the rest of it.
+	std::mt19937 rng(32);
+	std::uniform_real_distribution<float> x(-25.0f, 25.0f), y(-1.0f, 14.0f), z(11.5f, 120.0f), size(0.05f, 3.0f);
+	std::uniform_real_distribution<float> edge(-0.3f, 0.3f), tiny(0.01f, 0.2f);
+
+	int seen = 0, hidden = 0, culled = 0, wrong = 0;
+	for (int i = 0; i < 6000; ++i)
+	{
+		AABB box;
+		if (i % 2 == 0)
+		{
+			box.Min = { x(rng), y(rng), z(rng) };
+			box.Max = { box.Min.x + size(rng), box.Min.y + size(rng), box.Min.z + size(rng) };
+		}
+		else
+		{
+			// The wall's front edges, scaled from the eye out to the box.
+			float depth = z(rng), scale = (depth - kEye.z) / (10.2f - kEye.z);
+			if (i % 4 == 1)
+				box.Min = { 10.1f * scale + edge(rng), 0.5f * y(rng), depth };
+			else
+				box.Min = { 0.3f * x(rng), kEye.y + (8.3f - kEye.y) * scale + edge(rng), depth };
+			box.Max = { box.Min.x + tiny(rng), box.Min.y + tiny(rng), box.Min.z + tiny(rng) };
+		}
+
+		bool visible = buffer.IsVisible(box);
+		if (scene.SeesBox(box))
+		{
+			++seen;
+			if (!visible)
+				++wrong;
+		}
+		else
+		{
+			++hidden;
+			if (!visible)
+				++culled;
+		}
+	}
+
+	// No box that can be seen is ever culled, and most that cannot be are.
+	CHECK(wrong == 0);
+	CHECK(seen > 500 && hidden > 500);
+	CHECK(culled > hidden * 2 / 3);
+
+	// Right behind the middle of the wall; in front of it; reaching the
+	// near plane; off screen, where the buffer knows nothing.
+	CHECK(!buffer.IsVisible({ { -2.0f, 1.0f, 20.0f }, { 2.0f, 4.0f, 24.0f } }));
+	CHECK(buffer.IsVisible({ { -2.0f, 1.0f, 5.0f }, { 2.0f, 4.0f, 9.0f } }));
+	CHECK(buffer.IsVisible({ { -1.0f, 1.0f, -20.5f }, { 1.0f, 3.0f, 40.0f } }));
+	CHECK(buffer.IsVisible({ { 300.0f, 1.0f, 20.0f }, { 301.0f, 2.0f, 21.0f } }));
+}
@@ -0,0 +1,164 @@
+#include "Test.h"
+
+#include "DXRuntime/FrameScheduler.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace
+{
+	// How the frames ran once the scheduler had settled, in milliseconds.
+	struct Timeline
+	{
+		double Latency = 0.0;    // mean, sampling to GPU completion
+		double Interval = 0.0;   // mean, between GPU completions
+		double MinWait = 1e9;    // delay of the sampling past the fence wait
+		double MaxWait = 0.0;
+		double GpuIdle = 0.0;    // total, between frames
+		int MaxQueued = 0;       // frames on the GPU when one samples its input
+	};
+
+	// A GPU that runs the frames in order, frame i for gpu(i) seconds, fed
+	// by a CPU that records frame i in cpu(i) seconds.
+	Timeline Simulate(FrameScheduler& scheduler, const std::function<double(int)>& cpu,
+		const std::function<double(int)>& gpu, int frames = 400)
+	{
+		std::vector<double> done;   // completion time of fence f at f - 1
+		double now = 0.0, gpuFree = 0.0, firstDone = 0.0;
+
+		auto completed = [&](double time)
+		{
+			uint64_t fence = 0;
+			while (fence < done.size() && done[fence] <= time)
+				++fence;
+			return fence;
+		};
+
+		Timeline timeline;
+		const int settled = frames / 2;
+		for (int i = 0; i < frames; ++i)
+		{
+			scheduler.Complete(completed(now), now, false);
+			uint64_t fence = scheduler.WaitFence();
+			if (fence && done[fence - 1] > now)
+			{
+				now = done[fence - 1];
+				scheduler.Complete(fence, now, true);
+			}
+
+			// Asleep until the sampling time, unless the wake fence completes
+			// first, as FramePacer does.
+			double ready = now;
+			double sample = scheduler.SampleTime(now);
+			uint64_t wake = scheduler.WakeFence();
+			if (wake && done[wake - 1] < sample)
+			{
+				scheduler.Complete(wake, done[wake - 1], true);
+				sample = scheduler.SampleTime(done[wake - 1]);
+			}
+			double wait = (sample - ready) * 1000.0;
+			int queued = (int)(done.size() - completed(sample));
+
+			scheduler.BeginFrame(sample);
+			now = sample + cpu(i);
+
+			double start = std::max(now, gpuFree);
+			if (i > settled)
+				timeline.GpuIdle += (start - gpuFree) * 1000.0;
+			gpuFree = start + gpu(i);
+			done.push_back(gpuFree);
+			scheduler.Submit(done.size(), now);
+
+			if (i >= settled)
+			{
+				timeline.Latency += (gpuFree - sample) * 1000.0;
+				timeline.MinWait = std::min(timeline.MinWait, wait);
+				timeline.MaxWait = std::max(timeline.MaxWait, wait);
+				timeline.MaxQueued = std::max(timeline.MaxQueued, queued);
+			}
+			if (i == settled)
+				firstDone = gpuFree;
+		}
+
+		const int measured = frames - settled;
+		timeline.Latency /= measured;
+		timeline.Interval = (gpuFree - firstDone) * 1000.0 / (measured - 1);
+		return timeline;
+	}
+
+	FrameScheduler Paced(double targetLatency)
+	{
+		FrameScheduler scheduler(3);
+		scheduler.SetPacing(true);
+		scheduler.SetTargetLatency(targetLatency);
+		return scheduler;
+	}
+
+	auto Constant(double seconds)
+	{
+		return [seconds](int) { return seconds; };
+	}
+}
+
+TEST(PacingGpuBound)
+{
+	// 4 ms of CPU and 10 ms of GPU per frame.
+	FrameScheduler unpaced(3);
+	Timeline queued = Simulate(unpaced, Constant(0.004), Constant(0.010));
+	CHECK(queued.MaxQueued == 2);
+	CHECK(queued.Latency > 29.0 && queued.Latency < 31.0);
+	CHECK(queued.MaxWait < 0.001);
+
+	// Paced with the lowest latency: the frame samples its input just late
+	// enough to be submitted StartMargin before the GPU runs dry.
+	FrameScheduler lowest = Paced(0.0);
+	Timeline paced = Simulate(lowest, Constant(0.004), Constant(0.010));
+	const double expectedWait = 10.0 - 4.0 - FrameScheduler::StartMargin * 1000.0;
+	CHECK(paced.MaxQueued <= 1);
+	CHECK(paced.MinWait > expectedWait - 0.1 && paced.MaxWait < expectedWait + 0.1);
+	CHECK(paced.Latency < 15.0);
+	CHECK(paced.Interval < 10.01);
+	CHECK(paced.GpuIdle < 0.01);
+
+	// A target above that is met exactly, by waiting less.
+	FrameScheduler target = Paced(0.017);
+	Timeline relaxed = Simulate(target, Constant(0.004), Constant(0.010));
+	CHECK(relaxed.MaxQueued <= 1);
+	CHECK(relaxed.Latency > 16.9 && relaxed.Latency < 17.1);
+	CHECK(relaxed.MaxWait < paced.MinWait);
+	CHECK(relaxed.Interval < 10.01);
+}
+
+TEST(PacingCpuBound)
+{
+	// 10 ms of CPU and 4 ms of GPU: the GPU waits on the CPU, so there is
+	// nothing to gain by waiting.
+	FrameScheduler scheduler = Paced(0.0);
+	Timeline timeline = Simulate(scheduler, Constant(0.010), Constant(0.004));
+	CHECK(timeline.MaxWait < 0.01);
+	CHECK(timeline.MaxQueued <= 1);
+	CHECK(timeline.Interval < 10.01);
+	CHECK(timeline.Latency < 14.1);
+}
+
+TEST(PacingSpikyFrames)
+{
+	// CPU times within 20% of 4 ms, and a GPU frame of 25 ms every 37 frames,
+	// the first one included, so the GPU time estimate starts far too high.
+	auto cpu = [](int i) { return 0.004 * (1.0 + 0.2 * ((i * 7919 % 13) / 6.0 - 1.0)); };
+	auto gpu = [](int i) { return i % 37 == 0 ? 0.025 : 0.010; };
+
+	FrameScheduler scheduler = Paced(0.0);
+	Timeline timeline = Simulate(scheduler, cpu, gpu);
+
+	// Frames never pile up behind a spike, and the estimate comes back down
+	// after one: the waits stay near those of steady 10 ms frames and the
+	// GPU hardly idles.
+	const double meanGpu = 10.0 + 15.0 / 37.0;
+	CHECK(timeline.MaxQueued <= 1);
+	CHECK(timeline.MinWait > 5.0 && timeline.MaxWait < 7.5);
+	CHECK(timeline.GpuIdle < 0.2 * 200);
+	CHECK(timeline.Interval < meanGpu + 0.2);
+	CHECK(timeline.Latency < 16.0);
+}
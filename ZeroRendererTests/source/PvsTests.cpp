@@ -0,0 +1,277 @@
+#include "Test.h"
+
+#include "Engine/Scene.h"
+#include "Spatial/MeshBVH.h"
+#include "Spatial/PotentiallyVisibleSet.h"
+
+#include <memory>
+#include <random>
+
+namespace
+{
+	// The 12 triangles of a box.
+	std::vector<XMFLOAT3> BoxTriangles(const AABB& box)
+	{
+		const float lo[3] = { box.Min.x, box.Min.y, box.Min.z };
+		const float hi[3] = { box.Max.x, box.Max.y, box.Max.z };
+
+		std::vector<XMFLOAT3> vertices;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+			for (int side = 0; side < 2; ++side)
+			{
+				XMFLOAT3 quad[4];
+				for (int k = 0; k < 4; ++k)
+				{
+					float p[3];
+					p[axis] = side ? hi[axis] : lo[axis];
+					p[u] = (k == 1 || k == 2) ? hi[u] : lo[u];
+					p[v] = k >= 2 ? hi[v] : lo[v];
+					quad[k] = { p[0], p[1], p[2] };
+				}
+
+				for (int k : { 0, 1, 2, 0, 2, 3 })
+					vertices.push_back(quad[k]);
+			}
+		}
+		return vertices;
+	}
+
+	AABB Box(XMFLOAT3 min, XMFLOAT3 max)
+	{
+		AABB box;
+		box.Min = min;
+		box.Max = max;
+		return box;
+	}
+
+	// A thin wall in the x = 0 plane, far wider than anything it hides.
+	const AABB kWall = Box({ -0.1f, -50.0f, -50.0f }, { 0.1f, 50.0f, 50.0f });
+
+	bool SeesFromLeft(uint32_t item)
+	{
+		// Whole words of ones, then a mix, then whole words of zeros and a
+		// last word that is only partly used.
+		return item < 256 || (item < 456 && item % 3 == 0);
+	}
+}
+
+// Cells on either side of a wall see exactly the items on their side and the
+// wall, so decoding their sets must give those bits back.
+TEST(PvsSetsDecodeToTheBakedVisibility)
+{
+	const uint32_t itemCount = 600;
+
+	std::mt19937 rng(33);
+	std::uniform_real_distribution<float> depth(5.0f, 10.0f), spread(-8.0f, 8.0f);
+
+	std::vector<PotentiallyVisibleSet::Item> items(itemCount + 1);
+	for (uint32_t i = 0; i < itemCount; ++i)
+	{
+		XMFLOAT3 min = { depth(rng), spread(rng), spread(rng) };
+		if (SeesFromLeft(i))
+			min.x = -min.x - 1.0f;
+		items[i].Bounds = Box(min, { min.x + 1.0f, min.y + 1.0f, min.z + 1.0f });
+		XMStoreFloat4x4(&items[i].World, XMMatrixIdentity());
+	}
+
+	MeshBVH wall(BoxTriangles(kWall));
+	items[itemCount].Bounds = kWall;
+	items[itemCount].Mesh = &wall;
+	XMStoreFloat4x4(&items[itemCount].World, XMMatrixIdentity());
+
+	// Cells are 4 wide along x from -12, so the two at each end stay clear of the wall.
+	PotentiallyVisibleSet::Settings settings;
+	settings.Bounds = Box({ -12.0f, -10.0f, -10.0f }, { 12.0f, 10.0f, 10.0f });
+	settings.CellSize = 4.0f;
+
+	PotentiallyVisibleSet pvs;
+	pvs.Bake(items, settings);
+
+	CHECK(pvs.ItemCount() == itemCount + 1);
+	CHECK(pvs.CellCount() == 6 * 5 * 5);
+	CHECK(pvs.IsOccluder(itemCount));
+	CHECK(!pvs.IsOccluder(0));
+
+	std::vector<uint64_t> left((itemCount + 64) / 64, 0), right(left.size(), 0);
+	for (uint32_t i = 0; i <= itemCount; ++i)
+	{
+		if (i == itemCount || SeesFromLeft(i))
+			left[i >> 6] |= 1ull << (i & 63);
+		if (i == itemCount || !SeesFromLeft(i))
+			right[i >> 6] |= 1ull << (i & 63);
+	}
+
+	std::vector<uint64_t> bits;
+	for (uint32_t z = 0; z < 5; ++z)
+	{
+		for (uint32_t y = 0; y < 5; ++y)
+		{
+			for (uint32_t x : { 0u, 1u, 4u, 5u })
+			{
+				XMFLOAT3 center = { -10.0f + 4.0f * x, -8.0f + 4.0f * y, -8.0f + 4.0f * z };
+				int32_t cell = pvs.FindCell(center);
+				CHECK(cell == (int32_t)(x + 6 * (y + 5 * z)));
+				if (cell < 0)
+					continue;
+
+				pvs.Decode(pvs.GetSetIndex(cell), bits);
+				CHECK(bits == (x < 3 ? left : right));
+			}
+		}
+	}
+
+	// Equal sets are coded once.
+	int32_t a = pvs.FindCell({ -10.0f, -8.0f, -8.0f }), b = pvs.FindCell({ -6.0f, 8.0f, 8.0f });
+	CHECK(a >= 0 && b >= 0 && pvs.GetSetIndex(a) == pvs.GetSetIndex(b));
+	CHECK(pvs.SetCount() < pvs.CellCount());
+
+	// Without the wall everything is seen from everywhere: one set of whole
+	// words of ones.
+	items.resize(640);
+	for (uint32_t i = itemCount; i < 640; ++i)
+	{
+		items[i].Bounds = Box({ 5.0f, 0.0f, 0.0f }, { 6.0f, 1.0f, 1.0f });
+		items[i].Mesh = nullptr;
+	}
+
+	pvs.Bake(items, settings);
+	CHECK(pvs.SetCount() == 1);
+	pvs.Decode(0, bits);
+	CHECK(bits == std::vector<uint64_t>(10, ~0ull));
+}
+
+TEST(PvsFindCellCoversTheBakedRegion)
+{
+	PotentiallyVisibleSet pvs;
+	CHECK(pvs.FindCell({ 1.0f, 1.0f, 1.0f }) == -1);
+
+	std::vector<PotentiallyVisibleSet::Item> items(1);
+	items[0].Bounds = Box({ 4.0f, 2.0f, 1.0f }, { 5.0f, 3.0f, 2.0f });
+	XMStoreFloat4x4(&items[0].World, XMMatrixIdentity());
+
+	PotentiallyVisibleSet::Settings settings;
+	settings.Bounds = Box({ 0.0f, 0.0f, 0.0f }, { 10.0f, 6.0f, 3.0f });
+	settings.CellSize = 2.0f;
+	pvs.Bake(items, settings);
+
+	// 5 x 3 x 2 cells, x fastest; the last layer is cut by the bounds but whole.
+	CHECK(pvs.CellCount() == 30);
+	CHECK(pvs.FindCell({ 1.0f, 1.0f, 1.0f }) == 0);
+	CHECK(pvs.FindCell({ 3.0f, 1.0f, 1.0f }) == 1);
+	CHECK(pvs.FindCell({ 1.0f, 3.0f, 1.0f }) == 5);
+	CHECK(pvs.FindCell({ 1.0f, 1.0f, 3.0f }) == 15);
+	CHECK(pvs.FindCell({ 0.0f, 0.0f, 0.0f }) == 0);
+	CHECK(pvs.FindCell({ 9.99f, 5.99f, 3.99f }) == 29);
+
+	CHECK(pvs.FindCell({ -0.01f, 1.0f, 1.0f }) == -1);
+	CHECK(pvs.FindCell({ 10.0f, 1.0f, 1.0f }) == -1);
+	CHECK(pvs.FindCell({ 1.0f, 6.0f, 1.0f }) == -1);
+	CHECK(pvs.FindCell({ 1.0f, 1.0f, 4.0f }) == -1);
+
+	pvs.Clear();
+	CHECK(pvs.Empty());
+	CHECK(pvs.FindCell({ 1.0f, 1.0f, 1.0f }) == -1);
+}
+
+// A static wall hides the box behind it, batched or not, until the wall
+// moves, is hidden or is destroyed; moving anything else keeps the bake.
+TEST(PvsIsClearedWhenAnOccluderMoves)
+{
+	const AABB wallBox = Box({ -0.1f, -5.0f, -5.0f }, { 0.1f, 5.0f, 5.0f });
+	const AABB unitBox = Box({ -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f });
+
+	MeshGeometry geo;
+	SubmeshGeometry wallMesh;
+	wallMesh.IndexCount = 36;
+	wallMesh.Bounds = wallBox.ToBoundingBox();
+	wallMesh.BVH = std::make_shared<MeshBVH>(BoxTriangles(wallBox));
+	geo.DrawArgs["wall"] = wallMesh;
+
+	SubmeshGeometry boxMesh;
+	boxMesh.IndexCount = 36;
+	boxMesh.StartIndexLocation = 36;
+	boxMesh.Bounds = unitBox.ToBoundingBox();
+	geo.DrawArgs["box"] = boxMesh;
+
+	Material mat;
+
+	Scene scene;
+	ecs::Entity wall = scene.CreateRenderItem(RenderLayer::Opaque, XMMatrixIdentity(), XMMatrixIdentity(),
+		&mat, &geo, 36, 0, 0, wallMesh.Bounds);
+	ecs::Entity mover = scene.CreateRenderItem(RenderLayer::Opaque, XMMatrixTranslation(-6.0f, 0.0f, 0.0f), XMMatrixIdentity(),
+		&mat, &geo, 36, 36, 0, boxMesh.Bounds);
+	scene.CreateRenderItem(RenderLayer::Opaque, XMMatrixTranslation(6.0f, 0.0f, 0.0f), XMMatrixIdentity(),
+		&mat, &geo, 36, 36, 0, boxMesh.Bounds);
+	scene.UpdateTransforms();
+
+	const XMFLOAT3 eye = { -8.0f, 0.0f, 0.0f };
+	XMFLOAT4X4 view, proj, viewProj;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMLoadFloat3(&eye), XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+	XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(0.5f * 3.1415926f, 1.0f, 0.1f, 100.0f));
+	XMStoreFloat4x4(&viewProj, XMLoadFloat4x4(&view) * XMLoadFloat4x4(&proj));
+	const Frustum frustum = Frustum::FromViewProj(viewProj);
+
+	// Number of items PvsCull removes from a fresh cull, -1 if it has no set.
+	VisibleSet visible;
+	auto pvsCulled = [&](uint32_t inFrustum = 3) -> int
+	{
+		scene.Cull(frustum, view, proj, LayerMask(RenderLayer::Opaque), visible);
+		CHECK(visible.VisibleCount == inFrustum);
+		return scene.PvsCull(eye, visible) ? (int)visible.PvsCulledCount : -1;
+	};
+
+	CHECK(pvsCulled() == -1);
+
+	// Items that may move do not hide anything.
+	scene.BakePVS(2.0f, 32);
+	CHECK(!scene.GetPVS().Empty());
+	CHECK(pvsCulled() == 0);
+
+	scene.SetStatic(wall, true);
+	scene.BakePVS(2.0f, 32);
+	CHECK(pvsCulled() == 1);
+
+	LocalTransform local = scene.GetLocalTransform(mover);
+	local.Translation.y += 1.0f;
+	scene.SetLocalTransform(mover, local);
+	scene.UpdateTransforms();
+	CHECK(!scene.GetPVS().Empty());
+	CHECK(pvsCulled() == 1);
+
+	local = scene.GetLocalTransform(wall);
+	local.Translation.x += 1.0f;
+	scene.SetLocalTransform(wall, local);
+	scene.UpdateTransforms();
+	CHECK(scene.GetPVS().Empty());
+	CHECK(pvsCulled() == -1);
+
+	local.Translation.x -= 1.0f;
+	scene.SetLocalTransform(wall, local);
+	scene.UpdateTransforms();
+	scene.BakePVS(2.0f, 32);
+	CHECK(pvsCulled() == 1);
+
+	scene.SetVisible(wall, false);
+	CHECK(scene.GetPVS().Empty());
+
+	scene.SetVisible(wall, true);
+	scene.BakePVS(2.0f, 32);
+	CHECK(pvsCulled() == 1);
+
+	// A batched wall is drawn by its batch, not culled on its own, but it
+	// still hides the box; moving it clears the sets as before.
+	scene.SetBatched(wall, true);
+	scene.BakePVS(2.0f, 32);
+	CHECK(pvsCulled(2) == 1);
+
+	local.Translation.x += 1.0f;
+	scene.SetLocalTransform(wall, local);
+	scene.UpdateTransforms();
+	CHECK(scene.GetPVS().Empty());
+
+	scene.BakePVS(2.0f, 32);
+	scene.DestroyRenderItem(wall);
+	CHECK(scene.GetPVS().Empty());
+}
@@ -0,0 +1,216 @@
+#include "Test.h"
+
+#include "DXRuntime/RenderGraph.h"
+
+namespace
+{
+	const D3D12_RESOURCE_STATES RT = D3D12_RESOURCE_STATE_RENDER_TARGET;
+	const D3D12_RESOURCE_STATES PSR = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+	const D3D12_RESOURCE_STATES DW = D3D12_RESOURCE_STATE_DEPTH_WRITE;
+	const D3D12_RESOURCE_STATES DepthRead = D3D12_RESOURCE_STATES(D3D12_RESOURCE_STATE_DEPTH_READ | PSR);
+
+	// What the device would report for a texture of that many bytes.
+	D3D12_RESOURCE_ALLOCATION_INFO Info(UINT64 size)
+	{
+		return { size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT };
+	}
+
+	// The renderer's passes, declared as their Declare does, with one blur
+	// iteration to keep the plans short.
+	struct Frame
+	{
+		RenderGraph Graph;
+		RenderGraph::ResourceId BackBuffer, DepthStencil;
+		RenderGraph::ResourceId ShadowMap = RenderGraph::None, AmbientMap = RenderGraph::None;
+
+		Frame()
+		{
+			BackBuffer = Graph.Import("BackBuffer", D3D12_RESOURCE_STATE_PRESENT);
+			DepthStencil = Graph.Import("DepthStencil", DW);
+		}
+
+		void Shadow()
+		{
+			ShadowMap = Graph.CreateTexture("ShadowMap", {}, nullptr, Info(16 << 20));
+			RenderGraph::PassId pass = Graph.AddPass("Shadow");
+			Graph.Write(pass, ShadowMap, DW);
+		}
+
+		void Ssao()
+		{
+			RenderGraph::ResourceId normals = Graph.CreateTexture("NormalMap", {}, nullptr, Info(8 << 20));
+			RenderGraph::ResourceId ambient0 = Graph.CreateTexture("AmbientMap0", {}, nullptr, Info(1 << 20));
+			RenderGraph::ResourceId ambient1 = Graph.CreateTexture("AmbientMap1", {}, nullptr, Info(1 << 20));
+
+			RenderGraph::PassId pass = Graph.AddPass("Normals");
+			Graph.Write(pass, normals, RT);
+			Graph.Write(pass, DepthStencil, DW);
+
+			pass = Graph.AddPass("Ssao");
+			Graph.Read(pass, normals, PSR);
+			Graph.Read(pass, DepthStencil, DepthRead);
+			Graph.Write(pass, ambient0, RT);
+
+			pass = Graph.AddPass("SsaoBlurH");
+			Graph.Read(pass, normals, PSR);
+			Graph.Read(pass, DepthStencil, DepthRead);
+			Graph.Read(pass, ambient0, PSR);
+			Graph.Write(pass, ambient1, RT);
+
+			pass = Graph.AddPass("SsaoBlurV");
+			Graph.Read(pass, normals, PSR);
+			Graph.Read(pass, DepthStencil, DepthRead);
+			Graph.Read(pass, ambient1, PSR);
+			Graph.Write(pass, ambient0, RT);
+
+			AmbientMap = ambient0;
+		}
+
+		void Main()
+		{
+			RenderGraph::PassId pass = Graph.AddPass("Main");
+			Graph.Read(pass, ShadowMap, PSR);
+			Graph.Read(pass, AmbientMap, PSR);
+			Graph.Write(pass, BackBuffer, RT);
+			Graph.Write(pass, DepthStencil, DW);
+		}
+	};
+}
+
+TEST(RenderGraphShadowSsaoMainPlan)
+{
+	// The shadow map lives through the whole frame, so nothing can share
+	// memory with it.
+	Frame frame;
+	frame.Shadow();
+	frame.Ssao();
+	frame.Main();
+	frame.Graph.Compile();
+
+	CHECK_TEXT(frame.Graph.Describe(),
+		"Shadow\n"
+		"Normals\n"
+		"Ssao\n"
+		"  NormalMap: RENDER_TARGET -> PIXEL_SHADER_RESOURCE\n"
+		"  DepthStencil: DEPTH_WRITE -> DEPTH_READ|PIXEL_SHADER_RESOURCE\n"
+		"SsaoBlurH\n"
+		"  AmbientMap0: RENDER_TARGET -> PIXEL_SHADER_RESOURCE\n"
+		"SsaoBlurV\n"
+		"  AmbientMap1: RENDER_TARGET -> PIXEL_SHADER_RESOURCE\n"
+		"  AmbientMap0: PIXEL_SHADER_RESOURCE -> RENDER_TARGET\n"
+		"Main\n"
+		"  NormalMap: PIXEL_SHADER_RESOURCE -> RENDER_TARGET\n"
+		"  AmbientMap1: PIXEL_SHADER_RESOURCE -> RENDER_TARGET\n"
+		"  ShadowMap: DEPTH_WRITE -> PIXEL_SHADER_RESOURCE\n"
+		"  AmbientMap0: RENDER_TARGET -> PIXEL_SHADER_RESOURCE\n"
+		"  BackBuffer: COMMON -> RENDER_TARGET\n"
+		"  DepthStencil: DEPTH_READ|PIXEL_SHADER_RESOURCE -> DEPTH_WRITE\n"
+		"final\n"
+		"  ShadowMap: PIXEL_SHADER_RESOURCE -> DEPTH_WRITE\n"
+		"  AmbientMap0: PIXEL_SHADER_RESOURCE -> RENDER_TARGET\n"
+		"  BackBuffer: RENDER_TARGET -> COMMON\n"
+		"heap 27262976, 27262976 without aliasing\n"
+		"  ShadowMap: 0 + 16777216, passes 0-5, created DEPTH_WRITE\n"
+		"  NormalMap: 16777216 + 8388608, passes 1-4, created RENDER_TARGET\n"
+		"  AmbientMap0: 25165824 + 1048576, passes 2-5, created RENDER_TARGET\n"
+		"  AmbientMap1: 26214400 + 1048576, passes 3-4, created RENDER_TARGET\n");
+}
+
+TEST(RenderGraphRendererFramePlan)
+{
+	// As ZeroRenderer::BuildRenderGraph orders them: the shadow map takes
+	// over the memory of the normal map and a blur target.
+	Frame frame;
+	frame.Ssao();
+	frame.Shadow();
+	frame.Main();
+	frame.Graph.Compile();
+
+	CHECK_TEXT(frame.Graph.Describe(),
+		"Normals\n"
+		"  alias NormalMap after ShadowMap\n"
+		"Ssao\n"
+		"  NormalMap: RENDER_TARGET -> PIXEL_SHADER_RESOURCE\n"
+		"  DepthStencil: DEPTH_WRITE -> DEPTH_READ|PIXEL_SHADER_RESOURCE\n"
+		"SsaoBlurH\n"
+		"  alias AmbientMap1 after ShadowMap\n"
+		"  AmbientMap0: RENDER_TARGET -> PIXEL_SHADER_RESOURCE\n"
+		"SsaoBlurV\n"
+		"  AmbientMap1: RENDER_TARGET -> PIXEL_SHADER_RESOURCE\n"
+		"  AmbientMap0: PIXEL_SHADER_RESOURCE -> RENDER_TARGET\n"
+		"Shadow\n"
+		"  NormalMap: PIXEL_SHADER_RESOURCE -> RENDER_TARGET\n"
+		"  AmbientMap1: PIXEL_SHADER_RESOURCE -> RENDER_TARGET\n"
+		"  alias ShadowMap after any\n"
+		"Main\n"
+		"  ShadowMap: DEPTH_WRITE -> PIXEL_SHADER_RESOURCE\n"
+		"  AmbientMap0: RENDER_TARGET -> PIXEL_SHADER_RESOURCE\n"
+		"  BackBuffer: COMMON -> RENDER_TARGET\n"
+		"  DepthStencil: DEPTH_READ|PIXEL_SHADER_RESOURCE -> DEPTH_WRITE\n"
+		"final\n"
+		"  AmbientMap0: PIXEL_SHADER_RESOURCE -> RENDER_TARGET\n"
+		"  ShadowMap: PIXEL_SHADER_RESOURCE -> DEPTH_WRITE\n"
+		"  BackBuffer: RENDER_TARGET -> COMMON\n"
+		"heap 17825792, 27262976 without aliasing\n"
+		"  NormalMap: 0 + 8388608, passes 0-3, created RENDER_TARGET\n"
+		"  AmbientMap0: 16777216 + 1048576, passes 1-5, created RENDER_TARGET\n"
+		"  AmbientMap1: 8388608 + 1048576, passes 2-3, created RENDER_TARGET\n"
+		"  ShadowMap: 0 + 16777216, passes 4-5, created DEPTH_WRITE\n");
+}
+
+TEST(RenderGraphCulledPassAndAliasedTransients)
+{
+	RenderGraph graph;
+	RenderGraph::ResourceId backBuffer = graph.Import("BackBuffer", D3D12_RESOURCE_STATE_PRESENT);
+	RenderGraph::ResourceId debug = graph.CreateTexture("DebugView", {}, nullptr, Info(1 << 20));
+	RenderGraph::ResourceId bright = graph.CreateTexture("Bright", {}, nullptr, Info(100000));
+	RenderGraph::ResourceId bloom = graph.CreateTexture("Bloom", {}, nullptr, Info(100000));
+	RenderGraph::ResourceId color = graph.CreateTexture("Color", {}, nullptr, Info(100000));
+
+	// Nothing reads the debug view, so its pass goes.
+	RenderGraph::PassId pass = graph.AddPass("Debug");
+	graph.Write(pass, debug, RT);
+
+	pass = graph.AddPass("Bright");
+	graph.Write(pass, bright, RT);
+
+	pass = graph.AddPass("Bloom");
+	graph.Read(pass, bright, PSR);
+	graph.Write(pass, bloom, RT);
+
+	// Bright is dead by now: Color takes over its memory.
+	pass = graph.AddPass("Tonemap");
+	graph.Read(pass, bloom, PSR);
+	graph.Write(pass, color, RT);
+
+	pass = graph.AddPass("Present");
+	graph.Read(pass, color, PSR);
+	graph.Write(pass, backBuffer, RT);
+
+	graph.Compile();
+
+	CHECK(graph.IsCulled(0));
+	CHECK(graph.GetCulledCount() == 1);
+	CHECK_TEXT(graph.Describe(),
+		"Debug (culled)\n"
+		"Bright\n"
+		"  alias Bright after Color\n"
+		"Bloom\n"
+		"  Bright: RENDER_TARGET -> PIXEL_SHADER_RESOURCE\n"
+		"Tonemap\n"
+		"  Bright: PIXEL_SHADER_RESOURCE -> RENDER_TARGET\n"
+		"  alias Color after Bright\n"
+		"  Bloom: RENDER_TARGET -> PIXEL_SHADER_RESOURCE\n"
+		"Present\n"
+		"  Bloom: PIXEL_SHADER_RESOURCE -> RENDER_TARGET\n"
+		"  Color: RENDER_TARGET -> PIXEL_SHADER_RESOURCE\n"
+		"  BackBuffer: COMMON -> RENDER_TARGET\n"
+		"final\n"
+		"  Color: PIXEL_SHADER_RESOURCE -> RENDER_TARGET\n"
+		"  BackBuffer: RENDER_TARGET -> COMMON\n"
+		"heap 231072, 300000 without aliasing\n"
+		"  DebugView: unused\n"
+		"  Bright: 0 + 100000, passes 0-1, created RENDER_TARGET\n"
+		"  Bloom: 131072 + 100000, passes 1-2, created RENDER_TARGET\n"
+		"  Color: 0 + 100000, passes 2-3, created RENDER_TARGET\n");
+}
@@ -0,0 +1,389 @@
+#include "Test.h"
+
+#include "Engine/SceneSerializer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+namespace
+{
+	struct SceneFixture
+	{
+		std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> Geometries;
+		MatManager Materials;
+		Scene World;
+		std::vector<ecs::Entity> Items;
+
+		SceneFixture()
+		{
+			auto geo = std::make_unique<MeshGeometry>();
+			geo->Name = "shapeGeo";
+
+			SubmeshGeometry box;
+			box.IndexCount = 36;
+			box.Bounds = BoundingBox({ 0.0f, 0.0f, 0.0f }, { 0.5f, 0.5f, 0.5f });
+			geo->DrawArgs["box"] = box;
+
+			SubmeshGeometry sphere;
+			sphere.IndexCount = 600;
+			sphere.StartIndexLocation = 36;
+			sphere.BaseVertexLocation = 24;
+			sphere.Bounds = BoundingBox({ 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f });
+			geo->DrawArgs["sphere"] = sphere;
+
+			Geometries[geo->Name] = std::move(geo);
+		}
+
+		// Items 0..count-1 sit at x = index, so a loaded item can be told
+		// apart by its local translation.
+		void Populate(int count)
+		{
+			Materials.CreateMaterial("bricks0", 0, 0, { 1.0f, 0.9f, 0.8f, 1.0f }, { 0.1f, 0.1f, 0.1f }, 0.3f);
+			Materials.CreateMaterial("tile0", 1, 1, { 0.9f, 0.9f, 0.9f, 1.0f }, { 0.2f, 0.2f, 0.2f }, 0.1f, 5);
+			Materials.CreateMaterial("glass0", 2, 2, { 0.5f, 0.5f, 1.0f, 0.3f }, { 0.04f, 0.04f, 0.04f }, 0.0f);
+
+			MeshGeometry* geo = Geometries["shapeGeo"].get();
+			const char* materialNames[] = { "bricks0", "tile0", "glass0" };
+			for (int i = 0; i < count; ++i)
+			{
+				const SubmeshGeometry& submesh = geo->DrawArgs[i % 3 ? "box" : "sphere"];
+				RenderLayer layer = i % 7 == 0 ? RenderLayer::Transparent : RenderLayer::Opaque;
+				Items.push_back(World.CreateRenderItem(layer,
+					XMMatrixTranslation(float(i), float(i % 5), 0.5f * i), XMMatrixScaling(2.0f, 2.0f, 1.0f),
+					Materials.GetMaterial(materialNames[i % 3]), geo,
+					submesh.IndexCount, submesh.StartIndexLocation, submesh.BaseVertexLocation, submesh.Bounds));
+			}
+
+			for (int i = 10; i < count; i += 10)
+				World.SetParent(Items[i], Items[i - 9]);
+			World.SetParent(Items[20], Items[10]);
+
+			for (int i = 3; i < count; i += 11)
+				World.SetOccluder(Items[i], true);
+			for (int i = 4; i < count; i += 13)
+				World.SetVisible(Items[i], false);
+			for (int i = 5; i < count; i += 6)
+				World.SetStatic(Items[i], true);
+
+			World.UpdateTransforms();
+		}
+	};
+
+	std::string TempPath(const char* name)
+	{
+		return (std::filesystem::temp_directory_path() / name).string();
+	}
+
+	std::vector<char> ReadBytes(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void WriteBytes(const std::string& path, const std::vector<char>& bytes, size_t size)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(bytes.data(), size);
+	}
+
+	// Offsets of the sections of a scene file, see SceneSerializer.cpp.
+	struct FileLayout
+	{
+		uint32_t StringBytes, MaterialCount, SubmeshCount, ItemCount;
+		size_t Strings, Materials, Submeshes, Transforms, Locals, Bounds;
+		size_t ItemSubmeshes, ItemMaterials, Parents, Layers, Flags;
+	};
+
+	FileLayout LayoutOf(const std::vector<char>& bytes)
+	{
+		// Magic, Version, StringBytes, MaterialCount, SubmeshCount, ItemCount
+		uint32_t header[6];
+		std::memcpy(header, bytes.data(), sizeof(header));
+
+		size_t offset = 0;
+		auto next = [&](size_t size)
+		{
+			size_t at = offset;
+			offset = (offset + size + 15) / 16 * 16;
+			return at;
+		};
+
+		const size_t fileMaterialSize = 112;   // name, three indices, albedo, fresnel, roughness, transform
+		const size_t fileSubmeshSize = 12;
+
+		FileLayout layout;
+		layout.StringBytes = header[2];
+		layout.MaterialCount = header[3];
+		layout.SubmeshCount = header[4];
+		layout.ItemCount = header[5];
+
+		next(sizeof(header));
+		layout.Strings = next(layout.StringBytes);
+		layout.Materials = next(layout.MaterialCount * fileMaterialSize);
+		layout.Submeshes = next(layout.SubmeshCount * fileSubmeshSize);
+		layout.Transforms = next(layout.ItemCount * sizeof(TransformComponent));
+		layout.Locals = next(layout.ItemCount * sizeof(LocalTransform));
+		layout.Bounds = next(layout.ItemCount * sizeof(BoundsComponent));
+		layout.ItemSubmeshes = next(layout.ItemCount * sizeof(uint32_t));
+		layout.ItemMaterials = next(layout.ItemCount * sizeof(uint32_t));
+		layout.Parents = next(layout.ItemCount * sizeof(int32_t));
+		layout.Layers = next(layout.ItemCount);
+		layout.Flags = next(layout.ItemCount);
+		return layout;
+	}
+
+	template<typename T>
+	void Poke(std::vector<char>& bytes, size_t offset, T value)
+	{
+		std::memcpy(bytes.data() + offset, &value, sizeof(T));
+	}
+
+	int LayerOf(ecs::World& world, ecs::Entity item)
+	{
+		for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+			if (world.GetMask(item) & LayerMask((RenderLayer)layer))
+				return layer;
+		return -1;
+	}
+
+	// The loaded item at x = index of every item of the original.
+	std::map<int, ecs::Entity> ItemsByIndex(Scene& scene)
+	{
+		std::map<int, ecs::Entity> items;
+		scene.GetWorld().ForEachChunk(ecs::MaskOf<TransformComponent, RenderStateComponent>(), [&](ecs::Chunk& chunk)
+		{
+			for (uint32_t i = 0; i < chunk.Count; ++i)
+			{
+				ecs::Entity item = chunk.Entities()[i];
+				items[(int)scene.GetLocalTransform(item).Translation.x] = item;
+			}
+		});
+		return items;
+	}
+
+	bool SameBytes(const void* a, const void* b, size_t size)
+	{
+		return std::memcmp(a, b, size) == 0;
+	}
+}
+
+TEST(SceneFileRoundTripKeepsEveryItem)
+{
+	const int count = 60;
+
+	SceneFixture saved;
+	saved.Populate(count);
+
+	// Parented items keep their world transform, so give the locals back
+	// their unique x.
+	for (int i = 0; i < count; ++i)
+	{
+		LocalTransform local = saved.World.GetLocalTransform(saved.Items[i]);
+		local.Translation.x = float(i);
+		saved.World.SetLocalTransform(saved.Items[i], local);
+	}
+	saved.World.UpdateTransforms();
+
+	const std::string path = TempPath("ZeroRendererTests.zscn");
+	CHECK(SceneSerializer::Save(path, saved.World, saved.Materials));
+
+	SceneFixture loaded;
+	SceneSerializer::Limits limits;
+	limits.MaxMaterials = 3;
+	CHECK(SceneSerializer::Load(path, loaded.World, loaded.Materials, loaded.Geometries, limits));
+	CHECK(loaded.World.GetRitemSize() == saved.World.GetRitemSize());
+
+	ecs::World& savedWorld = saved.World.GetWorld();
+	ecs::World& loadedWorld = loaded.World.GetWorld();
+
+	std::map<int, ecs::Entity> items = ItemsByIndex(loaded.World);
+	CHECK(items.size() == (size_t)count);
+
+	for (int i = 0; i < count && items.size() == (size_t)count; ++i)
+	{
+		ecs::Entity a = saved.Items[i];
+		ecs::Entity b = items[i];
+
+		CHECK(SameBytes(savedWorld.Get<TransformComponent>(a), loadedWorld.Get<TransformComponent>(b), sizeof(TransformComponent)));
+		CHECK(SameBytes(&saved.World.GetLocalTransform(a), &loaded.World.GetLocalTransform(b), sizeof(LocalTransform)));
+		CHECK(SameBytes(savedWorld.Get<BoundsComponent>(a), loadedWorld.Get<BoundsComponent>(b), sizeof(BoundsComponent)));
+
+		ecs::Entity savedParent = saved.World.GetHierarchy().GetParent(a);
+		ecs::Entity loadedParent = loaded.World.GetHierarchy().GetParent(b);
+		CHECK((savedParent == ecs::NullEntity) == (loadedParent == ecs::NullEntity));
+		if (savedParent != ecs::NullEntity && loadedParent != ecs::NullEntity)
+			CHECK(saved.World.GetLocalTransform(savedParent).Translation.x == loaded.World.GetLocalTransform(loadedParent).Translation.x);
+
+		CHECK(LayerOf(savedWorld, a) == LayerOf(loadedWorld, b));
+		CHECK(savedWorld.Get<RenderStateComponent>(a)->Visible == loadedWorld.Get<RenderStateComponent>(b)->Visible);
+		CHECK(saved.World.IsOccluder(a) == loaded.World.IsOccluder(b));
+		CHECK(saved.World.IsStatic(a) == loaded.World.IsStatic(b));
+
+		const MeshComponent* savedMesh = savedWorld.Get<MeshComponent>(a);
+		const MeshComponent* loadedMesh = loadedWorld.Get<MeshComponent>(b);
+		CHECK(loadedMesh->Geo == loaded.Geometries["shapeGeo"].get());
+		CHECK(savedMesh->IndexCount == loadedMesh->IndexCount);
+		CHECK(savedMesh->StartIndexLocation == loadedMesh->StartIndexLocation);
+		CHECK(savedMesh->BaseVertexLocation == loadedMesh->BaseVertexLocation);
+
+		CHECK(savedWorld.Get<MaterialComponent>(a)->Mat->Name == loadedWorld.Get<MaterialComponent>(b)->Mat->Name);
+	}
+
+	saved.Materials.ForEachMaterial([&](const Material& mat)
+	{
+		const Material* other = loaded.Materials.FindMaterial(mat.Name);
+		CHECK(other != nullptr);
+		if (!other)
+			return;
+
+		CHECK(other->MatCBIndex == mat.MatCBIndex);
+		CHECK(other->DiffuseSrvHeapIndex == mat.DiffuseSrvHeapIndex);
+		CHECK(other->NormalSrvHeapIndex == mat.NormalSrvHeapIndex);
+		CHECK(SameBytes(&other->DiffuseAlbedo, &mat.DiffuseAlbedo, sizeof(XMFLOAT4)));
+		CHECK(SameBytes(&other->FresnelR0, &mat.FresnelR0, sizeof(XMFLOAT3)));
+		CHECK(other->Roughness == mat.Roughness);
+		CHECK(SameBytes(&other->MatTransform, &mat.MatTransform, sizeof(XMFLOAT4X4)));
+	});
+
+	// The hierarchy rebuilds the same world matrices.
+	loaded.World.UpdateTransforms();
+	for (int i = 0; i < count && items.size() == (size_t)count; ++i)
+	{
+		const XMFLOAT4X4& a = savedWorld.Get<TransformComponent>(saved.Items[i])->World;
+		const XMFLOAT4X4& b = loadedWorld.Get<TransformComponent>(items[i])->World;
+		for (int k = 0; k < 16; ++k)
+			CHECK(std::fabs((&a._11)[k] - (&b._11)[k]) < 1e-4f);
+	}
+
+	// Saving the loaded scene writes the same file.
+	const std::string again = TempPath("ZeroRendererTests2.zscn");
+	CHECK(SceneSerializer::Save(again, loaded.World, loaded.Materials));
+	CHECK(ReadBytes(path) == ReadBytes(again));
+
+	std::filesystem::remove(path);
+	std::filesystem::remove(again);
+}
+
+TEST(SceneFileRejectsTruncatedFiles)
+{
+	SceneFixture saved;
+	saved.Populate(30);
+
+	const std::string path = TempPath("ZeroRendererTests.zscn");
+	CHECK(SceneSerializer::Save(path, saved.World, saved.Materials));
+
+	const std::vector<char> bytes = ReadBytes(path);
+	const FileLayout layout = LayoutOf(bytes);
+	CHECK(layout.Flags + layout.ItemCount <= bytes.size());
+
+	SceneFixture target;
+	target.Populate(5);
+
+	// Every cut before the end of the last array; only its padding may go.
+	for (size_t size = 0; size < layout.Flags + layout.ItemCount; ++size)
+	{
+		WriteBytes(path, bytes, size);
+		if (SceneSerializer::Load(path, target.World, target.Materials, target.Geometries, {}))
+		{
+			CHECK(!"a truncated file loaded");
+			break;
+		}
+	}
+	CHECK(target.World.GetRitemSize() == 5);
+
+	WriteBytes(path, bytes, layout.Flags + layout.ItemCount);
+	CHECK(SceneSerializer::Load(path, target.World, target.Materials, target.Geometries, {}));
+	CHECK(target.World.GetRitemSize() == 30);
+
+	CHECK(!SceneSerializer::Load(TempPath("ZeroRendererTestsMissing.zscn"), target.World, target.Materials, target.Geometries, {}));
+
+	std::filesystem::remove(path);
+}
+
+TEST(SceneFileRejectsCorruptFiles)
+{
+	SceneFixture saved;
+	saved.Populate(30);
+
+	const std::string path = TempPath("ZeroRendererTests.zscn");
+	CHECK(SceneSerializer::Save(path, saved.World, saved.Materials));
+
+	const std::vector<char> bytes = ReadBytes(path);
+	const FileLayout layout = LayoutOf(bytes);
+
+	SceneFixture target;
+	target.Populate(5);
+
+	SceneSerializer::Limits limits;
+	limits.MaxMaterials = 3;
+
+	auto loads = [&](const std::vector<char>& file, const SceneSerializer::Limits& with)
+	{
+		WriteBytes(path, file, file.size());
+		return SceneSerializer::Load(path, target.World, target.Materials, target.Geometries, with);
+	};
+
+	auto rejects = [&](auto&& corrupt)
+	{
+		std::vector<char> file = bytes;
+		corrupt(file);
+		return !loads(file, limits);
+	};
+
+	const size_t last = layout.ItemCount - 1;
+
+	// Header
+	CHECK(rejects([&](auto& f) { Poke<uint32_t>(f, 0, 0x12345678); }));
+	CHECK(rejects([&](auto& f) { Poke<uint32_t>(f, 4, SceneSerializer::Version + 1); }));
+	CHECK(rejects([&](auto& f) { Poke<uint32_t>(f, 8, 0xFFFFFFF0u); }));
+	CHECK(rejects([&](auto& f) { Poke<uint32_t>(f, 20, 0xFFFFFFFFu); }));
+
+	// Strings and materials
+	CHECK(rejects([&](auto& f) { f[layout.Strings + layout.StringBytes - 1] = 'x'; }));
+	CHECK(rejects([&](auto& f) { Poke<uint32_t>(f, layout.Materials, layout.StringBytes); }));
+	CHECK(rejects([&](auto& f) { Poke<int32_t>(f, layout.Materials + 4, -1); }));
+	CHECK(rejects([&](auto& f) { Poke<int32_t>(f, layout.Materials + 4, 3); }));
+
+	// Geometry that is not loaded
+	const char geometryName[] = "shapeGeo";
+	auto geometry = std::search(bytes.begin() + layout.Strings, bytes.begin() + layout.Strings + layout.StringBytes,
+		geometryName, geometryName + sizeof(geometryName));
+	CHECK(rejects([&](auto& f) { f[geometry - bytes.begin()] = 'X'; }));
+
+	// Item indices
+	CHECK(rejects([&](auto& f) { Poke<uint32_t>(f, layout.ItemSubmeshes + 4 * last, layout.SubmeshCount); }));
+	CHECK(rejects([&](auto& f) { Poke<uint32_t>(f, layout.ItemMaterials, layout.MaterialCount); }));
+	CHECK(rejects([&](auto& f) { Poke<int32_t>(f, layout.Parents, -2); }));
+	CHECK(rejects([&](auto& f) { Poke<int32_t>(f, layout.Parents + 4 * last, (int32_t)layout.ItemCount); }));
+	CHECK(rejects([&](auto& f) { Poke<int32_t>(f, layout.Parents + 4 * 7, 7); }));
+	CHECK(rejects([&](auto& f) { Poke<int32_t>(f, layout.Parents, 1); Poke<int32_t>(f, layout.Parents + 4, 0); }));
+	CHECK(rejects([&](auto& f)
+	{
+		Poke<int32_t>(f, layout.Parents + 4 * 2, 3);
+		Poke<int32_t>(f, layout.Parents + 4 * 3, 4);
+		Poke<int32_t>(f, layout.Parents + 4 * 4, 2);
+	}));
+	CHECK(rejects([&](auto& f) { f[layout.Layers + last] = (char)RenderLayer::Count; }));
+
+	// Limits
+	SceneSerializer::Limits fewItems = limits;
+	fewItems.MaxItems = layout.ItemCount - 1;
+	CHECK(!loads(bytes, fewItems));
+
+	SceneSerializer::Limits fewMaterials = limits;
+	fewMaterials.MaxMaterials = 2;
+	CHECK(!loads(bytes, fewMaterials));
+
+	// None of the rejected files changed the scene.
+	CHECK(target.World.GetRitemSize() == 5);
+	CHECK(target.Materials.GetSize() == 3);
+
+	CHECK(loads(bytes, limits));
+	CHECK(target.World.GetRitemSize() == 30);
+
+	std::filesystem::remove(path);
+}
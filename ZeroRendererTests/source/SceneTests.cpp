@@ -0,0 +1,116 @@
+#include "Test.h"
+
+#include "Engine/Scene.h"
+
+#include <algorithm>
+#include <random>
+
+// Random creates and destroys: no two live items share an instance slot, the
+// draw items follow the live items, and the slots never exceed the most
+// items that were alive at once.
+TEST(DestroyedObjectSlotsAreReused)
+{
+	MeshGeometry geo;
+	SubmeshGeometry box;
+	box.IndexCount = 36;
+	box.Bounds = BoundingBox({ 0.0f, 0.0f, 0.0f }, { 0.5f, 0.5f, 0.5f });
+	geo.DrawArgs["box"] = box;
+
+	Material mat;
+
+	std::mt19937 rng(35);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+
+	Scene scene;
+	std::vector<ecs::Entity> live;
+	size_t peak = 0;
+
+	for (int step = 0; step < 20000; ++step)
+	{
+		bool create = live.empty() || (live.size() < 500 && rng() % 2);
+		if (create)
+		{
+			live.push_back(scene.CreateRenderItem(RenderLayer::Opaque,
+				XMMatrixTranslation(position(rng), position(rng), position(rng)), XMMatrixIdentity(),
+				&mat, &geo, box.IndexCount, 0, 0, box.Bounds));
+			peak = std::max(peak, live.size());
+		}
+		else
+		{
+			size_t victim = rng() % live.size();
+			scene.DestroyRenderItem(live[victim]);
+			live[victim] = live.back();
+			live.pop_back();
+		}
+
+		if (step % 1000 != 999)
+			continue;
+
+		std::vector<UINT> slots;
+		for (ecs::Entity item : live)
+			slots.push_back(scene.GetWorld().Get<RenderStateComponent>(item)->ObjectIndex);
+		std::sort(slots.begin(), slots.end());
+		CHECK(std::adjacent_find(slots.begin(), slots.end()) == slots.end());
+		CHECK(slots.empty() || slots.back() < scene.GetObjectData().size());
+
+		std::vector<UINT> drawn;
+		for (const DrawItem& draw : scene.GetDrawItems(RenderLayer::Opaque))
+			drawn.push_back(draw.ObjectIndex);
+		std::sort(drawn.begin(), drawn.end());
+		CHECK(drawn == slots);
+
+		CHECK(scene.GetRitemSize() == live.size());
+		CHECK(scene.GetObjectData().size() == peak);
+	}
+}
+
+// Compacting after a wave of deletions moves every item below the item count
+// and keeps the slots unique, whatever holes the deletions left.
+TEST(CompactedObjectSlotsStayUnique)
+{
+	MeshGeometry geo;
+	SubmeshGeometry box;
+	box.IndexCount = 36;
+	box.Bounds = BoundingBox({ 0.0f, 0.0f, 0.0f }, { 0.5f, 0.5f, 0.5f });
+	geo.DrawArgs["box"] = box;
+
+	Material mat;
+
+	std::mt19937 rng(36);
+
+	Scene scene;
+	std::vector<ecs::Entity> live;
+	for (int i = 0; i < 1000; ++i)
+	{
+		live.push_back(scene.CreateRenderItem(RenderLayer::Opaque, XMMatrixTranslation(float(i), 0.0f, 0.0f), XMMatrixIdentity(),
+			&mat, &geo, box.IndexCount, 0, 0, box.Bounds));
+	}
+
+	std::shuffle(live.begin(), live.end(), rng);
+	for (int i = 0; i < 800; ++i)
+	{
+		scene.DestroyRenderItem(live.back());
+		live.pop_back();
+	}
+
+	scene.CompactObjectIndices();
+	CHECK(scene.GetObjectData().size() == live.size());
+
+	std::vector<UINT> slots;
+	for (ecs::Entity item : live)
+		slots.push_back(scene.GetWorld().Get<RenderStateComponent>(item)->ObjectIndex);
+	std::sort(slots.begin(), slots.end());
+	CHECK(std::adjacent_find(slots.begin(), slots.end()) == slots.end());
+	CHECK(slots.back() < scene.GetObjectData().size());
+
+	std::vector<UINT> drawn;
+	for (const DrawItem& draw : scene.GetDrawItems(RenderLayer::Opaque))
+		drawn.push_back(draw.ObjectIndex);
+	std::sort(drawn.begin(), drawn.end());
+	CHECK(drawn == slots);
+
+	// New items take slots above the compacted ones.
+	ecs::Entity added = scene.CreateRenderItem(RenderLayer::Opaque, XMMatrixIdentity(), XMMatrixIdentity(),
+		&mat, &geo, box.IndexCount, 0, 0, box.Bounds);
+	CHECK(scene.GetWorld().Get<RenderStateComponent>(added)->ObjectIndex == live.size());
+}
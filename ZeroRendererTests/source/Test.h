@@ -0,0 +1,48 @@
+#pragma once
+
+//
+// A minimal test registry for the CPU-side code of the renderer.
+//
+//     TEST(WorldReusesSlots)
+//     {
+//         CHECK(world.IsAlive(e));
+//     }
+//
+// CHECK records a failure and carries on; CHECK_TEXT compares text, such as a
+// golden plan, and prints both sides when they differ. Main runs every test,
+// or those whose name contains the first argument, and returns the number
+// that failed.
+//
+
+#include <string>
+#include <vector>
+
+namespace test
+{
+	struct TestCase
+	{
+		const char* Name;
+		void (*Func)();
+	};
+
+	std::vector<TestCase>& Registry();
+
+	void Fail(const char* file, int line, const char* expr);
+	void CheckText(const std::string& actual, const std::string& expected, const char* file, int line);
+
+	struct Registrar
+	{
+		Registrar(const char* name, void (*func)()) { Registry().push_back({ name, func }); }
+	};
+}
+
+#define TEST(name) \
+	static void name(); \
+	static test::Registrar name##Registrar(#name, name); \
+	static void name()
+
+#define CHECK(expr) \
+	do { if (!(expr)) test::Fail(__FILE__, __LINE__, #expr); } while (0)
+
+#define CHECK_TEXT(actual, expected) \
+	test::CheckText((actual), (expected), __FILE__, __LINE__)